@@ -0,0 +1,30 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include "host_serial.h"
+
+int host_serial_open(const char *path, int flags) {
+    if (strcmp(path, "-") == 0) {
+        return dup(STDIN_FILENO);
+    }
+
+    int fd = open(path, flags | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (isatty(fd)) {
+        struct termios tio;
+        if (tcgetattr(fd, &tio) == 0) {
+            // USB-Serial-JTAG ignores the baud rate, a real UART needs the console speed
+            cfmakeraw(&tio);
+            cfsetispeed(&tio, B115200);
+            cfsetospeed(&tio, B115200);
+            tio.c_cc[VMIN] = 1;
+            tio.c_cc[VTIME] = 0;
+            tcsetattr(fd, TCSANOW, &tio);
+        }
+    }
+    return fd;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Open a capture input for reading: "-" is stdin, a tty (including a pty
+// stand-in) is switched to raw mode, anything else is opened as a file.
+// Returns a file descriptor or -1 with errno set.
+int host_serial_open(const char *path, int flags);
+
+#ifdef __cplusplus
+}
+#endif
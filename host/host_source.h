@@ -0,0 +1,74 @@
+#pragma once
+
+// Frame sources for the host build. Each source produces records shaped like
+// the ones the ESP-IDF Wi-Fi driver hands to the promiscuous callback, so the
+// scanner core can be fed exactly as on the device.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest 802.11 frame a source will emit (payload bytes after rx_ctrl)
+#define HOST_FRAME_MAX 2400
+
+typedef struct {
+    wifi_promiscuous_pkt_type_t type;
+    uint16_t len;           // Payload bytes present in the buffer
+    uint64_t time_us;       // Unwrapped receive time, rx_ctrl.timestamp keeps the low 32 bits
+    union {
+        wifi_promiscuous_pkt_t pkt;
+        uint8_t raw[sizeof(wifi_promiscuous_pkt_t) + HOST_FRAME_MAX];
+    };
+} host_frame_t;
+
+typedef struct host_source host_source_t;
+
+struct host_source {
+    // Returns 1 when a frame was produced, 0 at end of input and -1 on error
+    int (*next)(host_source_t *src, host_frame_t *frame);
+    void (*close)(host_source_t *src);
+};
+
+// Radiotap (linktype 127) or bare 802.11 (linktype 105) pcap file.
+// Frames without a channel field are assigned default_channel.
+host_source_t *pcap_source_open(const char *path, int default_channel);
+
+typedef struct {
+    uint64_t seed;
+    uint64_t count;         // Frames to produce, 0 for unlimited
+    uint32_t fps;           // Average on-air frame rate across all channels
+    uint32_t dwell_ms;      // Receiver hop interval, only frames on the current channel are heard.
+                            // 0 hears every channel; the caller then models the tuner itself.
+    int channels;           // Receiver walks channels 1..channels
+    int stations;           // Client population
+    int aps;                // Access point population
+} synth_config_t;
+
+#define SYNTH_CONFIG_DEFAULT() {    \
+    .seed = 1,                      \
+    .count = 0,                     \
+    .fps = 2000,                    \
+    .dwell_ms = 150,                \
+    .channels = 13,                 \
+    .stations = 64,                 \
+    .aps = 12,                      \
+}
+
+// Synthetic airspace with beacons, probes, data and control frames
+host_source_t *synth_source_open(const synth_config_t *cfg);
+
+static inline int host_source_next(host_source_t *src, host_frame_t *frame) {
+    return src->next(src, frame);
+}
+
+static inline void host_source_close(host_source_t *src) {
+    src->close(src);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_source.h"
+#include "scan_frame.h"
+
+#define PCAP_MAGIC_US   0xa1b2c3d4u
+#define PCAP_MAGIC_NS   0xa1b23c4du
+
+#define LINKTYPE_IEEE802_11          105
+#define LINKTYPE_IEEE802_11_RADIOTAP 127
+
+// Radiotap flags field
+#define RT_FLAG_FCS     0x10
+#define RT_FLAG_BADFCS  0x40
+
+#define FCS_LEN 4
+
+typedef struct {
+    host_source_t base;
+    FILE *fp;
+    bool swapped;
+    bool nanosec;
+    uint32_t linktype;
+    int default_channel;
+    bool have_first;
+    uint64_t first_us;
+    uint8_t buf[65536];
+} pcap_source_t;
+
+// Alignment and size of the radiotap fields we know, indexed by presence bit
+static const struct {
+    uint8_t align;
+    uint8_t size;
+} rt_fields[] = {
+    [0]  = {8, 8},   // TSFT
+    [1]  = {1, 1},   // Flags
+    [2]  = {1, 1},   // Rate
+    [3]  = {2, 4},   // Channel
+    [4]  = {1, 2},   // FHSS
+    [5]  = {1, 1},   // Antenna signal, dBm
+    [6]  = {1, 1},   // Antenna noise, dBm
+    [7]  = {2, 2},   // Lock quality
+    [8]  = {2, 2},   // TX attenuation
+    [9]  = {2, 2},   // dB TX attenuation
+    [10] = {1, 1},   // dBm TX power
+    [11] = {1, 1},   // Antenna
+    [12] = {1, 1},   // Antenna signal, dB
+    [13] = {1, 1},   // Antenna noise, dB
+    [14] = {2, 2},   // RX flags
+    [15] = {2, 2},   // TX flags
+    [16] = {1, 1},   // RTS retries
+    [17] = {1, 1},   // Data retries
+    [18] = {4, 8},   // XChannel
+    [19] = {1, 3},   // MCS
+    [20] = {4, 8},   // A-MPDU status
+    [21] = {2, 12},  // VHT
+    [22] = {8, 12},  // Timestamp
+};
+
+#define RT_KNOWN_FIELDS (int)(sizeof(rt_fields) / sizeof(rt_fields[0]))
+
+static uint32_t rd32(const pcap_source_t *s, const uint8_t *p) {
+    uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    return s->swapped ? __builtin_bswap32(v) : v;
+}
+
+static uint16_t le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t le32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Map a legacy rate in 500 kbps units to the driver's rx_ctrl.rate encoding
+static int rate_to_esp(uint8_t rate) {
+    switch (rate) {
+    case 2:   return 0x00;  // 1 Mbps
+    case 4:   return 0x01;  // 2 Mbps
+    case 11:  return 0x02;  // 5.5 Mbps
+    case 22:  return 0x03;  // 11 Mbps
+    case 96:  return 0x08;  // 48 Mbps
+    case 48:  return 0x09;  // 24 Mbps
+    case 24:  return 0x0A;  // 12 Mbps
+    case 12:  return 0x0B;  // 6 Mbps
+    case 108: return 0x0C;  // 54 Mbps
+    case 72:  return 0x0D;  // 36 Mbps
+    case 36:  return 0x0E;  // 18 Mbps
+    case 18:  return 0x0F;  // 9 Mbps
+    default:  return 0x0B;
+    }
+}
+
+static int freq_to_channel(uint16_t freq) {
+    if (freq == 2484) return 14;
+    if (freq >= 2412 && freq < 2484) return (freq - 2407) / 5;
+    return 0;  // Not a 2.4 GHz channel, rx_ctrl.channel cannot represent it
+}
+
+// Fill rx_ctrl from a radiotap header, returns the header length or -1
+static int parse_radiotap(const uint8_t *p, uint32_t caplen, wifi_pkt_rx_ctrl_t *rx, bool *has_fcs) {
+    if (caplen < 8 || p[0] != 0) return -1;
+
+    uint16_t it_len = le16(p + 2);
+    if (it_len > caplen || it_len < 8) return -1;
+
+    // Skip the chain of presence words, fields start after the last one
+    uint32_t present = le32(p + 4);
+    uint32_t off = 8;
+    uint32_t word = present;
+    while ((word & BIT(31)) && off + 4 <= it_len) {
+        word = le32(p + off);
+        off += 4;
+    }
+
+    for (int bit = 0; bit < 29; bit++) {
+        if (!(present & BIT(bit))) continue;
+        if (bit >= RT_KNOWN_FIELDS || rt_fields[bit].size == 0) break;
+
+        uint32_t align = rt_fields[bit].align;
+        off = (off + align - 1) & ~(align - 1);
+        if (off + rt_fields[bit].size > it_len) break;
+
+        const uint8_t *f = p + off;
+        switch (bit) {
+        case 1:
+            *has_fcs = (f[0] & RT_FLAG_FCS) != 0;
+            if (f[0] & RT_FLAG_BADFCS) rx->rx_state = BIT(0);
+            break;
+        case 2:
+            rx->rate = rate_to_esp(f[0]);
+            break;
+        case 3:
+            rx->channel = freq_to_channel(le16(f));
+            break;
+        case 5:
+            rx->rssi = (int8_t)f[0];
+            break;
+        case 6:
+            rx->noise_floor = (int8_t)f[0];
+            break;
+        case 19: {
+            // known, flags, mcs
+            rx->sig_mode = 1;
+            rx->mcs = f[2] & 0x7f;
+            rx->cwb = (f[1] & 0x03) == 1;
+            rx->sgi = (f[1] & 0x04) != 0;
+            break;
+        }
+        case 21: {
+            // known(2), flags, bandwidth, mcs_nss[4], coding, group_id, partial_aid(2)
+            rx->sig_mode = 3;
+            rx->mcs = f[4] >> 4;
+            rx->cwb = f[3] != 0;
+            rx->sgi = (f[2] & 0x04) != 0;
+            break;
+        }
+        default:
+            break;
+        }
+        off += rt_fields[bit].size;
+    }
+    return it_len;
+}
+
+static wifi_promiscuous_pkt_type_t frame_type(const uint8_t *frame, uint32_t len) {
+    if (len < 1) return WIFI_PKT_MISC;
+    switch ((frame[0] >> 2) & 0x3) {
+    case 0:  return WIFI_PKT_MGMT;
+    case 1:  return WIFI_PKT_CTRL;
+    case 2:  return WIFI_PKT_DATA;
+    default: return WIFI_PKT_MISC;
+    }
+}
+
+static int pcap_next(host_source_t *src, host_frame_t *frame) {
+    pcap_source_t *s = (pcap_source_t *)src;
+    uint8_t rec[16];
+
+    for (;;) {
+        if (fread(rec, 1, sizeof(rec), s->fp) != sizeof(rec)) {
+            return 0;
+        }
+
+        uint32_t ts_sec = rd32(s, rec);
+        uint32_t ts_frac = rd32(s, rec + 4);
+        uint32_t caplen = rd32(s, rec + 8);
+        uint32_t origlen = rd32(s, rec + 12);
+        if (caplen > sizeof(s->buf)) {
+            fprintf(stderr, "pcap: record of %u bytes exceeds buffer\n", caplen);
+            return -1;
+        }
+        if (fread(s->buf, 1, caplen, s->fp) != caplen) {
+            return 0;  // Truncated final record
+        }
+
+        wifi_pkt_rx_ctrl_t *rx = &frame->pkt.rx_ctrl;
+        memset(rx, 0, sizeof(*rx));
+        rx->rate = 0x0B;
+        rx->rssi = -100;
+        rx->noise_floor = -96;
+        rx->channel = s->default_channel;
+
+        bool has_fcs = s->linktype == LINKTYPE_IEEE802_11;
+        int hdr_len = 0;
+        if (s->linktype == LINKTYPE_IEEE802_11_RADIOTAP) {
+            hdr_len = parse_radiotap(s->buf, caplen, rx, &has_fcs);
+            if (hdr_len < 0) continue;  // Skip malformed records
+        }
+
+        uint64_t t_us = (uint64_t)ts_sec * 1000000u + (s->nanosec ? ts_frac / 1000u : ts_frac);
+        if (!s->have_first) {
+            s->first_us = t_us;
+            s->have_first = true;
+        }
+        t_us -= s->first_us;
+
+        if (origlen < (uint32_t)hdr_len) continue;
+
+        const uint8_t *body = s->buf + hdr_len;
+        uint32_t body_len = caplen - (uint32_t)hdr_len;
+        uint32_t air_len = origlen - (uint32_t)hdr_len + (has_fcs ? 0 : FCS_LEN);
+        uint32_t copy = body_len < HOST_FRAME_MAX ? body_len : HOST_FRAME_MAX;
+
+        memcpy(frame->pkt.payload, body, copy);
+        rx->sig_len = air_len > 0xfff ? 0xfff : air_len;
+        // The core reads header fields up to the beacon timestamps wherever
+        // sig_len says they are; a record cut short before them by the snap
+        // length must not have them read from the previous frame
+        if (copy < SCAN_BCN_FIXED_END && copy < rx->sig_len) {
+            rx->sig_len = copy;
+        }
+        rx->timestamp = (uint32_t)t_us;
+        frame->len = (uint16_t)copy;
+        frame->time_us = t_us;
+        frame->type = frame_type(body, body_len);
+        return 1;
+    }
+}
+
+static void pcap_close(host_source_t *src) {
+    pcap_source_t *s = (pcap_source_t *)src;
+    fclose(s->fp);
+    free(s);
+}
+
+host_source_t *pcap_source_open(const char *path, int default_channel) {
+    pcap_source_t *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+
+    s->fp = fopen(path, "rb");
+    if (!s->fp) {
+        perror(path);
+        free(s);
+        return NULL;
+    }
+
+    uint8_t hdr[24];
+    if (fread(hdr, 1, sizeof(hdr), s->fp) != sizeof(hdr)) {
+        fprintf(stderr, "%s: not a pcap file\n", path);
+        pcap_close(&s->base);
+        return NULL;
+    }
+
+    uint32_t magic = le32(hdr);
+    if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS) {
+        s->swapped = false;
+    } else if (magic == __builtin_bswap32(PCAP_MAGIC_US) || magic == __builtin_bswap32(PCAP_MAGIC_NS)) {
+        s->swapped = true;
+        magic = __builtin_bswap32(magic);
+    } else {
+        fprintf(stderr, "%s: unknown pcap magic 0x%08x (pcapng is not supported)\n", path, magic);
+        pcap_close(&s->base);
+        return NULL;
+    }
+    s->nanosec = magic == PCAP_MAGIC_NS;
+    s->linktype = rd32(s, hdr + 20) & 0x0fffffff;
+
+    if (s->linktype != LINKTYPE_IEEE802_11_RADIOTAP && s->linktype != LINKTYPE_IEEE802_11) {
+        fprintf(stderr, "%s: unsupported linktype %u, need 802.11 or radiotap\n", path, s->linktype);
+        pcap_close(&s->base);
+        return NULL;
+    }
+
+    s->default_channel = default_channel;
+    s->base.next = pcap_next;
+    s->base.close = pcap_close;
+    return &s->base;
+}
@@ -0,0 +1,669 @@
+#include <string.h>
+#include "scan_decode.h"
+
+static void decode_dist(scan_tlm_reader_t *sec, int nchan, scan_decoded_dist_t *d) {
+    d->window_s = scan_tlm_get_varint(sec);
+    for (int i = 0; i < nchan; i++) {
+        scan_hist_summary_t *s = &d->ch[i];
+        s->count = scan_tlm_get_varint(sec);
+        if (s->count == 0) continue;
+        s->min = (int8_t)scan_tlm_get_svarint(sec);
+        s->p10 = (int8_t)(s->min + scan_tlm_get_varint(sec));
+        s->p50 = (int8_t)(s->p10 + scan_tlm_get_varint(sec));
+        s->p90 = (int8_t)(s->p50 + scan_tlm_get_varint(sec));
+        s->max = (int8_t)(s->p90 + scan_tlm_get_varint(sec));
+    }
+}
+
+// Next optional section into sec, false at the end of the payload or on a bad length
+static bool next_section(scan_tlm_reader_t *r, uint32_t *tag, scan_tlm_reader_t *sec) {
+    if (scan_tlm_reader_done(r)) return false;
+
+    *tag = scan_tlm_get_varint(r);
+    uint16_t len = scan_tlm_get_u16(r);
+    if (r->error || (size_t)(r->end - r->p) < len) {
+        r->error = true;
+        return false;
+    }
+    scan_tlm_reader_init(sec, r->p, len);
+    r->p += len;
+    return true;
+}
+
+// Optional sections of a sweep or its continuation, unknown tags are skipped
+static void decode_sweep_sections(scan_tlm_reader_t *r, scan_decoded_sweep_t *out) {
+    uint32_t tag;
+    scan_tlm_reader_t sec;
+
+    out->continued = false;
+    while (next_section(r, &tag, &sec)) {
+        switch (tag) {
+        case SCAN_TLM_SEC_DWELL:
+            for (int i = 0; i < out->nchan; i++) {
+                out->ch[i].dwell_ms = scan_tlm_get_varint(&sec);
+            }
+            out->has_dwell = !sec.error;
+            break;
+        case SCAN_TLM_SEC_AIRTIME:
+            for (int i = 0; i < out->nchan; i++) {
+                out->ch[i].airtime_us = scan_tlm_get_varint(&sec);
+            }
+            out->has_airtime = !sec.error;
+            break;
+        case SCAN_TLM_SEC_FRAMES: {
+            uint32_t nclass = scan_tlm_get_varint(&sec);
+            if (nclass > SCAN_DECODE_MAX_CLASSES) break;
+            for (int i = 0; i < out->nchan; i++) {
+                out->ch[i].retries = scan_tlm_get_varint(&sec);
+                for (uint32_t cls = 0; cls < nclass; cls++) {
+                    out->ch[i].frames[cls] = scan_tlm_get_varint(&sec);
+                }
+            }
+            out->nclass = sec.error ? 0 : (int)nclass;
+            break;
+        }
+        case SCAN_TLM_SEC_NOISE:
+            for (int i = 0; i < out->nchan; i++) {
+                scan_decoded_channel_t *c = &out->ch[i];
+                c->nf_avg = scan_tlm_get_svarint(&sec);
+                uint32_t range = scan_tlm_get_varint(&sec);
+                if (range == 0) continue;
+                c->has_nf_range = true;
+                c->nf_min = (int8_t)scan_tlm_get_svarint(&sec);
+                c->nf_max = (int8_t)(c->nf_min + range - 1);
+            }
+            out->has_noise = !sec.error;
+            break;
+        case SCAN_TLM_SEC_SNR: {
+            uint32_t bin_db = scan_tlm_get_varint(&sec);
+            for (int i = 0; i < out->nchan; i++) {
+                uint32_t nbins = scan_tlm_get_varint(&sec);
+                if (nbins > SCAN_DECODE_MAX_SNR_BINS) {
+                    sec.error = true;
+                    break;
+                }
+                out->ch[i].nsnr = (int)nbins;
+                for (uint32_t bin = 0; bin < nbins; bin++) {
+                    out->ch[i].snr[bin] = scan_tlm_get_varint(&sec);
+                }
+            }
+            out->snr_bin_db = sec.error ? 0 : bin_db;
+            break;
+        }
+        case SCAN_TLM_SEC_DIST:
+            if (out->ndist < SCAN_DECODE_MAX_DISTS) {
+                decode_dist(&sec, out->nchan, &out->dist[out->ndist]);
+                if (!sec.error) out->ndist++;
+            }
+            break;
+        case SCAN_TLM_SEC_CONTINUED:
+            out->continued = true;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+bool scan_decode_sweep(const scan_tlm_frame_t *frame, scan_decoded_sweep_t *out) {
+    scan_tlm_reader_t r;
+    int32_t rssi = SCAN_RSSI_FLOOR;
+
+    if (frame->type != SCAN_TLM_SWEEP) return false;
+
+    memset(out, 0, sizeof(*out));
+    scan_tlm_reader_init(&r, frame->payload, frame->len);
+    out->seq = frame->seq;
+    out->iteration = scan_tlm_get_varint(&r);
+    out->time_ms = scan_tlm_get_varint(&r);
+    out->dropped = scan_tlm_get_varint(&r);
+
+    uint32_t nchan = scan_tlm_get_varint(&r);
+    if (nchan > SCAN_DECODE_MAX_CHANNELS) return false;
+    out->nchan = (int)nchan;
+
+    for (int i = 0; i < out->nchan; i++) {
+        rssi += scan_tlm_get_svarint(&r);
+        out->ch[i].rssi = rssi;
+        out->ch[i].packets = scan_tlm_get_varint(&r);
+        out->ch[i].errors = scan_tlm_get_varint(&r);
+    }
+
+    decode_sweep_sections(&r, out);
+    return !r.error;
+}
+
+bool scan_decode_sweep_more(const scan_tlm_frame_t *frame, scan_decoded_sweep_t *sweep) {
+    scan_tlm_reader_t r;
+
+    if (frame->type != SCAN_TLM_SWEEP_MORE || !sweep->continued) return false;
+
+    scan_tlm_reader_init(&r, frame->payload, frame->len);
+    uint32_t iteration = scan_tlm_get_varint(&r);
+    uint32_t time_ms = scan_tlm_get_varint(&r);
+    uint32_t nchan = scan_tlm_get_varint(&r);
+    if (r.error || iteration != sweep->iteration || time_ms != sweep->time_ms || nchan != (uint32_t)sweep->nchan) {
+        return false;
+    }
+
+    decode_sweep_sections(&r, sweep);
+    return !r.error;
+}
+
+bool scan_decode_aps(const scan_tlm_frame_t *frame, scan_decoded_aps_t *out) {
+    scan_tlm_reader_t r;
+
+    if (frame->type != SCAN_TLM_APS) return false;
+
+    memset(out, 0, sizeof(*out));
+    scan_tlm_reader_init(&r, frame->payload, frame->len);
+    out->seq = frame->seq;
+    out->time_ms = scan_tlm_get_varint(&r);
+
+    uint32_t count = scan_tlm_get_varint(&r);
+    if (count > SCAN_DECODE_MAX_APS) return false;
+    out->count = count;
+
+    for (size_t i = 0; i < out->count; i++) {
+        scan_tlm_ap_t *ap = &out->aps[i];
+        scan_tlm_get_bytes(&r, ap->bssid, sizeof(ap->bssid));
+        ap->channel = scan_tlm_get_u8(&r);
+        ap->rssi = (int8_t)scan_tlm_get_svarint(&r);
+        ap->authmode = scan_tlm_get_u8(&r);
+        ap->status = scan_tlm_get_u8(&r);
+
+        uint8_t ssid_len = scan_tlm_get_u8(&r);
+        if (ssid_len >= sizeof(ap->ssid)) return false;
+        scan_tlm_get_bytes(&r, ap->ssid, ssid_len);
+        ap->ssid[ssid_len] = '\0';
+    }
+    return !r.error;
+}
+
+bool scan_decode_stats(const scan_tlm_frame_t *frame, scan_decoded_stats_t *out) {
+    scan_tlm_reader_t r;
+
+    if (frame->type != SCAN_TLM_STATS) return false;
+
+    memset(out, 0, sizeof(*out));
+    scan_tlm_reader_init(&r, frame->payload, frame->len);
+    out->seq = frame->seq;
+    out->time_ms = scan_tlm_get_varint(&r);
+    out->interval_ms = scan_tlm_get_varint(&r);
+    out->cycles_per_us = scan_tlm_get_varint(&r);
+    if (out->cycles_per_us == 0) return false;
+
+    uint32_t tag;
+    scan_tlm_reader_t sec;
+    while (next_section(&r, &tag, &sec)) {
+        switch (tag) {
+        case SCAN_PROF_SEC_PROBE: {
+            if (out->nprobe == SCAN_DECODE_MAX_PROBES) break;
+            scan_decoded_probe_t *p = &out->probe[out->nprobe];
+            p->probe = scan_tlm_get_varint(&sec);
+            p->snap.count = scan_tlm_get_varint(&sec);
+            p->snap.busy_us = scan_tlm_get_varint(&sec);
+            p->snap.max = scan_tlm_get_varint(&sec);
+            uint32_t nbins = scan_tlm_get_varint(&sec);
+            if (nbins > SCAN_PROF_BINS) break;
+            for (uint32_t i = 0; i < nbins; i++) {
+                p->snap.bins[i] = scan_tlm_get_varint(&sec);
+            }
+            if (!sec.error) out->nprobe++;
+            break;
+        }
+        case SCAN_PROF_SEC_COUNTERS:
+            out->counters.ring_dropped = scan_tlm_get_varint(&sec);
+            out->counters.pcap_dropped = scan_tlm_get_varint(&sec);
+            out->counters.heap_min_free = scan_tlm_get_varint(&sec);
+            out->has_counters = !sec.error;
+            break;
+        case SCAN_PROF_SEC_TASK: {
+            if (out->ntask == SCAN_DECODE_MAX_TASKS) break;
+            scan_prof_task_t *t = &out->task[out->ntask];
+            uint8_t name_len = scan_tlm_get_u8(&sec);
+            if (name_len >= sizeof(t->name)) break;
+            scan_tlm_get_bytes(&sec, t->name, name_len);
+            t->name[name_len] = '\0';
+            t->core = (int8_t)scan_tlm_get_svarint(&sec);
+            t->prio = (uint8_t)scan_tlm_get_varint(&sec);
+            t->cpu_permille = (uint16_t)scan_tlm_get_varint(&sec);
+            t->stack_free = scan_tlm_get_varint(&sec);
+            if (!sec.error) out->ntask++;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return !r.error;
+}
+
+bool scan_decode_events(const scan_tlm_frame_t *frame, scan_decoded_events_t *out) {
+    scan_tlm_reader_t r;
+
+    if (frame->type != SCAN_TLM_EVENTS) return false;
+
+    memset(out, 0, sizeof(*out));
+    scan_tlm_reader_init(&r, frame->payload, frame->len);
+    out->seq = frame->seq;
+    out->time_ms = scan_tlm_get_varint(&r);
+    out->iteration = scan_tlm_get_varint(&r);
+    out->dropped = scan_tlm_get_varint(&r);
+
+    uint32_t count = scan_tlm_get_varint(&r);
+    if (count > SCAN_DECODE_MAX_EVENTS) return false;
+    out->count = count;
+
+    for (size_t i = 0; i < out->count; i++) {
+        scan_anom_event_t *e = &out->events[i];
+        e->channel = scan_tlm_get_u8(&r);
+        e->metric = scan_tlm_get_u8(&r);
+        e->kind = scan_tlm_get_u8(&r);
+        e->z = scan_tlm_get_svarint(&r) / 10.0f;
+        e->value = scan_tlm_get_svarint(&r) / 10.0f;
+        e->mean = scan_tlm_get_svarint(&r) / 10.0f;
+        e->sd = scan_tlm_get_svarint(&r) / 10.0f;
+    }
+    return !r.error;
+}
+
+bool scan_decode_devices(const scan_tlm_frame_t *frame, scan_decoded_devices_t *out) {
+    scan_tlm_reader_t r;
+
+    if (frame->type != SCAN_TLM_DEVICES) return false;
+
+    out->count = 0;
+    scan_tlm_reader_init(&r, frame->payload, frame->len);
+    out->seq = frame->seq;
+    out->time_ms = scan_tlm_get_varint(&r);
+    out->iteration = scan_tlm_get_varint(&r);
+    out->window_s = scan_tlm_get_varint(&r);
+
+    uint32_t count = scan_tlm_get_varint(&r);
+    if (count > SCAN_DECODE_MAX_CHANNELS + 1) return false;
+
+    for (uint32_t i = 0; i < count && !r.error; i++) {
+        out->channel[i] = scan_tlm_get_u8(&r);
+        size_t n = scan_hll_decode(&out->sketch[i], r.p, (size_t)(r.end - r.p));
+        if (n == 0 || out->channel[i] > SCAN_DECODE_MAX_CHANNELS) return false;
+        r.p += n;
+    }
+    out->count = count;
+    return !r.error;
+}
+
+static const char *ap_status_name(uint8_t status) {
+    switch (status) {
+    case SCAN_TLM_AP_SEEN:    return "seen";
+    case SCAN_TLM_AP_NEW:     return "new";
+    case SCAN_TLM_AP_CHANGED: return "changed";
+    case SCAN_TLM_AP_EXPIRED: return "expired";
+    default:                  return "unknown";
+    }
+}
+
+// SSIDs are arbitrary bytes; escape what would break CSV or JSON
+static void print_string(FILE *fp, const char *ssid, scan_decode_format_t fmt) {
+    fputc('"', fp);
+    for (const unsigned char *c = (const unsigned char *)ssid; *c; c++) {
+        if (*c == '"') {
+            fputs(fmt == SCAN_DECODE_CSV ? "\"\"" : "\\\"", fp);
+        } else if (*c == '\\' && fmt == SCAN_DECODE_JSON) {
+            fputs("\\\\", fp);
+        } else if (*c < 0x20 || *c >= 0x7f) {
+            fprintf(fp, fmt == SCAN_DECODE_CSV ? "\\x%02x" : "\\u%04x", *c);
+        } else {
+            fputc(*c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+void scan_decode_print_csv_header(FILE *fp) {
+    fprintf(fp, "# sweep,seq,iteration,time_ms,dropped,channel,rssi,packets,errors,dwell_ms,airtime_us\n");
+    fprintf(fp, "# dist,seq,window_s,channel,count,min,p10,p50,p90,max\n");
+    fprintf(fp, "# noise,seq,channel,avg_dbm,min,max\n");
+    fprintf(fp, "# snr,seq,channel,bin_db,frames per bin from 0 dB...\n");
+    fprintf(fp, "# frames,seq,channel,retries");
+    for (int cls = 0; cls < SCAN_FRAME_CLASSES; cls++) {
+        fprintf(fp, ",%s", scan_frame_class_name(cls));
+    }
+    fputc('\n', fp);
+    fprintf(fp, "# ap,seq,time_ms,bssid,channel,rssi,authmode,status,ssid\n");
+    fprintf(fp, "# probe,seq,time_ms,interval_ms,name,count,busy_us,p50_us,p99_us,max_us\n");
+    fprintf(fp, "# event,seq,time_ms,iteration,channel,metric,kind,z,value,baseline,sd\n");
+    fprintf(fp, "# heartbeat,seq,time_ms,iteration,dropped\n");
+    fprintf(fp, "# devices,seq,time_ms,iteration,window_s,channel (0: probe request sources),estimate\n");
+    fprintf(fp, "# counters,seq,time_ms,ring_dropped,pcap_dropped,heap_min_free\n");
+    fprintf(fp, "# task,seq,time_ms,name,core,prio,cpu_permille,stack_free\n");
+}
+
+static void print_sweep(FILE *fp, scan_decode_format_t fmt, const scan_decoded_sweep_t *s) {
+    if (fmt == SCAN_DECODE_CSV) {
+        for (int i = 0; i < s->nchan; i++) {
+            fprintf(fp, "sweep,%u,%u,%u,%u,%d,%d,%u,%u,", s->seq, s->iteration, s->time_ms, s->dropped,
+                    i + 1, (int)s->ch[i].rssi, s->ch[i].packets, s->ch[i].errors);
+            if (s->has_dwell) {
+                fprintf(fp, "%u", s->ch[i].dwell_ms);
+            }
+            fputc(',', fp);
+            if (s->has_airtime) {
+                fprintf(fp, "%u", s->ch[i].airtime_us);
+            }
+            fputc('\n', fp);
+        }
+        if (s->nclass > 0) {
+            for (int i = 0; i < s->nchan; i++) {
+                fprintf(fp, "frames,%u,%d,%u", s->seq, i + 1, s->ch[i].retries);
+                for (int cls = 0; cls < s->nclass; cls++) {
+                    fprintf(fp, ",%u", s->ch[i].frames[cls]);
+                }
+                fputc('\n', fp);
+            }
+        }
+        if (s->has_noise) {
+            for (int i = 0; i < s->nchan; i++) {
+                const scan_decoded_channel_t *c = &s->ch[i];
+                fprintf(fp, "noise,%u,%d,", s->seq, i + 1);
+                if (c->nf_avg != 0) {
+                    fprintf(fp, "%.2f", c->nf_avg / 16.0);
+                }
+                if (c->has_nf_range) {
+                    fprintf(fp, ",%d,%d\n", c->nf_min, c->nf_max);
+                } else {
+                    fprintf(fp, ",,\n");
+                }
+            }
+        }
+        if (s->snr_bin_db > 0) {
+            for (int i = 0; i < s->nchan; i++) {
+                fprintf(fp, "snr,%u,%d,%u", s->seq, i + 1, s->snr_bin_db);
+                for (int bin = 0; bin < s->ch[i].nsnr; bin++) {
+                    fprintf(fp, ",%u", s->ch[i].snr[bin]);
+                }
+                fputc('\n', fp);
+            }
+        }
+        for (int d = 0; d < s->ndist; d++) {
+            for (int i = 0; i < s->nchan; i++) {
+                const scan_hist_summary_t *h = &s->dist[d].ch[i];
+                fprintf(fp, "dist,%u,%u,%d,%u", s->seq, s->dist[d].window_s, i + 1, h->count);
+                if (h->count > 0) {
+                    fprintf(fp, ",%d,%d,%d,%d,%d", h->min, h->p10, h->p50, h->p90, h->max);
+                } else {
+                    fprintf(fp, ",,,,,");
+                }
+                fputc('\n', fp);
+            }
+        }
+        return;
+    }
+
+    fprintf(fp, "{\"type\":\"sweep\",\"seq\":%u,\"iteration\":%u,\"time_ms\":%u,\"dropped\":%u,\"channels\":[",
+            s->seq, s->iteration, s->time_ms, s->dropped);
+    for (int i = 0; i < s->nchan; i++) {
+        fprintf(fp, "%s{\"channel\":%d,\"rssi\":%d,\"packets\":%u,\"errors\":%u", i ? "," : "",
+                i + 1, (int)s->ch[i].rssi, s->ch[i].packets, s->ch[i].errors);
+        if (s->has_dwell) {
+            fprintf(fp, ",\"dwell_ms\":%u", s->ch[i].dwell_ms);
+        }
+        if (s->has_airtime) {
+            fprintf(fp, ",\"airtime_us\":%u", s->ch[i].airtime_us);
+        }
+        if (s->nclass > 0) {
+            fprintf(fp, ",\"frames\":{\"retries\":%u", s->ch[i].retries);
+            // Classes newer than this decoder have no name to key them by
+            for (int cls = 0; cls < s->nclass && cls < SCAN_FRAME_CLASSES; cls++) {
+                fprintf(fp, ",\"%s\":%u", scan_frame_class_name(cls), s->ch[i].frames[cls]);
+            }
+            fputc('}', fp);
+        }
+        if (s->has_noise && (s->ch[i].nf_avg != 0 || s->ch[i].has_nf_range)) {
+            fprintf(fp, ",\"noise\":{");
+            if (s->ch[i].nf_avg != 0) {
+                fprintf(fp, "\"avg\":%.2f%s", s->ch[i].nf_avg / 16.0, s->ch[i].has_nf_range ? "," : "");
+            }
+            if (s->ch[i].has_nf_range) {
+                fprintf(fp, "\"min\":%d,\"max\":%d", s->ch[i].nf_min, s->ch[i].nf_max);
+            }
+            fputc('}', fp);
+        }
+        if (s->snr_bin_db > 0) {
+            fprintf(fp, ",\"snr\":[");
+            for (int bin = 0; bin < s->ch[i].nsnr; bin++) {
+                fprintf(fp, "%s%u", bin ? "," : "", s->ch[i].snr[bin]);
+            }
+            fputc(']', fp);
+        }
+        fputc('}', fp);
+    }
+    fprintf(fp, "]");
+    if (s->snr_bin_db > 0) {
+        fprintf(fp, ",\"snr_bin_db\":%u", s->snr_bin_db);
+    }
+
+    if (s->ndist > 0) {
+        fprintf(fp, ",\"dist\":[");
+        for (int d = 0; d < s->ndist; d++) {
+            fprintf(fp, "%s{\"window_s\":%u,\"channels\":[", d ? "," : "", s->dist[d].window_s);
+            for (int i = 0; i < s->nchan; i++) {
+                const scan_hist_summary_t *h = &s->dist[d].ch[i];
+                fprintf(fp, "%s{\"channel\":%d,\"count\":%u", i ? "," : "", i + 1, h->count);
+                if (h->count > 0) {
+                    fprintf(fp, ",\"min\":%d,\"p10\":%d,\"p50\":%d,\"p90\":%d,\"max\":%d",
+                            h->min, h->p10, h->p50, h->p90, h->max);
+                }
+                fputc('}', fp);
+            }
+            fprintf(fp, "]}");
+        }
+        fputc(']', fp);
+    }
+    fprintf(fp, "}\n");
+}
+
+static void print_aps(FILE *fp, scan_decode_format_t fmt, const scan_decoded_aps_t *a) {
+    if (fmt == SCAN_DECODE_JSON) {
+        fprintf(fp, "{\"type\":\"aps\",\"seq\":%u,\"time_ms\":%u,\"aps\":[", a->seq, a->time_ms);
+    }
+    for (size_t i = 0; i < a->count; i++) {
+        const scan_tlm_ap_t *ap = &a->aps[i];
+        char bssid[18];
+        snprintf(bssid, sizeof(bssid), "%02x:%02x:%02x:%02x:%02x:%02x",
+                 ap->bssid[0], ap->bssid[1], ap->bssid[2], ap->bssid[3], ap->bssid[4], ap->bssid[5]);
+
+        if (fmt == SCAN_DECODE_CSV) {
+            fprintf(fp, "ap,%u,%u,%s,%u,%d,%u,%s,", a->seq, a->time_ms, bssid, ap->channel, ap->rssi,
+                    ap->authmode, ap_status_name(ap->status));
+            print_string(fp, ap->ssid, fmt);
+            fputc('\n', fp);
+        } else {
+            fprintf(fp, "%s{\"bssid\":\"%s\",\"channel\":%u,\"rssi\":%d,\"authmode\":%u,\"status\":\"%s\",\"ssid\":",
+                    i ? "," : "", bssid, ap->channel, ap->rssi, ap->authmode, ap_status_name(ap->status));
+            print_string(fp, ap->ssid, fmt);
+            fputc('}', fp);
+        }
+    }
+    if (fmt == SCAN_DECODE_JSON) {
+        fprintf(fp, "]}\n");
+    }
+}
+
+static void print_stats(FILE *fp, scan_decode_format_t fmt, const scan_decoded_stats_t *st) {
+    double cpu = st->cycles_per_us;
+
+    if (fmt == SCAN_DECODE_JSON) {
+        fprintf(fp, "{\"type\":\"stats\",\"seq\":%u,\"time_ms\":%u,\"interval_ms\":%u,\"probes\":[",
+                st->seq, st->time_ms, st->interval_ms);
+    }
+    for (int i = 0; i < st->nprobe; i++) {
+        const scan_decoded_probe_t *p = &st->probe[i];
+        double p50 = scan_prof_percentile(&p->snap, 50) / cpu;
+        double p99 = scan_prof_percentile(&p->snap, 99) / cpu;
+
+        if (fmt == SCAN_DECODE_CSV) {
+            fprintf(fp, "probe,%u,%u,%u,%s,%u,%u,%.2f,%.2f,%.2f\n", st->seq, st->time_ms, st->interval_ms,
+                    scan_prof_probe_name(p->probe), p->snap.count, p->snap.busy_us, p50, p99, p->snap.max / cpu);
+            continue;
+        }
+        fprintf(fp, "%s{\"name\":\"%s\",\"count\":%u,\"busy_us\":%u,\"p50_us\":%.2f,\"p99_us\":%.2f,"
+                "\"max_us\":%.2f,\"bins\":[", i ? "," : "", scan_prof_probe_name(p->probe), p->snap.count,
+                p->snap.busy_us, p50, p99, p->snap.max / cpu);
+        int nbins = SCAN_PROF_BINS;
+        while (nbins > 0 && p->snap.bins[nbins - 1] == 0) nbins--;
+        for (int b = 0; b < nbins; b++) {
+            fprintf(fp, "%s%u", b ? "," : "", p->snap.bins[b]);
+        }
+        fprintf(fp, "]}");
+    }
+
+    if (fmt == SCAN_DECODE_JSON) {
+        fprintf(fp, "]");
+        if (st->has_counters) {
+            fprintf(fp, ",\"ring_dropped\":%u,\"pcap_dropped\":%u,\"heap_min_free\":%u",
+                    st->counters.ring_dropped, st->counters.pcap_dropped, st->counters.heap_min_free);
+        }
+        fprintf(fp, ",\"tasks\":[");
+    } else if (st->has_counters) {
+        fprintf(fp, "counters,%u,%u,%u,%u,%u\n", st->seq, st->time_ms, st->counters.ring_dropped,
+                st->counters.pcap_dropped, st->counters.heap_min_free);
+    }
+
+    for (int i = 0; i < st->ntask; i++) {
+        const scan_prof_task_t *t = &st->task[i];
+        if (fmt == SCAN_DECODE_CSV) {
+            fprintf(fp, "task,%u,%u,", st->seq, st->time_ms);
+            print_string(fp, t->name, fmt);
+            fprintf(fp, ",%d,%u,%u,%u\n", t->core, t->prio, t->cpu_permille, t->stack_free);
+            continue;
+        }
+        fprintf(fp, "%s{\"name\":", i ? "," : "");
+        print_string(fp, t->name, fmt);
+        fprintf(fp, ",\"core\":%d,\"prio\":%u,\"cpu_permille\":%u,\"stack_free\":%u}", t->core, t->prio,
+                t->cpu_permille, t->stack_free);
+    }
+    if (fmt == SCAN_DECODE_JSON) {
+        fprintf(fp, "]}\n");
+    }
+}
+
+static void print_events(FILE *fp, scan_decode_format_t fmt, const scan_decoded_events_t *ev) {
+    if (fmt == SCAN_DECODE_JSON) {
+        fprintf(fp, "{\"type\":\"events\",\"seq\":%u,\"time_ms\":%u,\"iteration\":%u,\"dropped\":%u,\"events\":[",
+                ev->seq, ev->time_ms, ev->iteration, ev->dropped);
+    } else if (ev->count == 0 || ev->dropped > 0) {
+        // Events that did not fit are only visible on the heartbeat row
+        fprintf(fp, "heartbeat,%u,%u,%u,%u\n", ev->seq, ev->time_ms, ev->iteration, ev->dropped);
+    }
+    for (size_t i = 0; i < ev->count; i++) {
+        const scan_anom_event_t *e = &ev->events[i];
+        const char *metric = scan_anom_metric_name(e->metric);
+        const char *kind = scan_anom_kind_name(e->kind);
+
+        if (fmt == SCAN_DECODE_CSV) {
+            fprintf(fp, "event,%u,%u,%u,%u,%s,%s,%.1f,%.1f,%.1f,%.1f\n", ev->seq, ev->time_ms, ev->iteration,
+                    e->channel, metric, kind, (double)e->z, (double)e->value, (double)e->mean, (double)e->sd);
+        } else {
+            fprintf(fp, "%s{\"channel\":%u,\"metric\":\"%s\",\"kind\":\"%s\",\"z\":%.1f,\"value\":%.1f,"
+                    "\"baseline\":%.1f,\"sd\":%.1f}", i ? "," : "", e->channel, metric, kind, (double)e->z,
+                    (double)e->value, (double)e->mean, (double)e->sd);
+        }
+    }
+    if (fmt == SCAN_DECODE_JSON) {
+        fprintf(fp, "]}\n");
+    }
+}
+
+static void print_devices(FILE *fp, scan_decode_format_t fmt, const scan_decoded_devices_t *dev) {
+    if (fmt == SCAN_DECODE_JSON) {
+        fprintf(fp, "{\"type\":\"devices\",\"seq\":%u,\"time_ms\":%u,\"iteration\":%u,\"window_s\":%u,"
+                "\"estimates\":{", dev->seq, dev->time_ms, dev->iteration, dev->window_s);
+    }
+    for (size_t i = 0; i < dev->count; i++) {
+        uint32_t estimate = scan_hll_estimate(&dev->sketch[i]);
+        if (fmt == SCAN_DECODE_CSV) {
+            fprintf(fp, "devices,%u,%u,%u,%u,%u,%u\n", dev->seq, dev->time_ms, dev->iteration, dev->window_s,
+                    dev->channel[i], estimate);
+        } else {
+            fprintf(fp, "%s\"%u\":%u", i ? "," : "", dev->channel[i], estimate);
+        }
+    }
+    if (fmt == SCAN_DECODE_JSON) {
+        fprintf(fp, "}}\n");
+    }
+}
+
+// A sweep that goes on in continuation frames is held back until its last part
+static scan_decoded_sweep_t pending;
+static bool have_pending;
+
+void scan_decode_flush(FILE *fp, scan_decode_format_t fmt) {
+    if (!have_pending) return;
+    print_sweep(fp, fmt, &pending);
+    have_pending = false;
+}
+
+bool scan_decode_print(FILE *fp, scan_decode_format_t fmt, const scan_tlm_frame_t *frame) {
+    if (frame->type == SCAN_TLM_SWEEP_MORE) {
+        // Without its sweep a continuation has nothing to add to; the lost frame is counted by its sequence
+        if (!have_pending) return true;
+        bool ok = scan_decode_sweep_more(frame, &pending);
+        if (!ok || !pending.continued) {
+            scan_decode_flush(fp, fmt);
+        }
+        return ok;
+    }
+
+    // Any other frame means the pending sweep has no more parts coming
+    scan_decode_flush(fp, fmt);
+
+    switch (frame->type) {
+    case SCAN_TLM_SWEEP:
+        if (!scan_decode_sweep(frame, &pending)) return false;
+        have_pending = true;
+        if (!pending.continued) {
+            scan_decode_flush(fp, fmt);
+        }
+        return true;
+    case SCAN_TLM_APS: {
+        static scan_decoded_aps_t aps;
+        if (!scan_decode_aps(frame, &aps)) return false;
+        print_aps(fp, fmt, &aps);
+        return true;
+    }
+    case SCAN_TLM_STATS: {
+        static scan_decoded_stats_t stats;
+        if (!scan_decode_stats(frame, &stats)) return false;
+        print_stats(fp, fmt, &stats);
+        return true;
+    }
+    case SCAN_TLM_EVENTS: {
+        static scan_decoded_events_t events;
+        if (!scan_decode_events(frame, &events)) return false;
+        print_events(fp, fmt, &events);
+        return true;
+    }
+    case SCAN_TLM_DEVICES: {
+        static scan_decoded_devices_t devices;
+        if (!scan_decode_devices(frame, &devices)) return false;
+        print_devices(fp, fmt, &devices);
+        return true;
+    }
+    default:
+        return true;
+    }
+}
+
+void scan_decode_seq_update(scan_decode_seq_t *s, uint16_t seq) {
+    if (s->started && seq != s->next_seq) {
+        // Count forward distance only; a restarted device starts again from 0
+        uint16_t gap = (uint16_t)(seq - s->next_seq);
+        if (gap < 0x8000 && seq != 0) {
+            s->lost += gap;
+        }
+    }
+    s->started = true;
+    s->next_seq = (uint16_t)(seq + 1);
+    s->frames++;
+}
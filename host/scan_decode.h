@@ -0,0 +1,148 @@
+#pragma once
+
+// Host-side decoder for the scanner's binary telemetry (see main/scan_telemetry.h)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "scan_telemetry.h"
+#include "scan_prof.h"
+#include "scan_anom.h"
+#include "scan_hll.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Upper bounds for what a single frame can carry
+#define SCAN_DECODE_MAX_CHANNELS 14
+#define SCAN_DECODE_MAX_APS      96
+#define SCAN_DECODE_MAX_DISTS    4
+#define SCAN_DECODE_MAX_CLASSES  24
+#define SCAN_DECODE_MAX_SNR_BINS 32
+#define SCAN_DECODE_MAX_PROBES   8
+#define SCAN_DECODE_MAX_TASKS    32
+#define SCAN_DECODE_MAX_EVENTS   64
+
+typedef struct {
+    int32_t rssi;
+    uint32_t packets;
+    uint32_t errors;
+    uint32_t dwell_ms;
+    uint32_t airtime_us;
+    uint32_t retries;
+    uint32_t frames[SCAN_DECODE_MAX_CLASSES];   // Indexed by scan_frame_class_t
+    int32_t nf_avg;             // Noise floor running average, 1/16 dBm, 0 if none yet
+    bool has_nf_range;          // Some frame this sweep reported a noise floor
+    int8_t nf_min;
+    int8_t nf_max;
+    int nsnr;                   // SNR bins sent, the ones above are empty
+    uint32_t snr[SCAN_DECODE_MAX_SNR_BINS];
+} scan_decoded_channel_t;
+
+// RSSI distribution of one sweep (window_s 0) or of a longer window
+typedef struct {
+    uint32_t window_s;
+    scan_hist_summary_t ch[SCAN_DECODE_MAX_CHANNELS];
+} scan_decoded_dist_t;
+
+typedef struct {
+    uint16_t seq;
+    uint32_t iteration;
+    uint32_t time_ms;
+    uint32_t dropped;
+    int nchan;
+    bool has_dwell;
+    bool has_airtime;
+    int nclass;                 // Frame classes sent, 0 if the section was missing
+    bool has_noise;
+    uint32_t snr_bin_db;        // 0 if the SNR section was missing
+    scan_decoded_channel_t ch[SCAN_DECODE_MAX_CHANNELS];
+    int ndist;
+    scan_decoded_dist_t dist[SCAN_DECODE_MAX_DISTS];
+    bool continued;             // More sections follow in a SCAN_TLM_SWEEP_MORE frame
+} scan_decoded_sweep_t;
+
+typedef struct {
+    uint16_t seq;
+    uint32_t time_ms;
+    size_t count;
+    scan_tlm_ap_t aps[SCAN_DECODE_MAX_APS];
+} scan_decoded_aps_t;
+
+typedef struct {
+    uint32_t probe;             // scan_prof_probe_t
+    scan_prof_snap_t snap;      // Change over the interval, max since boot
+} scan_decoded_probe_t;
+
+typedef struct {
+    uint16_t seq;
+    uint32_t time_ms;
+    uint32_t interval_ms;
+    uint32_t cycles_per_us;
+    int nprobe;
+    scan_decoded_probe_t probe[SCAN_DECODE_MAX_PROBES];
+    bool has_counters;
+    scan_prof_counters_t counters;
+    int ntask;
+    scan_prof_task_t task[SCAN_DECODE_MAX_TASKS];
+} scan_decoded_stats_t;
+
+// Anomaly events; count 0 is a heartbeat
+typedef struct {
+    uint16_t seq;
+    uint32_t time_ms;
+    uint32_t iteration;
+    uint32_t dropped;
+    size_t count;
+    scan_anom_event_t events[SCAN_DECODE_MAX_EVENTS];
+} scan_decoded_events_t;
+
+// Distinct transmitter sketches; channel 0 is the probe request sources
+typedef struct {
+    uint16_t seq;
+    uint32_t time_ms;
+    uint32_t iteration;
+    uint32_t window_s;
+    size_t count;
+    uint8_t channel[SCAN_DECODE_MAX_CHANNELS + 1];
+    scan_hll_t sketch[SCAN_DECODE_MAX_CHANNELS + 1];
+} scan_decoded_devices_t;
+
+typedef enum {
+    SCAN_DECODE_CSV,
+    SCAN_DECODE_JSON,
+} scan_decode_format_t;
+
+// Return false if the payload is malformed
+bool scan_decode_sweep(const scan_tlm_frame_t *frame, scan_decoded_sweep_t *out);
+// Add the sections of a continuation frame to the sweep it belongs to
+bool scan_decode_sweep_more(const scan_tlm_frame_t *frame, scan_decoded_sweep_t *sweep);
+bool scan_decode_aps(const scan_tlm_frame_t *frame, scan_decoded_aps_t *out);
+bool scan_decode_stats(const scan_tlm_frame_t *frame, scan_decoded_stats_t *out);
+bool scan_decode_events(const scan_tlm_frame_t *frame, scan_decoded_events_t *out);
+bool scan_decode_devices(const scan_tlm_frame_t *frame, scan_decoded_devices_t *out);
+
+// Decode and print one frame. CSV rows start with the record kind so that
+// different record types can share one file. Unknown types are skipped. A
+// sweep split over several frames is printed whole once its last part is in;
+// call scan_decode_flush at the end of the stream.
+bool scan_decode_print(FILE *fp, scan_decode_format_t fmt, const scan_tlm_frame_t *frame);
+void scan_decode_flush(FILE *fp, scan_decode_format_t fmt);
+
+// Column header for CSV output
+void scan_decode_print_csv_header(FILE *fp);
+
+// Tracks sequence numbers to count frames lost between device and host
+typedef struct {
+    bool started;
+    uint16_t next_seq;
+    uint32_t frames;
+    uint32_t lost;
+} scan_decode_seq_t;
+
+void scan_decode_seq_update(scan_decode_seq_t *s, uint16_t seq);
+
+#ifdef __cplusplus
+}
+#endif
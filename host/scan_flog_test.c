@@ -0,0 +1,284 @@
+// Checks of the flash log against a RAM-backed NOR flash: wrapping the ring,
+// remounting, losing power in the middle of a write and sectors that no
+// longer erase. Frames are AP frames whose time_ms is their index, so a walk
+// has to return a run of consecutive times, oldest first.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scan_flog.h"
+
+#define SECTORS 6
+#define SIZE    (SECTORS * SCAN_FLOG_SECTOR)
+
+typedef struct {
+    uint8_t mem[SIZE];
+    int bad_sector;         // Never erases, -1 for none
+    long budget;            // Bytes written before the power goes, -1 for no limit
+} flash_t;
+
+static flash_t flash;
+static int failures;
+
+#define CHECK(cond, ...) do {                                   \
+        if (!(cond)) {                                          \
+            fprintf(stderr, "%s:%d: ", __func__, __LINE__);     \
+            fprintf(stderr, __VA_ARGS__);                       \
+            fputc('\n', stderr);                                \
+            failures++;                                         \
+        }                                                       \
+    } while (0)
+
+static bool flash_read(uint32_t offset, void *buf, size_t len, void *ctx) {
+    flash_t *f = ctx;
+
+    if (offset + len > SIZE) return false;
+    memcpy(buf, f->mem + offset, len);
+    return true;
+}
+
+// NOR flash: programming only clears bits
+static bool flash_write(uint32_t offset, const void *buf, size_t len, void *ctx) {
+    flash_t *f = ctx;
+    const uint8_t *p = buf;
+
+    if (offset + len > SIZE) return false;
+    for (size_t i = 0; i < len; i++) {
+        if (f->budget == 0) return false;
+        if (f->budget > 0) f->budget--;
+        f->mem[offset + i] &= p[i];
+    }
+    return true;
+}
+
+static bool flash_erase(uint32_t offset, size_t len, void *ctx) {
+    flash_t *f = ctx;
+
+    if (offset % SCAN_FLOG_SECTOR || len % SCAN_FLOG_SECTOR || offset + len > SIZE || f->budget == 0) {
+        return false;
+    }
+    for (uint32_t s = offset / SCAN_FLOG_SECTOR; s < (offset + len) / SCAN_FLOG_SECTOR; s++) {
+        if ((int)s == f->bad_sector) return false;
+    }
+    memset(f->mem + offset, 0xFF, len);
+    return true;
+}
+
+static const scan_flog_ops_t ops = {
+    .read = flash_read,
+    .write = flash_write,
+    .erase = flash_erase,
+    .ctx = &flash,
+};
+
+static void flash_reset(void) {
+    memset(flash.mem, 0xFF, sizeof(flash.mem));
+    flash.bad_sector = -1;
+    flash.budget = -1;
+}
+
+// Frame number t, with one to three APs so frames vary in length and cross pages
+static bool append(scan_flog_t *log, uint32_t t) {
+    scan_tlm_ap_t aps[3] = {0};
+    uint8_t buf[256];
+
+    for (int i = 0; i < 3; i++) {
+        aps[i].bssid[5] = (uint8_t)t;
+        aps[i].channel = (uint8_t)(1 + i);
+        snprintf(aps[i].ssid, sizeof(aps[i].ssid), "flog-%lu-%d", (unsigned long)t, i);
+    }
+    size_t len = scan_tlm_encode_aps(buf, sizeof(buf), (uint16_t)t, t, aps, 1 + t % 3);
+    return len > 0 && scan_flog_append(log, buf, len);
+}
+
+typedef struct {
+    uint32_t times[SIZE / 16];
+    uint32_t boots[SIZE / 16];
+    size_t count;
+} walked_t;
+
+static bool collect(const scan_flog_record_t *rec, void *ctx) {
+    walked_t *w = ctx;
+    uint32_t t;
+
+    if (scan_flog_frame_time(&rec->frame, &t) && w->count < sizeof(w->times) / sizeof(w->times[0])) {
+        w->times[w->count] = t;
+        w->boots[w->count] = rec->boot;
+        w->count++;
+    }
+    return true;
+}
+
+static bool walk(walked_t *w, scan_flog_walk_stats_t *stats) {
+    static uint8_t sector[SCAN_FLOG_SECTOR];
+
+    memset(w, 0, sizeof(*w));
+    return scan_flog_walk(&ops, SIZE, sector, collect, w, stats);
+}
+
+// Frames first..last, in order, each once
+static bool consecutive(const walked_t *w, uint32_t first, uint32_t last) {
+    if (w->count != last - first + 1) return false;
+    for (size_t i = 0; i < w->count; i++) {
+        if (w->times[i] != first + i) return false;
+    }
+    return true;
+}
+
+static void test_empty(void) {
+    scan_flog_t log;
+    scan_flog_walk_stats_t stats;
+    walked_t w;
+
+    flash_reset();
+    CHECK(scan_flog_mount(&log, &ops, SIZE), "mount failed");
+    CHECK(log.boot == 0 && log.next_seq == 0, "boot %lu seq %lu on a blank partition",
+          (unsigned long)log.boot, (unsigned long)log.next_seq);
+    CHECK(walk(&w, &stats) && w.count == 0 && stats.sectors == 0, "%zu frames in a blank partition", w.count);
+    CHECK(!scan_flog_mount(&log, &ops, SCAN_FLOG_SECTOR - 1), "mounted a partition without a whole sector");
+}
+
+// Several passes over the ring, then two more boots
+static void test_wrap(void) {
+    scan_flog_t log;
+    scan_flog_walk_stats_t stats;
+    walked_t w;
+    uint32_t t = 0;
+
+    flash_reset();
+    CHECK(scan_flog_mount(&log, &ops, SIZE), "mount failed");
+    for (; t < 1500; t++) {
+        CHECK(append(&log, t), "append %lu failed", (unsigned long)t);
+    }
+    CHECK(scan_flog_flush(&log), "flush failed");
+    CHECK(log.erases > 2 * SECTORS, "only %lu erases, the ring did not wrap", (unsigned long)log.erases);
+    CHECK(walk(&w, &stats) && w.count > 0, "walk failed");
+    CHECK(stats.sectors == SECTORS && stats.bad == 0, "%lu sectors, %lu bad frames",
+          (unsigned long)stats.sectors, (unsigned long)stats.bad);
+    CHECK(w.count > 0 && consecutive(&w, w.times[0], t - 1), "frames %lu~%lu are not the newest in order",
+          (unsigned long)(w.count ? w.times[0] : 0), (unsigned long)(w.count ? w.times[w.count - 1] : 0));
+
+    for (uint32_t boot = 1; boot <= 2; boot++) {
+        uint32_t first = w.times[0];
+
+        CHECK(scan_flog_mount(&log, &ops, SIZE) && log.boot == boot, "remount gave boot %lu",
+              (unsigned long)log.boot);
+        for (uint32_t end = t + 40; t < end; t++) {
+            CHECK(append(&log, t), "append %lu failed", (unsigned long)t);
+        }
+        CHECK(scan_flog_flush(&log), "flush failed");
+        CHECK(walk(&w, &stats) && w.count > 0 && consecutive(&w, w.times[0], t - 1) && w.times[0] > first,
+              "boot %lu: frames are not the newest in order", (unsigned long)boot);
+        CHECK(w.count > 0 && w.boots[w.count - 1] == boot, "last frame from boot %lu",
+              (unsigned long)(w.count ? w.boots[w.count - 1] : 0));
+    }
+}
+
+// The power goes after budget more bytes; what was flushed before survives
+// and the torn tail never shows up as a frame
+static void test_power_loss(void) {
+    for (long budget = 0; budget < 2 * SCAN_FLOG_SECTOR; budget += 97) {
+        scan_flog_t log;
+        scan_flog_walk_stats_t stats;
+        walked_t w;
+        uint32_t t = 0;
+
+        flash_reset();
+        CHECK(scan_flog_mount(&log, &ops, SIZE), "mount failed");
+        for (; t < 60; t++) {
+            append(&log, t);
+        }
+        CHECK(scan_flog_flush(&log), "flush failed");
+        uint32_t flushed = t;
+
+        flash.budget = budget;
+        while (append(&log, t) && t < 2000) {
+            t++;
+        }
+        scan_flog_flush(&log);
+        flash.budget = -1;
+
+        CHECK(walk(&w, &stats), "walk failed");
+        CHECK(w.count > 0 && consecutive(&w, 0, w.times[w.count - 1]) && w.times[w.count - 1] + 1 >= flushed,
+              "budget %ld: %zu frames up to %lu, %lu flushed", budget, w.count,
+              (unsigned long)(w.count ? w.times[w.count - 1] : 0), (unsigned long)flushed);
+        CHECK(w.count <= t + 1, "budget %ld: %zu frames but only %lu appended", budget, w.count,
+              (unsigned long)t + 1);
+
+        // The next boot goes on after the last frame that made it
+        uint32_t last = w.count ? w.times[w.count - 1] : 0;
+        CHECK(scan_flog_mount(&log, &ops, SIZE) && log.boot == 1, "remount failed");
+        for (t = last + 1; t < last + 30; t++) {
+            CHECK(append(&log, t), "append %lu after the power loss failed", (unsigned long)t);
+        }
+        CHECK(scan_flog_flush(&log), "flush failed");
+        CHECK(walk(&w, &stats) && consecutive(&w, 0, t - 1), "budget %ld: frames lost after the remount", budget);
+    }
+}
+
+// A sector that stops erasing keeps the header of an old pass; it costs the
+// frames that found it in the way, no more, and the walk stays in order
+// wherever the newest sector ends up
+static void test_bad_sector(void) {
+    static uint32_t accepted[2000];
+
+    for (uint32_t run = 1000; run < 1000 + 2 * SECTORS * 25; run += 25) {
+        scan_flog_t log;
+        scan_flog_walk_stats_t stats;
+        walked_t w;
+        size_t naccepted = 0;
+        uint32_t t = 0;
+
+        flash_reset();
+        CHECK(scan_flog_mount(&log, &ops, SIZE), "mount failed");
+        for (; log.erases < SECTORS + 1; t++) {
+            append(&log, t);
+        }
+        flash.bad_sector = 2;
+        for (uint32_t end = t + run; t < end; t++) {
+            if (append(&log, t)) {
+                accepted[naccepted++] = t;
+            }
+        }
+        CHECK(scan_flog_flush(&log), "flush failed");
+        CHECK(log.errors > 0 && naccepted < run, "run %lu: the bad sector was never hit", (unsigned long)run);
+        CHECK(walk(&w, &stats) && w.count > 0, "walk failed");
+
+        // The stale sector may come first when it follows the newest one,
+        // with frames from before it went bad
+        size_t old = 0;
+        while (old < w.count && w.times[old] < accepted[0]) {
+            old++;
+        }
+
+        // Every frame accepted since the oldest newer one walked is there, in order
+        size_t n = w.count - old;
+        size_t i = naccepted;
+        while (n > 0 && i > 0 && accepted[i - 1] != w.times[old]) {
+            i--;
+        }
+        CHECK(n > 0 && i > 0 && naccepted - (i - 1) == n &&
+              memcmp(accepted + i - 1, w.times + old, n * sizeof(w.times[0])) == 0,
+              "run %lu: %zu frames walked after %zu stale ones, not the newest accepted in order",
+              (unsigned long)run, n, old);
+
+        // All good sectors but the one being reused
+        uint32_t per_sector = SCAN_FLOG_SECTOR / 200;
+        CHECK(n >= (SECTORS - 2) * per_sector, "run %lu: only %zu recent frames walked from %lu sectors",
+              (unsigned long)run, n, (unsigned long)stats.sectors);
+    }
+}
+
+int main(void) {
+    test_empty();
+    test_wrap();
+    test_power_loss();
+    test_bad_sector();
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("scan_flog: all checks passed\n");
+    return 0;
+}
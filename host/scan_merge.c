@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "scan_merge.h"
+
+void scan_clock_init(scan_clock_t *c) {
+    memset(c, 0, sizeof(*c));
+}
+
+int64_t scan_clock_update(scan_clock_t *c, uint32_t dev_ms, int64_t host_ms) {
+    int64_t sample = host_ms - dev_ms;
+
+    if (c->valid && dev_ms < c->last_dev_ms) {
+        c->nsamples = 0;
+        c->resets++;
+    }
+    c->valid = true;
+    c->last_dev_ms = dev_ms;
+    c->samples[c->nsamples++ % SCAN_MERGE_CLOCK_SAMPLES] = sample;
+
+    uint32_t n = c->nsamples < SCAN_MERGE_CLOCK_SAMPLES ? c->nsamples : SCAN_MERGE_CLOCK_SAMPLES;
+    c->offset_ms = c->samples[0];
+    for (uint32_t i = 1; i < n; i++) {
+        if (c->samples[i] < c->offset_ms) c->offset_ms = c->samples[i];
+    }
+    return dev_ms + c->offset_ms;
+}
+
+static int64_t floor_to(int64_t t, uint32_t step) {
+    int64_t q = t / step;
+    if (t % step < 0) q--;
+    return q * step;
+}
+
+static scan_merge_bin_t *bin_at(scan_merge_t *m, int64_t start_ms) {
+    return &m->bins[(uint64_t)(start_ms / m->bin_ms) % SCAN_MERGE_MAX_BINS];
+}
+
+static void bin_clear(scan_merge_bin_t *bin, int64_t start_ms) {
+    memset(bin, 0, sizeof(*bin));
+    bin->start_ms = start_ms;
+    for (int d = 0; d < SCAN_MERGE_MAX_DEVICES; d++) {
+        for (int i = 0; i < SCAN_DECODE_MAX_CHANNELS; i++) {
+            bin->cell[d][i].rssi = SCAN_RSSI_FLOOR;
+        }
+    }
+}
+
+void scan_merge_init(scan_merge_t *m, uint32_t bin_ms, uint32_t latency_ms) {
+    memset(m, 0, sizeof(*m));
+    m->bin_ms = bin_ms;
+    m->latency_ms = latency_ms;
+}
+
+bool scan_merge_add(scan_merge_t *m, int dev, int64_t t_ms, const scan_decoded_sweep_t *sweep) {
+    int64_t start = floor_to(t_ms, m->bin_ms);
+
+    if (dev < 0 || dev >= SCAN_MERGE_MAX_DEVICES) return false;
+    if (!m->started) {
+        m->started = true;
+        m->next_ms = start;
+    }
+    if (start < m->next_ms) {
+        m->late++;
+        return false;
+    }
+    if (start >= m->next_ms + (int64_t)m->bin_ms * SCAN_MERGE_MAX_BINS) {
+        m->ahead++;
+        return false;
+    }
+
+    scan_merge_bin_t *bin = bin_at(m, start);
+    if (!bin->used || bin->start_ms != start) {
+        bin_clear(bin, start);
+        bin->used = true;
+    }
+    if (sweep->nchan > m->nchan) m->nchan = sweep->nchan;
+
+    bin->sweeps[dev]++;
+    for (int i = 0; i < sweep->nchan; i++) {
+        scan_merge_cell_t *c = &bin->cell[dev][i];
+        if (sweep->ch[i].rssi > c->rssi) c->rssi = sweep->ch[i].rssi;
+        c->packets += sweep->ch[i].packets;
+        c->errors += sweep->ch[i].errors;
+    }
+    return true;
+}
+
+bool scan_merge_add_devices(scan_merge_t *m, int64_t t_ms, const scan_decoded_devices_t *dev) {
+    int64_t start = floor_to(t_ms, m->bin_ms);
+    scan_merge_bin_t *bin = bin_at(m, start);
+
+    if (!m->started || !bin->used || bin->start_ms != start) return false;
+
+    bin->has_devices = true;
+    for (size_t i = 0; i < dev->count; i++) {
+        scan_hll_merge(&bin->devices[dev->channel[i]], &dev->sketch[i]);
+    }
+    return true;
+}
+
+bool scan_merge_add_window(scan_merge_t *m, int dev, int64_t t_ms, const scan_decoded_devices_t *win) {
+    scan_merge_window_t *w = NULL;
+
+    if (dev < 0 || dev >= SCAN_MERGE_MAX_DEVICES || win->window_s == 0) return false;
+    for (int i = 0; i < SCAN_MERGE_MAX_WINDOWS && w == NULL; i++) {
+        if (m->windows[i].window_s == win->window_s) w = &m->windows[i];
+    }
+    for (int i = 0; i < SCAN_MERGE_MAX_WINDOWS && w == NULL; i++) {
+        if (m->windows[i].window_s == 0) {
+            w = &m->windows[i];
+            w->window_s = win->window_s;
+        }
+    }
+    if (w == NULL) return false;
+
+    // A set split over several frames arrives with one device time
+    if (!w->has[dev] || w->dev_ms[dev] != win->time_ms) {
+        for (int i = 0; i <= SCAN_DECODE_MAX_CHANNELS; i++) {
+            scan_hll_reset(&w->sketch[dev][i]);
+        }
+        w->has[dev] = true;
+        w->dev_ms[dev] = win->time_ms;
+        w->t_ms[dev] = t_ms;
+    }
+    for (size_t i = 0; i < win->count; i++) {
+        scan_hll_merge(&w->sketch[dev][win->channel[i]], &win->sketch[i]);
+    }
+    return true;
+}
+
+void scan_merge_flush(scan_merge_t *m, int64_t now_ms, scan_merge_emit_cb_t cb, void *ctx) {
+    if (!m->started) return;
+
+    for (int n = 0; m->next_ms + m->bin_ms + m->latency_ms <= now_ms; n++) {
+        // Every bin that can hold data has been visited; the rest of a long
+        // quiet spell is empty, so skip to the first bin still open
+        if (n == SCAN_MERGE_MAX_BINS) {
+            m->next_ms = floor_to(now_ms - m->latency_ms, m->bin_ms);
+            break;
+        }
+
+        scan_merge_bin_t *bin = bin_at(m, m->next_ms);
+        if (bin->used && bin->start_ms == m->next_ms) {
+            cb(bin, ctx);
+        }
+        bin->used = false;
+        m->next_ms += m->bin_ms;
+    }
+}
+
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+} out_t;
+
+static void out(out_t *o, const char *fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    int n = vsnprintf(o->buf + (o->len < o->cap ? o->len : o->cap), o->len < o->cap ? o->cap - o->len : 0, fmt, ap);
+    va_end(ap);
+    if (n > 0) o->len += (size_t)n;
+}
+
+typedef enum {
+    MATRIX_RSSI,
+    MATRIX_PACKETS,
+    MATRIX_ERRORS,
+} matrix_t;
+
+static const char *const matrix_names[] = {"rssi", "packets", "errors"};
+
+// Rows of devices that sent nothing in the bin are null
+static void out_matrix(out_t *o, const scan_merge_t *m, const scan_merge_bin_t *bin, int ndev, matrix_t which) {
+    out(o, ",\"%s\":[", matrix_names[which]);
+    for (int d = 0; d < ndev; d++) {
+        if (bin->sweeps[d] == 0) {
+            out(o, "%snull", d ? "," : "");
+            continue;
+        }
+        out(o, "%s[", d ? "," : "");
+        for (int i = 0; i < m->nchan; i++) {
+            const scan_merge_cell_t *c = &bin->cell[d][i];
+            const char *sep = i ? "," : "";
+            switch (which) {
+            case MATRIX_RSSI:    out(o, "%s%d", sep, (int)c->rssi); break;
+            case MATRIX_PACKETS: out(o, "%s%u", sep, c->packets); break;
+            case MATRIX_ERRORS:  out(o, "%s%u", sep, c->errors); break;
+            }
+        }
+        out(o, "]");
+    }
+    out(o, "]");
+}
+
+// Per channel, over every channel and of probe requests, from sketches by channel
+static void out_transmitters(out_t *o, const scan_merge_t *m, const scan_hll_t *sketches) {
+    scan_hll_t all;
+
+    scan_hll_reset(&all);
+    out(o, "\"transmitters\":[");
+    for (int i = 1; i <= m->nchan; i++) {
+        out(o, "%s%u", i > 1 ? "," : "", scan_hll_estimate(&sketches[i]));
+        scan_hll_merge(&all, &sketches[i]);
+    }
+    out(o, "],\"transmitters_all\":%u,\"probe_sources\":%u", scan_hll_estimate(&all),
+        scan_hll_estimate(&sketches[0]));
+}
+
+// Windows whose sets cover the bin, sets older than their window left out
+static void out_windows(out_t *o, const scan_merge_t *m, const scan_merge_bin_t *bin, int ndev) {
+    static scan_hll_t sketches[SCAN_DECODE_MAX_CHANNELS + 1];
+    bool first = true;
+
+    for (int i = 0; i < SCAN_MERGE_MAX_WINDOWS; i++) {
+        const scan_merge_window_t *w = &m->windows[i];
+        int devices = 0;
+
+        if (w->window_s == 0) continue;
+        for (int c = 0; c <= SCAN_DECODE_MAX_CHANNELS; c++) {
+            scan_hll_reset(&sketches[c]);
+        }
+        for (int d = 0; d < ndev; d++) {
+            if (!w->has[d] || w->t_ms[d] + (int64_t)w->window_s * 1000 < bin->start_ms) continue;
+            for (int c = 0; c <= SCAN_DECODE_MAX_CHANNELS; c++) {
+                scan_hll_merge(&sketches[c], &w->sketch[d][c]);
+            }
+            devices++;
+        }
+        if (devices == 0) continue;
+
+        out(o, "%s{\"window_s\":%u,\"devices\":%d,", first ? ",\"windows\":[" : ",", w->window_s, devices);
+        out_transmitters(o, m, sketches);
+        out(o, "}");
+        first = false;
+    }
+    if (!first) out(o, "]");
+}
+
+size_t scan_merge_format(const scan_merge_t *m, const scan_merge_bin_t *bin, const char *const *names, int ndev,
+                         int64_t epoch_ms, char *buf, size_t cap) {
+    out_t o = {.buf = buf, .cap = cap};
+
+    out(&o, "{\"time_ms\":%lld,\"bin_ms\":%u,\"channels\":%d,\"devices\":[",
+        (long long)(bin->start_ms + epoch_ms), m->bin_ms, m->nchan);
+    for (int d = 0; d < ndev; d++) {
+        out(&o, "%s\"%s\"", d ? "," : "", names[d]);
+    }
+    out(&o, "],\"sweeps\":[");
+    for (int d = 0; d < ndev; d++) {
+        out(&o, "%s%u", d ? "," : "", bin->sweeps[d]);
+    }
+    out(&o, "]");
+    out_matrix(&o, m, bin, ndev, MATRIX_RSSI);
+    out_matrix(&o, m, bin, ndev, MATRIX_PACKETS);
+    out_matrix(&o, m, bin, ndev, MATRIX_ERRORS);
+    if (bin->has_devices) {
+        out(&o, ",");
+        out_transmitters(&o, m, bin->devices);
+    }
+    out_windows(&o, m, bin, ndev);
+    out(&o, "}\n");
+
+    return o.len < cap ? o.len : 0;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+// Merges the sweeps of several scanners into one time-aligned view.
+//
+// Every device stamps its sweeps with its own uptime. A per-device clock
+// estimate maps that onto the host's monotonic clock, and the merge sorts the
+// mapped sweeps into fixed-width time bins holding a device x channel matrix.
+// A bin is handed out once it is older than the latency allowance, so a
+// device that is a little behind still lands in the right bin; sweeps that
+// arrive later than that are counted and dropped. Memory is fixed: a ring of
+// SCAN_MERGE_MAX_BINS bins for up to SCAN_MERGE_MAX_DEVICES devices.
+//
+// Distinct transmitter sketches that come with the sweeps are merged per bin
+// across devices, so a transmitter heard by several scanners counts once.
+// Window sketches (window_s above 0) are kept per device and window length,
+// the latest set of each device, and merged across devices in every line for
+// as long as they are no older than their window.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "scan_decode.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCAN_MERGE_MAX_DEVICES   16
+#define SCAN_MERGE_MAX_BINS      16
+#define SCAN_MERGE_CLOCK_SAMPLES 32
+#define SCAN_MERGE_MAX_WINDOWS   4
+
+// Device to host clock mapping. The link adds a delay that is never negative,
+// so the smallest host - device difference over recent sweeps is the best
+// offset estimate; using a window rather than all history follows drift.
+typedef struct {
+    bool valid;
+    uint32_t last_dev_ms;
+    int64_t samples[SCAN_MERGE_CLOCK_SAMPLES];
+    uint32_t nsamples;
+    int64_t offset_ms;          // host = device + offset
+    uint32_t resets;            // Device clock went backwards, i.e. it rebooted
+} scan_clock_t;
+
+void scan_clock_init(scan_clock_t *c);
+
+// Feed one sweep received at host_ms, returns its time on the host clock
+int64_t scan_clock_update(scan_clock_t *c, uint32_t dev_ms, int64_t host_ms);
+
+typedef struct {
+    int32_t rssi;               // Strongest over the bin's sweeps
+    uint32_t packets;
+    uint32_t errors;
+} scan_merge_cell_t;
+
+typedef struct {
+    bool used;
+    int64_t start_ms;           // Host clock
+    uint16_t sweeps[SCAN_MERGE_MAX_DEVICES];
+    scan_merge_cell_t cell[SCAN_MERGE_MAX_DEVICES][SCAN_DECODE_MAX_CHANNELS];
+    bool has_devices;
+    scan_hll_t devices[SCAN_DECODE_MAX_CHANNELS + 1];  // By channel, 0 for probe request sources
+} scan_merge_bin_t;
+
+// Latest sketches of each device for one window length
+typedef struct {
+    uint32_t window_s;          // 0 while unused
+    bool has[SCAN_MERGE_MAX_DEVICES];
+    uint32_t dev_ms[SCAN_MERGE_MAX_DEVICES];    // Device time of the set, which all its frames share
+    int64_t t_ms[SCAN_MERGE_MAX_DEVICES];       // The same on the host clock
+    scan_hll_t sketch[SCAN_MERGE_MAX_DEVICES][SCAN_DECODE_MAX_CHANNELS + 1];
+} scan_merge_window_t;
+
+typedef struct {
+    uint32_t bin_ms;
+    uint32_t latency_ms;
+    int nchan;                  // Most channels any sweep had
+    bool started;
+    int64_t next_ms;            // Start of the oldest bin not handed out yet
+    uint32_t late;              // Sweeps for bins already handed out
+    uint32_t ahead;             // Sweeps too far ahead of the oldest open bin
+    scan_merge_bin_t bins[SCAN_MERGE_MAX_BINS];
+    scan_merge_window_t windows[SCAN_MERGE_MAX_WINDOWS];
+} scan_merge_t;
+
+void scan_merge_init(scan_merge_t *m, uint32_t bin_ms, uint32_t latency_ms);
+
+// Add a sweep from device dev at host time t_ms. Returns false if it was dropped.
+bool scan_merge_add(scan_merge_t *m, int dev, int64_t t_ms, const scan_decoded_sweep_t *sweep);
+
+// Merge the sketches of a sweep already added at host time t_ms. Returns
+// false if that sweep's bin is not open, i.e. the sweep was dropped.
+bool scan_merge_add_devices(scan_merge_t *m, int64_t t_ms, const scan_decoded_devices_t *dev);
+
+// Merge window sketches from device dev, sent at host time t_ms. A set with a
+// new device time replaces that device's previous one for the window length.
+// Returns false if there is no room for another window length.
+bool scan_merge_add_window(scan_merge_t *m, int dev, int64_t t_ms, const scan_decoded_devices_t *win);
+
+typedef void (*scan_merge_emit_cb_t)(const scan_merge_bin_t *bin, void *ctx);
+
+// Hand out, oldest first, the bins that ended more than latency_ms before now_ms
+void scan_merge_flush(scan_merge_t *m, int64_t now_ms, scan_merge_emit_cb_t cb, void *ctx);
+
+// One JSON line for a bin: its start as Unix time (start_ms + epoch_ms) and
+// rssi, packets and errors as device x channel matrices, with a null row for
+// devices that sent no sweep in the bin. If sketches came with the sweeps,
+// the distinct transmitters of all devices together follow per channel,
+// over every channel, and of probe requests, and the same for each window
+// with current sets, with the number of devices that contributed. Returns
+// the length, 0 if it did not fit in cap.
+size_t scan_merge_format(const scan_merge_t *m, const scan_merge_bin_t *bin, const char *const *names, int ndev,
+                         int64_t epoch_ms, char *buf, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,257 @@
+// Checks of the script engine on a simulated clock: loops and their
+// variables, $var expansion, the wait timeline and its lateness, failing
+// commands, captures and the compile errors. Commands are not run; each is
+// recorded with the time it started, and a command can be given a duration.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scan_script.h"
+
+#define MAX_LINES 64
+
+typedef struct {
+    uint32_t now_ms;
+    int nlines;
+    char lines[MAX_LINES][SCAN_SCRIPT_MAX_LINE + 64];
+    uint32_t at_ms[MAX_LINES];
+    uint32_t sleeps;
+    uint32_t captures;
+} sim_t;
+
+static int failures;
+
+#define CHECK(cond, ...) do {                                   \
+        if (!(cond)) {                                          \
+            fprintf(stderr, "%s:%d: ", __func__, __LINE__);     \
+            fprintf(stderr, __VA_ARGS__);                       \
+            fputc('\n', stderr);                                \
+            failures++;                                         \
+        }                                                       \
+    } while (0)
+
+// "slow <ms>" takes that long, "fail" returns 3, anything else is instant
+static int sim_exec(const char *line, void *ctx) {
+    sim_t *sim = ctx;
+
+    if (sim->nlines < MAX_LINES) {
+        snprintf(sim->lines[sim->nlines], sizeof(sim->lines[0]), "%s", line);
+        sim->at_ms[sim->nlines] = sim->now_ms;
+        sim->nlines++;
+    }
+    if (strncmp(line, "slow ", 5) == 0) {
+        sim->now_ms += (uint32_t)atoi(line + 5);
+    }
+    return strcmp(line, "fail") == 0 ? 3 : 0;
+}
+
+static uint32_t sim_now_ms(void *ctx) {
+    return ((sim_t *)ctx)->now_ms;
+}
+
+static void sim_sleep_until(uint32_t ms, void *ctx) {
+    sim_t *sim = ctx;
+
+    sim->now_ms = ms;
+    sim->sleeps++;
+}
+
+static void sim_capture(scan_script_capture_t *cap, void *ctx) {
+    sim_t *sim = ctx;
+
+    sim->captures++;
+    cap->desired = 1000;
+    cap->correct = 1000 - sim->captures;
+    cap->rssi = -600;
+}
+
+static const scan_script_ops_t ops = {
+    .exec = sim_exec,
+    .now_ms = sim_now_ms,
+    .sleep_until = sim_sleep_until,
+    .capture = sim_capture,
+};
+
+static scan_script_t script;
+static scan_script_report_t report;
+
+// Compile and run src from time start; false if it did not compile
+static bool run(const char *src, uint32_t start, sim_t *sim) {
+    char err[64];
+
+    memset(sim, 0, sizeof(*sim));
+    sim->now_ms = start;
+    if (!scan_script_compile(&script, src, err, sizeof(err))) {
+        fprintf(stderr, "'%s': %s\n", src, err);
+        return false;
+    }
+    scan_script_run(&script, &ops, sim, &report);
+    return true;
+}
+
+// The commands run, joined with '|'
+static const char *ran(const sim_t *sim) {
+    static char out[1024];
+    size_t len = 0;
+
+    out[0] = '\0';
+    for (int i = 0; i < sim->nlines && len < sizeof(out); i++) {
+        len += (size_t)snprintf(out + len, sizeof(out) - len, "%s%s", i ? "|" : "", sim->lines[i]);
+    }
+    return out;
+}
+
+static void expect(const char *src, const char *commands) {
+    sim_t sim;
+
+    CHECK(run(src, 0, &sim), "'%s' did not compile", src);
+    CHECK(strcmp(ran(&sim), commands) == 0, "'%s' ran '%s', expected '%s'", src, ran(&sim), commands);
+}
+
+static void test_loops(void) {
+    expect("a; b\nc", "a|b|c");
+    expect("  # comment\n\n  a  ;;  b # not a comment  ", "a|b # not a comment");
+    expect("for ch 1 11 5; esp_rx -n $ch; end", "esp_rx -n 1|esp_rx -n 6|esp_rx -n 11");
+    expect("for i 3 1; x $i; end", "x 3|x 2|x 1");
+    expect("for i 10 0 -4; x $i; end", "x 10|x 6|x 2");
+    expect("for i 1 0 1; x $i; end; y", "y");
+    expect("for i 0 0; x $i; end", "x 0");
+    expect("for i 0x10 0x11; x $i; end", "x 16|x 17");
+
+    // The innermost loop of a name wins and the outer one is back after its end
+    expect("for a 1 2; for a 10 11; x $a; end; y $a; end", "x 10|x 11|y 1|x 10|x 11|y 2");
+    expect("for a 1 2; for b 5 6; p $a.$b; end; end", "p 1.5|p 1.6|p 2.5|p 2.6");
+    expect("for a 1 1; for b 1 1; for c 1 1; for d 7 7; q $a$b$c$d; end; end; end; end", "q 1117");
+}
+
+static void test_expansion(void) {
+    expect("for ch 1 2; capture ch$ch; cmd -n$ch,$ch; end", "cmd -n1,1|cmd -n2,2");
+    CHECK(report.ncaptures == 2 && strcmp(report.captures[0].label, "ch1") == 0 &&
+          strcmp(report.captures[1].label, "ch2") == 0, "labels '%s' '%s'", report.captures[0].label,
+          report.captures[1].label);
+
+    // Only whole names expand; $chx is not $ch followed by x
+    char err[64];
+    CHECK(!scan_script_compile(&script, "for ch 1 2; x $chx; end", err, sizeof(err)), "$chx compiled");
+    expect("for v -2 -1; x $v; end", "x -2|x -1");
+
+    // Long values are cut at the line buffer, never past it
+    sim_t sim;
+    char src[SCAN_SCRIPT_MAX_LINE + 32];
+    int n = snprintf(src, sizeof(src), "for v 1000000000 1000000000; ");
+    for (int i = 0; n < (int)sizeof(src) - 8 && i < 40; i++) {
+        n += snprintf(src + n, sizeof(src) - n, "$v");
+    }
+    snprintf(src + n, sizeof(src) - n, "; end");
+    CHECK(run(src, 0, &sim), "long expansion did not compile");
+    CHECK(sim.nlines == 1 && strlen(sim.lines[0]) == SCAN_SCRIPT_MAX_LINE + 63, "long expansion ran %zu bytes",
+          sim.nlines ? strlen(sim.lines[0]) : 0);
+}
+
+static void test_timeline(void) {
+    sim_t sim;
+
+    // Waits add up on the script clock, whatever the commands in between took
+    CHECK(run("a; wait 1000; slow 300; wait 1000; b; wait 0; c", 5000, &sim), "did not compile");
+    CHECK(sim.nlines == 4 && sim.at_ms[0] == 5000 && sim.at_ms[1] == 6000 && sim.at_ms[2] == 7000 &&
+          sim.at_ms[3] == 7000, "commands at %lu %lu %lu %lu", (unsigned long)sim.at_ms[0],
+          (unsigned long)sim.at_ms[1], (unsigned long)sim.at_ms[2], (unsigned long)sim.at_ms[3]);
+    CHECK(report.late_ms == 0 && report.elapsed_ms == 2000, "late %lu, elapsed %lu",
+          (unsigned long)report.late_ms, (unsigned long)report.elapsed_ms);
+
+    // An overrun is not slept off and the next deadline stays where it was
+    CHECK(run("wait 100; slow 120; wait 50; a; slow 500; wait 100; b; wait 500; c", 0, &sim), "did not compile");
+    CHECK(sim.nlines == 5 && sim.at_ms[1] == 220 && sim.at_ms[3] == 720 && sim.at_ms[4] == 750,
+          "commands at %lu %lu %lu", (unsigned long)sim.at_ms[1], (unsigned long)sim.at_ms[3],
+          (unsigned long)sim.at_ms[4]);
+    CHECK(report.late_ms == 470, "worst overrun %lu ms, expected 470", (unsigned long)report.late_ms);
+
+    // Loops keep to the timeline too, and the clock may wrap
+    CHECK(run("for i 1 5; slow 30; wait 100; end", UINT32_MAX - 250, &sim), "did not compile");
+    CHECK(report.elapsed_ms == 500 && report.late_ms == 0 && sim.sleeps == 5, "elapsed %lu, late %lu, %lu sleeps",
+          (unsigned long)report.elapsed_ms, (unsigned long)report.late_ms, (unsigned long)sim.sleeps);
+}
+
+static void test_errors_and_captures(void) {
+    sim_t sim;
+
+    CHECK(run("a; fail; for i 1 2; fail; end; b", 0, &sim), "did not compile");
+    CHECK(report.commands == 5 && report.errors == 3 && report.error_step == 1 && report.error_status == 3 &&
+          strcmp(report.error_line, "fail") == 0, "%lu commands, %lu errors, first at %d",
+          (unsigned long)report.commands, (unsigned long)report.errors, report.error_step);
+
+    CHECK(run("a", 0, &sim) && report.error_step == -1 && report.errors == 0, "clean run reported an error");
+
+    char src[64];
+    snprintf(src, sizeof(src), "for i 1 %d; wait 10; capture c$i; end", CONFIG_SCAN_SCRIPT_MAX_CAPTURES + 5);
+    CHECK(run(src, 0, &sim), "did not compile");
+    CHECK(report.ncaptures == CONFIG_SCAN_SCRIPT_MAX_CAPTURES && sim.captures == CONFIG_SCAN_SCRIPT_MAX_CAPTURES,
+          "%d captures kept, %lu taken", report.ncaptures, (unsigned long)sim.captures);
+    CHECK(report.captures[0].t_ms == 10 && report.captures[1].t_ms == 20 && report.captures[1].correct == 998,
+          "capture 2 at %lu ms", (unsigned long)report.captures[1].t_ms);
+}
+
+// src must not compile, with an error that starts with msg
+static void reject(const char *src, const char *msg) {
+    char err[64] = "";
+
+    CHECK(!scan_script_compile(&script, src, err, sizeof(err)), "'%s' compiled", src);
+    CHECK(strncmp(err, msg, strlen(msg)) == 0, "'%s': '%s', expected '%s'", src, err, msg);
+}
+
+static void test_compile_errors(void) {
+    static char big[CONFIG_SCAN_SCRIPT_MAX_LEN + 256];
+
+    reject("wait", "Statement 1: wait <ms>");
+    reject("a; wait x", "Statement 2: wait <ms>");
+    reject("wait -1", "Statement 1: wait <ms>");
+    reject("wait 10 20", "Statement 1: wait <ms>");
+    reject("for 1 2", "Statement 1: for <var>");
+    reject("for i 1", "Statement 1: for <var>");
+    reject("for toolongname 1 2; end", "Statement 1: for <var>");
+    reject("for i 1 2 0; end", "Statement 1: step must be");
+    reject("for i 1 2 x; end", "Statement 1: step must be");
+    reject("for a 1 1; for b 1 1; for c 1 1; for d 1 1; for e 1 1; end; end; end; end; end",
+           "Statement 5: loops nested deeper");
+    reject("end", "Statement 1: end without for");
+    reject("for i 1 2; end 3", "Statement 2: end takes no");
+    reject("for i 1 2; x", "for without end");
+    reject("x $i", "Statement 1: unknown $variable");
+    reject("for i 1 2; end; x $i", "Statement 3: unknown $variable");
+    reject("x $", "Statement 1: unknown $variable");
+    reject("capture a_label_that_is_too_long", "Statement 1: capture label");
+
+    memset(big, 'x', SCAN_SCRIPT_MAX_LINE);
+    big[SCAN_SCRIPT_MAX_LINE] = '\0';
+    reject(big, "Statement 1 is too long");
+
+    size_t len = 0;
+    for (int i = 0; i <= CONFIG_SCAN_SCRIPT_MAX_STEPS; i++) {
+        len += (size_t)snprintf(big + len, sizeof(big) - len, "a;");
+    }
+    reject(big, "More than");
+
+    len = 0;
+    while (len + 120 < sizeof(big)) {
+        memset(big + len, 'y', 100);
+        big[len + 100] = ';';
+        len += 101;
+    }
+    big[len] = '\0';
+    reject(big, "Script is longer than");
+}
+
+int main(void) {
+    test_loops();
+    test_expansion();
+    test_timeline();
+    test_errors_and_captures();
+    test_compile_errors();
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("scan_script: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,404 @@
+// Reads the telemetry of several scanners at once and serves their sweeps,
+// merged into time-aligned device x channel matrices, to local clients over a
+// Unix socket. One thread, one epoll set: device inputs, the listening
+// socket and the clients. Each device is named on the command line:
+//
+//   scanee_agg -s /tmp/scanee.sock roof=/dev/ttyACM0 lobby=/dev/ttyACM1
+//   socat - UNIX-CONNECT:/tmp/scanee.sock
+//
+// Clients get one JSON line per time bin (see scan_merge.h). A client that
+// does not keep up loses lines rather than holding up the others. Devices
+// that disappear, e.g. on a USB reset, are reopened once a second.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "scan_decode.h"
+#include "scan_merge.h"
+#include "host_serial.h"
+
+#define MAX_CLIENTS     32
+#define CLIENT_BUF_LEN  (64 * 1024)
+#define LINE_MAX_LEN    (16 * 1024)
+#define REOPEN_MS       1000
+#define TICK_MS         100
+
+typedef enum {
+    SRC_DEVICE,
+    SRC_LISTEN,
+    SRC_CLIENT,
+} src_kind_t;
+
+typedef struct {
+    src_kind_t kind;
+    int fd;
+} src_t;
+
+typedef struct {
+    src_t src;
+    const char *name;
+    const char *path;
+    int64_t reopen_ms;          // When to try again while fd is -1
+    scan_tlm_parser_t parser;
+    scan_decode_seq_t seq;
+    scan_clock_t clock;
+    uint32_t sweeps;
+    uint32_t malformed;
+    uint32_t reopens;
+} device_t;
+
+typedef struct {
+    src_t src;
+    size_t len;
+    uint32_t dropped;           // Lines lost because the client fell behind
+    char buf[CLIENT_BUF_LEN];
+} client_t;
+
+static device_t devices[SCAN_MERGE_MAX_DEVICES];
+static const char *device_names[SCAN_MERGE_MAX_DEVICES];
+static int ndevices;
+static client_t *clients[MAX_CLIENTS];
+static src_t listener = {.kind = SRC_LISTEN, .fd = -1};
+static scan_merge_t merge;
+static int epfd;
+static int64_t epoch_ms;        // Unix time minus the monotonic clock
+static volatile sig_atomic_t stop;
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-s socket] [-b bin_ms] [-L latency_ms] name=device ...\n"
+            "  device is a serial port, pty or FIFO, up to %d of them\n"
+            "  -s  Unix socket to serve merged bins on (default /tmp/scanee.sock)\n"
+            "  -b  time bin width (default 2000 ms)\n"
+            "  -L  how long a bin waits for late sweeps after it ends (default 3000 ms)\n",
+            prog, SCAN_MERGE_MAX_DEVICES);
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static int64_t clock_ms(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int64_t now_ms(void) {
+    return clock_ms(CLOCK_MONOTONIC);
+}
+
+static int watch(src_t *src, uint32_t events, int op) {
+    struct epoll_event ev = {.events = events, .data.ptr = src};
+    return epoll_ctl(epfd, op, src->fd, &ev);
+}
+
+static void device_open(device_t *dev) {
+    dev->src.fd = host_serial_open(dev->path, O_RDONLY | O_NONBLOCK);
+    if (dev->src.fd < 0) {
+        dev->reopen_ms = now_ms() + REOPEN_MS;
+        return;
+    }
+    // Regular files cannot be polled
+    if (watch(&dev->src, EPOLLIN, EPOLL_CTL_ADD) < 0) {
+        fprintf(stderr, "%s: %s\n", dev->path, strerror(errno));
+        close(dev->src.fd);
+        dev->src.fd = -1;
+        dev->reopen_ms = INT64_MAX;
+        return;
+    }
+    // A new connection starts mid-stream; resynchronise on the next frame
+    scan_tlm_parser_init(&dev->parser);
+    dev->seq.started = false;
+}
+
+static void device_close(device_t *dev) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, dev->src.fd, NULL);
+    close(dev->src.fd);
+    dev->src.fd = -1;
+    dev->reopen_ms = now_ms() + REOPEN_MS;
+    dev->reopens++;
+}
+
+static void device_frame(device_t *dev, const scan_tlm_frame_t *frame, int64_t rx_ms) {
+    static scan_decoded_sweep_t sweep;
+    static scan_decoded_devices_t sketches;
+
+    if (frame->type != SCAN_TLM_SWEEP && frame->type != SCAN_TLM_SWEEP_MORE && frame->type != SCAN_TLM_APS &&
+        frame->type != SCAN_TLM_DEVICES) {
+        return;
+    }
+
+    scan_decode_seq_update(&dev->seq, frame->seq);
+
+    // Sketches follow their sweep, whose clock mapping they share; window
+    // sketches are kept per device until they are older than their window
+    if (frame->type == SCAN_TLM_DEVICES) {
+        if (!scan_decode_devices(frame, &sketches)) {
+            dev->malformed++;
+        } else if (!dev->clock.valid) {
+            // Nothing to map the time with before the first sweep
+        } else if (sketches.window_s == 0) {
+            scan_merge_add_devices(&merge, sketches.time_ms + dev->clock.offset_ms, &sketches);
+        } else {
+            scan_merge_add_window(&merge, (int)(dev - devices), sketches.time_ms + dev->clock.offset_ms, &sketches);
+        }
+        return;
+    }
+    // The matrices need no more than the first frame of a split sweep
+    if (frame->type != SCAN_TLM_SWEEP) return;
+
+    if (!scan_decode_sweep(frame, &sweep)) {
+        dev->malformed++;
+        return;
+    }
+    int64_t t = scan_clock_update(&dev->clock, sweep.time_ms, rx_ms);
+    scan_merge_add(&merge, (int)(dev - devices), t, &sweep);
+    dev->sweeps++;
+}
+
+static void device_read(device_t *dev) {
+    uint8_t buf[4096];
+
+    for (;;) {
+        ssize_t n = read(dev->src.fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) return;
+        if (n <= 0) {
+            // End of file, or EIO once the other side of a pty or a USB port is gone
+            fprintf(stderr, "%s: %s\n", dev->name, n == 0 ? "closed" : strerror(errno));
+            device_close(dev);
+            return;
+        }
+
+        int64_t rx_ms = now_ms();
+        size_t off = 0;
+        while (off < (size_t)n) {
+            scan_tlm_frame_t frame;
+            bool have_frame;
+            off += scan_tlm_parser_feed(&dev->parser, buf + off, (size_t)n - off, &frame, &have_frame);
+            if (have_frame) {
+                device_frame(dev, &frame, rx_ms);
+            }
+        }
+    }
+}
+
+static void client_close(client_t *c) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i] == c) clients[i] = NULL;
+    }
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->src.fd, NULL);
+    close(c->src.fd);
+    free(c);
+}
+
+// Returns false if the client has gone
+static bool client_flush(client_t *c) {
+    while (c->len > 0) {
+        ssize_t n = send(c->src.fd, c->buf, c->len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) break;
+        if (n <= 0) return false;
+        memmove(c->buf, c->buf + n, c->len - (size_t)n);
+        c->len -= (size_t)n;
+    }
+    watch(&c->src, c->len ? EPOLLIN | EPOLLOUT : EPOLLIN, EPOLL_CTL_MOD);
+    return true;
+}
+
+static void client_accept(void) {
+    int fd = accept4(listener.fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return;
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i] == NULL) {
+            client_t *c = calloc(1, sizeof(*c));
+            if (c == NULL) break;
+            c->src = (src_t){.kind = SRC_CLIENT, .fd = fd};
+            clients[i] = c;
+            watch(&c->src, EPOLLIN, EPOLL_CTL_ADD);
+            return;
+        }
+    }
+    close(fd);
+}
+
+// Clients only listen; anything they send is read and ignored
+static void client_event(client_t *c, uint32_t events) {
+    if (events & EPOLLIN) {
+        char buf[256];
+        ssize_t n = recv(c->src.fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            client_close(c);
+            return;
+        }
+    }
+    if ((events & (EPOLLERR | EPOLLHUP)) || ((events & EPOLLOUT) && !client_flush(c))) {
+        client_close(c);
+    }
+}
+
+static void emit_bin(const scan_merge_bin_t *bin, void *ctx) {
+    static char line[LINE_MAX_LEN];
+    size_t len = scan_merge_format(&merge, bin, device_names, ndevices, epoch_ms, line, sizeof(line));
+
+    (void)ctx;
+    if (len == 0) return;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        client_t *c = clients[i];
+        if (c == NULL) continue;
+        if (CLIENT_BUF_LEN - c->len < len) {
+            c->dropped++;
+            continue;
+        }
+        memcpy(c->buf + c->len, line, len);
+        c->len += len;
+        if (!client_flush(c)) {
+            client_close(c);
+        }
+    }
+}
+
+static int listen_on(const char *path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void print_summary(void) {
+    for (int i = 0; i < ndevices; i++) {
+        const device_t *d = &devices[i];
+        fprintf(stderr, "%s: sweeps %u, lost %u, crc errors %u, malformed %u, clock offset %lld ms, "
+                "reboots %u, reopens %u\n", d->name, d->sweeps, d->seq.lost, d->parser.crc_errors,
+                d->malformed, (long long)d->clock.offset_ms, d->clock.resets, d->reopens);
+    }
+    fprintf(stderr, "late sweeps %u, sweeps too far ahead %u\n", merge.late, merge.ahead);
+}
+
+int main(int argc, char **argv) {
+    const char *sock_path = "/tmp/scanee.sock";
+    uint32_t bin_ms = 2000;
+    uint32_t latency_ms = 3000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:b:L:h")) != -1) {
+        switch (opt) {
+        case 's': sock_path = optarg; break;
+        case 'b': bin_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'L': latency_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (bin_ms == 0 || optind == argc || argc - optind > SCAN_MERGE_MAX_DEVICES) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        return 1;
+    }
+
+    listener.fd = listen_on(sock_path);
+    if (listener.fd < 0) {
+        perror(sock_path);
+        return 1;
+    }
+    watch(&listener, EPOLLIN, EPOLL_CTL_ADD);
+
+    scan_merge_init(&merge, bin_ms, latency_ms);
+    epoch_ms = clock_ms(CLOCK_REALTIME) - now_ms();
+
+    for (int i = optind; i < argc; i++) {
+        device_t *dev = &devices[ndevices];
+        char *eq = strchr(argv[i], '=');
+
+        dev->src.kind = SRC_DEVICE;
+        dev->name = argv[i];
+        dev->path = argv[i];
+        if (eq) {
+            *eq = '\0';
+            dev->path = eq + 1;
+        }
+        scan_clock_init(&dev->clock);
+        device_names[ndevices++] = dev->name;
+        device_open(dev);
+        if (dev->src.fd < 0 && dev->reopen_ms != INT64_MAX) {
+            fprintf(stderr, "%s: %s, retrying\n", dev->path, strerror(errno));
+        }
+    }
+
+    // No SA_RESTART, so a signal ends epoll_wait and the summary is printed
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    while (!stop) {
+        struct epoll_event events[16];
+        int n = epoll_wait(epfd, events, 16, TICK_MS);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            src_t *src = events[i].data.ptr;
+            switch (src->kind) {
+            case SRC_DEVICE:
+                device_read((device_t *)src);
+                break;
+            case SRC_LISTEN:
+                client_accept();
+                break;
+            case SRC_CLIENT:
+                client_event((client_t *)src, events[i].events);
+                break;
+            }
+        }
+
+        int64_t now = now_ms();
+        for (int i = 0; i < ndevices; i++) {
+            if (devices[i].src.fd < 0 && now >= devices[i].reopen_ms) {
+                device_open(&devices[i]);
+            }
+        }
+        scan_merge_flush(&merge, now, emit_bin, NULL);
+    }
+
+    print_summary();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i]) client_close(clients[i]);
+    }
+    close(listener.fd);
+    unlink(sock_path);
+    return 0;
+}
@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+# End-to-end check of scanee_agg against scanee_replay. Two recordings from
+# scanee_host are replayed on ptys and merged; the JSON lines from the socket
+# and the per-device summary must account for every sweep. Recording b has a
+# sweep frame with a broken CRC, a stray frame header and console text in it,
+# so the parser has to resynchronise. Recording a is replayed a second time
+# on a new pty behind the same path, which the aggregator has to reopen and
+# treat as a device that rebooted. Only a carries window sketches, which
+# must show up in the lines as windows of one device.
+#
+#   scanee_agg_test.py <directory with the host tools>
+
+import json
+import os
+import re
+import shutil
+import signal
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+SPEED = 20
+BIN_MS = 1000
+LATENCY_MS = 2000
+
+
+def fail(msg):
+    print('FAIL: ' + msg, file=sys.stderr)
+    sys.exit(1)
+
+
+def frames(data):
+    """Offset, type and length of each frame in a recording with nothing else in it"""
+    off = 0
+    while off < len(data):
+        if data[off:off + 2] != b'\xa5\x5c':
+            fail('recording is not bare telemetry at offset %d' % off)
+        n = 8 + int.from_bytes(data[off + 6:off + 8], 'little') + 2
+        yield off, data[off + 3], n
+        off += n
+
+
+def count_sweeps(data):
+    return sum(1 for _, kind, _ in frames(data) if kind == 1)
+
+
+def record(tools, seed, *extra):
+    return subprocess.run([os.path.join(tools, 'scanee_host'), '-b', '-s', str(seed), '-n', '6000'] + list(extra),
+                          check=True, stdout=subprocess.PIPE).stdout
+
+
+def damage(data):
+    """Break the CRC of the fifth sweep frame and add junk in front of two others"""
+    sweeps = [(off, n) for off, kind, n in frames(data) if kind == 1]
+    if len(sweeps) < 8:
+        fail('recording too short')
+    out = bytearray(data)
+    off, n = sweeps[4]
+    out[off + 8 + n // 2] ^= 0xFF
+    # Later offsets first so the earlier ones stay valid
+    stray = b'\xa5\x5c\x01\x01\x00\x00\x10\x00'     # Header of a 16-byte frame whose CRC cannot match
+    out[sweeps[6][0]:sweeps[6][0]] = stray
+    out[sweeps[2][0]:sweeps[2][0]] = b'I (1234) scan: console text between frames\r\n'
+    return bytes(out)
+
+
+def replay(tools, links, recordings):
+    """Start scanee_replay and point each link at its pty"""
+    proc = subprocess.Popen([os.path.join(tools, 'scanee_replay'), '-x', str(SPEED), '-d', '0.5'] + recordings,
+                            stdout=subprocess.PIPE, text=True)
+    for link in links:
+        path, pty = proc.stdout.readline().split()
+        tmp = link + '.new'
+        os.symlink(pty, tmp)
+        os.replace(tmp, link)
+    return proc
+
+
+def read_lines(sock, lines):
+    buf = b''
+    while True:
+        chunk = sock.recv(65536)
+        if not chunk:
+            break
+        buf += chunk
+    lines.extend(buf.decode().splitlines())
+
+
+def main():
+    if len(sys.argv) != 2:
+        print('usage: %s <tool directory>' % sys.argv[0], file=sys.stderr)
+        return 2
+    tools = sys.argv[1]
+    work = tempfile.mkdtemp(prefix='scanee_agg_test.')
+    try:
+        return run(tools, work)
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+
+def run(tools, work):
+    a_bin = os.path.join(work, 'a.bin')
+    b_bin = os.path.join(work, 'b.bin')
+    a = record(tools, 1, '-D')
+    b = damage(record(tools, 2))
+    with open(a_bin, 'wb') as f:
+        f.write(a)
+    with open(b_bin, 'wb') as f:
+        f.write(b)
+    a_sweeps = count_sweeps(a)
+    b_sweeps = count_sweeps(record(tools, 2)) - 1
+
+    dev_a = os.path.join(work, 'dev_a')
+    dev_b = os.path.join(work, 'dev_b')
+    sock_path = os.path.join(work, 'agg.sock')
+
+    first = replay(tools, [dev_a, dev_b], [a_bin, b_bin])
+    agg = subprocess.Popen([os.path.join(tools, 'scanee_agg'), '-s', sock_path, '-b', str(BIN_MS),
+                            '-L', str(LATENCY_MS), 'a=' + dev_a, 'b=' + dev_b],
+                           stderr=subprocess.PIPE, text=True)
+
+    deadline = time.time() + 5
+    client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    while True:
+        try:
+            client.connect(sock_path)
+            break
+        except OSError:
+            if time.time() > deadline:
+                agg.kill()
+                first.kill()
+                fail('scanee_agg did not open its socket')
+            time.sleep(0.05)
+    lines = []
+    reader = threading.Thread(target=read_lines, args=(client, lines))
+    reader.start()
+
+    # The ptys go away with the first replay; the second one comes back behind dev_a
+    first.wait(timeout=60)
+    time.sleep(1.5)
+    second = replay(tools, [dev_a], [a_bin])
+    second.wait(timeout=60)
+    time.sleep((BIN_MS + LATENCY_MS) / 1000 + 1)
+
+    agg.send_signal(signal.SIGTERM)
+    _, summary = agg.communicate(timeout=10)
+    reader.join(timeout=10)
+    client.close()
+    sys.stderr.write(summary)
+
+    stats = {}
+    for m in re.finditer(r'^(\w+): sweeps (\d+), lost (\d+), crc errors (\d+), malformed (\d+), '
+                         r'clock offset -?\d+ ms, reboots (\d+), reopens (\d+)$', summary, re.M):
+        stats[m.group(1)] = dict(zip(('sweeps', 'lost', 'crc', 'malformed', 'reboots', 'reopens'),
+                                     map(int, m.groups()[1:])))
+    m = re.search(r'^late sweeps (\d+), sweeps too far ahead (\d+)$', summary, re.M)
+    if set(stats) != {'a', 'b'} or m is None:
+        fail('no summary from scanee_agg')
+    late, ahead = int(m.group(1)), int(m.group(2))
+
+    # Reopened and restarted: both passes of a arrive, the second after a clock reset
+    sa = stats['a']
+    if sa['sweeps'] != 2 * a_sweeps or sa['lost'] or sa['crc'] or sa['malformed']:
+        fail('device a: expected %d sweeps and no errors, got %s' % (2 * a_sweeps, sa))
+    if sa['reopens'] < 1 or sa['reboots'] != 1:
+        fail('device a: expected a reopen and one reboot, got %s' % sa)
+
+    # Resynchronised: only the broken sweep is missing, counted as lost
+    sb = stats['b']
+    if sb['sweeps'] != b_sweeps or sb['lost'] != 1 or sb['crc'] != 2 or sb['malformed']:
+        fail('device b: expected %d sweeps, 1 lost and 2 CRC errors, got %s' % (b_sweeps, sb))
+
+    merged = [0, 0]
+    windows = set()
+    last_time = None
+    for line in lines:
+        row = json.loads(line)
+        if row['devices'] != ['a', 'b'] or row['bin_ms'] != BIN_MS or len(row['rssi']) != 2:
+            fail('unexpected line: ' + line)
+        if last_time is not None and row['time_ms'] <= last_time:
+            fail('bins out of order: ' + line)
+        last_time = row['time_ms']
+        for d in range(2):
+            merged[d] += row['sweeps'][d]
+            if (row['rssi'][d] is None) != (row['sweeps'][d] == 0):
+                fail('device row does not match its sweep count: ' + line)
+        for w in row.get('windows', []):
+            if w['devices'] != 1 or w['transmitters_all'] == 0 or len(w['transmitters']) != row['channels']:
+                fail('unexpected window: ' + line)
+            windows.add(w['window_s'])
+    if merged[0] + merged[1] + late + ahead != sa['sweeps'] + sb['sweeps']:
+        fail('merged %s sweeps, %d late and %d ahead out of %d' %
+             (merged, late, ahead, sa['sweeps'] + sb['sweeps']))
+    if late or ahead:
+        fail('%d late and %d early sweeps with a replay this regular' % (late, ahead))
+    if windows != {60, 900, 3600}:
+        fail('expected the windows of device a, got %s' % sorted(windows))
+
+    print('%d lines, %d + %d sweeps merged' % (len(lines), merged[0], merged[1]))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
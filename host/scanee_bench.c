@@ -0,0 +1,393 @@
+// Throughput benchmark for the scanner hot path: the promiscuous callback
+// (scan_capture into the ring) and the aggregator (ring drain into the sweep,
+// frame classes, the station table, beacon timing, the distinct
+// transmitter sketches and the top talkers).
+// Run it before flashing to catch per-frame cost regressions.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include "scan_core.h"
+#include "scan_prof.h"
+#include "host_source.h"
+
+// Frames are generated once into a pool and replayed cyclically so that
+// source cost does not show up in the measurement
+#define POOL_MAX 4096
+#define BATCH    256
+
+// Reading the clock costs more than a capture, so only every n-th is timed
+#define PROF_SAMPLE_EVERY 64
+
+static scan_ring_t ring;
+static scan_sweep_t sweep;
+static scan_sta_table_t stations;
+static scan_seq_cache_t seq_cache;
+static scan_bcn_table_t beacons;
+static scan_dev_set_t devices;
+static scan_talkers_t talkers;
+static const scan_agg_t agg = {.sweep = &sweep, .stations = &stations, .seq_cache = &seq_cache, .beacons = &beacons,
+                               .devices = &devices, .talkers = &talkers};
+static scan_filter_config_t filter_cfg;
+static scan_filter_t filter;
+static host_frame_t pool[POOL_MAX];
+static scan_pkt_rec_t pool_recs[POOL_MAX];
+static size_t pool_len;
+static size_t pool_recs_len;
+
+static _Atomic bool producer_done;
+static scan_prof_t prof;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void report(const char *what, uint64_t frames, uint64_t ns) {
+    double per = frames ? (double)ns / (double)frames : 0.0;
+    double rate = ns ? (double)frames * 1e9 / (double)ns : 0.0;
+    printf("%-12s %10.2f ns/frame %12.0f frames/s\n", what, per, rate);
+}
+
+static uint64_t sweep_total(void) {
+    uint64_t total = 0;
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        total += (uint64_t)sweep.packet_count[i];
+    }
+    return total;
+}
+
+// Capture and aggregation alternate in batches on one thread, timed separately
+static void bench_inline(uint64_t frames) {
+    uint64_t capture_ns = 0;
+    uint64_t aggregate_ns = 0;
+    uint64_t done = 0;
+    size_t next = 0;
+
+    while (done < frames) {
+        uint64_t n = frames - done < BATCH ? frames - done : BATCH;
+
+        uint64_t t0 = now_ns();
+        for (uint64_t i = 0; i < n; i++) {
+            scan_capture(&ring, &filter, &pool[next].pkt, pool[next].type);
+            if (++next == pool_len) next = 0;
+        }
+        uint64_t t1 = now_ns();
+        scan_agg_drain(&agg, &ring, 0);
+        uint64_t t2 = now_ns();
+
+        capture_ns += t1 - t0;
+        aggregate_ns += t2 - t1;
+        done += n;
+    }
+
+    report("capture", frames, capture_ns);
+    report("aggregate", frames, aggregate_ns);
+    report("total", frames, capture_ns + aggregate_ns);
+}
+
+// Station table lookups alone, on the records the pool turns into
+static void bench_stations(uint64_t frames) {
+    scan_sta_table_t *table = calloc(1, sizeof(*table));
+    size_t next = 0;
+
+    if (!table || pool_recs_len == 0) {
+        free(table);
+        return;
+    }
+    scan_sta_init(table);
+
+    uint64_t t0 = now_ns();
+    for (uint64_t i = 0; i < frames; i++) {
+        scan_sta_update(table, &pool_recs[next], (uint32_t)i);
+        if (++next == pool_recs_len) next = 0;
+    }
+    uint64_t t1 = now_ns();
+
+    report("stations", frames, t1 - t0);
+    printf("stations     %u tracked, %lu evicted\n", table->count, (unsigned long)table->evictions);
+    free(table);
+}
+
+// Sketch updates alone, then the estimate against the true count for
+// random addresses, a few sketches per size
+static void bench_devices(uint64_t frames) {
+    static scan_dev_set_t set;
+    size_t next = 0;
+
+    if (pool_recs_len == 0) return;
+    scan_dev_reset(&set);
+
+    uint64_t t0 = now_ns();
+    for (uint64_t i = 0; i < frames; i++) {
+        scan_dev_update(&set, &pool_recs[next]);
+        if (++next == pool_recs_len) next = 0;
+    }
+    uint64_t t1 = now_ns();
+    report("devices", frames, t1 - t0);
+
+    uint64_t rng = 0x9e3779b97f4a7c15ULL;
+    uint32_t err = scan_hll_error_permille();
+    printf("devices      %u registers, %zu bytes per sketch, standard error %lu.%lu %%\n", SCAN_HLL_REGS,
+           sizeof(scan_hll_t), (unsigned long)(err / 10), (unsigned long)(err % 10));
+    printf("%-12s %10s %10s %10s %10s\n", "distinct", "mean est", "mean err %", "max err %", "bytes");
+    for (uint32_t n = 10; n <= 1000000; n *= 10) {
+        const int runs = 8;
+        double sum_est = 0.0;
+        double sum_err = 0.0;
+        double max_err = 0.0;
+        size_t bytes = 0;
+
+        for (int run = 0; run < runs; run++) {
+            scan_hll_t h;
+            uint8_t buf[SCAN_HLL_MAX_ENCODED];
+
+            scan_hll_reset(&h);
+            for (uint32_t i = 0; i < n; i++) {
+                uint8_t mac[6];
+                rng ^= rng >> 12;
+                rng ^= rng << 25;
+                rng ^= rng >> 27;
+                uint64_t x = rng * 0x2545F4914F6CDD1DULL;
+                for (int b = 0; b < 6; b++) {
+                    mac[b] = (uint8_t)(x >> (8 * b));
+                }
+                scan_hll_add_mac(&h, mac);
+            }
+            uint32_t est = scan_hll_estimate(&h);
+            double e = 100.0 * ((double)est - n) / n;
+            sum_est += est;
+            sum_err += e < 0 ? -e : e;
+            if ((e < 0 ? -e : e) > max_err) max_err = e < 0 ? -e : e;
+            bytes += scan_hll_encode(&h, buf, sizeof(buf));
+        }
+        printf("%-12u %10.0f %10.2f %10.2f %10zu\n", n, sum_est / runs, sum_err / runs, max_err, bytes / runs);
+    }
+}
+
+// Top talker updates alone, then the summaries against exact counts for
+// Zipf-distributed transmitters with frame lengths that differ per transmitter
+static void bench_talkers(uint64_t frames) {
+    static scan_talkers_t set;
+    size_t next = 0;
+
+    if (pool_recs_len == 0) return;
+    scan_talkers_reset(&set);
+
+    uint64_t t0 = now_ns();
+    for (uint64_t i = 0; i < frames; i++) {
+        scan_talkers_update(&set, &pool_recs[next]);
+        if (++next == pool_recs_len) next = 0;
+    }
+    uint64_t t1 = now_ns();
+    report("talkers", frames, t1 - t0);
+
+    scan_top_entry_t top[5];
+    const int k = (int)(sizeof(top) / sizeof(top[0]));
+    const uint32_t stream = 1000000;
+    uint64_t rng = 0x9e3779b97f4a7c15ULL;
+    printf("talkers      %d counters, %zu bytes per summary, top %d of %lu weighted frames\n",
+           CONFIG_SCAN_TOP_COUNTERS, sizeof(scan_top_t), k, (unsigned long)stream);
+    printf("%-12s %10s %10s %10s %10s\n", "distinct", "found", "certain", "max err %", "bound %");
+    for (uint32_t n = 10; n <= 100000; n *= 10) {
+        uint64_t *truth = calloc(n, sizeof(*truth));
+        double *cdf = malloc(n * sizeof(*cdf));
+        scan_top_t s;
+        double z = 0.0;
+
+        if (!truth || !cdf) {
+            free(truth);
+            free(cdf);
+            return;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            z += 1.0 / (i + 1);
+            cdf[i] = z;
+        }
+
+        scan_top_reset(&s);
+        for (uint32_t f = 0; f < stream; f++) {
+            rng ^= rng >> 12;
+            rng ^= rng << 25;
+            rng ^= rng >> 27;
+            double r = (double)((rng * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53) * z;
+            uint32_t lo = 0;
+            uint32_t hi = n - 1;
+            while (lo < hi) {
+                uint32_t mid = (lo + hi) / 2;
+                if (cdf[mid] < r) lo = mid + 1; else hi = mid;
+            }
+            uint8_t mac[6] = {0x02, 0, (uint8_t)(lo >> 24), (uint8_t)(lo >> 16), (uint8_t)(lo >> 8), (uint8_t)lo};
+            uint32_t weight = 100 + (lo * 2654435761u >> 24);
+            truth[lo] += weight;
+            scan_top_add(&s, mac, weight);
+        }
+
+        // An entry is found if fewer than k transmitters truly weigh more
+        size_t m = scan_top_list(&s, top, (size_t)k);
+        int found = 0;
+        int certain = 0;
+        double max_err = 0.0;
+        for (size_t i = 0; i < m; i++) {
+            uint32_t id = (uint32_t)top[i].mac[2] << 24 | (uint32_t)top[i].mac[3] << 16 |
+                          (uint32_t)top[i].mac[4] << 8 | top[i].mac[5];
+            uint64_t beaten = 0;
+            for (uint32_t j = 0; j < n; j++) {
+                beaten += truth[j] > truth[id];
+            }
+            found += beaten < (uint64_t)k;
+            certain += top[i].guaranteed;
+            double e = 100.0 * (double)(top[i].count - truth[id]) / s.total;
+            if (e > max_err) max_err = e;
+        }
+        printf("%-12u %10d %10d %10.2f %10.2f\n", n, found, certain, max_err, 100.0 / CONFIG_SCAN_TOP_COUNTERS);
+        free(truth);
+        free(cdf);
+    }
+}
+
+static void *consumer_main(void *arg) {
+    (void)arg;
+    while (!producer_done) {
+        uint32_t t0 = scan_prof_cycles();
+        if (scan_agg_drain(&agg, &ring, 0) > 0) {
+            scan_prof_add(&prof, SCAN_PROF_DRAIN, scan_prof_cycles() - t0);
+        }
+    }
+    scan_agg_drain(&agg, &ring, 0);
+    return NULL;
+}
+
+// Producer and consumer on separate threads, as the Wi-Fi and aggregator tasks
+// run on separate cores on the device. Drops show where the consumer falls behind.
+static int bench_threaded(uint64_t frames) {
+    pthread_t consumer;
+    size_t next = 0;
+
+    if (pthread_create(&consumer, NULL, consumer_main, NULL) != 0) {
+        perror("pthread_create");
+        return 1;
+    }
+
+    uint64_t t0 = now_ns();
+    for (uint64_t i = 0; i < frames; i++) {
+        if (i % PROF_SAMPLE_EVERY == 0) {
+            uint32_t c0 = scan_prof_cycles();
+            scan_capture(&ring, &filter, &pool[next].pkt, pool[next].type);
+            scan_prof_add(&prof, SCAN_PROF_CALLBACK, scan_prof_cycles() - c0);
+        } else {
+            scan_capture(&ring, &filter, &pool[next].pkt, pool[next].type);
+        }
+        if (++next == pool_len) next = 0;
+    }
+    uint64_t t1 = now_ns();
+    producer_done = true;
+    pthread_join(consumer, NULL);
+    uint64_t t2 = now_ns();
+
+    report("capture", frames, t1 - t0);
+    report("end-to-end", frames, t2 - t0);
+
+    // Latency spread of single captures (sampled) and of non-empty drains
+    scan_prof_snap_t snap[SCAN_PROF_PROBES];
+    for (int probe = 0; probe < SCAN_PROF_PROBES; probe++) {
+        scan_prof_snapshot(&prof, probe, &snap[probe]);
+    }
+    scan_prof_report_print(snap, prof.cycles_per_us, (uint32_t)((t2 - t0) / 1000000), false);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-n frames] [-r capture.pcap] [-s seed] [-t] [-T classes] [-R dbm]\n"
+            "  -n  frames to push through the pipeline (default 10000000)\n"
+            "  -r  build the frame pool from a pcap instead of the synthetic source\n"
+            "  -s  synthetic generator seed (default 1)\n"
+            "  -t  run producer and consumer on separate threads\n"
+            "  -T  capture filter: only these frame classes, comma separated\n"
+            "  -R  capture filter: only frames at or above this RSSI\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    uint64_t frames = 10000000;
+    const char *pcap_path = NULL;
+    bool threaded = false;
+    synth_config_t synth = SYNTH_CONFIG_DEFAULT();
+    int opt;
+
+    synth.channels = CONFIG_MAX_WIFI_CHANNELS;
+    scan_filter_config_default(&filter_cfg);
+
+    while ((opt = getopt(argc, argv, "n:r:s:tT:R:h")) != -1) {
+        switch (opt) {
+        case 'n': frames = strtoull(optarg, NULL, 0); break;
+        case 'r': pcap_path = optarg; break;
+        case 's': synth.seed = strtoull(optarg, NULL, 0); break;
+        case 't': threaded = true; break;
+        case 'T':
+            if (!scan_filter_parse_classes(optarg, &filter_cfg.classes)) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'R': filter_cfg.min_rssi = (int8_t)atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    synth.count = POOL_MAX;
+    host_source_t *src = pcap_path ? pcap_source_open(pcap_path, 1) : synth_source_open(&synth);
+    if (!src) {
+        return 1;
+    }
+    while (pool_len < POOL_MAX && host_source_next(src, &pool[pool_len]) > 0) {
+        pool_len++;
+    }
+    host_source_close(src);
+    if (pool_len == 0) {
+        fprintf(stderr, "no frames in source\n");
+        return 1;
+    }
+
+    // Records as the callback would produce them, for the table-only pass
+    scan_ring_init(&ring);
+    for (size_t i = 0; i < pool_len; i++) {
+        scan_capture(&ring, NULL, &pool[i].pkt, pool[i].type);
+        pool_recs_len += scan_ring_pop(&ring, &pool_recs[pool_recs_len], 1);
+    }
+
+    scan_filter_compile(&filter_cfg, &filter);
+    scan_prof_init(&prof, 1000);
+    scan_ring_init(&ring);
+    scan_sweep_reset(&sweep);
+    scan_sta_init(&stations);
+    scan_bcn_init(&beacons);
+    scan_seq_cache_init(&seq_cache);
+    scan_dev_reset(&devices);
+    scan_talkers_reset(&talkers);
+
+    printf("frames       %llu (pool of %zu, ring of %d)\n",
+           (unsigned long long)frames, pool_len, CONFIG_SCAN_RING_SIZE);
+
+    int ret = 0;
+    if (threaded) {
+        ret = bench_threaded(frames);
+    } else {
+        bench_inline(frames);
+        bench_stations(frames);
+        bench_devices(frames);
+        bench_talkers(frames);
+    }
+
+    printf("aggregated   %llu\n", (unsigned long long)sweep_total());
+    printf("ring drops   %lu\n", (unsigned long)scan_ring_dropped(&ring));
+    printf("filtered     %lu\n", (unsigned long)(frames - atomic_load(&filter.passed)));
+    return ret;
+}
@@ -0,0 +1,185 @@
+// Turns a scanner telemetry stream (serial port, pty, file or stdin) back into
+// CSV or JSON lines. Text mixed into the stream, e.g. log output, is skipped.
+// With -l the input is an image of the scanner's flash log partition instead,
+// as read with esptool.py read_flash or parttool.py read_partition.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "scan_decode.h"
+#include "scan_flog.h"
+#include "host_serial.h"
+
+static scan_tlm_parser_t parser;
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-f csv|json] [-l] [input]\n"
+            "  input is a serial device, file or '-' for stdin (default)\n"
+            "  -l  input is a flash log partition image\n",
+            prog);
+}
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+} log_image_t;
+
+static bool image_read(uint32_t offset, void *buf, size_t len, void *ctx) {
+    const log_image_t *img = ctx;
+
+    if (offset > img->size || len > img->size - offset) return false;
+    memcpy(buf, img->data + offset, len);
+    return true;
+}
+
+typedef struct {
+    scan_decode_format_t fmt;
+    scan_decode_seq_t seq;
+    bool started;
+    uint32_t boot;
+    uint32_t lost;
+    uint32_t malformed;
+} log_decode_t;
+
+static bool decode_log_frame(const scan_flog_record_t *rec, void *ctx) {
+    log_decode_t *d = ctx;
+
+    // Sequence numbers restart with every boot
+    if (!d->started || rec->boot != d->boot) {
+        d->lost += d->seq.lost;
+        d->seq = (scan_decode_seq_t){.frames = d->seq.frames};
+        d->started = true;
+        d->boot = rec->boot;
+    }
+    scan_decode_seq_update(&d->seq, rec->frame.seq);
+    if (!scan_decode_print(stdout, d->fmt, &rec->frame)) {
+        d->malformed++;
+    }
+    return true;
+}
+
+// The log is read whole; partitions are a few megabytes at most
+static int decode_log_image(const char *path, scan_decode_format_t fmt) {
+    FILE *fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (fp == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    uint8_t *data = NULL;
+    size_t size = 0, cap = 0;
+    for (;;) {
+        if (size == cap) {
+            cap = cap ? cap * 2 : 1 << 20;
+            uint8_t *grown = realloc(data, cap);
+            if (grown == NULL) {
+                perror("realloc");
+                free(data);
+                return 1;
+            }
+            data = grown;
+        }
+        size_t n = fread(data + size, 1, cap - size, fp);
+        if (n == 0) break;
+        size += n;
+    }
+    if (fp != stdin) fclose(fp);
+
+    log_image_t img = {.data = data, .size = size};
+    const scan_flog_ops_t ops = {.read = image_read, .ctx = &img};
+    static uint8_t sector[SCAN_FLOG_SECTOR];
+    log_decode_t d = {.fmt = fmt};
+    scan_flog_walk_stats_t stats;
+
+    if (fmt == SCAN_DECODE_CSV) {
+        scan_decode_print_csv_header(stdout);
+    }
+    bool ok = scan_flog_walk(&ops, (uint32_t)size, sector, decode_log_frame, &d, &stats);
+    scan_decode_flush(stdout, fmt);
+    free(data);
+
+    fprintf(stderr, "sectors %u, frames %u, lost %u, crc errors %u, malformed %u\n",
+            stats.sectors, stats.frames, d.lost + d.seq.lost, stats.bad, d.malformed);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    scan_decode_format_t fmt = SCAN_DECODE_CSV;
+    scan_decode_seq_t seq = {0};
+    uint32_t malformed = 0;
+    bool log_image = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:lh")) != -1) {
+        switch (opt) {
+        case 'f':
+            if (strcmp(optarg, "csv") == 0) {
+                fmt = SCAN_DECODE_CSV;
+            } else if (strcmp(optarg, "json") == 0) {
+                fmt = SCAN_DECODE_JSON;
+            } else {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'l':
+            log_image = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    const char *path = optind < argc ? argv[optind] : "-";
+    if (log_image) {
+        return decode_log_image(path, fmt);
+    }
+
+    int fd = host_serial_open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+
+    scan_tlm_parser_init(&parser);
+    if (fmt == SCAN_DECODE_CSV) {
+        scan_decode_print_csv_header(stdout);
+    }
+
+    uint8_t buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("read");
+            break;
+        }
+
+        size_t off = 0;
+        while (off < (size_t)n) {
+            scan_tlm_frame_t frame;
+            bool have_frame;
+            off += scan_tlm_parser_feed(&parser, buf + off, (size_t)n - off, &frame, &have_frame);
+            // Captured frames are numbered on their own, see scanee_pcap
+            if (!have_frame || frame.type == SCAN_TLM_PCAP) continue;
+
+            scan_decode_seq_update(&seq, frame.seq);
+            if (!scan_decode_print(stdout, fmt, &frame)) {
+                malformed++;
+            }
+        }
+        fflush(stdout);
+    }
+    close(fd);
+    scan_decode_flush(stdout, fmt);
+
+    fprintf(stderr, "frames %u, lost %u, crc errors %u, malformed %u, skipped bytes %u\n",
+            seq.frames, seq.lost, parser.crc_errors, malformed, parser.skipped);
+    return 0;
+}
@@ -0,0 +1,506 @@
+// Linux front end for the scanner core: replays a radiotap pcap or a synthetic
+// airspace through the same capture/aggregation path the firmware uses and
+// prints the sweep table scan_packet_rssi would print on the device.
+//
+// With -p the accepted frames are also sent as pcap telemetry, interleaved with
+// the sweep frames, like a device running 'capture start'.
+//
+// With -P the synthetic receiver hears every channel and the dwell scheduler
+// decides which of them the simulated radio is tuned to, as on the device.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "scan_core.h"
+#include "scan_telemetry.h"
+#include "scan_sched.h"
+#include "scan_window.h"
+#include "scan_pcap.h"
+#include "scan_anom.h"
+#include "scan_devices.h"
+#include "host_source.h"
+
+static scan_ring_t ring;
+static scan_sweep_t sweep;
+static scan_sta_table_t stations;
+static scan_seq_cache_t seq_cache;
+static scan_bcn_table_t beacons;
+static scan_dev_set_t devices;
+static scan_talkers_t talkers;
+static const scan_agg_t agg = {.sweep = &sweep, .stations = &stations, .seq_cache = &seq_cache, .beacons = &beacons,
+                               .devices = &devices, .talkers = &talkers};
+static scan_filter_config_t filter_cfg;
+static scan_filter_t filter;
+static bool print_filter;
+static int top_stations;
+static int top_beacons;
+static int top_talkers;
+static scan_sched_t sched;
+static scan_window_t win_1m;
+static scan_window_t win_15m;
+static bool print_dist;
+static bool print_classes;
+static bool print_devices;
+static scan_dev_window_t *dev_windows[3];
+static host_frame_t frame;
+static bool binary_output;
+static uint16_t tlm_seq;
+static bool pcap_output;
+static scan_pcap_ring_t pcap_ring;
+static uint8_t pcap_storage[1 << 20];
+static uint16_t pcap_seq;
+static bool detect_events;
+static bool quiet_output;
+static scan_anom_t anom;
+static uint32_t last_out_ms;
+
+// Send the captured frames, the device's writer task does this on a timer
+static void flush_pcap(void) {
+    uint8_t buf[SCAN_TLM_MAX_FRAME];
+    size_t len;
+
+    while ((len = scan_pcap_encode(&pcap_ring, buf, sizeof(buf), pcap_seq)) > 0) {
+        fwrite(buf, 1, len, stdout);
+        pcap_seq++;
+    }
+}
+
+// Split like the device's promiscuous callback, so capture sees the frames the filter accepted
+static void capture(void) {
+    if (!scan_capture_accept(&filter, &frame.pkt, frame.type)) return;
+
+    scan_capture_push(&ring, &frame.pkt, frame.type);
+    if (pcap_output) {
+        scan_pcap_capture(&pcap_ring, &frame.pkt, frame.len);
+        if (scan_pcap_fill(&pcap_ring) >= sizeof(pcap_storage) / 2) {
+            flush_pcap();
+        }
+    }
+}
+
+// Anomaly events of the sweep, or a heartbeat in quiet output if nothing has
+// gone out for a while. Sweeps count as output outside quiet mode.
+static void emit_events(const scan_sweep_t *s, uint32_t time_ms) {
+    scan_anom_event_t events[SCAN_ANOM_MAX_EVENTS];
+    size_t n = scan_anom_update(&anom, s, events, SCAN_ANOM_MAX_EVENTS);
+
+    if (!quiet_output) {
+        last_out_ms = time_ms;
+        if (n == 0) return;
+    } else if (n == 0 && time_ms - last_out_ms < CONFIG_SCAN_HEARTBEAT_S * 1000u) {
+        return;
+    }
+    last_out_ms = time_ms;
+
+    if (binary_output) {
+        uint8_t buf[SCAN_TLM_MAX_FRAME];
+        size_t len = scan_anom_encode(buf, sizeof(buf), tlm_seq++, time_ms, s->iteration, anom.dropped, events, n);
+        anom.dropped = 0;
+        fwrite(buf, 1, len, stdout);
+    } else {
+        scan_anom_events_print(s->iteration, events, n);
+    }
+}
+
+// Distinct transmitters of the sweep and the 1 min, 15 min and 1 h windows
+static void print_device_counts(void) {
+    static scan_dev_set_t window_set;
+    scan_dev_counts_t counts[4];
+
+    scan_dev_count(&devices, 0, &counts[0]);
+    for (int w = 0; w < 3; w++) {
+        scan_dev_window_union(dev_windows[w], &window_set);
+        scan_dev_count(&window_set, dev_windows[w]->length_ms, &counts[w + 1]);
+    }
+    scan_dev_report_print(counts, 4);
+}
+
+// Device sketches of a set, split over as many frames as they need
+static void write_device_frames(uint32_t time_ms, uint32_t iteration, uint32_t window_s, const scan_dev_set_t *set) {
+    uint8_t buf[SCAN_TLM_MAX_FRAME];
+    int next = 0;
+
+    do {
+        size_t len = scan_dev_encode(buf, sizeof(buf), tlm_seq++, time_ms, iteration, window_s, set, &next);
+        if (len == 0) break;
+        fwrite(buf, 1, len, stdout);
+    } while (next < SCAN_DEV_SKETCHES);
+}
+
+// Same output choice as the device: the sweep table, or telemetry frames.
+// The long-window distributions are updated with the sweep first.
+static void emit_sweep(const scan_sweep_t *s, uint64_t time_us) {
+    uint32_t time_ms = (uint32_t)(time_us / 1000);
+    scan_window_snap_t windows[2];
+
+    scan_window_add(&win_1m, s, time_ms);
+    scan_window_add(&win_15m, s, time_ms);
+    scan_window_snapshot(&win_1m, &windows[0]);
+    scan_window_snapshot(&win_15m, &windows[1]);
+    for (int w = 0; w < 3; w++) {
+        scan_dev_window_add(dev_windows[w], &devices, time_ms);
+    }
+
+    if (quiet_output) {
+        // Sweeps stay on the device, only what emit_events decides goes out
+    } else if (binary_output) {
+        uint8_t buf[SCAN_TLM_MAX_FRAME];
+        int next = 0;
+
+        flush_pcap();
+        do {
+            size_t len = scan_tlm_encode_sweep(buf, sizeof(buf), tlm_seq++, time_ms, s, windows,
+                                               sizeof(windows) / sizeof(windows[0]), &next);
+            if (len == 0) break;
+            fwrite(buf, 1, len, stdout);
+        } while (next != 0);
+        write_device_frames(time_ms, s->iteration, 0, &devices);
+        // Like 'devices -e' on the device, with every sweep
+        if (print_devices) {
+            static scan_dev_set_t window_set;
+            for (int w = 0; w < 3; w++) {
+                scan_dev_window_union(dev_windows[w], &window_set);
+                write_device_frames(time_ms, s->iteration, dev_windows[w]->length_ms / 1000, &window_set);
+            }
+        }
+    } else {
+        scan_report_print(s);
+        if (print_classes) {
+            scan_class_report_print(s);
+        }
+        if (print_dist) {
+            scan_dist_report_print(s, windows, sizeof(windows) / sizeof(windows[0]));
+            scan_snr_report_print(s);
+        }
+        if (print_devices) {
+            print_device_counts();
+        }
+    }
+    if (detect_events) {
+        emit_events(s, time_ms);
+    }
+}
+
+// Table entries are stamped with capture time, like uptime on the device
+static void drain(void) {
+    scan_agg_drain(&agg, &ring, (uint32_t)(frame.time_us / 1000));
+}
+
+// Complete and emit the sweep ending at time_us
+static void finish_sweep(uint32_t iteration, uint32_t *last_dropped, uint64_t time_us) {
+    drain();
+    uint32_t dropped = scan_ring_dropped(&ring);
+    sweep.dropped = dropped - *last_dropped;
+    *last_dropped = dropped;
+    sweep.iteration = iteration;
+    emit_sweep(&sweep, time_us);
+}
+
+static void print_filter_stats(void) {
+    if (print_filter && !binary_output) {
+        scan_filter_report_print(&filter_cfg, &filter);
+    }
+}
+
+static void print_stations(void) {
+    static scan_sta_t top[SCAN_STA_MAX_ENTRIES];
+
+    if (top_stations <= 0 || binary_output) return;
+    size_t n = scan_sta_top(&stations, SCAN_STA_BY_FRAMES, top,
+                            (size_t)top_stations < SCAN_STA_MAX_ENTRIES ? (size_t)top_stations : SCAN_STA_MAX_ENTRIES);
+    scan_sta_report_print(&stations, top, n, (uint32_t)(frame.time_us / 1000));
+}
+
+static void print_talkers(void) {
+    static scan_top_entry_t top[CONFIG_SCAN_TOP_COUNTERS];
+    size_t max = (size_t)top_talkers < CONFIG_SCAN_TOP_COUNTERS ? (size_t)top_talkers : CONFIG_SCAN_TOP_COUNTERS;
+
+    if (top_talkers <= 0 || binary_output) return;
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        char title[48];
+        if (talkers.frames[i].total == 0) continue;
+
+        snprintf(title, sizeof(title), "Top talkers on channel %d by frames", i + 1);
+        scan_top_report_print(title, &talkers.frames[i], top, scan_top_list(&talkers.frames[i], top, max), "frames");
+        snprintf(title, sizeof(title), "Top talkers on channel %d by airtime", i + 1);
+        scan_top_report_print(title, &talkers.airtime[i], top, scan_top_list(&talkers.airtime[i], top, max), "us");
+    }
+}
+
+static void print_beacons(void) {
+    if (top_beacons <= 0 || binary_output) return;
+    scan_bcn_report_print(&beacons, (size_t)top_beacons, (uint32_t)(frame.time_us / 1000));
+}
+
+static bool parse_policy(const char *name, scan_sched_policy_t *policy) {
+    for (int p = SCAN_SCHED_FIXED; p <= SCAN_SCHED_PRIORITY; p++) {
+        if (strcmp(name, scan_sched_policy_name(p)) == 0) {
+            *policy = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Scheduled survey of a synthetic airspace. Frames on channels the radio is
+// not tuned to at their receive time are never seen, like on the device.
+static int run_scheduled(host_source_t *src, const scan_sched_config_t *cfg) {
+    scan_sched_plan_t plan;
+    uint32_t last_dropped = 0;
+    uint32_t iteration = 1;
+    uint64_t slot_start = 0;
+    uint64_t slot_end = 0;
+    uint32_t hops = 0;
+    int slot = 0;
+    int ret;
+
+    scan_sched_init(&sched, cfg);
+    scan_sched_plan(&sched, 0, &plan);
+    scan_sched_apply_dwell(&plan, &sweep);
+    if (plan.count == 0) return -1;
+    scan_sched_visit(&sched, plan.slots[0].channel, 0, plan.slots[0].dwell_ms);
+    slot_end = plan.slots[0].dwell_ms * 1000ull;
+
+    while ((ret = host_source_next(src, &frame)) > 0) {
+        while (frame.time_us >= slot_end) {
+            // Beacons heard before the hop must not be paired with the next visit's
+            drain();
+            scan_bcn_set_hop(&beacons, ++hops);
+            slot_start = slot_end;
+            if (++slot == plan.count) {
+                finish_sweep(iteration++, &last_dropped, slot_start);
+                scan_sched_update(&sched, &sweep);
+                scan_sweep_reset(&sweep);
+                scan_dev_reset(&devices);
+                scan_sched_plan(&sched, (uint32_t)(slot_start / 1000), &plan);
+                scan_sched_apply_dwell(&plan, &sweep);
+                if (plan.count == 0) return -1;
+                slot = 0;
+            }
+            scan_sched_visit(&sched, plan.slots[slot].channel, (uint32_t)(slot_start / 1000),
+                             plan.slots[slot].dwell_ms);
+            slot_end = slot_start + plan.slots[slot].dwell_ms * 1000ull;
+        }
+
+        if (frame.pkt.rx_ctrl.channel != plan.slots[slot].channel) continue;
+
+        capture();
+        if (atomic_load(&ring.head) - atomic_load(&ring.tail) >= CONFIG_SCAN_RING_SIZE / 2) {
+            drain();
+        }
+    }
+
+    if (!binary_output) {
+        scan_sched_report_print(&sched);
+    }
+    return ret;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-r capture.pcap] [-c channel] [-n frames] [-s seed] [-f fps] [-w sweep_ms] [-P policy] [-d] [-C] [-D] [-S count] [-K count]\n"
+            "          [-B count] [-E] [-Q] [-b] [-p snaplen] [-T classes] [-R dbm] [-A mac] [-X mac]\n"
+            "  -r  replay a radiotap or 802.11 pcap instead of the synthetic source\n"
+            "  -c  channel assumed for pcap frames without a channel field (default 1)\n"
+            "  -n  synthetic frames to generate (default 100000)\n"
+            "  -s  synthetic generator seed (default 1)\n"
+            "  -f  synthetic on-air frame rate (default 2000)\n"
+            "  -w  sweep length in capture time (default %d ms, one 150 ms dwell per channel)\n"
+            "  -P  schedule channel dwell on the synthetic source: fixed, proportional or priority\n"
+            "  -d  print per-channel RSSI percentiles for the sweep, the last 1 and 15 minutes\n"
+            "  -C  print per-channel frame counts by type under each sweep\n"
+            "  -D  print distinct transmitters per channel for the sweep, the last 1 and 15 minutes and hour;\n"
+            "      with -b, send the window sketches after every sweep\n"
+            "  -S  print the most active stations at the end\n"
+            "  -K  print this many top talkers per channel by frames and by airtime at the end\n"
+            "  -B  print beacon timing of this many access points at the end, highest loss first\n"
+            "  -E  detect anomalies in each sweep and report them under it\n"
+            "  -Q  quiet: only anomaly events and a heartbeat every %d s, implies -E\n"
+            "  -b  write binary telemetry frames instead of the table (pipe into scanee_decode)\n"
+            "  -p  also write accepted frames cut to snaplen as pcap telemetry, implies -b (pipe into scanee_pcap)\n"
+            "  -T  capture only these frame classes, comma separated (see scan_frame.h)\n"
+            "  -R  capture only frames at or above this RSSI\n"
+            "  -A  capture only frames from this transmitter, repeatable\n"
+            "  -X  ignore frames from this transmitter, repeatable\n",
+            prog, CONFIG_MAX_WIFI_CHANNELS * 150, CONFIG_SCAN_HEARTBEAT_S);
+}
+
+int main(int argc, char **argv) {
+    const char *pcap_path = NULL;
+    int default_channel = 1;
+    uint32_t sweep_ms = CONFIG_MAX_WIFI_CHANNELS * 150;
+    synth_config_t synth = SYNTH_CONFIG_DEFAULT();
+    scan_sched_config_t sched_cfg;
+    bool scheduled = false;
+    int opt;
+
+    scan_sched_config_default(&sched_cfg);
+    scan_filter_config_default(&filter_cfg);
+
+    synth.count = 100000;
+    synth.channels = CONFIG_MAX_WIFI_CHANNELS;
+
+    while ((opt = getopt(argc, argv, "r:c:n:s:f:w:P:dCDS:K:B:EQbp:T:R:A:X:h")) != -1) {
+        switch (opt) {
+        case 'r': pcap_path = optarg; break;
+        case 'c': default_channel = atoi(optarg); break;
+        case 'n': synth.count = strtoull(optarg, NULL, 0); break;
+        case 's': synth.seed = strtoull(optarg, NULL, 0); break;
+        case 'f': synth.fps = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'w': sweep_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'P':
+            if (!parse_policy(optarg, &sched_cfg.policy)) {
+                usage(argv[0]);
+                return 2;
+            }
+            scheduled = true;
+            break;
+        case 'd': print_dist = true; break;
+        case 'C': print_classes = true; break;
+        case 'D': print_devices = true; break;
+        case 'S': top_stations = atoi(optarg); break;
+        case 'K': top_talkers = atoi(optarg); break;
+        case 'B': top_beacons = atoi(optarg); break;
+        case 'E': detect_events = true; break;
+        case 'Q':
+            detect_events = true;
+            quiet_output = true;
+            break;
+        case 'b': binary_output = true; break;
+        case 'p': {
+            int snaplen = atoi(optarg);
+            if (snaplen < 1 || snaplen > SCAN_PCAP_MAX_SNAPLEN) {
+                usage(argv[0]);
+                return 2;
+            }
+            scan_pcap_init(&pcap_ring, pcap_storage, sizeof(pcap_storage), (uint16_t)snaplen);
+            pcap_output = true;
+            binary_output = true;
+            break;
+        }
+        case 'T':
+            if (!scan_filter_parse_classes(optarg, &filter_cfg.classes)) {
+                usage(argv[0]);
+                return 2;
+            }
+            print_filter = true;
+            break;
+        case 'R':
+            filter_cfg.min_rssi = (int8_t)atoi(optarg);
+            print_filter = true;
+            break;
+        case 'A':
+        case 'X': {
+            uint8_t mac[6];
+            bool ok = scan_filter_parse_mac(optarg, mac) &&
+                      (opt == 'A' ? scan_filter_add_mac(filter_cfg.allow, &filter_cfg.nallow, mac)
+                                  : scan_filter_add_mac(filter_cfg.deny, &filter_cfg.ndeny, mac));
+            if (!ok) {
+                usage(argv[0]);
+                return 2;
+            }
+            print_filter = true;
+            break;
+        }
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (sweep_ms == 0 || (scheduled && pcap_path)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (scheduled) {
+        synth.dwell_ms = 0;
+        sched_cfg.budget_ms = sweep_ms;
+    }
+
+    host_source_t *src = pcap_path ? pcap_source_open(pcap_path, default_channel) : synth_source_open(&synth);
+    if (!src) {
+        return 1;
+    }
+
+    scan_filter_compile(&filter_cfg, &filter);
+    scan_ring_init(&ring);
+    scan_sweep_reset(&sweep);
+    scan_sta_init(&stations);
+    scan_bcn_init(&beacons);
+    scan_seq_cache_init(&seq_cache);
+    scan_window_init(&win_1m, 60 * 1000, 6);
+    scan_window_init(&win_15m, 15 * 60 * 1000, 5);
+    scan_dev_reset(&devices);
+    scan_talkers_reset(&talkers);
+    static const uint32_t dev_window_ms[3] = {60 * 1000, 15 * 60 * 1000, 60 * 60 * 1000};
+    static const int dev_window_slots[3] = {6, 5, 4};
+    for (int w = 0; w < 3; w++) {
+        dev_windows[w] = malloc(SCAN_DEV_WINDOW_SIZE(dev_window_slots[w]));
+        if (!dev_windows[w]) return 1;
+        scan_dev_window_init(dev_windows[w], dev_window_ms[w], dev_window_slots[w]);
+    }
+    scan_anom_config_t anom_cfg;
+    scan_anom_config_default(&anom_cfg);
+    scan_anom_init(&anom, &anom_cfg);
+    if (!binary_output && !quiet_output) {
+        scan_report_print_header();
+    }
+
+    if (scheduled) {
+        int ret = run_scheduled(src, &sched_cfg);
+        flush_pcap();
+        print_stations();
+        print_talkers();
+        print_beacons();
+        print_filter_stats();
+        host_source_close(src);
+        return ret < 0 ? 1 : 0;
+    }
+
+    // Unscheduled replay: the capture's own hopping is taken as it is, every
+    // channel counts as listened to for an equal share of the sweep
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        sweep.dwell_ms[i] = (uint16_t)(sweep_ms / CONFIG_MAX_WIFI_CHANNELS);
+    }
+
+    uint64_t sweep_us = (uint64_t)sweep_ms * 1000;
+    uint64_t sweep_end = sweep_us;
+    uint32_t last_dropped = 0;
+    uint32_t iteration = 1;
+    bool pending = false;
+    int ret;
+
+    while ((ret = host_source_next(src, &frame)) > 0) {
+        while (frame.time_us >= sweep_end) {
+            finish_sweep(iteration++, &last_dropped, sweep_end);
+            scan_sweep_reset(&sweep);
+            scan_dev_reset(&devices);
+            sweep_end += sweep_us;
+            pending = false;
+        }
+
+        capture();
+        pending = true;
+
+        // Drain well before the ring fills; the device drains on a timer instead
+        if (atomic_load(&ring.head) - atomic_load(&ring.tail) >= CONFIG_SCAN_RING_SIZE / 2) {
+            drain();
+        }
+    }
+
+    if (pending) {
+        drain();
+        sweep.dropped = scan_ring_dropped(&ring) - last_dropped;
+        sweep.iteration = iteration;
+        emit_sweep(&sweep, frame.time_us);
+    }
+
+    flush_pcap();
+    print_stations();
+    print_talkers();
+    print_beacons();
+    print_filter_stats();
+    host_source_close(src);
+    return ret < 0 ? 1 : 0;
+}
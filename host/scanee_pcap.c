@@ -0,0 +1,158 @@
+// Writes the frames a scanner streams with the 'capture' command to a pcap
+// file. Input is the scanner's console (serial port, pty, file or stdin), of
+// which only SCAN_TLM_PCAP telemetry frames are kept; log lines and other
+// telemetry are skipped. The output can be a file or '-' for a live pipe:
+//
+//   scanee_pcap -o - /dev/ttyACM0 | wireshark -k -i -
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "scan_decode.h"
+#include "scan_pcap.h"
+#include "host_serial.h"
+
+static scan_tlm_parser_t parser;
+static volatile sig_atomic_t stop;
+
+typedef struct {
+    scan_decode_seq_t seq;
+    uint32_t records;
+    uint32_t malformed;
+    bool have_dropped;
+    uint32_t dropped;           // Device ring drops, as last reported
+    uint32_t dropped_before;    // Drops of captures the device has since restarted
+} capture_stats_t;
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-o output.pcap] [-q] [input]\n"
+            "  input is a serial device, file or '-' for stdin (default)\n"
+            "  -o  pcap file to write, '-' for stdout (default capture.pcap)\n"
+            "  -q  do not report drops as they happen\n",
+            prog);
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static uint32_t le32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Append the records of one frame, false if the payload is malformed
+static bool write_records(FILE *out, const scan_tlm_frame_t *frame, capture_stats_t *st, bool quiet) {
+    scan_tlm_reader_t r;
+
+    scan_tlm_reader_init(&r, frame->payload, frame->len);
+    uint32_t dropped = scan_tlm_get_varint(&r);
+    if (r.error) return false;
+
+    // The counter restarts with every capture on the device
+    bool restarted = st->have_dropped && dropped < st->dropped;
+    uint32_t prev = st->have_dropped && !restarted ? st->dropped : 0;
+    if (restarted) {
+        st->dropped_before += st->dropped;
+    }
+    if (!quiet && dropped > prev) {
+        fprintf(stderr, "device dropped %u frames\n", dropped - prev);
+    }
+    st->dropped = dropped;
+    st->have_dropped = true;
+
+    while (!scan_tlm_reader_done(&r)) {
+        size_t left = (size_t)(r.end - r.p);
+        if (left < SCAN_PCAP_RECORD_HEADER_LEN) return false;
+
+        size_t len = SCAN_PCAP_RECORD_HEADER_LEN + le32(r.p + 8);
+        if (len > left) return false;
+
+        fwrite(r.p, 1, len, out);
+        r.p += len;
+        st->records++;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = "capture.pcap";
+    capture_stats_t st = {0};
+    bool quiet = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:qh")) != -1) {
+        switch (opt) {
+        case 'o': out_path = optarg; break;
+        case 'q': quiet = true; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    const char *path = optind < argc ? argv[optind] : "-";
+    int fd = host_serial_open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+
+    FILE *out = strcmp(out_path, "-") == 0 ? stdout : fopen(out_path, "wb");
+    if (out == NULL) {
+        perror(out_path);
+        close(fd);
+        return 1;
+    }
+
+    uint8_t hdr[SCAN_PCAP_FILE_HEADER_LEN];
+    scan_pcap_file_header(hdr, SCAN_PCAP_MAX_SNAPLEN + SCAN_PCAP_RADIOTAP_MAX);
+    fwrite(hdr, 1, sizeof(hdr), out);
+    fflush(out);
+
+    // No SA_RESTART, so Ctrl-C interrupts the read and the summary is printed
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    scan_tlm_parser_init(&parser);
+
+    uint8_t buf[4096];
+    ssize_t n;
+    while (!stop && (n = read(fd, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("read");
+            break;
+        }
+
+        size_t off = 0;
+        while (off < (size_t)n) {
+            scan_tlm_frame_t frame;
+            bool have_frame;
+            off += scan_tlm_parser_feed(&parser, buf + off, (size_t)n - off, &frame, &have_frame);
+            if (!have_frame || frame.type != SCAN_TLM_PCAP) continue;
+
+            scan_decode_seq_update(&st.seq, frame.seq);
+            if (!write_records(out, &frame, &st, quiet)) {
+                st.malformed++;
+            }
+        }
+        fflush(out);
+    }
+    close(fd);
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    fprintf(stderr, "records %u, frames %u, lost frames %u, device drops %u, crc errors %u, malformed %u\n",
+            st.records, st.seq.frames, st.seq.lost, st.dropped_before + st.dropped, parser.crc_errors,
+            st.malformed);
+    return 0;
+}
@@ -0,0 +1,213 @@
+// Stands in for scanner boards: replays recorded console streams, one pseudo
+// terminal per recording, at the pace the device produced them. Frames are
+// written when their time_ms comes up relative to the first one; the text and
+// untimed frames in between go out with the next timed frame. Record a stream
+// with e.g. 'scanee_host -b > a.bin' or 'cat /dev/ttyACM0 > a.bin'.
+//
+//   scanee_replay a.bin b.bin        # prints the pty of each recording
+//   scanee_agg a=/dev/pts/5 b=/dev/pts/6
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <termios.h>
+#include "scan_telemetry.h"
+#include "scan_flog.h"
+
+#define MAX_STREAMS 16
+
+typedef struct {
+    const char *path;
+    uint8_t *data;
+    size_t size;
+    size_t off;                 // Bytes already written
+    size_t next_end;            // End of the chunk that goes out at next_ms
+    int64_t next_ms;            // On the replay clock, INT64_MAX once done
+    uint32_t first_ms;          // Device time of the first timed frame
+    bool have_first;
+    int64_t base_ms;            // Replay time of the current pass
+    scan_tlm_parser_t parser;
+    int master;
+    int slave;                  // Kept open so nothing is lost before a reader opens the pty
+} stream_t;
+
+static stream_t streams[MAX_STREAMS];
+static int nstreams;
+static double speed = 1.0;
+static bool loop;
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-x speed] [-d delay_s] [-l] recording ...\n"
+            "  -x  replay this many times faster than recorded (default 1)\n"
+            "  -d  wait this long after printing the ptys (default 1 s)\n"
+            "  -l  start over at the end, like a device that rebooted\n",
+            prog);
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool load(stream_t *s) {
+    FILE *fp = fopen(s->path, "rb");
+    if (fp == NULL) return false;
+
+    size_t cap = 0;
+    for (;;) {
+        if (s->size == cap) {
+            cap = cap ? cap * 2 : 1 << 16;
+            uint8_t *grown = realloc(s->data, cap);
+            if (grown == NULL) {
+                fclose(fp);
+                return false;
+            }
+            s->data = grown;
+        }
+        size_t n = fread(s->data + s->size, 1, cap - s->size, fp);
+        if (n == 0) break;
+        s->size += n;
+    }
+    fclose(fp);
+    return true;
+}
+
+// The device side of a serial link is raw: no echo, no CR/LF translation
+static bool open_pty(stream_t *s) {
+    s->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (s->master < 0 || grantpt(s->master) < 0 || unlockpt(s->master) < 0) return false;
+
+    s->slave = open(ptsname(s->master), O_RDWR | O_NOCTTY);
+    if (s->slave < 0) return false;
+
+    struct termios tio;
+    if (tcgetattr(s->slave, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(s->slave, TCSANOW, &tio);
+    }
+    return true;
+}
+
+// Find the end of the next timed frame and when it is due
+static void schedule(stream_t *s) {
+    size_t off = s->next_end;
+
+    while (off < s->size) {
+        scan_tlm_frame_t frame;
+        bool have_frame;
+        uint32_t t;
+
+        off += scan_tlm_parser_feed(&s->parser, s->data + off, s->size - off, &frame, &have_frame);
+        if (!have_frame || !scan_flog_frame_time(&frame, &t)) continue;
+
+        if (!s->have_first) {
+            s->first_ms = t;
+            s->have_first = true;
+        }
+        s->next_end = off;
+        s->next_ms = s->base_ms + (int64_t)((int32_t)(t - s->first_ms) / speed);
+        return;
+    }
+
+    // Trailing bytes go out at once
+    s->next_end = s->size;
+    s->next_ms = s->off < s->size ? now_ms() : INT64_MAX;
+}
+
+static void restart(stream_t *s, int64_t base_ms) {
+    s->off = 0;
+    s->next_end = 0;
+    s->have_first = false;
+    s->base_ms = base_ms;
+    scan_tlm_parser_init(&s->parser);
+    schedule(s);
+}
+
+static bool write_all(int fd, const uint8_t *p, size_t len) {
+    while (len) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    double delay_s = 1.0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:d:lh")) != -1) {
+        switch (opt) {
+        case 'x': speed = atof(optarg); break;
+        case 'd': delay_s = atof(optarg); break;
+        case 'l': loop = true; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (speed <= 0 || delay_s < 0 || optind == argc || argc - optind > MAX_STREAMS) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        stream_t *s = &streams[nstreams++];
+        s->path = argv[i];
+        if (!load(s) || !open_pty(s)) {
+            perror(s->path);
+            return 1;
+        }
+        printf("%s %s\n", s->path, ptsname(s->master));
+    }
+    fflush(stdout);
+
+    // A reader that goes away must not end the replay
+    signal(SIGPIPE, SIG_IGN);
+    usleep((useconds_t)(delay_s * 1e6));
+
+    int64_t start = now_ms();
+    for (int i = 0; i < nstreams; i++) {
+        restart(&streams[i], start);
+    }
+
+    for (;;) {
+        stream_t *next = NULL;
+        for (int i = 0; i < nstreams; i++) {
+            if (streams[i].next_ms != INT64_MAX && (next == NULL || streams[i].next_ms < next->next_ms)) {
+                next = &streams[i];
+            }
+        }
+        if (next == NULL) break;
+
+        int64_t wait = next->next_ms - now_ms();
+        if (wait > 0) {
+            usleep((useconds_t)(wait * 1000));
+        }
+        if (!write_all(next->master, next->data + next->off, next->next_end - next->off)) {
+            perror(next->path);
+            return 1;
+        }
+        next->off = next->next_end;
+        schedule(next);
+
+        if (next->next_ms == INT64_MAX && loop) {
+            restart(next, now_ms());
+        }
+    }
+
+    // Let readers drain the ptys before they go away
+    sleep(1);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+// Host stand-in for the parts of ESP-IDF's esp_wifi_types.h used by the
+// scanner core. Layouts follow ESP-IDF v5.2 for CONFIG_IDF_TARGET_ESP32S3 so
+// records built on the host look exactly like the ones the driver delivers.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef BIT
+#define BIT(nr) (1UL << (nr))
+#endif
+
+typedef enum {
+    WIFI_PKT_MGMT,
+    WIFI_PKT_CTRL,
+    WIFI_PKT_DATA,
+    WIFI_PKT_MISC,
+} wifi_promiscuous_pkt_type_t;
+
+typedef struct {
+    signed rssi: 8;
+    unsigned rate: 5;
+    unsigned : 1;
+    unsigned sig_mode: 2;
+    unsigned : 16;
+    unsigned mcs: 7;
+    unsigned cwb: 1;
+    unsigned : 16;
+    unsigned smoothing: 1;
+    unsigned not_sounding: 1;
+    unsigned : 1;
+    unsigned aggregation: 1;
+    unsigned stbc: 2;
+    unsigned fec_coding: 1;
+    unsigned sgi: 1;
+    unsigned : 8;
+    unsigned ampdu_cnt: 8;
+    unsigned channel: 4;
+    unsigned secondary_channel: 4;
+    unsigned : 8;
+    unsigned timestamp: 32;
+    unsigned : 32;
+    signed noise_floor: 8;
+    unsigned : 24;
+    unsigned : 32;
+    unsigned : 31;
+    unsigned ant: 1;
+    unsigned sig_len: 12;
+    unsigned : 12;
+    unsigned rx_state: 8;
+} wifi_pkt_rx_ctrl_t;
+
+typedef struct {
+    wifi_pkt_rx_ctrl_t rx_ctrl;
+    uint8_t payload[0];
+} wifi_promiscuous_pkt_t;
+
+// Promiscuous filter masks, for code that computes them on both platforms
+typedef struct {
+    uint32_t filter_mask;
+} wifi_promiscuous_filter_t;
+
+#define WIFI_PROMIS_FILTER_MASK_ALL         (0xFFFFFFFF)
+#define WIFI_PROMIS_FILTER_MASK_MGMT        (1)
+#define WIFI_PROMIS_FILTER_MASK_CTRL        (1<<1)
+#define WIFI_PROMIS_FILTER_MASK_DATA        (1<<2)
+#define WIFI_PROMIS_FILTER_MASK_MISC        (1<<3)
+#define WIFI_PROMIS_FILTER_MASK_DATA_MPDU   (1<<4)
+#define WIFI_PROMIS_FILTER_MASK_DATA_AMPDU  (1<<5)
+#define WIFI_PROMIS_FILTER_MASK_FCSFAIL     (1<<6)
+
+#define WIFI_PROMIS_CTRL_FILTER_MASK_ALL         (0xFF800000)
+#define WIFI_PROMIS_CTRL_FILTER_MASK_WRAPPER     (1<<23)
+#define WIFI_PROMIS_CTRL_FILTER_MASK_BAR         (1<<24)
+#define WIFI_PROMIS_CTRL_FILTER_MASK_BA          (1<<25)
+#define WIFI_PROMIS_CTRL_FILTER_MASK_PSPOLL      (1<<26)
+#define WIFI_PROMIS_CTRL_FILTER_MASK_RTS         (1<<27)
+#define WIFI_PROMIS_CTRL_FILTER_MASK_CTS         (1<<28)
+#define WIFI_PROMIS_CTRL_FILTER_MASK_ACK         (1<<29)
+#define WIFI_PROMIS_CTRL_FILTER_MASK_CFEND       (1<<30)
+#define WIFI_PROMIS_CTRL_FILTER_MASK_CFENDACK    (1<<31)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,303 @@
+#include <stdlib.h>
+#include <string.h>
+#include "host_source.h"
+
+// 802.11 frame control byte 0 values (subtype << 4 | type << 2)
+#define FC_ASSOC_REQ  0x00
+#define FC_PROBE_REQ  0x40
+#define FC_PROBE_RESP 0x50
+#define FC_BEACON     0x80
+#define FC_AUTH       0xB0
+#define FC_DEAUTH     0xC0
+#define FC_RTS        0xB4
+#define FC_CTS        0xC4
+#define FC_ACK        0xD4
+#define FC_DATA       0x08
+#define FC_NULL       0x48
+#define FC_QOS_DATA   0x88
+
+#define FC1_TO_DS     0x01
+#define FC1_FROM_DS   0x02
+#define FC1_RETRY     0x08
+
+typedef struct {
+    uint8_t mac[6];
+    int ap;             // Index of the access point this device belongs to
+    int channel;
+    int rssi;           // Mean RSSI at the receiver
+    uint16_t seq;
+    uint64_t tsf_offset;
+    uint64_t tbtt_us;       // Access points: next target beacon transmission time
+    uint64_t beacon_us;     // and when that beacon goes out, after contention
+    bool is_ap;
+} synth_device_t;
+
+typedef struct {
+    host_source_t base;
+    synth_config_t cfg;
+    uint64_t rng;
+    uint64_t now_us;
+    uint64_t emitted;
+    int ndev;
+    synth_device_t *dev;
+} synth_source_t;
+
+static const uint8_t broadcast[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+// Beacon interval of every synthetic access point, TU
+#define SYNTH_BEACON_TU 100
+
+// xorshift64*, good enough and reproducible for a given seed
+static uint32_t synth_rand(synth_source_t *s) {
+    s->rng ^= s->rng >> 12;
+    s->rng ^= s->rng << 25;
+    s->rng ^= s->rng >> 27;
+    return (uint32_t)((s->rng * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static int synth_range(synth_source_t *s, int lo, int hi) {
+    return lo + (int)(synth_rand(s) % (uint32_t)(hi - lo + 1));
+}
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void put_le64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (v >> (8 * i)) & 0xff;
+    }
+}
+
+// Next beacon of an access point: on the TBTT grid of its TSF, usually a few
+// hundred microseconds late, sometimes several milliseconds on a busy medium
+static void synth_schedule_beacon(synth_source_t *s, synth_device_t *ap) {
+    uint64_t interval_us = SYNTH_BEACON_TU * 1024;
+
+    ap->tbtt_us += interval_us - (ap->tsf_offset + ap->tbtt_us) % interval_us;
+    ap->beacon_us = ap->tbtt_us + (uint64_t)(synth_range(s, 0, 19) ? synth_range(s, 0, 400)
+                                                                  : synth_range(s, 2000, 12000));
+}
+
+// Three-address header: fc, duration, addr1..3, sequence control. Returns 24.
+static int put_hdr3(uint8_t *p, uint8_t fc0, uint8_t fc1, const uint8_t *a1, const uint8_t *a2,
+                    const uint8_t *a3, uint16_t seq) {
+    p[0] = fc0;
+    p[1] = fc1;
+    put_le16(p + 2, 0);
+    memcpy(p + 4, a1, 6);
+    memcpy(p + 10, a2, 6);
+    memcpy(p + 16, a3, 6);
+    put_le16(p + 22, (uint16_t)(seq << 4));
+    return 24;
+}
+
+static int synth_next(host_source_t *src, host_frame_t *frame) {
+    synth_source_t *s = (synth_source_t *)src;
+    const synth_config_t *cfg = &s->cfg;
+    uint32_t mean_gap_us = 1000000u / (cfg->fps ? cfg->fps : 1);
+    uint64_t dwell_us = (uint64_t)cfg->dwell_ms * 1000;
+
+    if (cfg->count && s->emitted >= cfg->count) {
+        return 0;
+    }
+
+    // Advance simulated time until a device on the receiver's channel
+    // transmits. Beacons are due on their own schedule, the rest is random;
+    // a few beacons are lost on the air whether the receiver listens or not.
+    synth_device_t *d;
+    bool beacon;
+    while (1) {
+        uint64_t next_us = s->now_us + 1 + synth_rand(s) % (2 * mean_gap_us);
+        synth_device_t *due = &s->dev[0];
+        for (int i = 1; i < cfg->aps; i++) {
+            if (s->dev[i].beacon_us < due->beacon_us) due = &s->dev[i];
+        }
+
+        beacon = due->beacon_us <= next_us;
+        if (beacon) {
+            s->now_us = due->beacon_us;
+            synth_schedule_beacon(s, due);
+            if (synth_range(s, 0, 99) < 2) continue;
+            d = due;
+        } else {
+            s->now_us = next_us;
+            d = &s->dev[synth_rand(s) % (uint32_t)s->ndev];
+        }
+        if (!dwell_us) break;
+        int rx_channel = (int)((s->now_us / dwell_us) % (uint64_t)cfg->channels) + 1;
+        if (d->channel == rx_channel) break;
+    }
+
+    synth_device_t *ap = &s->dev[d->ap];
+    uint8_t *p = frame->pkt.payload;
+    int hdr = 0;
+    int sig_len;
+    int sig_mode = 0;
+    int rate = 0x0B;   // 6 Mbps OFDM
+    int mcs = 0;
+    int pick = synth_range(s, 0, 99);
+
+    memset(&frame->pkt.rx_ctrl, 0, sizeof(frame->pkt.rx_ctrl));
+    frame->type = WIFI_PKT_MGMT;
+    d->seq = (d->seq + 1) & 0x0fff;
+
+    if (d->is_ap) {
+        if (beacon) {
+            hdr = put_hdr3(p, FC_BEACON, 0, broadcast, d->mac, d->mac, d->seq);
+            put_le64(p + hdr, d->tsf_offset + s->now_us);
+            put_le16(p + hdr + 8, SYNTH_BEACON_TU);
+            put_le16(p + hdr + 10, 0x0431);  // Capabilities
+            p[hdr + 12] = 0;                 // SSID element
+            p[hdr + 13] = 6;
+            memcpy(p + hdr + 14, "synth", 5);
+            p[hdr + 19] = '0' + (d->ap % 10);
+            hdr += 20;
+            sig_len = synth_range(s, 150, 320);
+            rate = 0;                         // 1 Mbps long preamble
+        } else if (pick < 20) {
+            const synth_device_t *sta = &s->dev[synth_rand(s) % (uint32_t)s->ndev];
+            hdr = put_hdr3(p, FC_PROBE_RESP, 0, sta->mac, d->mac, d->mac, d->seq);
+            put_le64(p + hdr, d->tsf_offset + s->now_us);
+            put_le16(p + hdr + 8, 100);
+            hdr += 12;
+            sig_len = synth_range(s, 150, 320);
+        } else {
+            const synth_device_t *sta = &s->dev[synth_rand(s) % (uint32_t)s->ndev];
+            frame->type = WIFI_PKT_DATA;
+            hdr = put_hdr3(p, FC_QOS_DATA, FC1_FROM_DS, sta->mac, d->mac, d->mac, d->seq);
+            sig_len = synth_range(s, 80, 1540);
+            sig_mode = 1;
+            mcs = synth_range(s, 0, 7);
+        }
+    } else {
+        if (pick < 10) {
+            uint8_t mac[6];
+            memcpy(mac, d->mac, 6);
+            if (synth_range(s, 0, 1)) {
+                // Randomised, locally administered probe source address
+                for (int i = 0; i < 6; i++) {
+                    mac[i] = (uint8_t)synth_rand(s);
+                }
+                mac[0] = (mac[0] & 0xfc) | 0x02;
+            }
+            hdr = put_hdr3(p, FC_PROBE_REQ, 0, broadcast, mac, broadcast, d->seq);
+            sig_len = synth_range(s, 60, 200);
+            rate = 0;
+        } else if (pick < 13) {
+            hdr = put_hdr3(p, synth_range(s, 0, 1) ? FC_AUTH : FC_ASSOC_REQ, 0, ap->mac, d->mac, ap->mac, d->seq);
+            sig_len = synth_range(s, 40, 200);
+        } else if (pick < 14) {
+            hdr = put_hdr3(p, FC_DEAUTH, 0, ap->mac, d->mac, ap->mac, d->seq);
+            sig_len = 30;
+        } else if (pick < 22) {
+            frame->type = WIFI_PKT_CTRL;
+            p[0] = FC_RTS;
+            p[1] = 0;
+            put_le16(p + 2, 200);
+            memcpy(p + 4, ap->mac, 6);
+            memcpy(p + 10, d->mac, 6);
+            hdr = 16;
+            sig_len = 20;
+        } else if (pick < 34) {
+            // CTS/ACK only carry the receiver address
+            frame->type = WIFI_PKT_CTRL;
+            p[0] = synth_range(s, 0, 2) ? FC_ACK : FC_CTS;
+            p[1] = 0;
+            put_le16(p + 2, 0);
+            memcpy(p + 4, d->mac, 6);
+            hdr = 10;
+            sig_len = 14;
+            rate = 0x0A;
+        } else if (pick < 38) {
+            frame->type = WIFI_PKT_DATA;
+            hdr = put_hdr3(p, FC_NULL, FC1_TO_DS, ap->mac, d->mac, ap->mac, d->seq);
+            sig_len = 28;
+        } else {
+            uint8_t fc1 = FC1_TO_DS;
+            if (synth_range(s, 0, 99) < 4) {
+                // Retransmission of the previous frame
+                fc1 |= FC1_RETRY;
+                d->seq = (d->seq - 1) & 0x0fff;
+            }
+            frame->type = WIFI_PKT_DATA;
+            hdr = put_hdr3(p, synth_range(s, 0, 3) ? FC_QOS_DATA : FC_DATA, fc1, ap->mac, d->mac, ap->mac, d->seq);
+            sig_len = synth_range(s, 60, 1540);
+            sig_mode = 1;
+            mcs = synth_range(s, 0, 7);
+        }
+    }
+
+    wifi_pkt_rx_ctrl_t *rx = &frame->pkt.rx_ctrl;
+    rx->rssi = d->rssi + synth_range(s, -4, 4);
+    rx->rate = rate;
+    rx->sig_mode = sig_mode;
+    rx->mcs = mcs;
+    rx->cwb = 0;
+    rx->channel = d->channel;
+    rx->timestamp = (uint32_t)s->now_us;
+    rx->noise_floor = synth_range(s, -97, -92);
+    rx->sig_len = sig_len;
+    rx->rx_state = synth_range(s, 0, 99) == 0 ? BIT(0) : 0;
+
+    frame->len = (uint16_t)hdr;
+    frame->time_us = s->now_us;
+    s->emitted++;
+    return 1;
+}
+
+static void synth_close(host_source_t *src) {
+    synth_source_t *s = (synth_source_t *)src;
+    free(s->dev);
+    free(s);
+}
+
+host_source_t *synth_source_open(const synth_config_t *cfg) {
+    if (cfg->channels < 1 || cfg->aps < 1 || cfg->stations < 0) {
+        return NULL;
+    }
+
+    synth_source_t *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+
+    s->base.next = synth_next;
+    s->base.close = synth_close;
+    s->cfg = *cfg;
+    s->rng = cfg->seed ? cfg->seed : 1;
+    s->ndev = cfg->aps + cfg->stations;
+    s->dev = calloc((size_t)s->ndev, sizeof(*s->dev));
+    if (!s->dev) {
+        free(s);
+        return NULL;
+    }
+
+    static const int common_channels[] = {1, 6, 11};
+    for (int i = 0; i < s->ndev; i++) {
+        synth_device_t *d = &s->dev[i];
+        d->is_ap = i < cfg->aps;
+        for (int b = 0; b < 6; b++) {
+            d->mac[b] = (uint8_t)synth_rand(s);
+        }
+        d->mac[0] &= 0xfc;  // Globally administered unicast
+        d->seq = (uint16_t)(synth_rand(s) & 0x0fff);
+        if (d->is_ap) {
+            d->ap = i;
+            if (synth_range(s, 0, 9) < 7) {
+                d->channel = common_channels[synth_rand(s) % 3];
+            } else {
+                d->channel = synth_range(s, 1, cfg->channels);
+            }
+            if (d->channel > cfg->channels) {
+                d->channel = cfg->channels;
+            }
+            d->tsf_offset = (uint64_t)synth_rand(s) << 16;
+            synth_schedule_beacon(s, d);
+        } else {
+            d->ap = (int)(synth_rand(s) % (uint32_t)cfg->aps);
+            d->channel = s->dev[d->ap].channel;
+        }
+        d->rssi = synth_range(s, -88, -35);
+    }
+    return &s->base;
+}
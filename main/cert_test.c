@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "esp_system.h"
 #include "esp_wifi.h"
@@ -7,85 +8,997 @@
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "nvs_flash.h"
-#include "hal/usb_serial_jtag_ll.h"
 #include <fcntl.h>
 #include "driver/uart.h"
+#include "esp_vfs_dev.h"
+#include "esp_vfs_usb_serial_jtag.h"
+#include "esp_timer.h"
+#include "esp_console.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "esp_pm.h"
 #include "esp_private/wifi.h" // For low-level RF access
+#include "scan_core.h"
+#include "scan_telemetry.h"
+#include "scan_sched.h"
+#include "scan_window.h"
+#include "scan_airtime.h"
+#include "scan_ap.h"
+#include "scan_flog.h"
+#include "scan_out.h"
+#include "scan_pcap.h"
+#include "scan_prof.h"
+#include "scan_survey.h"
+#include "scan_anom.h"
+#include "scan_devices.h"
+#include "cmd_scan.h"
+#include "cmd_phy.h"
+#include "cmd_script.h"
 
 // Configurable parameters
-#ifndef CONFIG_MAX_WIFI_CHANNELS
-#define CONFIG_MAX_WIFI_CHANNELS 13
-#endif
-
 #ifndef CONFIG_SCAN_DELAY_MS
 #define CONFIG_SCAN_DELAY_MS 10
 #endif
 
+#ifndef CONFIG_SCAN_AGG_TASK_PRIO
+#define CONFIG_SCAN_AGG_TASK_PRIO 5
+#endif
+
+#ifndef CONFIG_SCAN_AGG_TASK_CORE
+#define CONFIG_SCAN_AGG_TASK_CORE 1
+#endif
+
+// How often the aggregator drains the ring when no sweep request is pending
+#ifndef CONFIG_SCAN_AGG_PERIOD_MS
+#define CONFIG_SCAN_AGG_PERIOD_MS 10
+#endif
+
+// Flash log: data partition it lives in, longest time frames wait in RAM,
+// and the default time between logged sweeps
+#ifndef CONFIG_SCAN_LOG_PARTITION
+#define CONFIG_SCAN_LOG_PARTITION "scanlog"
+#endif
+
+#ifndef CONFIG_SCAN_LOG_FLUSH_MS
+#define CONFIG_SCAN_LOG_FLUSH_MS 10000
+#endif
+
+#ifndef CONFIG_SCAN_LOG_INTERVAL_S
+#define CONFIG_SCAN_LOG_INTERVAL_S 60
+#endif
+
+// Frame capture: ring size in bytes (a power of two, in PSRAM if present),
+// default snap length, and how often the writer sends what has been captured
+#ifndef CONFIG_SCAN_PCAP_RING_SIZE
+#if CONFIG_SPIRAM
+#define CONFIG_SCAN_PCAP_RING_SIZE (1024 * 1024)
+#else
+#define CONFIG_SCAN_PCAP_RING_SIZE (64 * 1024)
+#endif
+#endif
+
+#ifndef CONFIG_SCAN_PCAP_SNAPLEN
+#define CONFIG_SCAN_PCAP_SNAPLEN 256
+#endif
+
+#ifndef CONFIG_SCAN_PCAP_FLUSH_MS
+#define CONFIG_SCAN_PCAP_FLUSH_MS 20
+#endif
+
+#ifndef CONFIG_SCAN_PCAP_TASK_PRIO
+#define CONFIG_SCAN_PCAP_TASK_PRIO 3
+#endif
+
+// Sweep output writer: below everything else on the aggregator's core, so
+// console output only ever uses time the capture path leaves over
+#ifndef CONFIG_SCAN_OUT_TASK_PRIO
+#define CONFIG_SCAN_OUT_TASK_PRIO 2
+#endif
+
+// Tasks the stats task table has room for; with more, task load is not reported
+#ifndef CONFIG_SCAN_PROF_MAX_TASKS
+#define CONFIG_SCAN_PROF_MAX_TASKS 32
+#endif
+
+// Lowest CPU clock in survey mode while nothing holds the full-clock lock
+#ifndef CONFIG_SCAN_SURVEY_MIN_FREQ_MHZ
+#define CONFIG_SCAN_SURVEY_MIN_FREQ_MHZ 40
+#endif
+
 #define TAG "WIFI_SCAN"
 
+// Requests sent to the aggregator task via task notification bits
+#define AGG_REQ_RESET         BIT(0)
+#define AGG_REQ_SNAPSHOT      BIT(1)
+#define AGG_REQ_STATIONS      BIT(2)
+#define AGG_REQ_BEACONS       BIT(3)
+#define AGG_REQ_TALKERS       BIT(4)
+#define AGG_REQ_TALKERS_RESET BIT(5)    // After the copy, if both are set
+
+// Console requests waiting in ctl_queue, sent to the scan loop via task notification bits
+#define SCAN_NOTIFY_CONTROL BIT(0)
+#define SCAN_NOTIFY_ABORT   BIT(1)    // Also end the sweep in progress
+
+#define CTL_QUEUE_LEN 4
+
+// Access point changes per telemetry frame, keeps a frame well below the payload limit
+#define AP_TLM_BATCH 16
+
+// Longest listen per channel in an AP scan, also how long the scan loop waits
+// for the scan at a time so console requests are not held up longer
+#define AP_SCAN_DWELL_MS 200
+
 // RSSI register address for ESP32-S3
 #define RSSI_REGISTER_ADDRESS (0x600B1C44)  // This is a placeholder - verify in ESP32-S3 TRM
 
-// Define operation modes
+// Settings changes from the console, applied by the scan loop
 typedef enum {
-    MODE_PACKET_RSSI_SCAN,
-    MODE_ACCESS_POINT_SCAN
-} operation_mode_t;
+    CTL_MODE,
+    CTL_OUTPUT,
+    CTL_SCHED,
+    CTL_STATS,
+    CTL_LOG,
+    CTL_SURVEY,
+    CTL_ANOMALY,
+    CTL_DEVICES,
+    CTL_RADIO,
+} scan_ctl_type_t;
+
+typedef struct {
+    scan_ctl_type_t type;
+    union {
+        operation_mode_t mode;
+        scan_output_t output;
+        scan_sched_config_t sched;
+        scan_log_config_t log;
+        scan_stats_opts_t stats;
+        scan_survey_config_t survey;
+        scan_anom_config_t anomaly;
+        int32_t devices_emit_s;
+        bool radio_phy;
+    };
+} scan_ctl_t;
 
 // Global mode variable (default to packet-based RSSI scan)
 static operation_mode_t current_mode = MODE_PACKET_RSSI_SCAN;
 static bool header_printed_packet_rssi = false;
 static bool header_printed_ap = false;
+static bool print_dist = false;
+static bool print_classes = false;
+static bool quiet_output = false;
+static output_format_t output_format = OUTPUT_TEXT;
+static uint32_t sweep_count;
+
+// The scan loop owns the settings above and the scheduler; the console sends
+// it changes through ctl_queue and keeps its own copy of what it asked for
+static TaskHandle_t scan_task_handle;
+static QueueHandle_t ctl_queue;
+static operation_mode_t ctl_mode = MODE_PACKET_RSSI_SCAN;
+static scan_output_t ctl_output = {.format = OUTPUT_TEXT};
+static scan_sched_config_t ctl_sched;
+static scan_log_config_t ctl_log = {.interval_s = CONFIG_SCAN_LOG_INTERVAL_S};
+
+// PHY tests holding the radio, see scan_app_radio_hold. radio_mutex keeps
+// the holders in order and the scan loop answers each change on
+// radio_ack_sem once the radio is where it was asked to be.
+static SemaphoreHandle_t radio_mutex;
+static SemaphoreHandle_t radio_ack_sem;
+static int radio_holds;
+static bool radio_want;         // Scan loop: last CTL_RADIO, not acted on while radio_ack is set
+static bool radio_ack;
+static bool radio_phy;          // Scan loop: Wi-Fi is stopped and the PHY is in RF test mode
+
+// Telemetry frames share one sequence counter across record types. The scan
+// loop and the sweep writer both send frames and text reports; out_mutex is
+// held from taking a sequence number until the frame is out, and for a whole
+// report, so frames leave in order and reports do not interleave.
+static uint16_t tlm_seq;
+static uint8_t tlm_buf[SCAN_TLM_MAX_FRAME];
+static SemaphoreHandle_t out_mutex;
+
+// Measurement variables for packet-based RSSI scan, owned by the aggregator task
+static scan_sweep_t live_sweep;
+
+// Copy of live_sweep taken by the aggregator at the end of each sweep
+static scan_sweep_t snap_sweep;
+
+// Finished sweeps go to the writer task, which prints or encodes them while
+// the scan loop captures the next one
+static scan_out_t sweep_out;
+static TaskHandle_t out_task_handle;
+static uint8_t out_frame[SCAN_TLM_MAX_FRAME];
+
+// Records travel from the Wi-Fi task to the aggregator through this ring
+static scan_ring_t pkt_ring;
+static TaskHandle_t agg_task_handle;
+static SemaphoreHandle_t agg_done_sem;
+static SemaphoreHandle_t agg_req_mutex;    // One request at a time, from the scan loop or the console
+
+// Transmitters seen in packet RSSI mode, owned by the aggregator task like live_sweep
+static scan_sta_table_t stations;
+static scan_sta_table_t *stations_copy_dst;
+
+// Beacon timing per access point, also the aggregator's. The scan loop counts
+// its channel hops so that beacons are only compared within one visit.
+static scan_bcn_table_t beacons;
+static scan_bcn_table_t *beacons_copy_dst;
+static _Atomic uint32_t hop_count;
+
+// Heaviest transmitters per channel, the aggregator's as well, kept across
+// sweeps until the console resets them
+static scan_talkers_t talkers;
+static scan_talkers_t *talkers_copy_dst;
+
+// Capture filter. The callback uses the active one; the console compiles a
+// new configuration into the other and swaps. The buffer being overwritten
+// was retired by the previous swap, a whole console command earlier, so no
+// callback can still be reading it.
+static scan_filter_config_t filter_cfg;
+static scan_filter_t filters[2];
+static _Atomic(scan_filter_t *) active_filter;
+
+// Last sequence number per transmitter, lets the aggregator skip retransmissions in the frame counts
+static scan_seq_cache_t seq_cache;
+
+// Access points merged across scans; entries are allocated at startup, in PSRAM if present
+static scan_ap_table_t ap_table;
+static SemaphoreHandle_t ap_scan_done_sem;
+static bool ap_scan_running;
+static bool ap_scan_mode_set;           // Station mode is set and ap_scan_prev_mode is to be restored
+static wifi_mode_t ap_scan_prev_mode;
+static scan_tlm_ap_t ap_batch[AP_TLM_BATCH];
+static size_t ap_batch_len;
+
+typedef struct {
+    int events[SCAN_AP_EXPIRED + 1];
+    int frames;
+} ap_scan_stats_t;
+
+// Decides how long each channel is listened to in the next sweep
+static scan_sched_t sched;
+
+// RSSI distributions over the last minute and quarter hour, fed one sweep at a time
+static scan_window_t win_1m;
+static scan_window_t win_15m;
+static const scan_window_t *const windows[] = {&win_1m, &win_15m};
+#define NUM_WINDOWS (sizeof(windows) / sizeof(windows[0]))
+
+// Flash log. The scan loop appends, the console dumps and erases; log_mutex
+// covers the log state and every flash access. Dumps take it one sector read
+// at a time so the scan loop is never held up for long.
+static const esp_partition_t *log_part;
+static scan_flog_t flog;
+static SemaphoreHandle_t log_mutex;
+static bool log_enabled;
+static uint32_t log_interval_ms;
+static uint32_t log_last_sweep_ms;
+static uint32_t log_last_flush_ms;
+static uint8_t log_sector[SCAN_FLOG_SECTOR];    // Console side, for dumps
+
+// Frame capture. The callback copies accepted frames into pcap_ring while
+// pcap_running is set; the writer task sends them as SCAN_TLM_PCAP frames,
+// numbered with their own sequence. The ring is allocated on first use.
+static scan_pcap_ring_t pcap_ring;
+static uint8_t *pcap_buf;
+static _Atomic bool pcap_running;
+static TaskHandle_t pcap_task_handle;
+static uint16_t pcap_seq;
+static uint32_t pcap_frames;
+static uint8_t pcap_frame[SCAN_TLM_MAX_FRAME];
+
+// Channel utilization of recent sweeps, written by the scan loop and read by the console
+static scan_airtime_hist_t airtime_hist;
+static SemaphoreHandle_t airtime_mutex;
+
+// Low-power survey, run by the scan loop. While the radio is off between
+// sweeps the aggregator waits without a timeout so that nothing but the
+// next sweep wakes the chip.
+static scan_survey_config_t ctl_survey = {.period_ms = CONFIG_SCAN_SURVEY_PERIOD_MS};
+static scan_survey_config_t survey_cfg = {.period_ms = CONFIG_SCAN_SURVEY_PERIOD_MS};
+static scan_survey_t survey;
+static uint32_t survey_wake_ms;
+static _Atomic bool agg_idle;
+// Anomaly detection on finished sweeps, run by the scan loop. In quiet
+// output the console hears nothing else, plus a heartbeat when it has not
+// heard from the scanner for CONFIG_SCAN_HEARTBEAT_S.
+static scan_anom_config_t ctl_anomaly;
+static scan_anom_t anom;
+static scan_anom_event_t anom_events[SCAN_ANOM_MAX_EVENTS];
+static uint32_t quiet_last_ms;
+
+// Distinct transmitters. The aggregator sketches the sweep like live_sweep;
+// the scan loop merges each finished sweep into windows of a minute, a
+// quarter hour and an hour, allocated at startup, in PSRAM if present. A
+// slot is a whole set of sketches, so without PSRAM the short windows get
+// fewer, longer slots and expire in coarser steps. The windows go out with
+// every logged sweep, on request and at the period set with 'devices -e'.
+static scan_dev_set_t live_devices;
+static scan_dev_set_t snap_devices;
+static scan_dev_window_t *dev_windows[3];
+static scan_dev_set_t dev_union;    // Scan loop, for reports
+static uint32_t dev_emit_ms;        // Window telemetry period, 0 if off
+static uint32_t dev_emit_last_ms;
+
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t pm_cpu_lock;    // Full clock, which also keeps the hot-path probes in one time base
+static esp_pm_lock_handle_t pm_awake_lock;  // No light sleep while the radio listens
+static bool pm_held;
+#endif
+
+#if CONFIG_SCAN_PROF
+// Hot-path probes, each written by the task whose code it times. The console
+// report and stats telemetry keep separate marks, so each covers the time
+// since its own previous output.
+typedef struct {
+    uint32_t time_ms;
+    scan_prof_snap_t probes[SCAN_PROF_PROBES];
+    uint32_t total_runtime;
+    size_t ntasks;
+    TaskHandle_t tasks[CONFIG_SCAN_PROF_MAX_TASKS];
+    uint32_t runtime[CONFIG_SCAN_PROF_MAX_TASKS];
+} prof_mark_t;
+
+static scan_prof_t prof;
+static prof_mark_t prof_console_mark;
+static prof_mark_t prof_tlm_mark;
+static uint32_t prof_emit_ms;   // Stats telemetry period, 0 if off
+static scan_prof_snap_t prof_delta[SCAN_PROF_PROBES];
+static scan_prof_task_t prof_tasks[CONFIG_SCAN_PROF_MAX_TASKS];
+#endif
+
+// Promiscuous mode callback (for packet-based RSSI scan). Runs in the Wi-Fi
+// task, so it only copies the fields we need into the ring and returns.
+void wifi_sniffer_packet_handler(void *buff, wifi_promiscuous_pkt_type_t type) {
+    const wifi_promiscuous_pkt_t *pkt = buff;
 
-// Measurement variables for packet-based RSSI scan
-static int32_t rssi_values[CONFIG_MAX_WIFI_CHANNELS] = {0};
-static int32_t packet_count[CONFIG_MAX_WIFI_CHANNELS] = {0};
-static int32_t error_count[CONFIG_MAX_WIFI_CHANNELS] = {0};
+    if (current_mode != MODE_PACKET_RSSI_SCAN) return;
 
+    SCAN_PROF_START(t0);
+    if (scan_capture_accept(atomic_load_explicit(&active_filter, memory_order_acquire), pkt, type)) {
+        scan_capture_push(&pkt_ring, pkt, type);
 
-// Function to read a single character from the USB Serial JTAG RX buffer
-int usb_serial_jtag_read_char(void) {
-    uint8_t char_buf;
-    // Check if data is available in the RX buffer
-    if (usb_serial_jtag_ll_rxfifo_data_available()) {
-        // Read a single character from the RX buffer
-        if (usb_serial_jtag_ll_read_rxfifo(&char_buf, 1) > 0) {
-            return char_buf;  // Return the character
+        // The driver's buffer holds the whole frame, FCS included
+        if (atomic_load_explicit(&pcap_running, memory_order_relaxed)) {
+            scan_pcap_capture(&pcap_ring, pkt, pkt->rx_ctrl.sig_len);
         }
     }
-    return -1; // Return -1 if no character is available
+    SCAN_PROF_STOP(&prof, SCAN_PROF_CALLBACK, t0);
 }
 
-// Promiscuous mode callback (for packet-based RSSI scan)
-void wifi_sniffer_packet_handler(void *buff, wifi_promiscuous_pkt_type_t type) {
-    if (current_mode != MODE_PACKET_RSSI_SCAN) return;
+static uint32_t uptime_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+// Aggregator task: the only writer of the per-channel arrays. It drains the
+// ring periodically and serves reset/snapshot requests from scan_packet_rssi.
+static void aggregator_task(void *arg) {
+    const scan_agg_t agg = {.sweep = &live_sweep, .stations = &stations, .seq_cache = &seq_cache,
+                            .beacons = &beacons, .devices = &live_devices, .talkers = &talkers};
+    uint32_t last_dropped = 0;
+
+    scan_sweep_reset(&live_sweep);
+    scan_dev_reset(&live_devices);
+    scan_sta_init(&stations);
+    scan_bcn_init(&beacons);
+    scan_talkers_reset(&talkers);
+    scan_seq_cache_init(&seq_cache);
+    while (1) {
+        uint32_t req = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &req,
+                        atomic_load(&agg_idle) ? portMAX_DELAY : pdMS_TO_TICKS(CONFIG_SCAN_AGG_PERIOD_MS));
+
+        // Records still in the ring from before a hop land in the new visit;
+        // that costs a pair at most and never counts a missed beacon
+        scan_bcn_set_hop(&beacons, atomic_load(&hop_count));
+
+        SCAN_PROF_START(t0);
+        scan_agg_drain(&agg, &pkt_ring, uptime_ms());
+        SCAN_PROF_STOP(&prof, SCAN_PROF_DRAIN, t0);
+
+        if (req & AGG_REQ_SNAPSHOT) {
+            uint32_t dropped = scan_ring_dropped(&pkt_ring);
+            live_sweep.dropped = dropped - last_dropped;
+            last_dropped = dropped;
+            snap_sweep = live_sweep;
+            snap_devices = live_devices;
+        }
+        if (req & AGG_REQ_RESET) {
+            scan_sweep_reset(&live_sweep);
+            scan_dev_reset(&live_devices);
+        }
+        if (req & AGG_REQ_STATIONS) {
+            *stations_copy_dst = stations;
+        }
+        if (req & AGG_REQ_BEACONS) {
+            *beacons_copy_dst = beacons;
+        }
+        if (req & AGG_REQ_TALKERS) {
+            *talkers_copy_dst = talkers;
+        }
+        if (req & AGG_REQ_TALKERS_RESET) {
+            scan_talkers_reset(&talkers);
+        }
+        if (req) {
+            xSemaphoreGive(agg_done_sem);
+        }
+    }
+}
+
+// Send a request to the aggregator and wait until it has been served
+static void aggregator_request(uint32_t req) {
+    xSemaphoreTake(agg_req_mutex, portMAX_DELAY);
+    xTaskNotify(agg_task_handle, req, eSetBits);
+    xSemaphoreTake(agg_done_sem, portMAX_DELAY);
+    xSemaphoreGive(agg_req_mutex);
+}
+
+void scan_app_get_stations(scan_sta_table_t *out) {
+    xSemaphoreTake(agg_req_mutex, portMAX_DELAY);
+    stations_copy_dst = out;
+    xTaskNotify(agg_task_handle, AGG_REQ_STATIONS, eSetBits);
+    xSemaphoreTake(agg_done_sem, portMAX_DELAY);
+    xSemaphoreGive(agg_req_mutex);
+}
+
+void scan_app_get_beacons(scan_bcn_table_t *out) {
+    xSemaphoreTake(agg_req_mutex, portMAX_DELAY);
+    beacons_copy_dst = out;
+    xTaskNotify(agg_task_handle, AGG_REQ_BEACONS, eSetBits);
+    xSemaphoreTake(agg_done_sem, portMAX_DELAY);
+    xSemaphoreGive(agg_req_mutex);
+}
+
+void scan_app_get_talkers(scan_talkers_t *out, bool reset) {
+    xSemaphoreTake(agg_req_mutex, portMAX_DELAY);
+    talkers_copy_dst = out;
+    xTaskNotify(agg_task_handle, reset ? AGG_REQ_TALKERS | AGG_REQ_TALKERS_RESET : AGG_REQ_TALKERS, eSetBits);
+    xSemaphoreTake(agg_done_sem, portMAX_DELAY);
+    xSemaphoreGive(agg_req_mutex);
+}
+
+void scan_app_get_airtime(scan_airtime_hist_t *out) {
+    xSemaphoreTake(airtime_mutex, portMAX_DELAY);
+    *out = airtime_hist;
+    xSemaphoreGive(airtime_mutex);
+}
+
+static esp_err_t set_hw_filter(const scan_filter_t *filter) {
+    const wifi_promiscuous_filter_t hw = {.filter_mask = filter->hw_mask};
+    const wifi_promiscuous_filter_t hw_ctrl = {.filter_mask = filter->hw_ctrl_mask};
+    esp_err_t err = esp_wifi_set_promiscuous_filter(&hw);
+    if (err == ESP_OK && filter->hw_ctrl_mask) {
+        err = esp_wifi_set_promiscuous_ctrl_filter(&hw_ctrl);
+    }
+    return err;
+}
+
+// Called from the console task only, and once at startup before the console exists
+esp_err_t scan_app_set_filter(const scan_filter_config_t *cfg) {
+    scan_filter_t *next = atomic_load(&active_filter) == &filters[0] ? &filters[1] : &filters[0];
+
+    scan_filter_compile(cfg, next);
+
+    // Software first, so frames the radio starts passing are already checked
+    atomic_store_explicit(&active_filter, next, memory_order_release);
+    filter_cfg = *cfg;
+
+    return set_hw_filter(next);
+}
+
+void scan_app_get_filter(scan_filter_config_t *cfg, const scan_filter_t **filter) {
+    *cfg = filter_cfg;
+    *filter = atomic_load(&active_filter);
+}
+
+// Console side of the settings: remember the request, hand it to the scan loop
+static void post_control(const scan_ctl_t *msg, bool abort_sweep) {
+    xQueueSend(ctl_queue, msg, portMAX_DELAY);
+    xTaskNotify(scan_task_handle, abort_sweep ? SCAN_NOTIFY_CONTROL | SCAN_NOTIFY_ABORT : SCAN_NOTIFY_CONTROL,
+                eSetBits);
+}
+
+operation_mode_t scan_app_get_mode(void) {
+    return ctl_mode;
+}
+
+void scan_app_set_mode(operation_mode_t mode) {
+    const scan_ctl_t msg = {.type = CTL_MODE, .mode = mode};
+    ctl_mode = mode;
+    post_control(&msg, true);
+}
+
+void scan_app_get_output(scan_output_t *out) {
+    *out = ctl_output;
+}
+
+void scan_app_set_output(const scan_output_t *out) {
+    const scan_ctl_t msg = {.type = CTL_OUTPUT, .output = *out};
+    ctl_output = *out;
+    post_control(&msg, false);
+}
+
+void scan_app_get_sched(scan_sched_config_t *cfg) {
+    *cfg = ctl_sched;
+}
+
+void scan_app_set_sched(const scan_sched_config_t *cfg) {
+    const scan_ctl_t msg = {.type = CTL_SCHED, .sched = *cfg};
+    ctl_sched = *cfg;
+    post_control(&msg, true);
+}
+
+void scan_app_request_stats(const scan_stats_opts_t *opts) {
+    const scan_ctl_t msg = {.type = CTL_STATS, .stats = *opts};
+    post_control(&msg, false);
+}
+
+void scan_app_get_survey(scan_survey_config_t *cfg) {
+    *cfg = ctl_survey;
+}
+
+esp_err_t scan_app_set_survey(const scan_survey_config_t *cfg) {
+    const scan_ctl_t msg = {.type = CTL_SURVEY, .survey = *cfg};
 
-    // Ignore packets of types we're not interested in
-    if (type != WIFI_PKT_MGMT && type != WIFI_PKT_DATA) {
+#if !CONFIG_PM_ENABLE
+    if (cfg->enabled) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+#endif
+    ctl_survey = *cfg;
+    post_control(&msg, true);  // Ends a sleep in progress
+    return ESP_OK;
+}
+
+// The current configuration again, which the scan loop only prints
+void scan_app_request_survey(void) {
+    const scan_ctl_t msg = {.type = CTL_SURVEY, .survey = ctl_survey};
+    post_control(&msg, false);
+}
+
+void scan_app_get_anomaly(scan_anom_config_t *cfg) {
+    *cfg = ctl_anomaly;
+}
+
+void scan_app_set_anomaly(const scan_anom_config_t *cfg) {
+    const scan_ctl_t msg = {.type = CTL_ANOMALY, .anomaly = *cfg};
+    ctl_anomaly = *cfg;
+    post_control(&msg, false);
+}
+
+void scan_app_request_devices(int32_t emit_s) {
+    const scan_ctl_t msg = {.type = CTL_DEVICES, .devices_emit_s = emit_s};
+    post_control(&msg, false);
+}
+
+// Only the first hold and the last release reach the scan loop
+void scan_app_radio_hold(void) {
+    xSemaphoreTake(radio_mutex, portMAX_DELAY);
+    if (radio_holds++ == 0) {
+        const scan_ctl_t msg = {.type = CTL_RADIO, .radio_phy = true};
+        post_control(&msg, true);
+        xSemaphoreTake(radio_ack_sem, portMAX_DELAY);
+    }
+    xSemaphoreGive(radio_mutex);
+}
+
+void scan_app_radio_release(void) {
+    xSemaphoreTake(radio_mutex, portMAX_DELAY);
+    if (radio_holds > 0 && --radio_holds == 0) {
+        const scan_ctl_t msg = {.type = CTL_RADIO, .radio_phy = false};
+        post_control(&msg, true);
+        xSemaphoreTake(radio_ack_sem, portMAX_DELAY);
+    }
+    xSemaphoreGive(radio_mutex);
+}
+
+static esp_err_t init_aggregator(void) {
+    scan_ring_init(&pkt_ring);
+    scan_airtime_hist_init(&airtime_hist);
+
+    agg_done_sem = xSemaphoreCreateBinary();
+    agg_req_mutex = xSemaphoreCreateMutex();
+    airtime_mutex = xSemaphoreCreateMutex();
+    if (agg_done_sem == NULL || agg_req_mutex == NULL || airtime_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t ret = xTaskCreatePinnedToCore(aggregator_task, "scan_agg", 4096, NULL,
+                                             CONFIG_SCAN_AGG_TASK_PRIO, &agg_task_handle,
+                                             CONFIG_SCAN_AGG_TASK_CORE);
+    return ret == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+// Binary frames must reach the host byte for byte, so LF -> CRLF translation
+// on the console is switched off while binary output is selected or a frame
+// capture is streaming
+static void set_line_endings(output_format_t format) {
+    bool binary = format == OUTPUT_BINARY || atomic_load(&pcap_running);
+    esp_line_endings_t endings = binary ? ESP_LINE_ENDINGS_LF : ESP_LINE_ENDINGS_CRLF;
+#if CONFIG_ESP_CONSOLE_UART
+    esp_vfs_dev_uart_port_set_tx_line_endings(CONFIG_ESP_CONSOLE_UART_NUM, endings);
+#elif CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG
+    esp_vfs_dev_usb_serial_jtag_set_tx_line_endings(endings);
+#endif
+}
+
+// A sweep still waiting for the writer was meant for the old format and is
+// dropped: a frame must not go out with CRLF translation on, nor a table in
+// the middle of binary output. The one being written finishes first.
+static void set_output_format(output_format_t format) {
+    if (format != output_format) {
+        xSemaphoreTake(out_mutex, portMAX_DELAY);
+        scan_out_discard(&sweep_out);
+        set_line_endings(format);
+        xSemaphoreGive(out_mutex);
+    }
+    if (format == OUTPUT_TEXT && output_format != OUTPUT_TEXT) {
+        header_printed_packet_rssi = false;
+        header_printed_ap = false;
+    }
+    output_format = format;
+}
+
+static bool log_flash_read(uint32_t offset, void *buf, size_t len, void *ctx) {
+    return esp_partition_read(log_part, offset, buf, len) == ESP_OK;
+}
+
+static bool log_flash_write(uint32_t offset, const void *buf, size_t len, void *ctx) {
+    return esp_partition_write(log_part, offset, buf, len) == ESP_OK;
+}
+
+static bool log_flash_erase(uint32_t offset, size_t len, void *ctx) {
+    return esp_partition_erase_range(log_part, offset, len) == ESP_OK;
+}
+
+// Reads for the console, which walks the log while the scan loop keeps appending
+static bool log_flash_read_locked(uint32_t offset, void *buf, size_t len, void *ctx) {
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    bool ok = log_flash_read(offset, buf, len, ctx);
+    xSemaphoreGive(log_mutex);
+    return ok;
+}
+
+static const scan_flog_ops_t log_ops = {
+    .read = log_flash_read,
+    .write = log_flash_write,
+    .erase = log_flash_erase,
+};
+
+static const scan_flog_ops_t log_walk_ops = {
+    .read = log_flash_read_locked,
+};
+
+// A missing or unreadable partition only disables the log
+static esp_err_t init_log(void) {
+    log_mutex = xSemaphoreCreateMutex();
+    if (log_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    log_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, CONFIG_SCAN_LOG_PARTITION);
+    if (log_part == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition, flash log disabled", CONFIG_SCAN_LOG_PARTITION);
+        return ESP_OK;
+    }
+    if (!scan_flog_mount(&flog, &log_ops, log_part->size)) {
+        ESP_LOGE(TAG, "Flash log could not be read, disabled");
+        log_part = NULL;
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "Flash log: %lu sectors, boot %lu", (unsigned long)flog.nsectors, (unsigned long)flog.boot);
+    return ESP_OK;
+}
+
+// Frames reach flash a page at a time; this bounds how long a slow trickle
+// of records can sit in RAM, and with it what a power loss takes
+static void log_tick(void) {
+    if (!log_enabled || uptime_ms() - log_last_flush_ms < CONFIG_SCAN_LOG_FLUSH_MS) {
+        return;
+    }
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    scan_flog_flush(&flog);
+    xSemaphoreGive(log_mutex);
+    log_last_flush_ms = uptime_ms();
+}
+
+// Frames go to the console in binary output and to the flash log when asked.
+// The caller holds out_mutex.
+static void emit_telemetry(const uint8_t *frame, size_t len, bool to_log, bool to_console) {
+    if (len == 0) {
+        ESP_LOGW(TAG, "Telemetry frame too large, dropped");
         return;
     }
-    if (!buff) return;
+    if (to_log) {
+        xSemaphoreTake(log_mutex, portMAX_DELAY);
+        if (!scan_flog_append(&flog, frame, len)) {
+            ESP_LOGD(TAG, "Flash log append failed");
+        }
+        xSemaphoreGive(log_mutex);
+    }
+    if (to_console) {
+        fwrite(frame, 1, len, stdout);
+        fflush(stdout);
+    }
+}
+
+esp_err_t scan_app_get_log(scan_log_config_t *cfg) {
+    *cfg = ctl_log;
+    return log_part ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t scan_app_set_log(const scan_log_config_t *cfg) {
+    const scan_ctl_t msg = {.type = CTL_LOG, .log = *cfg};
+
+    if (log_part == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    ctl_log = *cfg;
+    post_control(&msg, false);
+    return ESP_OK;
+}
+
+// Put what the scan loop has batched on flash before the console reads it back
+static esp_err_t log_prepare_walk(void) {
+    if (log_part == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    scan_flog_flush(&flog);
+    xSemaphoreGive(log_mutex);
+    return ESP_OK;
+}
+
+typedef struct {
+    bool started;
+    uint32_t boot;
+    uint32_t frames;
+    uint32_t first_ms;
+    uint32_t last_ms;
+} log_boot_span_t;
+
+static void print_boot_span(const log_boot_span_t *span) {
+    printf("boot %-6lu %8lu frames  %10.1f .. %.1f s\n", (unsigned long)span->boot, (unsigned long)span->frames,
+           span->first_ms / 1000.0, span->last_ms / 1000.0);
+}
 
-    const wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buff;
-    const wifi_pkt_rx_ctrl_t *rx_ctrl = &pkt->rx_ctrl;
+// Walk callback for the info listing: one line per boot, in log order
+static bool log_info_frame(const scan_flog_record_t *rec, void *ctx) {
+    log_boot_span_t *span = ctx;
+    uint32_t t;
 
-    if (rx_ctrl->channel >= 1 && rx_ctrl->channel <= CONFIG_MAX_WIFI_CHANNELS) {
-        int index = rx_ctrl->channel - 1;
-        if (packet_count[index] == 0 || rx_ctrl->rssi > rssi_values[index]) {
-            rssi_values[index] = rx_ctrl->rssi;
+    if (!span->started || rec->boot != span->boot) {
+        if (span->started) {
+            print_boot_span(span);
+        }
+        *span = (log_boot_span_t){.started = true, .boot = rec->boot, .first_ms = UINT32_MAX};
+    }
+    span->frames++;
+    if (scan_flog_frame_time(&rec->frame, &t)) {
+        if (t < span->first_ms) {
+            span->first_ms = t;
+        }
+        if (t > span->last_ms) {
+            span->last_ms = t;
         }
-        packet_count[index]++;
+    }
+    return true;
+}
 
-        // Check for actual error conditions in rx_state
-        if (rx_ctrl->rx_state != 0) {  // Non-zero state indicates some kind of error
-            if ((rx_ctrl->rx_state & BIT(0)) ||     // CRC error
-                (rx_ctrl->rx_state & BIT(1)) ||     // PHY error
-                (rx_ctrl->rx_state & BIT(7))) {     // Incomplete reception
-                error_count[index]++;
-            }
+esp_err_t scan_app_log_info(void) {
+    log_boot_span_t span = {0};
+    scan_flog_walk_stats_t stats;
+    scan_flog_t snap;
+
+    esp_err_t err = log_prepare_walk();
+    if (err != ESP_OK) {
+        return err;
+    }
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    snap = flog;
+    xSemaphoreGive(log_mutex);
+
+    printf("# Flash log '%s', %lu KB in %lu sectors, this is boot %lu\n", log_part->label,
+           (unsigned long)(log_part->size / 1024), (unsigned long)snap.nsectors, (unsigned long)snap.boot);
+    printf("# This boot: %lu frames, %lu bytes, %lu sectors erased, %lu flash errors\n",
+           (unsigned long)snap.frames, (unsigned long)snap.bytes, (unsigned long)snap.erases,
+           (unsigned long)snap.errors);
+    if (!scan_flog_walk(&log_walk_ops, log_part->size, log_sector, log_info_frame, &span, &stats)) {
+        return ESP_FAIL;
+    }
+    if (span.started) {
+        print_boot_span(&span);
+    }
+    printf("# %lu sectors used, %lu frames, %lu damaged\n", (unsigned long)stats.sectors,
+           (unsigned long)stats.frames, (unsigned long)stats.bad);
+    return ESP_OK;
+}
+
+typedef struct {
+    const scan_log_range_t *range;
+    uint32_t frames;
+} log_dump_t;
+
+static bool log_dump_frame(const scan_flog_record_t *rec, void *ctx) {
+    log_dump_t *dump = ctx;
+    const scan_log_range_t *range = dump->range;
+    uint32_t t;
+
+    if (!range->all_boots && rec->boot != range->boot) {
+        return true;
+    }
+    if (scan_flog_frame_time(&rec->frame, &t) && (t < range->from_ms || t > range->to_ms)) {
+        return true;
+    }
+    fwrite(rec->raw, 1, rec->len, stdout);
+    dump->frames++;
+    return true;
+}
+
+esp_err_t scan_app_log_dump(const scan_log_range_t *range) {
+    log_dump_t dump = {.range = range};
+    scan_flog_walk_stats_t stats;
+
+    esp_err_t err = log_prepare_walk();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Frames go out as they are stored, through binary line endings whatever the output format
+    fflush(stdout);
+    set_line_endings(OUTPUT_BINARY);
+    bool ok = scan_flog_walk(&log_walk_ops, log_part->size, log_sector, log_dump_frame, &dump, &stats);
+    fflush(stdout);
+    set_line_endings(output_format);
+
+    ESP_LOGI(TAG, "Log dump: %lu of %lu frames sent", (unsigned long)dump.frames, (unsigned long)stats.frames);
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t scan_app_log_erase(void) {
+    if (log_part == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    bool ok = scan_flog_format(&flog);
+    xSemaphoreGive(log_mutex);
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+// Sends whatever the callback captured every CONFIG_SCAN_PCAP_FLUSH_MS, and
+// sleeps until the next start once a stopped capture has been drained
+static void pcap_writer_task(void *arg) {
+    while (1) {
+        bool active = atomic_load(&pcap_running) || scan_pcap_fill(&pcap_ring) != 0;
+        ulTaskNotifyTake(pdTRUE, active ? pdMS_TO_TICKS(CONFIG_SCAN_PCAP_FLUSH_MS) : portMAX_DELAY);
+
+        size_t len;
+        bool sent = false;
+        while ((len = scan_pcap_encode(&pcap_ring, pcap_frame, sizeof(pcap_frame), pcap_seq)) > 0) {
+            fwrite(pcap_frame, 1, len, stdout);
+            pcap_seq++;
+            pcap_frames++;
+            sent = true;
+        }
+        if (sent) {
+            fflush(stdout);
+        }
+    }
+}
+
+static esp_err_t init_capture(void) {
+    uint8_t *buf = NULL;
+
+#if CONFIG_SPIRAM
+    buf = heap_caps_malloc(CONFIG_SCAN_PCAP_RING_SIZE, MALLOC_CAP_SPIRAM);
+#endif
+    if (buf == NULL) {
+        buf = heap_caps_malloc(CONFIG_SCAN_PCAP_RING_SIZE, MALLOC_CAP_DEFAULT);
+    }
+    if (buf == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (!scan_pcap_init(&pcap_ring, buf, CONFIG_SCAN_PCAP_RING_SIZE, CONFIG_SCAN_PCAP_SNAPLEN)) {
+        free(buf);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    BaseType_t ret = xTaskCreatePinnedToCore(pcap_writer_task, "scan_pcap", 3072, NULL,
+                                             CONFIG_SCAN_PCAP_TASK_PRIO, &pcap_task_handle,
+                                             CONFIG_SCAN_AGG_TASK_CORE);
+    if (ret != pdPASS) {
+        free(buf);
+        return ESP_ERR_NO_MEM;
+    }
+    pcap_buf = buf;
+    return ESP_OK;
+}
+
+esp_err_t scan_app_capture_start(uint16_t snaplen) {
+    if (atomic_load(&pcap_running)) {
+        scan_pcap_set_snaplen(&pcap_ring, snaplen);
+        return ESP_OK;
+    }
+    if (pcap_buf == NULL) {
+        esp_err_t err = init_capture();
+        if (err != ESP_OK) {
+            return err;
         }
     }
+
+    scan_pcap_restart(&pcap_ring, snaplen);
+    pcap_frames = 0;
+    fflush(stdout);
+    atomic_store(&pcap_running, true);
+    set_line_endings(output_format);
+    xTaskNotifyGive(pcap_task_handle);
+    return ESP_OK;
+}
+
+// Frames still in the ring go out before the console gets its line endings back
+esp_err_t scan_app_capture_stop(void) {
+    if (!atomic_load(&pcap_running)) {
+        return ESP_OK;
+    }
+    atomic_store(&pcap_running, false);
+    xTaskNotifyGive(pcap_task_handle);
+    for (int i = 0; i < 100 && scan_pcap_fill(&pcap_ring) != 0; i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    set_line_endings(output_format);
+    return ESP_OK;
+}
+
+void scan_app_get_capture(scan_capture_status_t *st) {
+    *st = (scan_capture_status_t){
+        .running = atomic_load(&pcap_running),
+        .snaplen = pcap_buf ? atomic_load(&pcap_ring.snaplen) : CONFIG_SCAN_PCAP_SNAPLEN,
+        .ring_size = CONFIG_SCAN_PCAP_RING_SIZE,
+        .ring_fill = pcap_buf ? scan_pcap_fill(&pcap_ring) : 0,
+        .captured = atomic_load(&pcap_ring.captured),
+        .dropped = atomic_load(&pcap_ring.dropped),
+        .frames = pcap_frames,
+    };
+}
+
+// A script stored for boot runs before the prompt appears. It gets its own
+// task so the scan loop is already serving the settings it changes.
+static void console_boot_task(void *arg) {
+    esp_console_repl_t *repl = arg;
+
+    script_run_boot();
+    ESP_ERROR_CHECK(esp_console_start_repl(repl));
+    vTaskDelete(NULL);
+}
+
+// One REPL for the scanner, PHY test and script commands. With USB-Serial-JTAG
+// as the primary console the REPL task blocks in the driver, which its RX
+// interrupt wakes, so nothing polls for input.
+static void start_console(void) {
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = "scan>";
+    // Room for a whole script in one line, and for the commands it runs nested in the REPL task
+    repl_config.max_cmdline_length = 1024;
+    repl_config.task_stack_size = 8192;
+
+#if CONFIG_ESP_CONSOLE_UART
+    esp_console_dev_uart_config_t hw_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_console_new_repl_uart(&hw_config, &repl_config, &repl));
+#elif CONFIG_ESP_CONSOLE_USB_CDC
+    esp_console_dev_usb_cdc_config_t hw_config = ESP_CONSOLE_DEV_CDC_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_console_new_repl_usb_cdc(&hw_config, &repl_config, &repl));
+#elif CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG
+    esp_console_dev_usb_serial_jtag_config_t hw_config = ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_console_new_repl_usb_serial_jtag(&hw_config, &repl_config, &repl));
+#endif
+
+    register_scan_cmd();
+    register_phy_cmd();
+    register_script_cmd();
+    xTaskCreate(console_boot_task, "console_boot", 8192, repl, repl_config.task_priority, NULL);
 }
 
 // Initialize NVS (required for WiFi)
@@ -116,58 +1029,99 @@ static esp_err_t init_wifi(void) {
     return ESP_OK;
 }
 
-void scan_packet_rssi(void) {
-    static int scan_iteration = 1;
+// Scan results are merged into the AP table and only the changes are output
+static void ap_event(const scan_ap_entry_t *entry, scan_ap_event_t event, void *ctx) {
+    ap_scan_stats_t *stats = ctx;
+    const scan_ap_obs_t *ap = &entry->ap;
 
-    // Reset tracking arrays before new scan
-    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
-        rssi_values[i] = -100;  // Lowest reasonable RSSI
-        packet_count[i] = 0;
-        error_count[i] = 0;
-    }
+    stats->events[event]++;
 
-    // Scan each channel
-    for (int channel = 1; channel <= CONFIG_MAX_WIFI_CHANNELS; channel++) {
-        ESP_ERROR_CHECK(esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE));
-        vTaskDelay(pdMS_TO_TICKS(150)); // Allow time for packet collection
-    }
-
-    // Print header once at the beginning
-    if (!header_printed_packet_rssi) {
-        printf("# Format for each channel: RSSI(dBm)/Packets[/Errors if any]\n");
-        printf("Scan     ");
-        for (int channel = 1; channel <= CONFIG_MAX_WIFI_CHANNELS; channel++) {
-            printf("Ch%-4d       ", channel);
+    if (output_format == OUTPUT_BINARY || log_enabled) {
+        scan_tlm_ap_t *out = &ap_batch[ap_batch_len++];
+        memcpy(out->bssid, ap->bssid, sizeof(out->bssid));
+        memcpy(out->ssid, ap->ssid, sizeof(out->ssid));
+        out->channel = ap->channel;
+        out->rssi = ap->rssi;
+        out->authmode = ap->authmode;
+        out->status = event == SCAN_AP_NEW ? SCAN_TLM_AP_NEW :
+                      event == SCAN_AP_CHANGED ? SCAN_TLM_AP_CHANGED : SCAN_TLM_AP_EXPIRED;
+        if (ap_batch_len == AP_TLM_BATCH) {
+            emit_telemetry(tlm_buf, scan_tlm_encode_aps(tlm_buf, sizeof(tlm_buf), tlm_seq++, uptime_ms(), ap_batch,
+                                                        ap_batch_len), log_enabled, output_format == OUTPUT_BINARY);
+            ap_batch_len = 0;
+            stats->frames++;
+        }
+        if (output_format == OUTPUT_BINARY) {
+            return;
         }
-        printf("\n");
-        header_printed_packet_rssi = true;
     }
 
-    // Print results
-    printf("%-6d", scan_iteration++);
-    for (int channel = 1; channel <= CONFIG_MAX_WIFI_CHANNELS; channel++) {
-        int index = channel - 1;
-        int rssi = rssi_values[index];
-        int packets = packet_count[index];
-        int errors = error_count[index];
+    printf("%-8s %02x:%02x:%02x:%02x:%02x:%02x  %-8d %-10d %-5d %s\n", scan_ap_event_name(event),
+           ap->bssid[0], ap->bssid[1], ap->bssid[2], ap->bssid[3], ap->bssid[4], ap->bssid[5],
+           ap->channel, ap->rssi, ap->authmode, ap->ssid);
+}
+
+// Runs on the default event loop; the scan loop picks the results up
+static void wifi_scan_done_handler(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    xSemaphoreGive(ap_scan_done_sem);
+}
 
-        // Print RSSI and packet count, and errors only if present
-        if (errors > 0) {
-            printf("%5d/%-3d/%-3d ", packets > 0 ? rssi : -100, packets, errors);
-        } else {
-            printf("%5d/%-3d    ", packets > 0 ? rssi : -100, packets);
-        }
+static esp_err_t init_ap_scan(void) {
+    size_t bytes = CONFIG_SCAN_AP_TABLE_SIZE * sizeof(scan_ap_entry_t);
+    scan_ap_entry_t *entries = NULL;
+
+#if CONFIG_SPIRAM
+    entries = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+#endif
+    if (entries == NULL) {
+        entries = heap_caps_malloc(bytes, MALLOC_CAP_DEFAULT);
     }
-    printf("\n");
+    ap_scan_done_sem = xSemaphoreCreateBinary();
+    if (entries == NULL || ap_scan_done_sem == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    scan_ap_table_init(&ap_table, entries, CONFIG_SCAN_AP_TABLE_SIZE);
+
+    return esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, &wifi_scan_done_handler, NULL, NULL);
 }
 
+static esp_err_t init_devices(void) {
+    static const struct {
+        uint32_t length_ms;
+        int nslots;
+    } lengths[] = {
+#if CONFIG_SPIRAM
+        {60 * 1000, 6}, {15 * 60 * 1000, 5}, {60 * 60 * 1000, 4},
+#else
+        {60 * 1000, 3}, {15 * 60 * 1000, 3}, {60 * 60 * 1000, 4},
+#endif
+    };
 
-void scan_access_points(void) {
-    wifi_ap_record_t ap_records[20];  // Increased number of records
-    uint16_t ap_count = 20;  // Set max number of records to retrieve
+    for (size_t i = 0; i < sizeof(dev_windows) / sizeof(dev_windows[0]); i++) {
+        size_t bytes = SCAN_DEV_WINDOW_SIZE(lengths[i].nslots);
+        scan_dev_window_t *win = NULL;
+#if CONFIG_SPIRAM
+        win = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+#endif
+        if (win == NULL) {
+            win = heap_caps_malloc(bytes, MALLOC_CAP_DEFAULT);
+        }
+        if (win == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        scan_dev_window_init(win, lengths[i].length_ms, lengths[i].nslots);
+        dev_windows[i] = win;
+    }
+    return ESP_OK;
+}
 
-    // Ensure Wi-Fi is in the correct mode
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+static void ap_scan_start(void) {
+    // Scans need station mode; the mode before it comes back in ap_scan_stop
+    if (!ap_scan_mode_set) {
+        ESP_ERROR_CHECK(esp_wifi_get_mode(&ap_scan_prev_mode));
+        ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+        ap_scan_mode_set = true;
+    }
 
     wifi_scan_config_t scan_config = {
         .ssid = NULL,
@@ -176,64 +1130,785 @@ void scan_access_points(void) {
         .show_hidden = true,
         .scan_type = WIFI_SCAN_TYPE_ACTIVE,
         .scan_time.active.min = 100,
-        .scan_time.active.max = 200
+        .scan_time.active.max = AP_SCAN_DWELL_MS
     };
 
-    // Stop any ongoing scan first
-    esp_wifi_scan_stop();
+    // A completion left over from a stopped scan must not be taken for this one
+    xSemaphoreTake(ap_scan_done_sem, 0);
 
-    // Start scan with specific configuration
-    esp_err_t scan_result = esp_wifi_scan_start(&scan_config, true);
+    esp_err_t scan_result = esp_wifi_scan_start(&scan_config, false);
     if (scan_result != ESP_OK) {
         ESP_LOGE(TAG, "Scan start failed with error: %s", esp_err_to_name(scan_result));
         return;
     }
+    ap_scan_running = true;
+}
 
-    scan_result = esp_wifi_scan_get_ap_records(&ap_count, ap_records);
-    if (scan_result != ESP_OK) {
-        ESP_LOGE(TAG, "Get AP records failed with error: %s", esp_err_to_name(scan_result));
-        return;
+// Leaving AP mode: the radio must be free for channel hopping again
+static void ap_scan_stop(void) {
+    if (ap_scan_running) {
+        esp_wifi_scan_stop();
+        esp_wifi_clear_ap_list();
+        ap_scan_running = false;
     }
+    if (ap_scan_mode_set) {
+        ESP_ERROR_CHECK(esp_wifi_set_mode(ap_scan_prev_mode));
+        ap_scan_mode_set = false;
+    }
+}
+
+static void ap_scan_collect(void) {
+    static uint32_t scan_iteration = 1;
+    ap_scan_stats_t stats = {0};
+    uint16_t ap_count = 0;
+    uint32_t now = uptime_ms();
+
+    ap_scan_running = false;
+    esp_wifi_scan_get_ap_num(&ap_count);
+    xSemaphoreTake(out_mutex, portMAX_DELAY);
 
     // Print header once
-    if (!header_printed_ap) {
-        printf("# Access Point Scan Results\n");
-        printf("Channel  RSSI(dBm)  SSID\n");
+    if (output_format == OUTPUT_TEXT && !header_printed_ap) {
+        printf("# Access Point Scan Results (changes only)\n");
+        printf("Event    BSSID              Channel  RSSI(dBm)  Auth  SSID\n");
         header_printed_ap = true;
     }
 
-    // Print access point details
-    for (int i = 0; i < ap_count; i++) {
-        printf("%-8d %-11d %s\n",
-               ap_records[i].primary,
-               ap_records[i].rssi,
-               ap_records[i].ssid);
+    // Records are taken one at a time, so no scan size limits what is kept
+    for (uint16_t i = 0; i < ap_count; i++) {
+        wifi_ap_record_t rec;
+        if (esp_wifi_scan_get_ap_record(&rec) != ESP_OK) {
+            break;
+        }
+
+        scan_ap_obs_t obs = {
+            .channel = rec.primary,
+            .rssi = rec.rssi,
+            .authmode = rec.authmode,
+        };
+        memcpy(obs.bssid, rec.bssid, sizeof(obs.bssid));
+        memcpy(obs.ssid, rec.ssid, sizeof(obs.ssid) - 1);
+        scan_ap_observe(&ap_table, &obs, now, ap_event, &stats);
+    }
+    esp_wifi_clear_ap_list();
+    scan_ap_expire(&ap_table, now, ap_event, &stats);
+
+    if (output_format == OUTPUT_BINARY || log_enabled) {
+        if (ap_batch_len > 0 || stats.frames == 0) {
+            emit_telemetry(tlm_buf, scan_tlm_encode_aps(tlm_buf, sizeof(tlm_buf), tlm_seq++, now, ap_batch, ap_batch_len),
+                           log_enabled, output_format == OUTPUT_BINARY);
+            ap_batch_len = 0;
+        }
+    }
+    if (output_format == OUTPUT_TEXT) {
+        printf("# Scan %lu: %u found, %u tracked (%d new, %d changed, %d expired)\n",
+               (unsigned long)scan_iteration, ap_count, (unsigned)ap_table.count,
+               stats.events[SCAN_AP_NEW], stats.events[SCAN_AP_CHANGED], stats.events[SCAN_AP_EXPIRED]);
+    }
+    xSemaphoreGive(out_mutex);
+    scan_iteration++;
+}
+
+// Called from the scan loop in AP mode; waits at most one dwell for the scan
+void scan_access_points(void) {
+    if (!ap_scan_running) {
+        ap_scan_start();
+        return;
+    }
+    if (xSemaphoreTake(ap_scan_done_sem, pdMS_TO_TICKS(AP_SCAN_DWELL_MS)) == pdTRUE) {
+        ap_scan_collect();
+    }
+}
+
+#if CONFIG_SCAN_PROF
+// Probe changes since the mark, returns the interval they cover
+static uint32_t prof_collect(prof_mark_t *mark, scan_prof_snap_t *delta) {
+    uint32_t now = uptime_ms();
+    uint32_t interval = now - mark->time_ms;
+
+    for (int probe = 0; probe < SCAN_PROF_PROBES; probe++) {
+        scan_prof_snap_t snap;
+        scan_prof_snapshot(&prof, probe, &snap);
+        scan_prof_diff(&snap, &mark->probes[probe], &delta[probe]);
+        mark->probes[probe] = snap;
+    }
+    mark->time_ms = now;
+    return interval;
+}
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+// CPU share of every task since the mark and its stack high-water mark.
+// Returns 0 if there are more tasks than the table has room for.
+static size_t prof_collect_tasks(prof_mark_t *mark, scan_prof_task_t *out) {
+    static TaskStatus_t status[CONFIG_SCAN_PROF_MAX_TASKS];
+    configRUN_TIME_COUNTER_TYPE total;
+    UBaseType_t n = uxTaskGetSystemState(status, CONFIG_SCAN_PROF_MAX_TASKS, &total);
+
+    // Run time counts per core while total is wall time
+    uint64_t elapsed = (uint64_t)((uint32_t)total - mark->total_runtime) * portNUM_PROCESSORS;
+    for (UBaseType_t i = 0; i < n; i++) {
+        const TaskStatus_t *st = &status[i];
+        scan_prof_task_t *t = &out[i];
+        uint32_t before = 0;
+
+        for (size_t j = 0; j < mark->ntasks; j++) {
+            if (mark->tasks[j] == st->xHandle) {
+                before = mark->runtime[j];
+                break;
+            }
+        }
+        uint64_t permille = elapsed ? (uint64_t)((uint32_t)st->ulRunTimeCounter - before) * 1000 / elapsed : 0;
+
+        strlcpy(t->name, st->pcTaskName, sizeof(t->name));
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        t->core = st->xCoreID == tskNO_AFFINITY ? -1 : (int8_t)st->xCoreID;
+#else
+        t->core = -1;
+#endif
+        t->prio = (uint8_t)st->uxCurrentPriority;
+        t->cpu_permille = permille > 1000 ? 1000 : (uint16_t)permille;
+        t->stack_free = st->usStackHighWaterMark;   // Bytes, stacks are byte arrays in ESP-IDF
+    }
+
+    for (UBaseType_t i = 0; i < n; i++) {
+        mark->tasks[i] = status[i].xHandle;
+        mark->runtime[i] = (uint32_t)status[i].ulRunTimeCounter;
+    }
+    mark->ntasks = n;
+    mark->total_runtime = (uint32_t)total;
+    return n;
+}
+#else
+static size_t prof_collect_tasks(prof_mark_t *mark, scan_prof_task_t *out) {
+    return 0;
+}
+#endif
+
+static void prof_counters(scan_prof_counters_t *c) {
+    c->ring_dropped = scan_ring_dropped(&pkt_ring);
+    c->pcap_dropped = atomic_load_explicit(&pcap_ring.dropped, memory_order_relaxed);
+    c->heap_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+}
+
+static void print_prof(bool hist) {
+    uint32_t interval = prof_collect(&prof_console_mark, prof_delta);
+    scan_prof_report_print(prof_delta, prof.cycles_per_us, interval, hist);
+
+    size_t ntasks = prof_collect_tasks(&prof_console_mark, prof_tasks);
+    if (ntasks == 0) {
+        printf("# Task load needs CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS and at most %d tasks\n",
+               CONFIG_SCAN_PROF_MAX_TASKS);
+        return;
+    }
+    scan_prof_task_report_print(prof_tasks, ntasks);
+}
+
+// Stats telemetry at the period set with 'stats -e', binary output only
+static void prof_tick(void) {
+    if (prof_emit_ms == 0 || output_format != OUTPUT_BINARY || uptime_ms() - prof_tlm_mark.time_ms < prof_emit_ms) {
+        return;
+    }
+
+    scan_prof_counters_t counters;
+    uint32_t interval = prof_collect(&prof_tlm_mark, prof_delta);
+    size_t ntasks = prof_collect_tasks(&prof_tlm_mark, prof_tasks);
+    prof_counters(&counters);
+    xSemaphoreTake(out_mutex, portMAX_DELAY);
+    emit_telemetry(tlm_buf, scan_prof_encode(tlm_buf, sizeof(tlm_buf), tlm_seq++, uptime_ms(), interval,
+                                             prof.cycles_per_us, prof_delta, &counters, prof_tasks, ntasks),
+                   false, true);
+    xSemaphoreGive(out_mutex);
+}
+#endif
+
+static void print_stats(const scan_stats_opts_t *opts) {
+    const scan_filter_t *filter = atomic_load(&active_filter);
+
+    printf("# Scanner status\n");
+    printf("%-10s %s%s\n", "mode", current_mode == MODE_PACKET_RSSI_SCAN ? "rssi" : "ap",
+           radio_phy ? ", paused for PHY tests" : "");
+    printf("%-10s %s, dist %s, classes %s, quiet %s\n", "output", output_format == OUTPUT_BINARY ? "binary" : "text",
+           print_dist ? "on" : "off", print_classes ? "on" : "off", quiet_output ? "on" : "off");
+    printf("%-10s %lu\n", "anomalies", (unsigned long)anom.events);
+    printf("%-10s %lu\n", "sweeps", (unsigned long)sweep_count);
+    printf("%-10s %lu written, %lu coalesced\n", "sweep out",
+           (unsigned long)atomic_load_explicit(&sweep_out.written, memory_order_relaxed),
+           (unsigned long)sweep_out.coalesced);
+    printf("%-10s %lu\n", "dropped", (unsigned long)scan_ring_dropped(&pkt_ring));
+    printf("%-10s %lu\n", "captured", (unsigned long)atomic_load_explicit(&filter->passed, memory_order_relaxed));
+    printf("%-10s %lu\n", "aps", (unsigned long)ap_table.count);
+    printf("%-10s %lu\n", "free heap", (unsigned long)esp_get_free_heap_size());
+    if (log_part) {
+        printf("%-10s %s, %lu frames this boot\n", "flash log", log_enabled ? "on" : "off",
+               (unsigned long)flog.frames);
+    }
+    if (survey_cfg.enabled) {
+        uint32_t duty = scan_survey_duty_permille(&survey);
+        printf("%-10s on, one sweep every %lu ms, duty %lu.%lu %%\n", "survey", (unsigned long)survey_cfg.period_ms,
+               (unsigned long)(duty / 10), (unsigned long)(duty % 10));
+    }
+#if CONFIG_SCAN_PROF
+    scan_prof_counters_t counters;
+    prof_counters(&counters);
+    printf("%-10s %lu\n", "pcap drops", (unsigned long)counters.pcap_dropped);
+    printf("%-10s %lu free, %lu lowest\n", "internal", (unsigned long)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+           (unsigned long)counters.heap_min_free);
+    if (prof_emit_ms) {
+        printf("%-10s every %lu s\n", "stats tlm", (unsigned long)(prof_emit_ms / 1000));
+    }
+    print_prof(opts->hist);
+#else
+    printf("# Hot-path instrumentation compiled out (CONFIG_SCAN_PROF 0)\n");
+#endif
+    scan_sched_report_print(&sched);
+
+#if CONFIG_SCAN_PROF
+    // The driver keeps its RX buffer and drop counters to itself; this is the only way to read them
+    if (opts->driver) {
+        fflush(stdout);
+        esp_wifi_statis_dump(WIFI_STATIS_BUFFER | WIFI_STATIS_RXTX);
+    }
+#endif
+}
+
+// Take or drop the locks that keep the chip at full clock and out of light sleep
+static void survey_hold(bool awake) {
+#if CONFIG_PM_ENABLE
+    if (awake == pm_held) return;
+    if (awake) {
+        esp_pm_lock_acquire(pm_cpu_lock);
+        esp_pm_lock_acquire(pm_awake_lock);
+    } else {
+        esp_pm_lock_release(pm_awake_lock);
+        esp_pm_lock_release(pm_cpu_lock);
+    }
+    pm_held = awake;
+#endif
+}
+
+// Switch frequency scaling and automatic light sleep on or off with the survey
+static void survey_apply(const scan_survey_config_t *cfg) {
+#if CONFIG_PM_ENABLE
+    if (cfg->enabled != survey_cfg.enabled) {
+        const esp_pm_config_t pm = {
+            .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+            .min_freq_mhz = cfg->enabled ? CONFIG_SCAN_SURVEY_MIN_FREQ_MHZ : CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+            .light_sleep_enable = cfg->enabled,
+        };
+
+        // Locks first, so the new configuration never lets the loop itself slow down
+        survey_hold(cfg->enabled);
+        esp_err_t err = esp_pm_configure(&pm);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Power management setup failed: %s", esp_err_to_name(err));
+            survey_hold(false);
+            return;
+        }
+        if (cfg->enabled) {
+            scan_survey_init(&survey, cfg->period_ms);
+            survey_wake_ms = uptime_ms();
+        }
+        ESP_LOGI(TAG, "Survey mode %s", cfg->enabled ? "on" : "off");
+    }
+    survey.period_ms = cfg->period_ms;
+    survey_cfg = *cfg;
+#endif
+    scan_survey_report_print(&survey, &survey_cfg);
+}
+
+// Distinct transmitters of the last sweep and of each window
+static void print_devices(void) {
+    scan_dev_counts_t counts[1 + sizeof(dev_windows) / sizeof(dev_windows[0])];
+
+    scan_dev_count(&snap_devices, 0, &counts[0]);
+    for (size_t i = 0; i < sizeof(dev_windows) / sizeof(dev_windows[0]); i++) {
+        scan_dev_window_union(dev_windows[i], &dev_union);
+        scan_dev_count(&dev_union, dev_windows[i]->length_ms, &counts[i + 1]);
+    }
+    scan_dev_report_print(counts, sizeof(counts) / sizeof(counts[0]));
+}
+
+// The windows as SCAN_TLM_DEVICES frames with their length in window_s, each
+// in as many frames as it needs. Called with out_mutex held.
+static void emit_device_windows(bool to_log, bool to_console) {
+    uint32_t now = uptime_ms();
+
+    for (size_t i = 0; i < sizeof(dev_windows) / sizeof(dev_windows[0]); i++) {
+        int next = 0;
+        scan_dev_window_union(dev_windows[i], &dev_union);
+        while (next < SCAN_DEV_SKETCHES) {
+            size_t len = scan_dev_encode(tlm_buf, sizeof(tlm_buf), tlm_seq, now, sweep_count,
+                                         dev_windows[i]->length_ms / 1000, &dev_union, &next);
+            if (len == 0) break;
+            tlm_seq++;
+            emit_telemetry(tlm_buf, len, to_log, to_console);
+        }
+    }
+}
+
+// Window telemetry at the period set with 'devices -e', binary output only
+static void devices_tick(void) {
+    if (dev_emit_ms == 0 || output_format != OUTPUT_BINARY || uptime_ms() - dev_emit_last_ms < dev_emit_ms) {
+        return;
+    }
+    dev_emit_last_ms = uptime_ms();
+    xSemaphoreTake(out_mutex, portMAX_DELAY);
+    emit_device_windows(false, true);
+    xSemaphoreGive(out_mutex);
+}
+
+// Apply whatever the console has queued. Runs on the scan loop only.
+static void apply_controls(void) {
+    scan_ctl_t msg;
+
+    while (xQueueReceive(ctl_queue, &msg, 0) == pdTRUE) {
+        switch (msg.type) {
+        case CTL_MODE:
+            if (msg.mode == current_mode) break;
+            if (msg.mode == MODE_PACKET_RSSI_SCAN) {
+                ap_scan_stop();
+                header_printed_packet_rssi = false; // Allow header to be reprinted
+                ESP_LOGI(TAG, "Switched to Packet-based RSSI Scan Mode");
+            } else {
+                header_printed_ap = false; // Allow header to be reprinted
+                ESP_LOGI(TAG, "Switched to Access Point Scan Mode");
+            }
+            current_mode = msg.mode;
+            break;
+        case CTL_OUTPUT:
+            set_output_format(msg.output.format);
+            print_dist = msg.output.dist;
+            print_classes = msg.output.classes;
+            if (msg.output.quiet && !quiet_output) {
+                quiet_last_ms = uptime_ms();
+            }
+            quiet_output = msg.output.quiet;
+            break;
+        case CTL_SCHED:
+            scan_sched_set_config(&sched, &msg.sched);
+            ESP_LOGI(TAG, "Channel schedule: %s", scan_sched_policy_name(msg.sched.policy));
+            break;
+        case CTL_STATS:
+#if CONFIG_SCAN_PROF
+            if (msg.stats.emit_s >= 0) {
+                prof_emit_ms = (uint32_t)msg.stats.emit_s * 1000;
+            }
+#endif
+            xSemaphoreTake(out_mutex, portMAX_DELAY);
+            print_stats(&msg.stats);
+            xSemaphoreGive(out_mutex);
+            break;
+        case CTL_LOG:
+            if (log_enabled && !msg.log.enabled) {
+                xSemaphoreTake(log_mutex, portMAX_DELAY);
+                scan_flog_flush(&flog);
+                xSemaphoreGive(log_mutex);
+            }
+            log_enabled = msg.log.enabled;
+            log_interval_ms = msg.log.interval_s * 1000;
+            log_last_sweep_ms = uptime_ms() - log_interval_ms;  // Log the next sweep
+            log_last_flush_ms = uptime_ms();
+            ESP_LOGI(TAG, "Flash log %s", log_enabled ? "on" : "off");
+            break;
+        case CTL_SURVEY:
+            xSemaphoreTake(out_mutex, portMAX_DELAY);
+            survey_apply(&msg.survey);
+            xSemaphoreGive(out_mutex);
+            break;
+        case CTL_ANOMALY:
+            xSemaphoreTake(out_mutex, portMAX_DELAY);
+            anom.cfg = msg.anomaly;
+            scan_anom_report_print(&anom);
+            xSemaphoreGive(out_mutex);
+            break;
+        case CTL_DEVICES:
+            if (msg.devices_emit_s >= 0) {
+                dev_emit_ms = (uint32_t)msg.devices_emit_s * 1000;
+            }
+            xSemaphoreTake(out_mutex, portMAX_DELAY);
+            if (output_format == OUTPUT_BINARY) {
+                emit_device_windows(false, true);
+            } else {
+                print_devices();
+            }
+            xSemaphoreGive(out_mutex);
+            break;
+        case CTL_RADIO:
+            radio_want = msg.radio_phy;
+            radio_ack = true;
+            break;
+        }
+    }
+}
+
+// Hand the radio to the PHY tests or take it back, between sweeps. RF test
+// mode needs Wi-Fi stopped; coming back is the same as waking from a survey
+// sleep.
+static void radio_apply(void) {
+    if (!radio_ack) return;
+
+    if (radio_want && !radio_phy) {
+        ap_scan_stop();
+        ESP_ERROR_CHECK(esp_wifi_set_promiscuous(false));
+        ESP_ERROR_CHECK(esp_wifi_stop());
+        esp_wifi_power_domain_on();
+        esp_phy_rftest_config(1);
+        esp_phy_rftest_init();
+        ESP_LOGI(TAG, "Scanning paused, the radio is in RF test mode");
+    } else if (!radio_want && radio_phy) {
+        esp_phy_rftest_config(0);
+        esp_wifi_power_domain_off();
+        ESP_ERROR_CHECK(esp_wifi_start());
+        ESP_ERROR_CHECK(set_hw_filter(atomic_load(&active_filter)));
+        ESP_ERROR_CHECK(esp_wifi_set_promiscuous(true));
+        survey_wake_ms = uptime_ms();   // The pause is no survey awake time
+        ESP_LOGI(TAG, "Scanning resumed");
+    }
+    radio_phy = radio_want;
+    radio_ack = false;
+    xSemaphoreGive(radio_ack_sem);
+}
+
+// Wait ms while serving console requests. Returns false if one of them asked
+// for the sweep in progress to be abandoned.
+static bool scan_wait(uint32_t ms) {
+    const TickType_t start = xTaskGetTickCount();
+    const TickType_t ticks = pdMS_TO_TICKS(ms);
+
+    while (1) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        uint32_t bits = 0;
+
+        if (elapsed >= ticks || xTaskNotifyWait(0, UINT32_MAX, &bits, ticks - elapsed) == pdFALSE) {
+            return true;
+        }
+        apply_controls();
+        if (bits & SCAN_NOTIFY_ABORT) {
+            return false;
+        }
+    }
+}
+
+// Text report of a published sweep, on the writer task
+static void print_sweep(const scan_out_sweep_t *out) {
+    if (out->flags & SCAN_OUT_HEADER) {
+        scan_report_print_header();
+    }
+    scan_report_print(&out->sweep);
+    if (out->flags & SCAN_OUT_CLASSES) {
+        scan_class_report_print(&out->sweep);
+    }
+    if (out->flags & SCAN_OUT_DIST) {
+        scan_dist_report_print(&out->sweep, out->windows, out->nwindows);
+        scan_snr_report_print(&out->sweep);
+    }
+}
+
+// Console output blocks once the USB buffer is full, so this is timed as a
+// whole. The chip stays at full clock and awake until the sweep is out,
+// also between survey sweeps.
+static void write_sweep(const scan_out_sweep_t *out) {
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_acquire(pm_cpu_lock);
+    esp_pm_lock_acquire(pm_awake_lock);
+#endif
+    xSemaphoreTake(out_mutex, portMAX_DELAY);
+
+    SCAN_PROF_START(t0);
+    bool quiet = out->flags & SCAN_OUT_QUIET;
+    bool sweep_console = (out->flags & SCAN_OUT_BINARY) && !quiet;
+    if (sweep_console || (out->flags & SCAN_OUT_LOG)) {
+        // A busy sweep and the sketches after it take as many frames as they need
+        int next = 0;
+        do {
+            size_t len = scan_tlm_encode_sweep(out_frame, sizeof(out_frame), tlm_seq, out->time_ms, &out->sweep,
+                                               out->windows, out->nwindows, &next);
+            if (len == 0) break;
+            tlm_seq++;
+            emit_telemetry(out_frame, len, out->flags & SCAN_OUT_LOG, sweep_console);
+        } while (next != 0);
+
+        next = 0;
+        while (next < SCAN_DEV_SKETCHES) {
+            size_t len = scan_dev_encode(out_frame, sizeof(out_frame), tlm_seq, out->time_ms, out->sweep.iteration,
+                                         0, &out->devices, &next);
+            if (len == 0) break;
+            tlm_seq++;
+            emit_telemetry(out_frame, len, out->flags & SCAN_OUT_LOG, sweep_console);
+        }
+    }
+    if ((out->flags & SCAN_OUT_TEXT) && !quiet) {
+        print_sweep(out);
+    }
+
+    bool events_binary = (out->flags & SCAN_OUT_EVENTS) && (out->flags & SCAN_OUT_BINARY);
+    if (events_binary || (out->flags & SCAN_OUT_EVENT_LOG)) {
+        emit_telemetry(out_frame, scan_anom_encode(out_frame, sizeof(out_frame), tlm_seq++, out->time_ms,
+                                                   out->sweep.iteration, out->events_dropped, out->events,
+                                                   out->nevents),
+                       out->flags & SCAN_OUT_EVENT_LOG, events_binary);
+    }
+    if ((out->flags & SCAN_OUT_EVENTS) && (out->flags & SCAN_OUT_TEXT)) {
+        scan_anom_events_print(out->sweep.iteration, out->events, out->nevents);
+        if (out->events_dropped) {
+            printf("# %lu more events dropped\n", (unsigned long)out->events_dropped);
+        }
+    }
+    SCAN_PROF_STOP(&prof, SCAN_PROF_REPORT, t0);
+
+    xSemaphoreGive(out_mutex);
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_release(pm_awake_lock);
+    esp_pm_lock_release(pm_cpu_lock);
+#endif
+}
+
+// Writes whatever the scan loop has published, then waits for the next sweep
+static void out_writer_task(void *arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        const scan_out_sweep_t *out;
+        while ((out = scan_out_take(&sweep_out)) != NULL) {
+            write_sweep(out);
+            scan_out_release(&sweep_out, out);
+        }
+    }
+}
+
+static esp_err_t init_output(void) {
+    scan_out_init(&sweep_out);
+    out_mutex = xSemaphoreCreateMutex();
+    if (out_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t ret = xTaskCreatePinnedToCore(out_writer_task, "scan_out", 4096, NULL,
+                                             CONFIG_SCAN_OUT_TASK_PRIO, &out_task_handle,
+                                             CONFIG_SCAN_AGG_TASK_CORE);
+    return ret == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+// Hand the sweep in snap_sweep and its nevents anomaly events to the writer
+// with the current output settings. Never waits; a sweep the writer has not
+// started on is replaced, but its events are kept. In quiet output a sweep
+// with nothing to report and nothing to log is not published at all.
+static void publish_sweep(bool log_sweep, size_t nevents) {
+    uint32_t now = uptime_ms();
+    uint32_t flags = 0;
+
+    if (nevents > 0 || anom.dropped > 0) {
+        flags |= SCAN_OUT_EVENTS;
+        if (log_enabled) {
+            flags |= SCAN_OUT_EVENT_LOG;
+        }
+    }
+    if (quiet_output) {
+        flags |= SCAN_OUT_QUIET;
+        if (now - quiet_last_ms >= CONFIG_SCAN_HEARTBEAT_S * 1000) {
+            flags |= SCAN_OUT_EVENTS;
+        }
+        if (!(flags & SCAN_OUT_EVENTS) && !log_sweep) {
+            return;
+        }
+        if (flags & SCAN_OUT_EVENTS) {
+            quiet_last_ms = now;
+        }
+    }
+
+    uint32_t coalesced = sweep_out.coalesced;
+    scan_out_sweep_t *out = scan_out_begin(&sweep_out);
+    if (sweep_out.coalesced != coalesced) {
+        flags |= out->flags & (SCAN_OUT_EVENTS | SCAN_OUT_EVENT_LOG);
+    } else {
+        out->nevents = 0;
+        out->events_dropped = 0;
+    }
+    out->events_dropped += anom.dropped;
+    anom.dropped = 0;
+    for (size_t i = 0; i < nevents; i++) {
+        if (out->nevents < SCAN_ANOM_MAX_EVENTS) {
+            out->events[out->nevents++] = anom_events[i];
+        } else {
+            out->events_dropped++;
+        }
+    }
+
+    out->flags = flags;
+    if (output_format == OUTPUT_BINARY) {
+        out->flags |= SCAN_OUT_BINARY;
+    } else {
+        out->flags |= SCAN_OUT_TEXT;
+        if (!header_printed_packet_rssi && !quiet_output) {
+            out->flags |= SCAN_OUT_HEADER;
+            header_printed_packet_rssi = true;
+        }
+        if (print_classes) {
+            out->flags |= SCAN_OUT_CLASSES;
+        }
+        if (print_dist) {
+            out->flags |= SCAN_OUT_DIST;
+        }
+    }
+    if (log_sweep) {
+        out->flags |= SCAN_OUT_LOG;
     }
-    printf("Total APs found: %d\n", ap_count);
+    out->time_ms = now;
+    out->sweep = snap_sweep;
+    out->devices = snap_devices;
+    out->nwindows = NUM_WINDOWS;
+    for (size_t i = 0; i < NUM_WINDOWS; i++) {
+        scan_window_snapshot(windows[i], &out->windows[i]);
+    }
+
+    scan_out_publish(&sweep_out, out);
+    xTaskNotifyGive(out_task_handle);
+}
+
+void scan_packet_rssi(void) {
+    // Reset tracking arrays before new scan
+    aggregator_request(AGG_REQ_RESET);
+
+    // Visit the channels the scheduler picked for this sweep. A mode or
+    // schedule change drops the partial sweep; the next one starts from a reset.
+    scan_sched_plan_t plan;
+    scan_sched_plan(&sched, uptime_ms(), &plan);
+    for (int i = 0; i < plan.count; i++) {
+        ESP_ERROR_CHECK(esp_wifi_set_channel(plan.slots[i].channel, WIFI_SECOND_CHAN_NONE));
+        atomic_fetch_add(&hop_count, 1);
+        scan_sched_visit(&sched, plan.slots[i].channel, uptime_ms(), plan.slots[i].dwell_ms);
+        if (!scan_wait(plan.slots[i].dwell_ms)) { // Allow time for packet collection
+            return;
+        }
+    }
+
+    // Let the aggregator drain what is left in the ring and hand us a copy
+    aggregator_request(AGG_REQ_SNAPSHOT);
+
+    snap_sweep.iteration = ++sweep_count;
+    scan_sched_apply_dwell(&plan, &snap_sweep);
+    scan_sched_update(&sched, &snap_sweep);
+    scan_window_add(&win_1m, &snap_sweep, uptime_ms());
+    scan_window_add(&win_15m, &snap_sweep, uptime_ms());
+    for (size_t i = 0; i < sizeof(dev_windows) / sizeof(dev_windows[0]); i++) {
+        scan_dev_window_add(dev_windows[i], &snap_devices, uptime_ms());
+    }
+
+    xSemaphoreTake(airtime_mutex, portMAX_DELAY);
+    scan_airtime_hist_push(&airtime_hist, &snap_sweep);
+    xSemaphoreGive(airtime_mutex);
+
+    size_t nevents = scan_anom_update(&anom, &snap_sweep, anom_events, SCAN_ANOM_MAX_EVENTS);
+
+    // The log keeps one sweep per interval; the windows in it cover the sweeps in between
+    bool log_sweep = log_enabled && uptime_ms() - log_last_sweep_ms >= log_interval_ms;
+    if (log_sweep) {
+        log_last_sweep_ms = uptime_ms();
+    }
+    publish_sweep(log_sweep, nevents);
+
+    // The sweep's own sketches go with it; the windows are logged from here
+    if (log_sweep) {
+        xSemaphoreTake(out_mutex, portMAX_DELAY);
+        emit_device_windows(true, false);
+        xSemaphoreGive(out_mutex);
+    }
+}
+
+// Survey mode after a sweep: the radio goes off and the locks are dropped
+// until the next period starts, so FreeRTOS idle can put the chip into
+// light sleep. Console commands still wake the loop.
+static void survey_sleep(void) {
+    uint32_t sleep_ms = scan_survey_sweep_done(&survey, uptime_ms() - survey_wake_ms);
+
+    if (sleep_ms > 0) {
+        ESP_ERROR_CHECK(esp_wifi_set_promiscuous(false));
+        ESP_ERROR_CHECK(esp_wifi_stop());
+        atomic_store(&agg_idle, true);
+        survey_hold(false);
+
+        uint32_t start = uptime_ms();
+        scan_wait(sleep_ms);
+        scan_survey_slept(&survey, uptime_ms() - start);
+
+        // Waking up counts as awake time of the next sweep
+        survey_wake_ms = uptime_ms();
+        survey_hold(survey_cfg.enabled);
+        atomic_store(&agg_idle, false);
+        ESP_ERROR_CHECK(esp_wifi_start());
+        ESP_ERROR_CHECK(set_hw_filter(atomic_load(&active_filter)));
+        ESP_ERROR_CHECK(esp_wifi_set_promiscuous(true));
+        return;
+    }
+    survey_wake_ms = uptime_ms();
+}
+
+static esp_err_t init_power(void) {
+#if CONFIG_PM_ENABLE
+    esp_err_t err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "scan_cpu", &pm_cpu_lock);
+    if (err == ESP_OK) {
+        err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "scan_awake", &pm_awake_lock);
+    }
+    return err;
+#else
+    return ESP_OK;
+#endif
 }
 
 void app_main(void) {
+#if CONFIG_SCAN_PROF
+    // Before any task that records into a probe starts
+    scan_prof_init(&prof, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+#endif
+
     // Initialize NVS and WiFi
     ESP_ERROR_CHECK(init_nvs());
     ESP_ERROR_CHECK(init_wifi());
+    ESP_ERROR_CHECK(init_aggregator());
+    ESP_ERROR_CHECK(init_ap_scan());
+    ESP_ERROR_CHECK(init_devices());
+    ESP_ERROR_CHECK(init_log());
+    ESP_ERROR_CHECK(init_power());
+    ESP_ERROR_CHECK(init_output());
+
+    // Capture everything the scanner handles until the filter command says otherwise
+    scan_filter_config_t filter_default;
+    scan_filter_config_default(&filter_default);
+    ESP_ERROR_CHECK(scan_app_set_filter(&filter_default));
+
+    scan_sched_config_default(&ctl_sched);
+    scan_sched_init(&sched, &ctl_sched);
+    scan_window_init(&win_1m, 60 * 1000, 6);
+    scan_window_init(&win_15m, 15 * 60 * 1000, 5);
+    scan_anom_config_default(&ctl_anomaly);
+    scan_anom_init(&anom, &ctl_anomaly);
+
+    // This task is the scan loop; console commands reach it through ctl_queue
+    scan_task_handle = xTaskGetCurrentTaskHandle();
+    ctl_queue = xQueueCreate(CTL_QUEUE_LEN, sizeof(scan_ctl_t));
+    radio_mutex = xSemaphoreCreateMutex();
+    radio_ack_sem = xSemaphoreCreateBinary();
+    if (ctl_queue == NULL || radio_mutex == NULL || radio_ack_sem == NULL) {
+        ESP_ERROR_CHECK(ESP_ERR_NO_MEM);
+    }
+    start_console();
 
     // Enable promiscuous mode once for packet-based RSSI scan
     ESP_ERROR_CHECK(esp_wifi_set_promiscuous(true));
     ESP_ERROR_CHECK(esp_wifi_set_promiscuous_rx_cb((wifi_promiscuous_cb_t)wifi_sniffer_packet_handler));
 
     while (1) {
-        // Check for keystrokes
-        int ch = usb_serial_jtag_read_char();
-        if (ch != -1) {
-            if (ch == '1') {
-                current_mode = MODE_PACKET_RSSI_SCAN;
-                header_printed_packet_rssi = false; // Allow header to be reprinted
-                ESP_LOGI(TAG, "Switched to Packet-based RSSI Scan Mode");
-            } else if (ch == '2') {
-                current_mode = MODE_ACCESS_POINT_SCAN;
-                header_printed_ap = false; // Allow header to be reprinted
-                ESP_LOGI(TAG, "Switched to Access Point Scan Mode");
-            }
+        // Requests that arrived outside a dwell wait. Their notification is
+        // cleared first so it cannot cut the coming sweep short.
+        xTaskNotifyWait(0, UINT32_MAX, NULL, 0);
+        apply_controls();
+        radio_apply();
+
+        // While PHY tests hold the radio only console requests are served
+        if (radio_phy) {
+            log_tick();
+            scan_wait(1000);
+            continue;
         }
 
         // Perform scan based on current mode
@@ -249,8 +1924,19 @@ void app_main(void) {
                 break;
         }
 
-        // Delay between iterations
-        vTaskDelay(pdMS_TO_TICKS(CONFIG_SCAN_DELAY_MS));
+        log_tick();
+        devices_tick();
+#if CONFIG_SCAN_PROF
+        prof_tick();
+#endif
+
+        // Delay between iterations, or sleep until the next survey sweep
+        if (survey_cfg.enabled && current_mode == MODE_PACKET_RSSI_SCAN) {
+            survey_sleep();
+        } else if (current_mode != MODE_ACCESS_POINT_SCAN || !ap_scan_running) {
+            // A running AP scan has been waited for already
+            scan_wait(CONFIG_SCAN_DELAY_MS);
+        }
     }
 
     // Cleanup (unreachable in this implementation)
@@ -3,25 +3,115 @@
  *
  * SPDX-License-Identifier: Unlicense OR CC0-1.0
  */
+#include <string.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
 #include "esp_console.h"
+#include "esp_timer.h"
 #include "argtable3/argtable3.h"
 #include "esp_phy_cert_test.h"
 #include "cmd_phy.h"
+#include "scan_per.h"
+#include "cmd_scan.h"
 
 #define TAG "cmd_phy"
 
 #define CERT_TASK_PRIO 2
 
+// The worker runs every TX/RX test; its stack is sized for esp_phy_wifi_rx,
+// the hungriest of the test functions
+#define CERT_WORKER_STACK_SIZE (1024 * 20)
+#define CERT_WORKER_QUEUE_LEN  4
+
+// RX sweep defaults: longest listen per point, length of one RX run, and the
+// PER interval the point has to converge to
+#define RX_SWEEP_DEFAULT_DWELL_MS    5000
+#define RX_SWEEP_DEFAULT_INTERVAL_MS 250
+#define RX_SWEEP_DEFAULT_PRECISION   1.0
+#define RX_SWEEP_DEFAULT_CONFIDENCE  95
+#define RX_SWEEP_DEFAULT_MIN_PACKETS 100
+
+// How long an RX run may take to wind down after esp_phy_test_start_stop(0)
+#define RX_SWEEP_STOP_TIMEOUT_MS     1000
+
 #if CONFIG_ESP_PHY_ENABLE_CERT_TEST
 
+typedef enum {
+    CERT_CMD_WIFI_TX,
+    CERT_CMD_WIFI_RX,
+    CERT_CMD_BLE_TX,
+    CERT_CMD_BLE_RX,
+} cert_cmd_type_t;
+
+// A test run for the worker, copied into the queue so the next command cannot
+// change it under a running test
+typedef struct {
+    cert_cmd_type_t type;
+    int64_t entry_us;               // When the console handler was entered
+    uint32_t stops;                 // cert_stops when the run was queued
+    SemaphoreHandle_t done;         // Given when the run has returned, may be NULL
+    union {
+#if SOC_WIFI_SUPPORTED
+        phy_wifi_tx_s wifi_tx;
+        phy_wifi_rx_s wifi_rx;
+#endif
+#if SOC_BT_SUPPORTED
+        phy_ble_tx_s ble_tx;
+        phy_ble_rx_s ble_rx;
+#endif
+    } args;
+} cert_cmd_t;
+
+static const char *const cert_cmd_names[] = {
+    [CERT_CMD_WIFI_TX] = "wifi tx",
+    [CERT_CMD_WIFI_RX] = "wifi rx",
+    [CERT_CMD_BLE_TX]  = "ble tx",
+    [CERT_CMD_BLE_RX]  = "ble rx",
+};
+
+static StackType_t cert_worker_stack[CERT_WORKER_STACK_SIZE];
+static StaticTask_t cert_worker_tcb;
+static TaskHandle_t cert_worker_task;
+static uint8_t cert_queue_storage[CERT_WORKER_QUEUE_LEN * sizeof(cert_cmd_t)];
+static StaticQueue_t cert_queue_buf;
+static QueueHandle_t cert_queue;
+
+// Written by the worker, bar cert_rejected; cert_status reads them without locking
+static volatile bool cert_busy;
+static bool cert_holding;                   // The worker holds the radio, see scan_app_radio_hold
+static esp_phy_rx_result_t cert_rx_last;    // Taken when an RX run returned, before the radio went back
+static volatile cert_cmd_type_t cert_current;
+static uint32_t cert_runs;
+static uint32_t cert_rejected;
+static int64_t cert_latency_last_us;
+static int64_t cert_latency_max_us;
+static int64_t cert_latency_sum_us;
+
+// Stops asked for so far; each run notes the count it was queued at
+static atomic_uint cert_stops;
+
 static phy_args_t       phy_args;
+
+// A tone stays on until it is turned off, and holds the radio until then
+static bool tone_holding;
 #if SOC_WIFI_SUPPORTED
 static phy_wifi_tx_t    phy_wifi_tx_args;
 static phy_wifi_rx_t    phy_wifi_rx_args;
 static phy_wifiscwout_t phy_wifiscwout_args;
+static phy_wifi_rx_sweep_t phy_wifi_rx_sweep_args;
+
+// RX sweep state, the matrix is too large for a task stack
+static scan_per_sweep_t rx_sweep;
+static scan_per_target_t rx_sweep_target;
+static uint32_t rx_sweep_dwell_ms;
+static uint32_t rx_sweep_interval_ms;
+static volatile bool rx_sweep_running;
+static volatile bool rx_sweep_stop;
+static SemaphoreHandle_t rx_sweep_run_done;
 #endif
 #if SOC_BT_SUPPORTED
 static phy_ble_tx_t     phy_ble_tx_args;
@@ -29,6 +119,13 @@ static phy_ble_rx_t     phy_ble_rx_args;
 static phy_bt_tx_tone_t phy_bt_tx_tone_args;
 #endif
 
+// Stop the test that runs, or the one the worker is starting
+static void cert_stop(void)
+{
+    atomic_fetch_add(&cert_stops, 1);
+    esp_phy_test_start_stop(0);
+}
+
 #if CONFIG_ESP_PHY_LEGACY_COMMANDS
 #define arg_int0(_a, _b, _c, _d) arg_int0(NULL, NULL, _c, _d)
 #define arg_int1(_a, _b, _c, _d) arg_int1(NULL, NULL, _c, _d)
@@ -58,7 +155,13 @@ static int esp_phy_cmdstop_func(int argc, char **argv)
         return 1;
     }
 
-    esp_phy_test_start_stop(0);
+#if SOC_WIFI_SUPPORTED
+    // The sweep prints what it has measured so far once its current run ends
+    if (rx_sweep_running) {
+        rx_sweep_stop = true;
+    }
+#endif
+    cert_stop();
 
     return 0;
 }
@@ -72,7 +175,13 @@ static int esp_phy_get_rx_result_func(int argc, char **argv)
         return 1;
     }
 
-    esp_phy_get_rx_result(&rx_result);
+    // A run that has ended gave the radio back, which may have cleared the
+    // counters, so its figures are the ones the worker kept
+    if (cert_busy) {
+        esp_phy_get_rx_result(&rx_result);
+    } else {
+        rx_result = cert_rx_last;
+    }
 
     ESP_LOGI(TAG, "Desired: %lu, Correct: %lu, RSSI: %d, flag: %lu", rx_result.phy_rx_total_count,
                 rx_result.phy_rx_correct_count, rx_result.phy_rx_rssi, rx_result.phy_rx_result_flag);
@@ -80,23 +189,191 @@ static int esp_phy_get_rx_result_func(int argc, char **argv)
     return 0;
 }
 
+// Hold the radio for a tone being turned on, let it go once it is off
+static void tone_hold(bool on)
+{
+    if (on && !tone_holding) {
+        scan_app_radio_hold();
+    } else if (!on && tone_holding) {
+        scan_app_radio_release();
+    }
+    tone_holding = on;
+}
+
+// End of a run: the radio goes back to the scanner unless another run is queued
+static void cert_worker_done(const cert_cmd_t *cmd)
+{
+    cert_busy = false;
+    if (uxQueueMessagesWaiting(cert_queue) == 0) {
+        scan_app_radio_release();
+        cert_holding = false;
+    }
+    if (cmd->done) {
+        xSemaphoreGive(cmd->done);
+    }
+}
+
+// Runs the TX/RX tests one at a time. The test functions do not return until
+// the test is stopped, so the worker stays busy for as long as a test runs.
+// The scanner is paused from the first run until the queue is empty again.
+static void cert_worker(void *arg)
+{
+    cert_cmd_t cmd;
+
+    while (1) {
+        xQueueReceive(cert_queue, &cmd, portMAX_DELAY);
+        cert_current = cmd.type;
+        cert_busy = true;
+        if (!cert_holding) {
+            scan_app_radio_hold();
+            cert_holding = true;
+        }
+
+        // A stop or a newer run that came in before the start would be lost
+        // once the test is running, so the run is dropped instead
+        esp_phy_test_start_stop(3);
+        if (atomic_load(&cert_stops) != cmd.stops || uxQueueMessagesWaiting(cert_queue) > 0) {
+            esp_phy_test_start_stop(0);
+            cert_worker_done(&cmd);
+            continue;
+        }
+
+        int64_t latency = esp_timer_get_time() - cmd.entry_us;
+        cert_latency_last_us = latency;
+        cert_latency_sum_us += latency;
+        if (latency > cert_latency_max_us) {
+            cert_latency_max_us = latency;
+        }
+        cert_runs++;
+
+        switch (cmd.type) {
 #if SOC_WIFI_SUPPORTED
-void cert_wifi_tx(void *arg)
+        case CERT_CMD_WIFI_TX: {
+            phy_wifi_tx_s *tx = &cmd.args.wifi_tx;
+            esp_phy_wifi_tx(tx->channel, tx->rate, tx->backoff, tx->length_byte, tx->packet_delay, tx->packet_num);
+            break;
+        }
+        case CERT_CMD_WIFI_RX:
+            esp_phy_wifi_rx(cmd.args.wifi_rx.channel, cmd.args.wifi_rx.rate);
+            break;
+#endif
+#if SOC_BT_SUPPORTED
+        case CERT_CMD_BLE_TX: {
+            phy_ble_tx_s *tx = &cmd.args.ble_tx;
+            esp_phy_ble_tx(tx->txpwr, tx->channel, tx->len, tx->data_type, tx->syncw, tx->rate, tx->tx_num_in);
+            break;
+        }
+        case CERT_CMD_BLE_RX:
+            esp_phy_ble_rx(cmd.args.ble_rx.channel, cmd.args.ble_rx.syncw, cmd.args.ble_rx.rate);
+            break;
+#endif
+        default:
+            break;
+        }
+
+        if (cmd.type == CERT_CMD_WIFI_RX || cmd.type == CERT_CMD_BLE_RX) {
+            esp_phy_get_rx_result(&cert_rx_last);
+        }
+        cert_worker_done(&cmd);
+    }
+}
+
+// Queue a test run for the worker. A test that is still running is stopped
+// first so the new one takes its place, as it did with a task per command.
+static bool cert_worker_post(cert_cmd_type_t type, const void *args, size_t len, int64_t entry_us,
+                             SemaphoreHandle_t done)
 {
-    phy_wifi_tx_s *cmd  = (phy_wifi_tx_s*)arg;
+    cert_cmd_t cmd = {
+        .type = type,
+        .entry_us = entry_us,
+        .done = done,
+    };
 
-    esp_phy_test_start_stop(3);
-    esp_phy_wifi_tx(cmd->channel, cmd->rate, cmd->backoff, cmd->length_byte, cmd->packet_delay, cmd->packet_num);
+    memcpy(&cmd.args, args, len);
+    if (cert_busy) {
+        cert_stop();
+    }
+    cmd.stops = atomic_load(&cert_stops);
+    if (xQueueSend(cert_queue, &cmd, 0) != pdTRUE) {
+        cert_rejected++;
+        ESP_LOGW(TAG, "PHY worker is not keeping up, %s dropped", cert_cmd_names[type]);
+        return false;
+    }
+    return true;
+}
 
-    vTaskDelete(NULL);
+static int esp_phy_cert_status_func(int argc, char **argv)
+{
+    printf("PHY worker: %s%s, %lu runs, %lu dropped, stack %lu bytes free\n",
+           cert_busy ? "running " : "idle", cert_busy ? cert_cmd_names[cert_current] : "",
+           (unsigned long)cert_runs, (unsigned long)cert_rejected,
+           (unsigned long)uxTaskGetStackHighWaterMark(cert_worker_task));
+    if (cert_runs) {
+        printf("Command to radio start: last %lld us, mean %lld us, worst %lld us\n", (long long)cert_latency_last_us,
+               (long long)(cert_latency_sum_us / cert_runs), (long long)cert_latency_max_us);
+    }
+    return 0;
 }
 
-void cert_wifi_rx(void *arg)
+#if SOC_WIFI_SUPPORTED
+// Measure one point in runs of rx_sweep_interval_ms until its PER has
+// converged or the dwell is used up. Returns false if the sweep must end.
+static bool cert_wifi_rx_sweep_point(uint8_t channel, uint8_t rate, scan_per_point_t *pt)
 {
-    phy_wifi_rx_s *cmd  = (phy_wifi_rx_s*)arg;
+    phy_wifi_rx_s cmd;
+    esp_phy_rx_result_t rx_result;
 
-    esp_phy_test_start_stop(3);
-    esp_phy_wifi_rx(cmd->channel, cmd->rate);
+    cmd.channel = channel;
+    cmd.rate = rate;
+    while (!rx_sweep_stop && pt->elapsed_ms < rx_sweep_dwell_ms) {
+        uint32_t run_ms = rx_sweep_dwell_ms - pt->elapsed_ms;
+        if (run_ms > rx_sweep_interval_ms) {
+            run_ms = rx_sweep_interval_ms;
+        }
+
+        if (!cert_worker_post(CERT_CMD_WIFI_RX, &cmd, sizeof(cmd), esp_timer_get_time(), rx_sweep_run_done)) {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(run_ms));
+        cert_stop();
+        if (xSemaphoreTake(rx_sweep_run_done, pdMS_TO_TICKS(RX_SWEEP_STOP_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGE(TAG, "RX run on channel %u did not stop", channel);
+            return false;
+        }
+
+        esp_phy_get_rx_result(&rx_result);
+        scan_per_add(pt, rx_result.phy_rx_total_count, rx_result.phy_rx_correct_count, rx_result.phy_rx_rssi, run_ms);
+        if (scan_per_converged(pt, &rx_sweep_target)) {
+            pt->done = true;
+            break;
+        }
+    }
+    return !rx_sweep_stop;
+}
+
+// The radio is held for the whole sweep, so the scanner does not come back
+// between the runs and every count comes from the PHY in RF test mode
+static void cert_wifi_rx_sweep(void *arg)
+{
+    scan_app_radio_hold();
+    for (int c = 0; c < rx_sweep.nchan; c++) {
+        for (int r = 0; r < rx_sweep.nrate; r++) {
+            scan_per_point_t *pt = &rx_sweep.points[c][r];
+            bool more = cert_wifi_rx_sweep_point(rx_sweep.channels[c], rx_sweep.rates[r], pt);
+
+            ESP_LOGI(TAG, "chan=%u, rate=%s, desired=%lu, correct=%lu, %lu ms%s", rx_sweep.channels[c],
+                     scan_per_rate_name(rx_sweep.rates[r]), (unsigned long)pt->desired,
+                     (unsigned long)pt->correct, (unsigned long)pt->elapsed_ms,
+                     pt->done ? "" : ", not converged");
+            if (!more) {
+                goto out;
+            }
+        }
+    }
+out:
+    scan_app_radio_release();
+    scan_per_matrix_print(&rx_sweep);
+    rx_sweep_running = false;
 
     vTaskDelete(NULL);
 }
@@ -118,7 +395,8 @@ static int esp_phy_cbw40m_en_func(int argc, char **argv)
 
 static int esp_phy_wifi_tx_func(int argc, char **argv)
 {
-    static phy_wifi_tx_s cmd;
+    int64_t entry_us = esp_timer_get_time();
+    phy_wifi_tx_s cmd;
     int nerrors = arg_parse(argc, argv, (void **) &phy_wifi_tx_args);
     if (nerrors != 0) {
         arg_print_errors(stderr, phy_wifi_tx_args.end, argv[0]);
@@ -167,14 +445,13 @@ static int esp_phy_wifi_tx_func(int argc, char **argv)
         ESP_LOGW(TAG, "Default packet_num is 0");
     }
 
-    xTaskCreate(cert_wifi_tx, "cert_wifi_tx", 1024 * 10, (void *)&cmd, CERT_TASK_PRIO, NULL);
-
-    return 0;
+    return cert_worker_post(CERT_CMD_WIFI_TX, &cmd, sizeof(cmd), entry_us, NULL) ? 0 : 1;
 }
 
 static int esp_phy_wifi_rx_func(int argc, char **argv)
 {
-    static phy_wifi_rx_s cmd;
+    int64_t entry_us = esp_timer_get_time();
+    phy_wifi_rx_s cmd;
     int nerrors = arg_parse(argc, argv, (void **) &phy_wifi_rx_args);
     if (nerrors != 0) {
         arg_print_errors(stderr, phy_wifi_rx_args.end, argv[0]);
@@ -195,7 +472,82 @@ static int esp_phy_wifi_rx_func(int argc, char **argv)
         ESP_LOGW(TAG, "Default rate is PHY_RATE_1M");
     }
 
-    xTaskCreate(cert_wifi_rx, "cert_wifi_rx", 1024 * 20, (void *)&cmd, CERT_TASK_PRIO, NULL);
+    return cert_worker_post(CERT_CMD_WIFI_RX, &cmd, sizeof(cmd), entry_us, NULL) ? 0 : 1;
+}
+
+static int esp_phy_wifi_rx_sweep_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &phy_wifi_rx_sweep_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, phy_wifi_rx_sweep_args.end, argv[0]);
+        return 1;
+    }
+
+    if (rx_sweep_running) {
+        ESP_LOGW(TAG, "RX sweep already running, cmdstop ends it");
+        return 1;
+    }
+
+    memset(&rx_sweep, 0, sizeof(rx_sweep));
+    if (!scan_per_parse_channels(phy_wifi_rx_sweep_args.channels->sval[0], &rx_sweep)) {
+        ESP_LOGW(TAG, "Channels must be a list of 1~14 or all");
+        return 1;
+    }
+    if (!scan_per_parse_rates(phy_wifi_rx_sweep_args.rates->sval[0], &rx_sweep)) {
+        ESP_LOGW(TAG, "Rates must be a list of rate codes or names (1M, 54M, MCS7) or all");
+        return 1;
+    }
+
+    int dwell = RX_SWEEP_DEFAULT_DWELL_MS;
+    if (phy_wifi_rx_sweep_args.dwell->count == 1) {
+        dwell = phy_wifi_rx_sweep_args.dwell->ival[0];
+    }
+    int interval = RX_SWEEP_DEFAULT_INTERVAL_MS;
+    if (phy_wifi_rx_sweep_args.interval->count == 1) {
+        interval = phy_wifi_rx_sweep_args.interval->ival[0];
+    }
+    if (interval < 10 || dwell < interval) {
+        ESP_LOGW(TAG, "Need 10 <= interval <= dwell");
+        return 1;
+    }
+
+    double precision = RX_SWEEP_DEFAULT_PRECISION;
+    if (phy_wifi_rx_sweep_args.precision->count == 1) {
+        precision = phy_wifi_rx_sweep_args.precision->dval[0];
+    }
+    int confidence = RX_SWEEP_DEFAULT_CONFIDENCE;
+    if (phy_wifi_rx_sweep_args.confidence->count == 1) {
+        confidence = phy_wifi_rx_sweep_args.confidence->ival[0];
+    }
+    int min_packets = RX_SWEEP_DEFAULT_MIN_PACKETS;
+    if (phy_wifi_rx_sweep_args.min_packets->count == 1) {
+        min_packets = phy_wifi_rx_sweep_args.min_packets->ival[0];
+    }
+    if (min_packets < 0 ||
+        !scan_per_target_init(&rx_sweep_target, confidence, (float)precision, (uint32_t)min_packets)) {
+        ESP_LOGW(TAG, "Confidence must be 80, 90, 95, 98 or 99, precision 0~50 %%");
+        return 1;
+    }
+
+    if (rx_sweep_run_done == NULL) {
+        rx_sweep_run_done = xSemaphoreCreateBinary();
+        if (rx_sweep_run_done == NULL) {
+            return 1;
+        }
+    }
+    xSemaphoreTake(rx_sweep_run_done, 0);
+    rx_sweep_dwell_ms = dwell;
+    rx_sweep_interval_ms = interval;
+    rx_sweep_stop = false;
+    rx_sweep_running = true;
+
+    ESP_LOGI(TAG, "Wifi rx sweep: %d channels x %d rates, dwell=%d, interval=%d, PER +-%.1f%% at %d%%",
+             rx_sweep.nchan, rx_sweep.nrate, dwell, interval, precision, confidence);
+    if (xTaskCreate(cert_wifi_rx_sweep, "cert_rx_sweep", 4096, NULL, CERT_TASK_PRIO, NULL) != pdPASS) {
+        rx_sweep_running = false;
+        return 1;
+    }
+
     return 0;
 }
 
@@ -231,36 +583,23 @@ static int esp_phy_wifiscwout_func(int argc, char **argv)
         ESP_LOGW(TAG, "Default attenuation is 0");
     }
 
+    if (enable) {
+        tone_hold(true);
+    }
     esp_phy_wifi_tx_tone(enable, channel, attenuation);
+    if (!enable) {
+        tone_hold(false);
+    }
 
     return 0;
 }
 #endif
 
 #if SOC_BT_SUPPORTED
-void cert_ble_tx(void *arg)
-{
-    phy_ble_tx_s *cmd = (phy_ble_tx_s *)arg;
-
-    esp_phy_test_start_stop(3);
-    esp_phy_ble_tx(cmd->txpwr, cmd->channel, cmd->len, cmd->data_type, cmd->syncw, cmd->rate, cmd->tx_num_in);
-
-    vTaskDelete(NULL);
-}
-
-void cert_ble_rx(void *arg)
-{
-    phy_ble_rx_s *cmd = (phy_ble_rx_s *)arg;
-
-    esp_phy_test_start_stop(3);
-    esp_phy_ble_rx(cmd->channel, cmd->syncw, cmd->rate);
-
-    vTaskDelete(NULL);
-}
-
 static int esp_phy_ble_tx_func(int argc, char **argv)
 {
-    static phy_ble_tx_s cmd;
+    int64_t entry_us = esp_timer_get_time();
+    phy_ble_tx_s cmd;
     int nerrors = arg_parse(argc, argv, (void **) &phy_ble_tx_args);
     if (nerrors != 0) {
         arg_print_errors(stderr, phy_ble_tx_args.end, argv[0]);
@@ -316,14 +655,13 @@ static int esp_phy_ble_tx_func(int argc, char **argv)
         ESP_LOGW(TAG, "Default tx_num_in is 0");
     }
 
-    xTaskCreate(cert_ble_tx, "cert_ble_tx", 4096, (void *)&cmd, CERT_TASK_PRIO, NULL);
-
-    return 0;
+    return cert_worker_post(CERT_CMD_BLE_TX, &cmd, sizeof(cmd), entry_us, NULL) ? 0 : 1;
 }
 
 static int esp_phy_ble_rx_func(int argc, char **argv)
 {
-    static phy_ble_rx_s cmd;
+    int64_t entry_us = esp_timer_get_time();
+    phy_ble_rx_s cmd;
     int nerrors = arg_parse(argc, argv, (void **) &phy_ble_rx_args);
     if (nerrors != 0) {
         arg_print_errors(stderr, phy_ble_rx_args.end, argv[0]);
@@ -351,9 +689,7 @@ static int esp_phy_ble_rx_func(int argc, char **argv)
         ESP_LOGW(TAG, "Default rate is PHY_BLE_RATE_1M");
     }
 
-    xTaskCreate(cert_ble_rx, "cert_ble_rx", 4096, (void *)&cmd, CERT_TASK_PRIO, NULL);
-
-    return 0;
+    return cert_worker_post(CERT_CMD_BLE_RX, &cmd, sizeof(cmd), entry_us, NULL) ? 0 : 1;
 }
 
 static int esp_phy_bt_tx_tone_func(int argc, char **argv)
@@ -388,7 +724,13 @@ static int esp_phy_bt_tx_tone_func(int argc, char **argv)
         ESP_LOGW(TAG, "Default backoff is 0");
     }
 
+    if (start) {
+        tone_hold(true);
+    }
     esp_phy_bt_tx_tone(start, channel, attenuation);
+    if (!start) {
+        tone_hold(false);
+    }
 
     return 0;
 }
@@ -396,6 +738,10 @@ static int esp_phy_bt_tx_tone_func(int argc, char **argv)
 
 void register_phy_cmd(void)
 {
+    cert_queue = xQueueCreateStatic(CERT_WORKER_QUEUE_LEN, sizeof(cert_cmd_t), cert_queue_storage, &cert_queue_buf);
+    cert_worker_task = xTaskCreateStatic(cert_worker, "cert_worker", CERT_WORKER_STACK_SIZE, NULL, CERT_TASK_PRIO,
+                                         cert_worker_stack, &cert_worker_tcb);
+
     phy_args.enable  = arg_int0(NULL, NULL, "<enable>", "enable");
     phy_args.end = arg_end(1);
 
@@ -426,6 +772,15 @@ void register_phy_cmd(void)
     };
     ESP_ERROR_CHECK( esp_console_cmd_register(&get_rx_result) );
 
+    const esp_console_cmd_t cert_status_cmd = {
+        .command = "cert_status",
+        .help = "Show the PHY test worker state and the delay from command to radio start",
+        .hint = NULL,
+        .func = &esp_phy_cert_status_func,
+        .argtable = NULL
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cert_status_cmd) );
+
 #if SOC_WIFI_SUPPORTED
     const esp_console_cmd_t cbw40m_cmd = {
         .command = "cbw40m_en",
@@ -466,6 +821,24 @@ void register_phy_cmd(void)
     };
     ESP_ERROR_CHECK( esp_console_cmd_register(&esp_rx_cmd) );
 
+    phy_wifi_rx_sweep_args.channels    = arg_str1("n", "channels"   , "<ch,...|all>"  , "channels to test, 1~14");
+    phy_wifi_rx_sweep_args.rates       = arg_str1("r", "rates"      , "<rate,...|all>", "rate codes or names, e.g. 0x0,6M,MCS7");
+    phy_wifi_rx_sweep_args.dwell       = arg_int0("t", "dwell"      , "<ms>"          , "longest listen per point, default 5000");
+    phy_wifi_rx_sweep_args.interval    = arg_int0("i", "interval"   , "<ms>"          , "counter sampling interval, default 250");
+    phy_wifi_rx_sweep_args.precision   = arg_dbl0("e", "precision"  , "<percent>"     , "stop once PER is known to +-this, default 1");
+    phy_wifi_rx_sweep_args.confidence  = arg_int0("z", "confidence" , "<percent>"     , "confidence level 80/90/95/98/99, default 95");
+    phy_wifi_rx_sweep_args.min_packets = arg_int0("m", "min_packets", "<count>"       , "packets needed before stopping early, default 100");
+    phy_wifi_rx_sweep_args.end         = arg_end(1);
+
+    const esp_console_cmd_t esp_rx_sweep_cmd = {
+        .command = "esp_rx_sweep",
+        .help = "WiFi RX PER sweep over channels and rates, cmdstop ends it early",
+        .hint = NULL,
+        .func = &esp_phy_wifi_rx_sweep_func,
+        .argtable = &phy_wifi_rx_sweep_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&esp_rx_sweep_cmd) );
+
     phy_wifiscwout_args.enable      = arg_int0("e", "start"      , "<start>"      , "enable CW");
     phy_wifiscwout_args.channel     = arg_int0("c", "channel"    , "<channel>"    , "channel setting, 1~14");
     phy_wifiscwout_args.attenuation = arg_int0("p", "attenuation", "<attenuation>", "Transmit power attenuation");
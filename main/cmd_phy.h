@@ -53,6 +53,17 @@ typedef struct {
     uint32_t channel;
     esp_phy_wifi_rate_t rate;
 } phy_wifi_rx_s;
+
+typedef struct {
+    struct arg_str *channels;
+    struct arg_str *rates;
+    struct arg_int *dwell;
+    struct arg_int *interval;
+    struct arg_dbl *precision;
+    struct arg_int *confidence;
+    struct arg_int *min_packets;
+    struct arg_end *end;
+} phy_wifi_rx_sweep_t;
 #endif
 
 #if SOC_BT_SUPPORTED
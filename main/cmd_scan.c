@@ -0,0 +1,950 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_console.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "argtable3/argtable3.h"
+#include "cmd_scan.h"
+#include "scan_pcap.h"
+
+#define TAG "cmd_scan"
+
+#define STA_DEFAULT_COUNT 20
+#define AIRTIME_DEFAULT_COUNT 10
+#define BEACONS_DEFAULT_COUNT 20
+#define TOP_DEFAULT_COUNT 5
+
+// Longest log time in seconds whose milliseconds still fit a uint32_t
+#define LOG_MAX_S ((int)(UINT32_MAX / 1000))
+
+static scan_sta_args_t sta_args;
+static scan_airtime_args_t airtime_args;
+static scan_top_args_t top_args;
+static scan_beacons_args_t beacons_args;
+static scan_filter_args_t filter_args;
+static scan_mode_args_t mode_args;
+static scan_output_args_t output_args;
+static scan_plan_args_t plan_args;
+static scan_dwell_args_t dwell_args;
+static scan_stats_args_t stats_args;
+static scan_log_args_t log_args;
+static scan_capture_args_t capture_args;
+static scan_survey_args_t survey_args;
+static scan_anomaly_args_t anomaly_args;
+static scan_devices_args_t devices_args;
+
+static scan_top_entry_t top_list[CONFIG_SCAN_TOP_COUNTERS];
+
+// Snapshot and sort buffers are too large for the console task stack and
+// only live for one command, so they come from the heap, in PSRAM if present
+static void *snap_alloc(size_t size)
+{
+    void *p = NULL;
+
+#if CONFIG_SPIRAM
+    p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+#endif
+    if (p == NULL) {
+        p = heap_caps_malloc(size, MALLOC_CAP_DEFAULT);
+    }
+    if (p == NULL) {
+        ESP_LOGW(TAG, "No memory for a %u byte snapshot", (unsigned)size);
+    }
+    return p;
+}
+
+static int scan_sta_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &sta_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, sta_args.end, argv[0]);
+        return 1;
+    }
+
+    int count = STA_DEFAULT_COUNT;
+    if (sta_args.count->count == 1) {
+        count = sta_args.count->ival[0];
+        if (count < 1 || count > SCAN_STA_MAX_ENTRIES) {
+            ESP_LOGW(TAG, "Count must be 1~%d", SCAN_STA_MAX_ENTRIES);
+            return 1;
+        }
+    }
+
+    scan_sta_order_t order = SCAN_STA_BY_FRAMES;
+    if (sta_args.order->count == 1) {
+        const char *name = sta_args.order->sval[0];
+        if (strcmp(name, "frames") == 0) {
+            order = SCAN_STA_BY_FRAMES;
+        } else if (strcmp(name, "rssi") == 0) {
+            order = SCAN_STA_BY_RSSI;
+        } else if (strcmp(name, "recent") == 0) {
+            order = SCAN_STA_BY_RECENT;
+        } else {
+            ESP_LOGW(TAG, "Unknown order '%s', use frames, rssi or recent", name);
+            return 1;
+        }
+    }
+
+    scan_sta_table_t *snap = snap_alloc(sizeof(*snap));
+    scan_sta_t *top = snap ? snap_alloc(SCAN_STA_MAX_ENTRIES * sizeof(*top)) : NULL;
+    if (top == NULL) {
+        free(snap);
+        return 1;
+    }
+    scan_app_get_stations(snap);
+    size_t n = scan_sta_top(snap, order, top, (size_t)count);
+    scan_sta_report_print(snap, top, n, (uint32_t)(esp_timer_get_time() / 1000));
+    free(top);
+    free(snap);
+
+    return 0;
+}
+
+static int scan_beacons_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &beacons_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, beacons_args.end, argv[0]);
+        return 1;
+    }
+
+    int count = BEACONS_DEFAULT_COUNT;
+    if (beacons_args.count->count == 1) {
+        count = beacons_args.count->ival[0];
+        if (count < 1 || count > CONFIG_SCAN_BCN_TABLE_SIZE) {
+            ESP_LOGW(TAG, "Count must be 1~%d", CONFIG_SCAN_BCN_TABLE_SIZE);
+            return 1;
+        }
+    }
+
+    scan_bcn_table_t *snap = snap_alloc(sizeof(*snap));
+    if (snap == NULL) {
+        return 1;
+    }
+    scan_app_get_beacons(snap);
+    scan_bcn_report_print(snap, (size_t)count, (uint32_t)(esp_timer_get_time() / 1000));
+    free(snap);
+
+    return 0;
+}
+
+static int scan_airtime_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &airtime_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, airtime_args.end, argv[0]);
+        return 1;
+    }
+
+    int count = AIRTIME_DEFAULT_COUNT;
+    if (airtime_args.count->count == 1) {
+        count = airtime_args.count->ival[0];
+        if (count < 1 || count > CONFIG_SCAN_AIRTIME_HISTORY) {
+            ESP_LOGW(TAG, "Count must be 1~%d", CONFIG_SCAN_AIRTIME_HISTORY);
+            return 1;
+        }
+    }
+
+    scan_airtime_hist_t *snap = snap_alloc(sizeof(*snap));
+    if (snap == NULL) {
+        return 1;
+    }
+    scan_app_get_airtime(snap);
+    scan_airtime_hist_print(snap, count);
+    free(snap);
+
+    return 0;
+}
+
+static void print_top(const char *by, int channel, const scan_top_t *s, const char *unit, int count)
+{
+    char title[48];
+
+    if (s->total == 0) {
+        return;
+    }
+    snprintf(title, sizeof(title), "Top talkers on channel %d by %s", channel, by);
+    size_t n = scan_top_list(s, top_list, (size_t)count);
+    scan_top_report_print(title, s, top_list, n, unit);
+}
+
+static int scan_top_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &top_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, top_args.end, argv[0]);
+        return 1;
+    }
+
+    int first = 1;
+    int last = CONFIG_MAX_WIFI_CHANNELS;
+    if (top_args.channel->count == 1) {
+        first = last = top_args.channel->ival[0];
+        if (first < 1 || first > CONFIG_MAX_WIFI_CHANNELS) {
+            ESP_LOGW(TAG, "Channel must be 1~%d", CONFIG_MAX_WIFI_CHANNELS);
+            return 1;
+        }
+    }
+
+    int count = TOP_DEFAULT_COUNT;
+    if (top_args.count->count == 1) {
+        count = top_args.count->ival[0];
+        if (count < 1 || count > CONFIG_SCAN_TOP_COUNTERS) {
+            ESP_LOGW(TAG, "Count must be 1~%d", CONFIG_SCAN_TOP_COUNTERS);
+            return 1;
+        }
+    }
+
+    bool by_frames = true;
+    bool by_airtime = true;
+    if (top_args.order->count == 1) {
+        const char *name = top_args.order->sval[0];
+        if (strcmp(name, "frames") == 0) {
+            by_airtime = false;
+        } else if (strcmp(name, "airtime") == 0) {
+            by_frames = false;
+        } else {
+            ESP_LOGW(TAG, "Unknown order '%s', use frames or airtime", name);
+            return 1;
+        }
+    }
+
+    scan_talkers_t *snap = snap_alloc(sizeof(*snap));
+    if (snap == NULL) {
+        return 1;
+    }
+    scan_app_get_talkers(snap, top_args.reset->count > 0);
+    for (int channel = first; channel <= last; channel++) {
+        if (by_frames) {
+            print_top("frames", channel, &snap->frames[channel - 1], "frames", count);
+        }
+        if (by_airtime) {
+            print_top("airtime", channel, &snap->airtime[channel - 1], "us", count);
+        }
+    }
+    free(snap);
+
+    return 0;
+}
+
+static bool add_macs(struct arg_str *arg, uint8_t list[][6], uint8_t *count)
+{
+    for (int i = 0; i < arg->count; i++) {
+        uint8_t mac[6];
+        if (!scan_filter_parse_mac(arg->sval[i], mac)) {
+            ESP_LOGW(TAG, "Bad MAC address '%s', use aa:bb:cc:dd:ee:ff", arg->sval[i]);
+            return false;
+        }
+        if (!scan_filter_add_mac(list, count, mac)) {
+            ESP_LOGW(TAG, "At most %d addresses per list", CONFIG_SCAN_FILTER_MAX_MACS);
+            return false;
+        }
+    }
+    return true;
+}
+
+static int scan_filter_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &filter_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, filter_args.end, argv[0]);
+        return 1;
+    }
+
+    scan_filter_config_t cfg;
+    const scan_filter_t *filter;
+    scan_app_get_filter(&cfg, &filter);
+
+    bool changed = false;
+    if (filter_args.clear->count) {
+        scan_filter_config_default(&cfg);
+        changed = true;
+    }
+    if (filter_args.classes->count == 1) {
+        if (!scan_filter_parse_classes(filter_args.classes->sval[0], &cfg.classes)) {
+            ESP_LOGW(TAG, "Unknown frame class in '%s'", filter_args.classes->sval[0]);
+            return 1;
+        }
+        changed = true;
+    }
+    if (filter_args.rssi->count == 1) {
+        const char *text = filter_args.rssi->sval[0];
+        char *end;
+        long rssi = strtol(text, &end, 10);
+        if (strcmp(text, "off") == 0) {
+            cfg.min_rssi = SCAN_FILTER_RSSI_OFF;
+        } else if (*end != '\0' || end == text || rssi < -127 || rssi > 0) {
+            ESP_LOGW(TAG, "RSSI must be -127~0 or off");
+            return 1;
+        } else {
+            cfg.min_rssi = (int8_t)rssi;
+        }
+        changed = true;
+    }
+    if (filter_args.allow->count || filter_args.deny->count) {
+        if (!add_macs(filter_args.allow, cfg.allow, &cfg.nallow) ||
+            !add_macs(filter_args.deny, cfg.deny, &cfg.ndeny)) {
+            return 1;
+        }
+        changed = true;
+    }
+
+    if (changed) {
+        esp_err_t err = scan_app_set_filter(&cfg);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Promiscuous filter rejected: %s", esp_err_to_name(err));
+            return 1;
+        }
+        scan_app_get_filter(&cfg, &filter);
+    }
+    scan_filter_report_print(&cfg, filter);
+
+    return 0;
+}
+
+static const char *mode_name(operation_mode_t mode)
+{
+    return mode == MODE_PACKET_RSSI_SCAN ? "rssi" : "ap";
+}
+
+static int scan_mode_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &mode_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, mode_args.end, argv[0]);
+        return 1;
+    }
+
+    if (mode_args.mode->count == 1) {
+        const char *name = mode_args.mode->sval[0];
+        if (strcmp(name, "rssi") == 0) {
+            scan_app_set_mode(MODE_PACKET_RSSI_SCAN);
+        } else if (strcmp(name, "ap") == 0) {
+            scan_app_set_mode(MODE_ACCESS_POINT_SCAN);
+        } else {
+            ESP_LOGW(TAG, "Unknown mode '%s', use rssi or ap", name);
+            return 1;
+        }
+    }
+    printf("mode %s\n", mode_name(scan_app_get_mode()));
+
+    return 0;
+}
+
+static bool parse_on_off(struct arg_str *arg, bool *value)
+{
+    if (arg->count == 0) {
+        return true;
+    }
+    if (strcmp(arg->sval[0], "on") == 0) {
+        *value = true;
+    } else if (strcmp(arg->sval[0], "off") == 0) {
+        *value = false;
+    } else {
+        ESP_LOGW(TAG, "Use on or off, not '%s'", arg->sval[0]);
+        return false;
+    }
+    return true;
+}
+
+static int scan_output_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &output_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, output_args.end, argv[0]);
+        return 1;
+    }
+
+    scan_output_t out;
+    scan_app_get_output(&out);
+
+    if (output_args.format->count == 1) {
+        const char *name = output_args.format->sval[0];
+        if (strcmp(name, "text") == 0) {
+            out.format = OUTPUT_TEXT;
+        } else if (strcmp(name, "binary") == 0) {
+            out.format = OUTPUT_BINARY;
+        } else {
+            ESP_LOGW(TAG, "Unknown format '%s', use text or binary", name);
+            return 1;
+        }
+    }
+    if (!parse_on_off(output_args.dist, &out.dist) || !parse_on_off(output_args.classes, &out.classes) ||
+        !parse_on_off(output_args.quiet, &out.quiet)) {
+        return 1;
+    }
+    if (output_args.format->count || output_args.dist->count || output_args.classes->count ||
+        output_args.quiet->count) {
+        scan_app_set_output(&out);
+    }
+    printf("format %s, dist %s, classes %s, quiet %s\n", out.format == OUTPUT_BINARY ? "binary" : "text",
+           out.dist ? "on" : "off", out.classes ? "on" : "off", out.quiet ? "on" : "off");
+
+    return 0;
+}
+
+static void print_sched(const scan_sched_config_t *cfg)
+{
+    printf("policy %s, budget %lu ms, min dwell %lu ms, max revisit %lu ms, priority",
+           scan_sched_policy_name(cfg->policy), (unsigned long)cfg->budget_ms,
+           (unsigned long)cfg->min_dwell_ms, (unsigned long)cfg->max_revisit_ms);
+    for (int i = 0; i < cfg->priority_count; i++) {
+        printf("%c%d", i ? ',' : ' ', cfg->priority[i]);
+    }
+    printf("\n");
+}
+
+static bool parse_channels(const char *text, scan_sched_config_t *cfg)
+{
+    uint8_t channels[CONFIG_MAX_WIFI_CHANNELS];
+    int count = 0;
+    const char *p = text;
+
+    while (*p) {
+        char *end;
+        long ch = strtol(p, &end, 10);
+        if (end == p || (*end != ',' && *end != '\0') || ch < 1 || ch > CONFIG_MAX_WIFI_CHANNELS) {
+            ESP_LOGW(TAG, "Channels must be a list of 1~%d, e.g. 1,6,11", CONFIG_MAX_WIFI_CHANNELS);
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            if (channels[i] == ch) {
+                ESP_LOGW(TAG, "Channel %ld listed twice", ch);
+                return false;
+            }
+        }
+        channels[count++] = (uint8_t)ch;
+        p = *end == ',' ? end + 1 : end;
+    }
+    if (count == 0) {
+        ESP_LOGW(TAG, "No channels given");
+        return false;
+    }
+    memcpy(cfg->priority, channels, (size_t)count);
+    cfg->priority_count = count;
+    return true;
+}
+
+static int scan_plan_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &plan_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, plan_args.end, argv[0]);
+        return 1;
+    }
+
+    scan_sched_config_t cfg;
+    scan_app_get_sched(&cfg);
+
+    if (plan_args.policy->count == 1) {
+        const char *name = plan_args.policy->sval[0];
+        int p;
+        for (p = SCAN_SCHED_FIXED; p <= SCAN_SCHED_PRIORITY; p++) {
+            if (strcmp(name, scan_sched_policy_name(p)) == 0) {
+                break;
+            }
+        }
+        if (p > SCAN_SCHED_PRIORITY) {
+            ESP_LOGW(TAG, "Unknown policy '%s', use fixed, proportional or priority", name);
+            return 1;
+        }
+        cfg.policy = p;
+    }
+    if (plan_args.channels->count == 1 && !parse_channels(plan_args.channels->sval[0], &cfg)) {
+        return 1;
+    }
+    if (plan_args.policy->count || plan_args.channels->count) {
+        scan_app_set_sched(&cfg);
+    }
+    print_sched(&cfg);
+
+    return 0;
+}
+
+static int scan_dwell_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &dwell_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, dwell_args.end, argv[0]);
+        return 1;
+    }
+
+    scan_sched_config_t cfg;
+    scan_app_get_sched(&cfg);
+
+    if (dwell_args.budget->count == 1) {
+        cfg.budget_ms = (uint32_t)dwell_args.budget->ival[0];
+    }
+    if (dwell_args.min_dwell->count == 1) {
+        cfg.min_dwell_ms = (uint32_t)dwell_args.min_dwell->ival[0];
+    }
+    if (dwell_args.max_revisit->count == 1) {
+        cfg.max_revisit_ms = (uint32_t)dwell_args.max_revisit->ival[0];
+    }
+    // A dwell slot is a uint16_t waited out in ticks, so a visit shorter than
+    // one tick would not listen at all, and the budget has to cover one visit
+    if (cfg.min_dwell_ms < portTICK_PERIOD_MS || cfg.min_dwell_ms > UINT16_MAX || cfg.budget_ms < cfg.min_dwell_ms ||
+        cfg.budget_ms > UINT16_MAX || cfg.max_revisit_ms < cfg.budget_ms) {
+        ESP_LOGW(TAG, "Need %lu (one tick) <= min dwell <= budget <= %d and budget <= max revisit",
+                 (unsigned long)portTICK_PERIOD_MS, UINT16_MAX);
+        return 1;
+    }
+    if (dwell_args.budget->count || dwell_args.min_dwell->count || dwell_args.max_revisit->count) {
+        scan_app_set_sched(&cfg);
+    }
+    print_sched(&cfg);
+
+    return 0;
+}
+
+static int scan_stats_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &stats_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, stats_args.end, argv[0]);
+        return 1;
+    }
+
+    scan_stats_opts_t opts = {
+        .hist = stats_args.hist->count > 0,
+        .driver = stats_args.driver->count > 0,
+        .emit_s = -1,
+    };
+    if (stats_args.emit->count == 1) {
+        if (stats_args.emit->ival[0] < 0 || stats_args.emit->ival[0] > 3600) {
+            ESP_LOGW(TAG, "Emit period must be 0~3600 s");
+            return 1;
+        }
+        opts.emit_s = stats_args.emit->ival[0];
+    }
+    scan_app_request_stats(&opts);
+    return 0;
+}
+
+static void print_log_config(const scan_log_config_t *cfg)
+{
+    printf("flash log %s, one sweep every %lu s\n", cfg->enabled ? "on" : "off", (unsigned long)cfg->interval_s);
+}
+
+static int scan_log_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &log_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, log_args.end, argv[0]);
+        return 1;
+    }
+
+    scan_log_config_t cfg;
+    esp_err_t err = scan_app_get_log(&cfg);
+    const char *action = log_args.action->count ? log_args.action->sval[0] : "status";
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No flash log partition in this build");
+        return 1;
+    }
+
+    if (strcmp(action, "status") == 0) {
+        print_log_config(&cfg);
+    } else if (strcmp(action, "start") == 0 || strcmp(action, "stop") == 0) {
+        cfg.enabled = strcmp(action, "start") == 0;
+        if (log_args.interval->count == 1) {
+            if (log_args.interval->ival[0] < 0 || log_args.interval->ival[0] > LOG_MAX_S) {
+                ESP_LOGW(TAG, "Interval must be 0~%d s", LOG_MAX_S);
+                return 1;
+            }
+            cfg.interval_s = (uint32_t)log_args.interval->ival[0];
+        }
+        err = scan_app_set_log(&cfg);
+        print_log_config(&cfg);
+    } else if (strcmp(action, "info") == 0) {
+        err = scan_app_log_info();
+    } else if (strcmp(action, "dump") == 0) {
+        // Range checked before scaling, so no time wraps around
+        if ((log_args.from->count && (log_args.from->ival[0] < 0 || log_args.from->ival[0] > LOG_MAX_S)) ||
+            (log_args.to->count && (log_args.to->ival[0] < 0 || log_args.to->ival[0] > LOG_MAX_S))) {
+            ESP_LOGW(TAG, "Times must be 0~%d s", LOG_MAX_S);
+            return 1;
+        }
+        scan_log_range_t range = {
+            .all_boots = log_args.boot->count == 0,
+            .boot = log_args.boot->count ? (uint32_t)log_args.boot->ival[0] : 0,
+            .from_ms = log_args.from->count ? (uint32_t)log_args.from->ival[0] * 1000 : 0,
+            .to_ms = log_args.to->count ? (uint32_t)log_args.to->ival[0] * 1000 : UINT32_MAX,
+        };
+        if (range.from_ms > range.to_ms) {
+            ESP_LOGW(TAG, "Need from <= to");
+            return 1;
+        }
+        err = scan_app_log_dump(&range);
+    } else if (strcmp(action, "erase") == 0) {
+        err = scan_app_log_erase();
+    } else {
+        ESP_LOGW(TAG, "Unknown action '%s', use start, stop, info, dump or erase", action);
+        return 1;
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "log %s failed: %s", action, esp_err_to_name(err));
+        return 1;
+    }
+    return 0;
+}
+
+static void print_capture(const scan_capture_status_t *st)
+{
+    printf("capture %s, snaplen %u, ring %lu/%lu bytes, %lu frames captured, %lu dropped, %lu sent\n",
+           st->running ? "on" : "off", st->snaplen, (unsigned long)st->ring_fill, (unsigned long)st->ring_size,
+           (unsigned long)st->captured, (unsigned long)st->dropped, (unsigned long)st->frames);
+}
+
+static int scan_capture_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &capture_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, capture_args.end, argv[0]);
+        return 1;
+    }
+
+    scan_capture_status_t st;
+    const char *action = capture_args.action->count ? capture_args.action->sval[0] : "status";
+    esp_err_t err = ESP_OK;
+
+    scan_app_get_capture(&st);
+    if (strcmp(action, "start") == 0) {
+        int snaplen = capture_args.snaplen->count ? capture_args.snaplen->ival[0] : st.snaplen;
+        if (snaplen < 1 || snaplen > SCAN_PCAP_MAX_SNAPLEN) {
+            ESP_LOGW(TAG, "Snap length must be 1~%d bytes", SCAN_PCAP_MAX_SNAPLEN);
+            return 1;
+        }
+        err = scan_app_capture_start((uint16_t)snaplen);
+    } else if (strcmp(action, "stop") == 0) {
+        err = scan_app_capture_stop();
+    } else if (strcmp(action, "status") != 0) {
+        ESP_LOGW(TAG, "Unknown action '%s', use start or stop", action);
+        return 1;
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "capture %s failed: %s", action, esp_err_to_name(err));
+        return 1;
+    }
+    scan_app_get_capture(&st);
+    print_capture(&st);
+    return 0;
+}
+
+static int scan_survey_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &survey_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, survey_args.end, argv[0]);
+        return 1;
+    }
+
+    // A bare query must not wake a sleeping survey or cut its sweep short
+    if (survey_args.action->count == 0 && survey_args.period->count == 0) {
+        scan_app_request_survey();
+        return 0;
+    }
+
+    scan_survey_config_t cfg;
+    scan_app_get_survey(&cfg);
+    if (survey_args.action->count) {
+        const char *action = survey_args.action->sval[0];
+        if (strcmp(action, "on") != 0 && strcmp(action, "off") != 0) {
+            ESP_LOGW(TAG, "Unknown action '%s', use on or off", action);
+            return 1;
+        }
+        cfg.enabled = strcmp(action, "on") == 0;
+    }
+    if (survey_args.period->count == 1) {
+        if (survey_args.period->ival[0] < 1000 || survey_args.period->ival[0] > 24 * 3600 * 1000) {
+            ESP_LOGW(TAG, "Period must be 1000~%d ms", 24 * 3600 * 1000);
+            return 1;
+        }
+        cfg.period_ms = (uint32_t)survey_args.period->ival[0];
+    }
+
+    esp_err_t err = scan_app_set_survey(&cfg);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "survey failed: %s", esp_err_to_name(err));
+        return 1;
+    }
+    return 0;
+}
+
+static int scan_anomaly_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &anomaly_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, anomaly_args.end, argv[0]);
+        return 1;
+    }
+
+    scan_anom_config_t cfg;
+    scan_app_get_anomaly(&cfg);
+    if (anomaly_args.spike->count == 1) {
+        double z = anomaly_args.spike->dval[0];
+        if (z < 1.0 || z > 20.0) {
+            ESP_LOGW(TAG, "Spike threshold must be 1~20");
+            return 1;
+        }
+        cfg.z_spike = (float)z;
+    }
+    if (anomaly_args.shift->count == 1) {
+        double z = anomaly_args.shift->dval[0];
+        if (z < 0.5 || z > 20.0) {
+            ESP_LOGW(TAG, "Shift threshold must be 0.5~20");
+            return 1;
+        }
+        cfg.z_shift = (float)z;
+    }
+    if (anomaly_args.sustain->count == 1) {
+        int sustain = anomaly_args.sustain->ival[0];
+        if (sustain < 1 || sustain > UINT8_MAX) {
+            ESP_LOGW(TAG, "Sustain must be 1~%d sweeps", UINT8_MAX);
+            return 1;
+        }
+        cfg.sustain = (uint8_t)sustain;
+    }
+
+    scan_app_set_anomaly(&cfg);
+    return 0;
+}
+
+static int scan_devices_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &devices_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, devices_args.end, argv[0]);
+        return 1;
+    }
+
+    int32_t emit_s = -1;
+    if (devices_args.emit->count == 1) {
+        if (devices_args.emit->ival[0] < 0 || devices_args.emit->ival[0] > 3600) {
+            ESP_LOGW(TAG, "Emit period must be 0~3600 s");
+            return 1;
+        }
+        emit_s = devices_args.emit->ival[0];
+    }
+    scan_app_request_devices(emit_s);
+    return 0;
+}
+
+void register_scan_cmd(void)
+{
+    sta_args.count = arg_int0("n", "count", "<count>", "Number of stations to list, default 20");
+    sta_args.order = arg_str0("s", "sort", "<frames|rssi|recent>", "Sort order, default frames");
+    sta_args.end   = arg_end(1);
+
+    const esp_console_cmd_t sta_cmd = {
+        .command = "sta",
+        .help = "List transmitters heard in packet RSSI scan mode",
+        .hint = NULL,
+        .func = &scan_sta_func,
+        .argtable = &sta_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&sta_cmd) );
+
+    beacons_args.count = arg_int0("n", "count", "<count>", "Number of access points to list, default 20");
+    beacons_args.end   = arg_end(1);
+
+    const esp_console_cmd_t beacons_cmd = {
+        .command = "beacons",
+        .help = "Beacon timing per access point in packet RSSI scan mode, highest loss first",
+        .hint = NULL,
+        .func = &scan_beacons_func,
+        .argtable = &beacons_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&beacons_cmd) );
+
+    airtime_args.count = arg_int0("n", "count", "<count>", "Number of sweeps to list, default 10");
+    airtime_args.end   = arg_end(1);
+
+    const esp_console_cmd_t airtime_cmd = {
+        .command = "airtime",
+        .help = "Show per-channel utilization of recent packet RSSI sweeps",
+        .hint = NULL,
+        .func = &scan_airtime_func,
+        .argtable = &airtime_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&airtime_cmd) );
+
+    top_args.channel = arg_int0("c", "channel", "<1~13>", "Only this channel");
+    top_args.count   = arg_int0("n", "count", "<count>", "Talkers per channel, default 5");
+    top_args.order   = arg_str0("s", "sort", "<frames|airtime>", "Only this ranking, default both");
+    top_args.reset   = arg_lit0("r", "reset", "Start counting afresh after this report");
+    top_args.end     = arg_end(4);
+
+    const esp_console_cmd_t top_cmd = {
+        .command = "top",
+        .help = "Heaviest transmitters per channel by frames and by estimated airtime since\n"
+                "boot or the last reset, with the error bound of each count",
+        .hint = NULL,
+        .func = &scan_top_func,
+        .argtable = &top_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&top_cmd) );
+
+    filter_args.classes = arg_str0("t", "types", "<class,...>", "Frame classes to capture, e.g. beacon,probe_req or all");
+    filter_args.rssi    = arg_str0("r", "rssi", "<dBm|off>", "Drop frames below this RSSI");
+    filter_args.allow   = arg_strn("a", "allow", "<mac>", 0, CONFIG_SCAN_FILTER_MAX_MACS, "Only capture frames from this transmitter");
+    filter_args.deny    = arg_strn("x", "deny", "<mac>", 0, CONFIG_SCAN_FILTER_MAX_MACS, "Never capture frames from this transmitter");
+    filter_args.clear   = arg_lit0("c", "clear", "Reset to capturing everything, applied before other options");
+    filter_args.end     = arg_end(4);
+
+    const esp_console_cmd_t filter_cmd = {
+        .command = "filter",
+        .help = "Show or change the packet RSSI capture filter and its per-stage reject counters",
+        .hint = NULL,
+        .func = &scan_filter_func,
+        .argtable = &filter_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&filter_cmd) );
+
+    mode_args.mode = arg_str0(NULL, NULL, "<rssi|ap>", "Packet RSSI sweeps or access point survey");
+    mode_args.end  = arg_end(1);
+
+    const esp_console_cmd_t mode_cmd = {
+        .command = "mode",
+        .help = "Show or switch the scan mode, ends the sweep in progress",
+        .hint = NULL,
+        .func = &scan_mode_func,
+        .argtable = &mode_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&mode_cmd) );
+
+    output_args.format  = arg_str0("f", "format", "<text|binary>", "Text tables or framed binary telemetry");
+    output_args.dist    = arg_str0("d", "dist", "<on|off>", "RSSI distributions under each sweep");
+    output_args.classes = arg_str0("c", "classes", "<on|off>", "Frame class breakdown under each sweep");
+    output_args.quiet   = arg_str0("q", "quiet", "<on|off>", "Only anomaly events, and a heartbeat when idle");
+    output_args.end     = arg_end(4);
+
+    const esp_console_cmd_t output_cmd = {
+        .command = "output",
+        .help = "Show or change what is printed after each scan",
+        .hint = NULL,
+        .func = &scan_output_func,
+        .argtable = &output_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&output_cmd) );
+
+    plan_args.policy   = arg_str0("p", "policy", "<fixed|proportional|priority>", "How the sweep budget is divided");
+    plan_args.channels = arg_str0("c", "channels", "<ch,...>", "Channels favoured by the priority policy");
+    plan_args.end      = arg_end(2);
+
+    const esp_console_cmd_t plan_cmd = {
+        .command = "plan",
+        .help = "Show or change the channel plan, ends the sweep in progress",
+        .hint = NULL,
+        .func = &scan_plan_func,
+        .argtable = &plan_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&plan_cmd) );
+
+    dwell_args.budget      = arg_int0("b", "budget", "<ms>", "Listening time per sweep");
+    dwell_args.min_dwell   = arg_int0("m", "min", "<ms>", "Shortest visit to a channel");
+    dwell_args.max_revisit = arg_int0("r", "revisit", "<ms>", "Longest time a channel may go unvisited");
+    dwell_args.end         = arg_end(3);
+
+    const esp_console_cmd_t dwell_cmd = {
+        .command = "dwell",
+        .help = "Show or change the sweep timing, ends the sweep in progress",
+        .hint = NULL,
+        .func = &scan_dwell_func,
+        .argtable = &dwell_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&dwell_cmd) );
+
+    stats_args.hist   = arg_lit0("H", "hist", "Add the latency histogram of each hot-path probe");
+    stats_args.driver = arg_lit0("d", "driver", "Dump the Wi-Fi driver's buffer and RX/TX counters to the log");
+    stats_args.emit   = arg_int0("e", "emit", "<s>", "Send stats telemetry this often in binary output, 0 to stop");
+    stats_args.end    = arg_end(3);
+
+    const esp_console_cmd_t stats_cmd = {
+        .command = "stats",
+        .help = "Print scanner status, hot-path timing since the last stats, task load and\n"
+                "per-channel hop statistics",
+        .hint = NULL,
+        .func = &scan_stats_func,
+        .argtable = &stats_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&stats_cmd) );
+
+    log_args.action   = arg_str0(NULL, NULL, "<start|stop|info|dump|erase>", "Show the settings if omitted");
+    log_args.interval = arg_int0("i", "interval", "<s>", "start/stop: time between logged sweeps");
+    log_args.boot     = arg_int0("b", "boot", "<n>", "dump: only this boot, as listed by info");
+    log_args.from     = arg_int0("s", "from", "<s>", "dump: records from this many seconds after boot");
+    log_args.to       = arg_int0("e", "to", "<s>", "dump: records up to this many seconds after boot");
+    log_args.end      = arg_end(4);
+
+    const esp_console_cmd_t log_cmd = {
+        .command = "log",
+        .help = "Record sweeps and AP changes to the flash log, list what it holds, or dump it as binary telemetry",
+        .hint = NULL,
+        .func = &scan_log_func,
+        .argtable = &log_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&log_cmd) );
+
+    capture_args.action  = arg_str0(NULL, NULL, "<start|stop>", "Show the capture state if omitted");
+    capture_args.snaplen = arg_int0("s", "snaplen", "<bytes>", "start: bytes kept of each frame");
+    capture_args.end     = arg_end(2);
+
+    const esp_console_cmd_t capture_cmd = {
+        .command = "capture",
+        .help = "Stream frames accepted by the filter to the host as pcap records in binary telemetry\n"
+                "(packet RSSI mode only). Receive them with scanee_pcap.",
+        .hint = NULL,
+        .func = &scan_capture_func,
+        .argtable = &capture_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&capture_cmd) );
+
+    survey_args.action = arg_str0(NULL, NULL, "<on|off>", "Show the duty-cycle figures if omitted");
+    survey_args.period = arg_int0("p", "period", "<ms>", "Time from one sweep start to the next");
+    survey_args.end    = arg_end(2);
+
+    const esp_console_cmd_t survey_cmd = {
+        .command = "survey",
+        .help = "Low-power survey: one packet RSSI sweep per period at full clock, radio off and\n"
+                "light sleep in between. Prints awake and sleep time per sweep and the duty cycle.",
+        .hint = NULL,
+        .func = &scan_survey_func,
+        .argtable = &survey_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&survey_cmd) );
+
+    anomaly_args.spike   = arg_dbl0("z", "spike", "<z>", "Standard deviations off the baseline for a spike");
+    anomaly_args.shift   = arg_dbl0("s", "shift", "<z>", "Standard deviations off the baseline for a shift");
+    anomaly_args.sustain = arg_int0("n", "sustain", "<sweeps>", "Sweeps in a row beyond the shift threshold");
+    anomaly_args.end     = arg_end(3);
+
+    const esp_console_cmd_t anomaly_cmd = {
+        .command = "anomaly",
+        .help = "Show or change the anomaly detection thresholds, with the learnt per-channel\n"
+                "baselines. Events follow each sweep; output -q on prints nothing else.",
+        .hint = NULL,
+        .func = &scan_anomaly_func,
+        .argtable = &anomaly_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&anomaly_cmd) );
+
+    devices_args.emit = arg_int0("e", "emit", "<s>", "Send the window sketches this often in binary output, 0 to stop");
+    devices_args.end  = arg_end(2);
+
+    const esp_console_cmd_t devices_cmd = {
+        .command = "devices",
+        .help = "Distinct transmitters per channel over the last sweep, minute, quarter hour\n"
+                "and hour, estimated from HyperLogLog sketches, and the probe request sources.\n"
+                "In binary output the window sketches are sent as telemetry instead.",
+        .hint = NULL,
+        .func = &scan_devices_func,
+        .argtable = &devices_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&devices_cmd) );
+}
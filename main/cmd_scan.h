@@ -0,0 +1,246 @@
+#pragma once
+
+#include "scan_sta.h"
+#include "scan_bcn.h"
+#include "scan_airtime.h"
+#include "scan_filter.h"
+#include "scan_sched.h"
+#include "scan_survey.h"
+#include "scan_anom.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Define operation modes
+typedef enum {
+    MODE_PACKET_RSSI_SCAN,
+    MODE_ACCESS_POINT_SCAN
+} operation_mode_t;
+
+// Output formats for scan results
+typedef enum {
+    OUTPUT_TEXT,      // Human-readable tables
+    OUTPUT_BINARY     // Framed telemetry, see scan_telemetry.h
+} output_format_t;
+
+// What the scan loop prints after each sweep
+typedef struct {
+    output_format_t format;
+    bool dist;        // RSSI distributions, text output only
+    bool classes;     // Frame class breakdown, text output only
+    bool quiet;       // Anomaly events and heartbeats only, see scan_anom.h
+} scan_output_t;
+
+// Flash log of telemetry frames, see scan_flog.h
+typedef struct {
+    bool enabled;
+    uint32_t interval_s;  // Shortest time between logged sweeps, AP changes are always logged
+} scan_log_config_t;
+
+// Records a log dump sends: one boot or all, and a time since that boot
+typedef struct {
+    bool all_boots;
+    uint32_t boot;
+    uint32_t from_ms;
+    uint32_t to_ms;
+} scan_log_range_t;
+
+// Frame capture state, see scan_pcap.h
+typedef struct {
+    bool running;
+    uint16_t snaplen;
+    uint32_t ring_size;   // Bytes
+    uint32_t ring_fill;
+    uint32_t captured;    // Frames since the capture started
+    uint32_t dropped;     // Frames lost to a full ring
+    uint32_t frames;      // Telemetry frames sent
+} scan_capture_status_t;
+
+// Extras of a stats request. Hot-path figures cover the time since the previous request.
+typedef struct {
+    bool hist;            // Latency histograms of the hot-path probes
+    bool driver;          // Wi-Fi driver buffer and RX/TX counters, dumped to the log
+    int32_t emit_s;       // Send SCAN_TLM_STATS every emit_s seconds in binary output, 0 off, -1 unchanged
+} scan_stats_opts_t;
+
+typedef struct {
+    struct arg_str *mode;
+    struct arg_end *end;
+} scan_mode_args_t;
+
+typedef struct {
+    struct arg_str *format;
+    struct arg_str *dist;
+    struct arg_str *classes;
+    struct arg_str *quiet;
+    struct arg_end *end;
+} scan_output_args_t;
+
+typedef struct {
+    struct arg_str *policy;
+    struct arg_str *channels;
+    struct arg_end *end;
+} scan_plan_args_t;
+
+typedef struct {
+    struct arg_int *budget;
+    struct arg_int *min_dwell;
+    struct arg_int *max_revisit;
+    struct arg_end *end;
+} scan_dwell_args_t;
+
+typedef struct {
+    struct arg_int *count;
+    struct arg_str *order;
+    struct arg_end *end;
+} scan_sta_args_t;
+
+typedef struct {
+    struct arg_int *count;
+    struct arg_end *end;
+} scan_airtime_args_t;
+
+typedef struct {
+    struct arg_int *channel;
+    struct arg_int *count;
+    struct arg_str *order;
+    struct arg_lit *reset;
+    struct arg_end *end;
+} scan_top_args_t;
+
+typedef struct {
+    struct arg_int *count;
+    struct arg_end *end;
+} scan_beacons_args_t;
+
+typedef struct {
+    struct arg_str *classes;
+    struct arg_str *rssi;
+    struct arg_str *allow;
+    struct arg_str *deny;
+    struct arg_lit *clear;
+    struct arg_end *end;
+} scan_filter_args_t;
+
+typedef struct {
+    struct arg_lit *hist;
+    struct arg_lit *driver;
+    struct arg_int *emit;
+    struct arg_end *end;
+} scan_stats_args_t;
+
+typedef struct {
+    struct arg_str *action;
+    struct arg_int *interval;
+    struct arg_int *boot;
+    struct arg_int *from;
+    struct arg_int *to;
+    struct arg_end *end;
+} scan_log_args_t;
+
+typedef struct {
+    struct arg_str *action;
+    struct arg_int *snaplen;
+    struct arg_end *end;
+} scan_capture_args_t;
+
+typedef struct {
+    struct arg_str *action;
+    struct arg_int *period;
+    struct arg_end *end;
+} scan_survey_args_t;
+
+typedef struct {
+    struct arg_dbl *spike;
+    struct arg_dbl *shift;
+    struct arg_int *sustain;
+    struct arg_end *end;
+} scan_anomaly_args_t;
+
+typedef struct {
+    struct arg_int *emit;
+    struct arg_end *end;
+} scan_devices_args_t;
+
+void register_scan_cmd(void);
+
+// Provided by the scanner application: consistent copy of the station table
+void scan_app_get_stations(scan_sta_table_t *out);
+
+// Provided by the scanner application: consistent copy of the beacon timing table
+void scan_app_get_beacons(scan_bcn_table_t *out);
+
+// Provided by the scanner application: copy of the top talker summaries,
+// started afresh after the copy if reset is set
+void scan_app_get_talkers(scan_talkers_t *out, bool reset);
+
+// Provided by the scanner application: copy of the channel utilization history
+void scan_app_get_airtime(scan_airtime_hist_t *out);
+
+// Provided by the scanner application: capture filter and its counters
+esp_err_t scan_app_set_filter(const scan_filter_config_t *cfg);
+void scan_app_get_filter(scan_filter_config_t *cfg, const scan_filter_t **filter);
+
+// Provided by the scanner application: settings owned by the scan loop. The
+// setters queue the change and return; mode and schedule changes cut the
+// sweep in progress short within its current dwell slot.
+operation_mode_t scan_app_get_mode(void);
+void scan_app_set_mode(operation_mode_t mode);
+void scan_app_get_output(scan_output_t *out);
+void scan_app_set_output(const scan_output_t *out);
+void scan_app_get_sched(scan_sched_config_t *cfg);
+void scan_app_set_sched(const scan_sched_config_t *cfg);
+
+// Provided by the scanner application: status summary, hot-path timing and
+// task load, printed by the scan loop
+void scan_app_request_stats(const scan_stats_opts_t *opts);
+
+// Provided by the scanner application: the flash log. The setter fails with
+// ESP_ERR_NOT_FOUND when there is no log partition. Dumps send the stored
+// frames to the console as binary telemetry.
+esp_err_t scan_app_get_log(scan_log_config_t *cfg);
+esp_err_t scan_app_set_log(const scan_log_config_t *cfg);
+esp_err_t scan_app_log_info(void);
+esp_err_t scan_app_log_dump(const scan_log_range_t *range);
+esp_err_t scan_app_log_erase(void);
+
+// Provided by the scanner application: frame capture to the console as
+// SCAN_TLM_PCAP telemetry. Starting a running capture changes its snap length.
+esp_err_t scan_app_capture_start(uint16_t snaplen);
+esp_err_t scan_app_capture_stop(void);
+void scan_app_get_capture(scan_capture_status_t *st);
+
+// Provided by the scanner application: low-power survey mode, see
+// scan_survey.h. The setter fails with ESP_ERR_NOT_SUPPORTED when power
+// management is not built in; otherwise the scan loop applies the change,
+// ending the sweep or sleep in progress, and prints the duty-cycle figures.
+// The request only prints them and leaves the sweep or sleep alone.
+void scan_app_get_survey(scan_survey_config_t *cfg);
+esp_err_t scan_app_set_survey(const scan_survey_config_t *cfg);
+void scan_app_request_survey(void);
+
+// Provided by the scanner application: anomaly detection thresholds. The
+// scan loop applies them and prints the thresholds and baselines, which is
+// also what setting the current thresholds again does.
+void scan_app_get_anomaly(scan_anom_config_t *cfg);
+void scan_app_set_anomaly(const scan_anom_config_t *cfg);
+
+// Provided by the scanner application: distinct transmitters per channel over
+// the last sweep, minute, quarter hour and hour, printed by the scan loop. In
+// binary output the window sketches are sent instead, and every emit_s
+// seconds if that is above 0; -1 leaves the period unchanged.
+void scan_app_request_devices(int32_t emit_s);
+
+// Provided by the scanner application: the radio for PHY tests. The first
+// hold pauses the scan loop: the sweep in progress ends, promiscuous mode
+// goes off, Wi-Fi stops and the PHY enters RF test mode. Holds nest, and the
+// last release brings Wi-Fi back and scanning goes on. Both return once the
+// scan loop has done so; never call them from the scan loop.
+void scan_app_radio_hold(void);
+void scan_app_radio_release(void);
+
+#ifdef __cplusplus
+}
+#endif
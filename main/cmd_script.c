@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_console.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "argtable3/argtable3.h"
+#include "esp_phy_cert_test.h"
+#include "cmd_script.h"
+#include "cmd_scan.h"
+
+#define TAG "cmd_script"
+
+// Scripts are NVS blobs keyed by name; the boot entry holds the name of the
+// script to run at startup and cannot clash because names never start with '.'
+#define SCRIPT_NAMESPACE "script"
+#define SCRIPT_BOOT_KEY  ".boot"
+#define SCRIPT_NAME_MAX  15
+
+static scan_script_args_t script_args;
+
+// Script being edited and its compiled form, too large for the console task stack
+static char script_src[CONFIG_SCAN_SCRIPT_MAX_LEN];
+static size_t script_src_len;
+static scan_script_t script_prog;
+static scan_script_report_t script_report;
+
+// Waits end on a one-shot timer rather than on the tick, so a script keeps
+// to the millisecond without spinning
+static esp_timer_handle_t script_timer;
+static SemaphoreHandle_t script_wake;
+
+static int script_exec(const char *line, void *ctx)
+{
+    // esp_console_run reuses one line buffer, the script command must not run itself
+    if (strncmp(line, "script", 6) == 0 && (line[6] == ' ' || line[6] == '\0')) {
+        ESP_LOGW(TAG, "Scripts cannot run the script command");
+        return -1;
+    }
+
+    int ret = 0;
+    esp_err_t err = esp_console_run(line, &ret);
+    if (err == ESP_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "Unknown command: %s", line);
+        return -1;
+    }
+    return err == ESP_OK ? ret : -1;
+}
+
+static uint32_t script_now_ms(void *ctx)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void script_timer_cb(void *arg)
+{
+    xSemaphoreGive(script_wake);
+}
+
+static void script_sleep_until(uint32_t ms, void *ctx)
+{
+    int64_t now_us = esp_timer_get_time();
+    int64_t left_us = (int64_t)(int32_t)(ms - (uint32_t)(now_us / 1000)) * 1000 - now_us % 1000;
+
+    if (left_us <= 0) {
+        return;
+    }
+    xSemaphoreTake(script_wake, 0);
+    if (esp_timer_start_once(script_timer, (uint64_t)left_us) != ESP_OK) {
+        vTaskDelay(pdMS_TO_TICKS(left_us / 1000));
+        return;
+    }
+    xSemaphoreTake(script_wake, portMAX_DELAY);
+}
+
+static void script_capture(scan_script_capture_t *cap, void *ctx)
+{
+#if CONFIG_ESP_PHY_ENABLE_CERT_TEST
+    esp_phy_rx_result_t rx_result;
+
+    esp_phy_get_rx_result(&rx_result);
+    cap->desired = rx_result.phy_rx_total_count;
+    cap->correct = rx_result.phy_rx_correct_count;
+    cap->rssi = rx_result.phy_rx_rssi;
+#endif
+}
+
+// Compile and run src, then print the consolidated result block
+static int script_run(const char *src)
+{
+    static const scan_script_ops_t ops = {
+        .exec = script_exec,
+        .now_ms = script_now_ms,
+        .sleep_until = script_sleep_until,
+        .capture = script_capture,
+    };
+    char err[64];
+
+    if (!scan_script_compile(&script_prog, src, err, sizeof(err))) {
+        ESP_LOGW(TAG, "%s", err);
+        return 1;
+    }
+    // The scanner stays paused for the whole run, so captures and PHY tests
+    // see the same radio however the script is timed
+    scan_app_radio_hold();
+    scan_script_run(&script_prog, &ops, NULL, &script_report);
+    scan_app_radio_release();
+    scan_script_report_print(&script_report);
+
+    return script_report.errors ? 1 : 0;
+}
+
+static bool script_name_valid(const char *name)
+{
+    size_t len = strlen(name);
+
+    if (len == 0 || len > SCRIPT_NAME_MAX || name[0] == '.') {
+        ESP_LOGW(TAG, "Script names are 1~%d characters and do not start with '.'", SCRIPT_NAME_MAX);
+        return false;
+    }
+    return true;
+}
+
+static esp_err_t script_store(const char *name)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(SCRIPT_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(handle, name, script_src, script_src_len);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+static esp_err_t script_fetch(const char *name)
+{
+    nvs_handle_t handle;
+    size_t len = sizeof(script_src) - 1;
+    esp_err_t err = nvs_open(SCRIPT_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_get_blob(handle, name, script_src, &len);
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    script_src_len = len;
+    script_src[len] = '\0';
+    return ESP_OK;
+}
+
+static esp_err_t script_erase(const char *key)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(SCRIPT_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_erase_key(handle, key);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+static esp_err_t script_boot_name(char *name, size_t len)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(SCRIPT_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_get_str(handle, SCRIPT_BOOT_KEY, name, &len);
+    nvs_close(handle);
+    return err;
+}
+
+static esp_err_t script_set_boot(const char *name)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(SCRIPT_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_str(handle, SCRIPT_BOOT_KEY, name);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+static void script_print_stored(void)
+{
+    nvs_iterator_t it = NULL;
+    char boot[SCRIPT_NAME_MAX + 1] = "";
+
+    script_boot_name(boot, sizeof(boot));
+    esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, SCRIPT_NAMESPACE, NVS_TYPE_BLOB, &it);
+    while (err == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        printf("%-16s%s\n", info.key, strcmp(info.key, boot) == 0 ? " (boot)" : "");
+        err = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+}
+
+static bool script_append(const char *text)
+{
+    size_t len = strlen(text);
+
+    if (script_src_len + len + 2 > sizeof(script_src)) {
+        ESP_LOGW(TAG, "Script is limited to %d bytes", CONFIG_SCAN_SCRIPT_MAX_LEN);
+        return false;
+    }
+    memcpy(script_src + script_src_len, text, len);
+    script_src_len += len;
+    script_src[script_src_len++] = '\n';
+    script_src[script_src_len] = '\0';
+    return true;
+}
+
+static int script_func(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &script_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, script_args.end, argv[0]);
+        return 1;
+    }
+
+    // argv points into the console's line buffer, which the commands a script
+    // runs overwrite, so nothing below may use it once a script has started
+    const char *action = script_args.action->sval[0];
+    const char *arg = script_args.arg->count ? script_args.arg->sval[0] : NULL;
+    esp_err_t err = ESP_OK;
+
+    if (strcmp(action, "exec") == 0 && arg) {
+        return script_run(arg);
+    } else if (strcmp(action, "add") == 0 && arg) {
+        return script_append(arg) ? 0 : 1;
+    } else if (strcmp(action, "clear") == 0) {
+        script_src_len = 0;
+        script_src[0] = '\0';
+    } else if (strcmp(action, "show") == 0) {
+        printf("%s", script_src);
+    } else if (strcmp(action, "run") == 0) {
+        if (arg) {
+            if (!script_name_valid(arg)) {
+                return 1;
+            }
+            err = script_fetch(arg);
+        }
+        if (err == ESP_OK) {
+            return script_run(script_src);
+        }
+    } else if (strcmp(action, "save") == 0 && arg) {
+        if (!script_name_valid(arg)) {
+            return 1;
+        }
+        err = script_store(arg);
+    } else if (strcmp(action, "load") == 0 && arg) {
+        if (!script_name_valid(arg)) {
+            return 1;
+        }
+        err = script_fetch(arg);
+    } else if (strcmp(action, "delete") == 0 && arg) {
+        if (!script_name_valid(arg)) {
+            return 1;
+        }
+        err = script_erase(arg);
+    } else if (strcmp(action, "boot") == 0 && arg) {
+        err = strcmp(arg, "off") == 0 ? script_erase(SCRIPT_BOOT_KEY) :
+              script_name_valid(arg) ? script_set_boot(arg) : ESP_ERR_INVALID_ARG;
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    } else if (strcmp(action, "list") == 0) {
+        script_print_stored();
+    } else {
+        ESP_LOGW(TAG, "Unknown action '%s' or missing argument", action);
+        return 1;
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "%s failed: %s", action, esp_err_to_name(err));
+        return 1;
+    }
+    return 0;
+}
+
+void script_run_boot(void)
+{
+    char name[SCRIPT_NAME_MAX + 1];
+
+    if (script_boot_name(name, sizeof(name)) != ESP_OK) {
+        return;
+    }
+    if (script_fetch(name) != ESP_OK) {
+        ESP_LOGW(TAG, "Boot script '%s' not found", name);
+        return;
+    }
+    ESP_LOGI(TAG, "Running boot script '%s'", name);
+    script_run(script_src);
+}
+
+void register_script_cmd(void)
+{
+    const esp_timer_create_args_t timer_args = {
+        .callback = script_timer_cb,
+        .name = "script_wait",
+    };
+    script_wake = xSemaphoreCreateBinary();
+    if (script_wake == NULL) {
+        ESP_ERROR_CHECK( ESP_ERR_NO_MEM );
+    }
+    ESP_ERROR_CHECK( esp_timer_create(&timer_args, &script_timer) );
+
+    script_args.action = arg_str1(NULL, NULL, "<action>", "exec, add, clear, show, run, save, load, delete, boot or list");
+    script_args.arg    = arg_str0(NULL, NULL, "<text|name>", "Statements for exec and add, a script name otherwise");
+    script_args.end    = arg_end(2);
+
+    const esp_console_cmd_t script_cmd = {
+        .command = "script",
+        .help = "Run cert test sequences on the device. Statements are separated by ';' or newlines:\n"
+                "  <command>, wait <ms>, for <var> <from> <to> [step] ... end, capture [label]\n"
+                "'exec' runs its argument at once, 'add' appends to the edit buffer which 'run',\n"
+                "'save' and 'load' work on. 'boot <name|off>' selects the script run at startup.",
+        .hint = NULL,
+        .func = &script_func,
+        .argtable = &script_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&script_cmd) );
+}
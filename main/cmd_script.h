@@ -0,0 +1,23 @@
+#pragma once
+
+#include "scan_script.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    struct arg_str *action;
+    struct arg_str *arg;
+    struct arg_end *end;
+} scan_script_args_t;
+
+void register_script_cmd(void);
+
+// Run the script marked for boot, if there is one. Call once all commands
+// are registered and before the REPL task starts.
+void script_run_boot(void);
+
+#ifdef __cplusplus
+}
+#endif
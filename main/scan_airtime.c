@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <string.h>
+#include "scan_airtime.h"
+
+// DSSS/CCK: long preamble 192 us, short 96 us
+#define DSSS(pre_us, kbps) {(pre_us), 0, (uint32_t)(8000ULL * 65536 / (kbps))}
+
+// OFDM: 16 us training and 4 us SIGNAL plus 6 us signal extension; 22 SERVICE and tail bits
+#define OFDM(ndbps) {26, 3, (uint32_t)(8ULL * 4000 * 65536 / (1000ULL * (ndbps)))}
+
+// HT mixed format: legacy preamble, HT-SIG, HT-STF and one HT-LTF per stream
+#define HT(ndbps, nss, tsym_ns) {20 + 8 + 4 + 4 * (nss) + 6, 3, (uint32_t)(8ULL * (tsym_ns) * 65536 / (1000ULL * (ndbps)))}
+
+// MCS 0-7 on one stream, then MCS 8-15 on two
+#define HT_ROW(tsym_ns, a, b, c, d, e, f, g, h)                                     \
+    HT(a, 1, tsym_ns), HT(b, 1, tsym_ns), HT(c, 1, tsym_ns), HT(d, 1, tsym_ns),    \
+    HT(e, 1, tsym_ns), HT(f, 1, tsym_ns), HT(g, 1, tsym_ns), HT(h, 1, tsym_ns),    \
+    HT(2 * (a), 2, tsym_ns), HT(2 * (b), 2, tsym_ns), HT(2 * (c), 2, tsym_ns),     \
+    HT(2 * (d), 2, tsym_ns), HT(2 * (e), 2, tsym_ns), HT(2 * (f), 2, tsym_ns),     \
+    HT(2 * (g), 2, tsym_ns), HT(2 * (h), 2, tsym_ns)
+
+// Codes follow wifi_phy_rate_t. Unused codes count as 1 Mbps so they are not undercounted.
+#define UNUSED DSSS(192, 1000)
+
+const scan_airtime_rate_t scan_airtime_legacy[32] = {
+    DSSS(192, 1000),    // 0x00  1 Mbps long preamble
+    DSSS(192, 2000),    // 0x01  2 Mbps
+    DSSS(192, 5500),    // 0x02  5.5 Mbps
+    DSSS(192, 11000),   // 0x03  11 Mbps
+    UNUSED,
+    DSSS(96, 2000),     // 0x05  2 Mbps short preamble
+    DSSS(96, 5500),     // 0x06  5.5 Mbps
+    DSSS(96, 11000),    // 0x07  11 Mbps
+    OFDM(192),          // 0x08  48 Mbps
+    OFDM(96),           // 0x09  24 Mbps
+    OFDM(48),           // 0x0A  12 Mbps
+    OFDM(24),           // 0x0B  6 Mbps
+    OFDM(216),          // 0x0C  54 Mbps
+    OFDM(144),          // 0x0D  36 Mbps
+    OFDM(72),           // 0x0E  18 Mbps
+    OFDM(36),           // 0x0F  9 Mbps
+    UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED,
+    UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED,
+};
+
+// Data bits per symbol for MCS 0-7 at 20 and 40 MHz
+const scan_airtime_rate_t scan_airtime_ht[64] = {
+    HT_ROW(4000, 26, 52, 78, 104, 156, 208, 234, 260),
+    HT_ROW(4000, 54, 108, 162, 216, 324, 432, 486, 540),
+    HT_ROW(3600, 26, 52, 78, 104, 156, 208, 234, 260),
+    HT_ROW(3600, 54, 108, 162, 216, 324, 432, 486, 540),
+};
+
+uint16_t scan_airtime_util_permille(const scan_sweep_t *sweep, int channel) {
+    const int i = channel - 1;
+
+    if (sweep->dwell_ms[i] == 0) {
+        return SCAN_AIRTIME_NOT_VISITED;
+    }
+    uint32_t permille = sweep->airtime_us[i] / sweep->dwell_ms[i];
+    return (uint16_t)(permille > 1000 ? 1000 : permille);
+}
+
+void scan_airtime_hist_init(scan_airtime_hist_t *hist) {
+    memset(hist, 0, sizeof(*hist));
+}
+
+void scan_airtime_hist_push(scan_airtime_hist_t *hist, const scan_sweep_t *sweep) {
+    hist->iteration[hist->head] = sweep->iteration;
+    for (int channel = 1; channel <= CONFIG_MAX_WIFI_CHANNELS; channel++) {
+        hist->util[hist->head][channel - 1] = scan_airtime_util_permille(sweep, channel);
+    }
+    hist->head = (hist->head + 1) % CONFIG_SCAN_AIRTIME_HISTORY;
+    if (hist->count < CONFIG_SCAN_AIRTIME_HISTORY) {
+        hist->count++;
+    }
+}
+
+static void print_util(uint16_t permille) {
+    if (permille == SCAN_AIRTIME_NOT_VISITED) {
+        printf("%9s    ", "-");
+    } else {
+        printf("%8u.%u%%  ", permille / 10, permille % 10);
+    }
+}
+
+void scan_airtime_report_print(const scan_sweep_t *sweep) {
+    printf("%-6s", "util");
+    for (int channel = 1; channel <= CONFIG_MAX_WIFI_CHANNELS; channel++) {
+        print_util(scan_airtime_util_permille(sweep, channel));
+    }
+    printf("\n");
+}
+
+void scan_airtime_hist_print(const scan_airtime_hist_t *hist, int n) {
+    uint32_t sum[CONFIG_MAX_WIFI_CHANNELS] = {0};
+    uint32_t visits[CONFIG_MAX_WIFI_CHANNELS] = {0};
+
+    if (n > hist->count) n = hist->count;
+
+    printf("# Channel utilization, last %d sweeps\n", n);
+    printf("Scan  ");
+    for (int channel = 1; channel <= CONFIG_MAX_WIFI_CHANNELS; channel++) {
+        printf("Ch%-4d       ", channel);
+    }
+    printf("\n");
+
+    for (int k = n; k > 0; k--) {
+        int row = (hist->head - k + CONFIG_SCAN_AIRTIME_HISTORY) % CONFIG_SCAN_AIRTIME_HISTORY;
+        printf("%-6lu", (unsigned long)hist->iteration[row]);
+        for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+            uint16_t u = hist->util[row][i];
+            print_util(u);
+            if (u != SCAN_AIRTIME_NOT_VISITED) {
+                sum[i] += u;
+                visits[i]++;
+            }
+        }
+        printf("\n");
+    }
+
+    printf("%-6s", "mean");
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        print_util(visits[i] ? (uint16_t)(sum[i] / visits[i]) : SCAN_AIRTIME_NOT_VISITED);
+    }
+    printf("\n");
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+// Time on air of received frames, estimated from the PHY parameters in
+// rx_ctrl. Each rate has a table entry with its preamble length and cost per
+// payload byte, so one estimate is a lookup, a multiply and a shift. Symbol
+// padding is averaged rather than rounded up, which is within one OFDM symbol.
+
+#include <stdint.h>
+#include "scan_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sweeps kept in the utilization history
+#ifndef CONFIG_SCAN_AIRTIME_HISTORY
+#define CONFIG_SCAN_AIRTIME_HISTORY 60
+#endif
+
+// scan_pkt_rec_t.phy layout
+#define SCAN_PHY_SIG_MODE_MASK 0x03    // 0 11b/g, 1 11n, 3 11ac
+#define SCAN_PHY_CWB           0x04    // 40 MHz
+#define SCAN_PHY_SGI           0x08    // Short guard interval
+
+typedef struct {
+    uint16_t preamble_us;       // Preamble, headers and 2.4 GHz signal extension
+    uint16_t overhead_bytes;    // SERVICE and tail bits rounded to bytes
+    uint32_t us_per_byte_q16;   // Payload time per byte, 16.16 fixed point
+} scan_airtime_rate_t;
+
+// Indexed by the non-HT rate code and by mcs | cwb << 4 | sgi << 5
+extern const scan_airtime_rate_t scan_airtime_legacy[32];
+extern const scan_airtime_rate_t scan_airtime_ht[64];
+
+static inline uint32_t scan_airtime_us(const scan_pkt_rec_t *rec) {
+    const scan_airtime_rate_t *r;
+
+    if ((rec->phy & SCAN_PHY_SIG_MODE_MASK) == 0) {
+        r = &scan_airtime_legacy[rec->rate & 0x1F];
+    } else {
+        r = &scan_airtime_ht[(rec->mcs & 0x0F) | ((rec->phy & SCAN_PHY_CWB) ? 0x10 : 0) |
+                             ((rec->phy & SCAN_PHY_SGI) ? 0x20 : 0)];
+    }
+    return r->preamble_us + (((uint32_t)rec->sig_len + r->overhead_bytes) * r->us_per_byte_q16 >> 16);
+}
+
+// Busy fraction of a channel's dwell in a sweep, in 1/1000, or
+// SCAN_AIRTIME_NOT_VISITED for channels the sweep skipped
+#define SCAN_AIRTIME_NOT_VISITED 0xFFFF
+uint16_t scan_airtime_util_permille(const scan_sweep_t *sweep, int channel);
+
+// Per-channel utilization of the most recent sweeps
+typedef struct {
+    int head;                   // Next row to write
+    int count;
+    uint32_t iteration[CONFIG_SCAN_AIRTIME_HISTORY];
+    uint16_t util[CONFIG_SCAN_AIRTIME_HISTORY][CONFIG_MAX_WIFI_CHANNELS];
+} scan_airtime_hist_t;
+
+void scan_airtime_hist_init(scan_airtime_hist_t *hist);
+void scan_airtime_hist_push(scan_airtime_hist_t *hist, const scan_sweep_t *sweep);
+
+// Utilization row printed under each sweep in the report table
+void scan_airtime_report_print(const scan_sweep_t *sweep);
+
+// Last n sweeps of the history, oldest first, and the mean over them
+void scan_airtime_hist_print(const scan_airtime_hist_t *hist, int n);
+
+#ifdef __cplusplus
+}
+#endif
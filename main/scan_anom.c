@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "scan_anom.h"
+#include "scan_telemetry.h"
+
+#define ANOM_ALPHA (1.0f / (1 << CONFIG_SCAN_ANOM_EWMA_SHIFT))
+
+// Smallest standard deviation a baseline is scored with, absolute plus a share
+// of the mean, so a metric that has been flat for a while does not turn every
+// small wobble into an event
+static const struct {
+    float abs;
+    float rel;
+} sd_floor[SCAN_ANOM_METRICS] = {
+    [SCAN_ANOM_RATE]     = {1.0f, 0.05f},
+    [SCAN_ANOM_ERRORS]   = {2.0f, 0.05f},
+    [SCAN_ANOM_RSSI_P50] = {CONFIG_SCAN_HIST_BIN_DB, 0.0f},
+    [SCAN_ANOM_RSSI_P90] = {CONFIG_SCAN_HIST_BIN_DB, 0.0f},
+    [SCAN_ANOM_UTIL]     = {5.0f, 0.05f},
+};
+
+void scan_anom_config_default(scan_anom_config_t *cfg) {
+    cfg->z_spike = CONFIG_SCAN_ANOM_SPIKE_Z10 / 10.0f;
+    cfg->z_shift = CONFIG_SCAN_ANOM_SHIFT_Z10 / 10.0f;
+    cfg->sustain = CONFIG_SCAN_ANOM_SUSTAIN;
+}
+
+void scan_anom_init(scan_anom_t *a, const scan_anom_config_t *cfg) {
+    memset(a, 0, sizeof(*a));
+    a->cfg = *cfg;
+}
+
+static float stat_sd(const scan_anom_stat_t *s, scan_anom_metric_t metric) {
+    float min_sd = sd_floor[metric].abs + sd_floor[metric].rel * fabsf(s->mean);
+    float sd = sqrtf(s->var);
+    return sd > min_sd ? sd : min_sd;
+}
+
+static void learn(scan_anom_stat_t *s, float x, float alpha) {
+    float d = x - s->mean;
+    s->mean += alpha * d;
+    s->var = (1.0f - alpha) * (s->var + alpha * d * d);
+}
+
+// Values of the sweep's metrics on one channel; false for those it has none of
+static void channel_metrics(const scan_sweep_t *sweep, int i, float *x, bool *valid) {
+    uint32_t dwell = sweep->dwell_ms[i];
+    uint32_t packets = sweep->packet_count[i];
+    bool enough = packets >= CONFIG_SCAN_ANOM_MIN_FRAMES;
+
+    x[SCAN_ANOM_RATE] = packets * 1000.0f / dwell;
+    x[SCAN_ANOM_UTIL] = (float)sweep->airtime_us[i] / dwell;
+    valid[SCAN_ANOM_RATE] = true;
+    valid[SCAN_ANOM_UTIL] = true;
+
+    valid[SCAN_ANOM_ERRORS] = enough;
+    valid[SCAN_ANOM_RSSI_P50] = enough;
+    valid[SCAN_ANOM_RSSI_P90] = enough;
+    if (enough) {
+        x[SCAN_ANOM_ERRORS] = sweep->error_count[i] * 1000.0f / packets;
+        x[SCAN_ANOM_RSSI_P50] = (float)scan_hist_percentile(&sweep->hist[i], 50);
+        x[SCAN_ANOM_RSSI_P90] = (float)scan_hist_percentile(&sweep->hist[i], 90);
+    }
+}
+
+static void add_event(scan_anom_t *a, scan_anom_event_t *events, size_t max, size_t *n,
+                      const scan_anom_event_t *e) {
+    a->events++;
+    if (*n < max) {
+        events[(*n)++] = *e;
+    } else {
+        a->dropped++;
+    }
+}
+
+size_t scan_anom_update(scan_anom_t *a, const scan_sweep_t *sweep, scan_anom_event_t *events, size_t max) {
+    const scan_anom_config_t *cfg = &a->cfg;
+    size_t n = 0;
+
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        if (sweep->dwell_ms[i] == 0) continue;
+
+        float x[SCAN_ANOM_METRICS];
+        bool valid[SCAN_ANOM_METRICS];
+        channel_metrics(sweep, i, x, valid);
+
+        for (int m = 0; m < SCAN_ANOM_METRICS; m++) {
+            scan_anom_stat_t *s = &a->stat[i][m];
+            if (!valid[m]) continue;
+
+            if (s->samples < CONFIG_SCAN_ANOM_WARMUP) {
+                s->samples++;
+                learn(s, x[m], 1.0f / s->samples);
+                continue;
+            }
+
+            float sd = stat_sd(s, m);
+            float z = (x[m] - s->mean) / sd;
+            int sign = z >= cfg->z_shift ? 1 : z <= -cfg->z_shift ? -1 : 0;
+            scan_anom_event_t e = {.channel = (uint8_t)(i + 1), .metric = (uint8_t)m, .mean = s->mean, .sd = sd};
+
+            if (sign == 0 || sign != s->run_sign) {
+                s->run = 0;
+                s->run_sum = 0.0f;
+                s->spiked = false;
+            }
+            s->run_sign = (int8_t)sign;
+            if (sign != 0) {
+                s->run++;
+                s->run_sum += x[m];
+            }
+
+            if (fabsf(z) >= cfg->z_spike && !s->spiked) {
+                e.kind = SCAN_ANOM_SPIKE;
+                e.z = z;
+                e.value = x[m];
+                add_event(a, events, max, &n, &e);
+                s->spiked = true;
+            }
+
+            if (s->run >= cfg->sustain) {
+                float level = s->run_sum / s->run;
+                e.kind = SCAN_ANOM_SHIFT;
+                e.z = (level - s->mean) / sd;
+                e.value = level;
+                add_event(a, events, max, &n, &e);
+                s->mean = level;
+                s->run = 0;
+                s->run_sign = 0;
+                s->run_sum = 0.0f;
+                s->spiked = false;
+                continue;
+            }
+
+            float band = cfg->z_spike * sd;
+            float clamped = x[m] > s->mean + band ? s->mean + band : x[m] < s->mean - band ? s->mean - band : x[m];
+            learn(s, clamped, ANOM_ALPHA);
+        }
+    }
+    return n;
+}
+
+const char *scan_anom_metric_name(scan_anom_metric_t metric) {
+    switch (metric) {
+    case SCAN_ANOM_RATE:     return "rate";
+    case SCAN_ANOM_ERRORS:   return "errors";
+    case SCAN_ANOM_RSSI_P50: return "rssi_p50";
+    case SCAN_ANOM_RSSI_P90: return "rssi_p90";
+    case SCAN_ANOM_UTIL:     return "util";
+    default:                 return "unknown";
+    }
+}
+
+const char *scan_anom_kind_name(scan_anom_kind_t kind) {
+    switch (kind) {
+    case SCAN_ANOM_SPIKE: return "spike";
+    case SCAN_ANOM_SHIFT: return "shift";
+    default:              return "unknown";
+    }
+}
+
+static const char *const metric_units[SCAN_ANOM_METRICS] = {"/s", "permille", "dBm", "dBm", "permille"};
+
+void scan_anom_events_print(uint32_t iteration, const scan_anom_event_t *events, size_t count) {
+    if (count == 0) {
+        printf("# Heartbeat at sweep %lu, no events\n", (unsigned long)iteration);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const scan_anom_event_t *e = &events[i];
+        printf("# Event sweep %lu ch %u %s %s: %.1f %s, baseline %.1f sd %.1f, z %+.1f\n",
+               (unsigned long)iteration, e->channel, scan_anom_metric_name(e->metric), scan_anom_kind_name(e->kind),
+               (double)e->value, metric_units[e->metric], (double)e->mean, (double)e->sd, (double)e->z);
+    }
+}
+
+void scan_anom_report_print(const scan_anom_t *a) {
+    printf("# Anomaly detection: spike at z %.1f, shift at z %.1f for %u sweeps; %lu events so far\n",
+           (double)a->cfg.z_spike, (double)a->cfg.z_shift, a->cfg.sustain, (unsigned long)a->events);
+    printf("# Baseline mean/sd per visited channel, - while learning\n");
+    printf("Ch  ");
+    for (int m = 0; m < SCAN_ANOM_METRICS; m++) {
+        printf("%-16s", scan_anom_metric_name(m));
+    }
+    printf("\n");
+
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        bool seen = false;
+        for (int m = 0; m < SCAN_ANOM_METRICS; m++) {
+            seen |= a->stat[i][m].samples > 0;
+        }
+        if (!seen) continue;
+
+        printf("%-4d", i + 1);
+        for (int m = 0; m < SCAN_ANOM_METRICS; m++) {
+            const scan_anom_stat_t *s = &a->stat[i][m];
+            if (s->samples < CONFIG_SCAN_ANOM_WARMUP) {
+                printf("%-16s", "-");
+            } else {
+                char cell[24];
+                snprintf(cell, sizeof(cell), "%.1f/%.1f", (double)s->mean, (double)stat_sd(s, m));
+                printf("%-16s", cell);
+            }
+        }
+        printf("\n");
+    }
+}
+
+static int32_t tenths(float v) {
+    return (int32_t)lroundf(v * 10.0f);
+}
+
+size_t scan_anom_encode(uint8_t *buf, size_t cap, uint16_t seq, uint32_t time_ms, uint32_t iteration,
+                        uint32_t dropped, const scan_anom_event_t *events, size_t count) {
+    scan_tlm_writer_t w;
+
+    scan_tlm_begin(&w, buf, cap, SCAN_TLM_EVENTS);
+    scan_tlm_put_varint(&w, time_ms);
+    scan_tlm_put_varint(&w, iteration);
+    scan_tlm_put_varint(&w, dropped);
+    scan_tlm_put_varint(&w, (uint32_t)count);
+    for (size_t i = 0; i < count; i++) {
+        const scan_anom_event_t *e = &events[i];
+        scan_tlm_put_u8(&w, e->channel);
+        scan_tlm_put_u8(&w, e->metric);
+        scan_tlm_put_u8(&w, e->kind);
+        scan_tlm_put_svarint(&w, tenths(e->z));
+        scan_tlm_put_svarint(&w, tenths(e->value));
+        scan_tlm_put_svarint(&w, tenths(e->mean));
+        scan_tlm_put_svarint(&w, tenths(e->sd));
+    }
+    return scan_tlm_end(&w, seq);
+}
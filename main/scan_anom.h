@@ -0,0 +1,141 @@
+#pragma once
+
+// Streaming anomaly detection on the per-channel sweep metrics. Each channel
+// keeps an exponentially weighted mean and variance per metric, learnt from
+// the sweeps themselves, and every new sweep is scored against them:
+//
+//   spike  one sweep at least z_spike standard deviations off the baseline
+//   shift  sustain sweeps in a row at least z_shift off on the same side; the
+//          baseline then moves to the new level at once
+//
+// Samples beyond z_spike are clamped to that band before they are learnt, so
+// a burst barely moves the baseline while a wider spread still widens it.
+// Channels the scheduler skipped are left alone, and the error and RSSI
+// metrics need a minimum number of frames to mean anything.
+//
+// Events go out as SCAN_TLM_EVENTS frames:
+//
+//   time_ms, iteration, dropped, count, count x { channel, metric, kind,
+//   z, value, baseline, sd }
+//
+// z, value, baseline and sd are signed varints in tenths of the metric's
+// unit (z in tenths of a standard deviation); for a shift, value is the new
+// level. dropped counts events that did not fit since the previous frame. A
+// frame with count 0 is a heartbeat.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "scan_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Weight of a new sweep in the baselines is 1/2^CONFIG_SCAN_ANOM_EWMA_SHIFT
+#ifndef CONFIG_SCAN_ANOM_EWMA_SHIFT
+#define CONFIG_SCAN_ANOM_EWMA_SHIFT 5
+#endif
+
+// Sweeps a metric is only learnt from, as a plain average, before it is scored
+#ifndef CONFIG_SCAN_ANOM_WARMUP
+#define CONFIG_SCAN_ANOM_WARMUP 8
+#endif
+
+// Frames a channel needs in a sweep before its error rate and RSSI count
+#ifndef CONFIG_SCAN_ANOM_MIN_FRAMES
+#define CONFIG_SCAN_ANOM_MIN_FRAMES 20
+#endif
+
+// Default thresholds, tenths of a standard deviation
+#ifndef CONFIG_SCAN_ANOM_SPIKE_Z10
+#define CONFIG_SCAN_ANOM_SPIKE_Z10 50
+#endif
+
+#ifndef CONFIG_SCAN_ANOM_SHIFT_Z10
+#define CONFIG_SCAN_ANOM_SHIFT_Z10 20
+#endif
+
+#ifndef CONFIG_SCAN_ANOM_SUSTAIN
+#define CONFIG_SCAN_ANOM_SUSTAIN 5
+#endif
+
+// Quiet output sends a heartbeat when nothing else has gone out for this long
+#ifndef CONFIG_SCAN_HEARTBEAT_S
+#define CONFIG_SCAN_HEARTBEAT_S 60
+#endif
+
+// Events kept per sweep, the rest are counted as dropped
+#define SCAN_ANOM_MAX_EVENTS 32
+
+typedef enum {
+    SCAN_ANOM_RATE,         // Frames per second of dwell
+    SCAN_ANOM_ERRORS,       // Frames with errors, permille
+    SCAN_ANOM_RSSI_P50,     // dBm
+    SCAN_ANOM_RSSI_P90,     // dBm
+    SCAN_ANOM_UTIL,         // Estimated airtime, permille of the dwell
+    SCAN_ANOM_METRICS,
+} scan_anom_metric_t;
+
+typedef enum {
+    SCAN_ANOM_SPIKE = 1,
+    SCAN_ANOM_SHIFT = 2,
+} scan_anom_kind_t;
+
+typedef struct {
+    float z_spike;
+    float z_shift;
+    uint8_t sustain;        // Sweeps, 1~255
+} scan_anom_config_t;
+
+typedef struct {
+    float mean;
+    float var;
+    uint16_t samples;       // Counts up to the warm-up only
+    int8_t run_sign;        // Side of the baseline the current run is on, 0 if none
+    uint8_t run;            // Sweeps in the run
+    bool spiked;            // The run has already been reported as a spike
+    float run_sum;
+} scan_anom_stat_t;
+
+typedef struct {
+    scan_anom_config_t cfg;
+    scan_anom_stat_t stat[CONFIG_MAX_WIFI_CHANNELS][SCAN_ANOM_METRICS];
+    uint32_t events;        // Since init
+    uint32_t dropped;       // Events that did not fit, since the caller last cleared it
+} scan_anom_t;
+
+typedef struct {
+    uint8_t channel;
+    uint8_t metric;         // scan_anom_metric_t
+    uint8_t kind;           // scan_anom_kind_t
+    float z;
+    float value;            // The sweep's value, or the new level of a shift
+    float mean;             // Baseline before the event
+    float sd;
+} scan_anom_event_t;
+
+void scan_anom_config_default(scan_anom_config_t *cfg);
+
+void scan_anom_init(scan_anom_t *a, const scan_anom_config_t *cfg);
+
+// Score a finished sweep and learn from it. Up to max events are written to
+// events; returns how many.
+size_t scan_anom_update(scan_anom_t *a, const scan_sweep_t *sweep, scan_anom_event_t *events, size_t max);
+
+const char *scan_anom_metric_name(scan_anom_metric_t metric);
+const char *scan_anom_kind_name(scan_anom_kind_t kind);
+
+// One line per event, or a heartbeat line if there are none
+void scan_anom_events_print(uint32_t iteration, const scan_anom_event_t *events, size_t count);
+
+// Thresholds and the current baselines, mean/sd per channel and metric
+void scan_anom_report_print(const scan_anom_t *a);
+
+// Complete SCAN_TLM_EVENTS frame, 0 if it did not fit
+size_t scan_anom_encode(uint8_t *buf, size_t cap, uint16_t seq, uint32_t time_ms, uint32_t iteration,
+                        uint32_t dropped, const scan_anom_event_t *events, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,96 @@
+#include <string.h>
+#include "scan_ap.h"
+
+// Weight of a new scan in the RSSI average is 1/2^AP_EWMA_SHIFT
+#define AP_EWMA_SHIFT 2
+
+void scan_ap_table_init(scan_ap_table_t *table, scan_ap_entry_t *entries, size_t capacity) {
+    memset(entries, 0, capacity * sizeof(*entries));
+    table->entries = entries;
+    table->capacity = capacity;
+    table->count = 0;
+    table->expire_ms = CONFIG_SCAN_AP_EXPIRE_MS;
+    table->rssi_delta_db = CONFIG_SCAN_AP_RSSI_DELTA_DB;
+}
+
+const char *scan_ap_event_name(scan_ap_event_t event) {
+    switch (event) {
+    case SCAN_AP_NEW:     return "new";
+    case SCAN_AP_CHANGED: return "changed";
+    case SCAN_AP_EXPIRED: return "expired";
+    default:              return "unknown";
+    }
+}
+
+static int ewma_dbm(int16_t ewma) {
+    return (ewma >= 0 ? ewma + 8 : ewma - 8) / 16;
+}
+
+static void remove_entry(scan_ap_table_t *table, scan_ap_entry_t *e, scan_ap_event_cb_t cb, void *ctx) {
+    if (cb) cb(e, SCAN_AP_EXPIRED, ctx);
+    e->used = false;
+    table->count--;
+}
+
+void scan_ap_observe(scan_ap_table_t *table, const scan_ap_obs_t *obs, uint32_t now_ms,
+                     scan_ap_event_cb_t cb, void *ctx) {
+    scan_ap_entry_t *free_slot = NULL;
+    scan_ap_entry_t *oldest = NULL;
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        scan_ap_entry_t *e = &table->entries[i];
+        if (!e->used) {
+            if (!free_slot) free_slot = e;
+            continue;
+        }
+        if (!oldest || (int32_t)(e->last_seen_ms - oldest->last_seen_ms) < 0) {
+            oldest = e;
+        }
+        if (memcmp(e->ap.bssid, obs->bssid, sizeof(obs->bssid)) != 0) continue;
+
+        // Known AP: smooth RSSI and report only what a reader would care about
+        e->rssi_ewma += (int16_t)((obs->rssi * 16 - e->rssi_ewma) / (1 << AP_EWMA_SHIFT));
+        e->last_seen_ms = now_ms;
+        e->sightings++;
+
+        int rssi = ewma_dbm(e->rssi_ewma);
+        int moved = rssi - e->reported_rssi;
+        bool changed = e->ap.channel != obs->channel || e->ap.authmode != obs->authmode ||
+                       strcmp(e->ap.ssid, obs->ssid) != 0 ||
+                       moved >= table->rssi_delta_db || moved <= -table->rssi_delta_db;
+
+        e->ap = *obs;
+        e->ap.rssi = (int8_t)rssi;
+        if (changed) {
+            e->reported_rssi = (int8_t)rssi;
+            if (cb) cb(e, SCAN_AP_CHANGED, ctx);
+        }
+        return;
+    }
+
+    if (!free_slot) {
+        if (!oldest) return;
+        remove_entry(table, oldest, cb, ctx);
+        free_slot = oldest;
+    }
+
+    scan_ap_entry_t *e = free_slot;
+    e->ap = *obs;
+    e->used = true;
+    e->rssi_ewma = (int16_t)(obs->rssi * 16);
+    e->reported_rssi = obs->rssi;
+    e->first_seen_ms = now_ms;
+    e->last_seen_ms = now_ms;
+    e->sightings = 1;
+    table->count++;
+    if (cb) cb(e, SCAN_AP_NEW, ctx);
+}
+
+void scan_ap_expire(scan_ap_table_t *table, uint32_t now_ms, scan_ap_event_cb_t cb, void *ctx) {
+    for (size_t i = 0; i < table->capacity; i++) {
+        scan_ap_entry_t *e = &table->entries[i];
+        if (e->used && now_ms - e->last_seen_ms >= table->expire_ms) {
+            remove_entry(table, e, cb, ctx);
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// Persistent table of access points found by active scans. Each scan's
+// results are merged into it, RSSI is smoothed across scans and APs that have
+// not been seen for a while age out. Merging reports only what changed, so
+// the output of a long survey is a list of events rather than repeated dumps.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Entries in the table; storage is provided by the caller
+#ifndef CONFIG_SCAN_AP_TABLE_SIZE
+#define CONFIG_SCAN_AP_TABLE_SIZE 128
+#endif
+
+// APs not seen for this long are dropped
+#ifndef CONFIG_SCAN_AP_EXPIRE_MS
+#define CONFIG_SCAN_AP_EXPIRE_MS 60000
+#endif
+
+// Smoothed RSSI must move this far from the last reported value to count as a change
+#ifndef CONFIG_SCAN_AP_RSSI_DELTA_DB
+#define CONFIG_SCAN_AP_RSSI_DELTA_DB 6
+#endif
+
+typedef enum {
+    SCAN_AP_NEW,
+    SCAN_AP_CHANGED,
+    SCAN_AP_EXPIRED,
+} scan_ap_event_t;
+
+// One AP as reported by a scan
+typedef struct {
+    uint8_t bssid[6];
+    char ssid[33];
+    uint8_t channel;
+    int8_t rssi;
+    uint8_t authmode;
+} scan_ap_obs_t;
+
+typedef struct {
+    scan_ap_obs_t ap;           // Latest observation, rssi replaced by the smoothed value
+    bool used;
+    int16_t rssi_ewma;          // dBm in 1/16 units
+    int8_t reported_rssi;       // RSSI in the last event for this AP
+    uint32_t first_seen_ms;
+    uint32_t last_seen_ms;
+    uint32_t sightings;         // Scans that found this AP
+} scan_ap_entry_t;
+
+typedef struct {
+    scan_ap_entry_t *entries;
+    size_t capacity;
+    size_t count;
+    uint32_t expire_ms;
+    int rssi_delta_db;
+} scan_ap_table_t;
+
+typedef void (*scan_ap_event_cb_t)(const scan_ap_entry_t *entry, scan_ap_event_t event, void *ctx);
+
+// entries must hold capacity zeroed or unused elements
+void scan_ap_table_init(scan_ap_table_t *table, scan_ap_entry_t *entries, size_t capacity);
+
+// Merge one AP from the current scan. cb, if set, is called for new and changed
+// entries. A full table makes room by expiring the AP seen least recently.
+void scan_ap_observe(scan_ap_table_t *table, const scan_ap_obs_t *obs, uint32_t now_ms,
+                     scan_ap_event_cb_t cb, void *ctx);
+
+// Drop APs not seen within expire_ms, calling cb for each
+void scan_ap_expire(scan_ap_table_t *table, uint32_t now_ms, scan_ap_event_cb_t cb, void *ctx);
+
+const char *scan_ap_event_name(scan_ap_event_t event);
+
+#ifdef __cplusplus
+}
+#endif
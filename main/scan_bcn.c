@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <string.h>
+#include "scan_bcn.h"
+
+// Weight of a new sample in the averages is 1/2^BCN_EWMA_SHIFT
+#define BCN_EWMA_SHIFT 3
+
+#define BCN_ONE (1u << SCAN_BCN_FRAC_BITS)
+
+void scan_bcn_init(scan_bcn_table_t *table) {
+    memset(table, 0, sizeof(*table));
+}
+
+void scan_bcn_set_hop(scan_bcn_table_t *table, uint32_t hop) {
+    if (hop != table->hop) {
+        table->hop = hop;
+        table->visit++;
+    }
+}
+
+// First sample sets the average, later ones move it by 1/2^BCN_EWMA_SHIFT
+static void ewma(uint32_t *avg, uint32_t sample_us, bool first) {
+    int32_t sample = (int32_t)(sample_us * BCN_ONE);
+    *avg = first ? (uint32_t)sample : (uint32_t)((int32_t)*avg + (sample - (int32_t)*avg) / (1 << BCN_EWMA_SHIFT));
+}
+
+static scan_bcn_t *bcn_lookup(scan_bcn_table_t *table, const uint8_t bssid[6]) {
+    scan_bcn_t *oldest = NULL;
+
+    for (int i = 0; i < table->count; i++) {
+        scan_bcn_t *e = &table->entries[i];
+        if (memcmp(e->bssid, bssid, 6) == 0) {
+            return e;
+        }
+        if (!oldest || (int32_t)(e->last_seen_ms - oldest->last_seen_ms) < 0) {
+            oldest = e;
+        }
+    }
+
+    scan_bcn_t *e;
+    if (table->count < CONFIG_SCAN_BCN_TABLE_SIZE) {
+        e = &table->entries[table->count++];
+    } else {
+        e = oldest;
+        table->evictions++;
+    }
+    memset(e, 0, sizeof(*e));
+    memcpy(e->bssid, bssid, 6);
+    return e;
+}
+
+void scan_bcn_update(scan_bcn_table_t *table, const scan_pkt_rec_t *rec, uint32_t now_ms) {
+    if (rec->channel != table->channel) {
+        table->channel = rec->channel;
+        table->visit++;
+    }
+    if (rec->bcn_interval == 0) return;
+
+    scan_bcn_t *e = bcn_lookup(table, rec->addr2);
+    uint32_t interval_us = (uint32_t)rec->bcn_interval * 1024;
+    uint32_t tbtt = rec->bcn_tsf - rec->bcn_delay;
+
+    // Compare with the previous beacon if both were heard in this visit and
+    // the AP kept its channel and schedule
+    bool paired = e->beacons > 0 && e->visit == table->visit && e->channel == rec->channel &&
+                  e->interval_tu == rec->bcn_interval;
+    if (paired) {
+        uint32_t span = tbtt - e->last_tbtt;
+        uint32_t n = (span + interval_us / 2) / interval_us;
+
+        if (n > 0 && n <= SCAN_BCN_MAX_GAP) {
+            uint32_t arrival = rec->timestamp - e->last_rx_us;
+            uint32_t scheduled = n * interval_us;
+            bool first = e->expected == 0;
+
+            e->expected += n;
+            e->missed += n - 1;
+            ewma(&e->period, arrival / n, first);
+            ewma(&e->jitter, arrival > scheduled ? arrival - scheduled : scheduled - arrival, first);
+        }
+    }
+
+    ewma(&e->delay, rec->bcn_delay, e->beacons == 0);
+    if (rec->bcn_delay > e->delay_max) {
+        e->delay_max = rec->bcn_delay;
+    }
+    if (rec->bcn_delay > CONFIG_SCAN_BCN_LATE_US) {
+        e->late++;
+    }
+
+    e->beacons++;
+    e->channel = rec->channel;
+    e->interval_tu = rec->bcn_interval;
+    e->visit = table->visit;
+    e->last_rx_us = rec->timestamp;
+    e->last_tbtt = tbtt;
+    e->last_seen_ms = now_ms;
+}
+
+uint32_t scan_bcn_loss_permille(const scan_bcn_t *e) {
+    return e->expected ? (uint32_t)((uint64_t)e->missed * 1000 / e->expected) : 0;
+}
+
+void scan_bcn_report_print(const scan_bcn_table_t *table, size_t max, uint32_t now_ms) {
+    uint8_t order[CONFIG_SCAN_BCN_TABLE_SIZE];
+    size_t n = 0;
+
+    // Insertion sort by loss, the table is small
+    for (int i = 0; i < table->count; i++) {
+        uint32_t loss = scan_bcn_loss_permille(&table->entries[i]);
+        size_t pos = n++;
+        while (pos > 0 && scan_bcn_loss_permille(&table->entries[order[pos - 1]]) < loss) {
+            order[pos] = order[pos - 1];
+            pos--;
+        }
+        order[pos] = (uint8_t)i;
+    }
+    if (n > max) n = max;
+
+    printf("# Beacons: %u access points, %lu evicted, capacity %d; late is over %d us after the TBTT\n",
+           table->count, (unsigned long)table->evictions, CONFIG_SCAN_BCN_TABLE_SIZE, CONFIG_SCAN_BCN_LATE_US);
+    printf("BSSID              Ch  BI(TU) Beacons  Missed  Loss(%%)  Late   Period(ms) Jitter(us) Delay(us)  Max(us) Idle(s)\n");
+
+    for (size_t i = 0; i < n; i++) {
+        const scan_bcn_t *e = &table->entries[order[i]];
+        uint32_t loss = scan_bcn_loss_permille(e);
+
+        printf("%02x:%02x:%02x:%02x:%02x:%02x  %-3u %-6u %-8lu %-7lu ",
+               e->bssid[0], e->bssid[1], e->bssid[2], e->bssid[3], e->bssid[4], e->bssid[5],
+               e->channel, e->interval_tu, (unsigned long)e->beacons, (unsigned long)e->missed);
+        if (e->expected) {
+            printf("%3lu.%lu    %-6lu %-10.2f %-10lu ", (unsigned long)(loss / 10), (unsigned long)(loss % 10),
+                   (unsigned long)e->late, (double)e->period / BCN_ONE / 1000, (unsigned long)(e->jitter / BCN_ONE));
+        } else {
+            printf("%5s    %-6lu %-10s %-10s ", "-", (unsigned long)e->late, "-", "-");
+        }
+        printf("%-10lu %-7u %lu\n", (unsigned long)(e->delay / BCN_ONE), e->delay_max,
+               (unsigned long)((now_ms - e->last_seen_ms) / 1000));
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+// Beacon timing per access point. A beacon carries the AP's TSF at the
+// moment it went out and the advertised beacon interval, so the TSF minus
+// its remainder modulo the interval is the target beacon transmission time
+// (TBTT) the beacon belongs to. Two beacons from the same AP are then an
+// exact number of intervals apart, and any TBTT in between that produced no
+// beacon is counted as missed. The remainder itself is how long the AP had
+// to wait for the medium, which is the first thing to grow on a busy channel.
+//
+// Beacons are only paired within one visit to the AP's channel. The receiver
+// spends most of a sweep elsewhere and the beacons sent meanwhile are not
+// lost. A visit ends when the record stream moves to another channel, and
+// whenever the owner reports a hop with scan_bcn_set_hop: the scan loop does
+// so on every channel change, so returning to a channel after a round of
+// quiet ones is not mistaken for a long gap either.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "scan_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Access points tracked; when full the one heard from least recently is replaced
+#ifndef CONFIG_SCAN_BCN_TABLE_SIZE
+#define CONFIG_SCAN_BCN_TABLE_SIZE 32
+#endif
+
+// A beacon sent this long after its TBTT counts as late
+#ifndef CONFIG_SCAN_BCN_LATE_US
+#define CONFIG_SCAN_BCN_LATE_US 2048
+#endif
+
+// Pairs further apart than this many intervals are not compared: the AP
+// restarted or the receiver stopped listening, neither says much about loss
+#define SCAN_BCN_MAX_GAP 50
+
+// Averages are kept in 1/16 us
+#define SCAN_BCN_FRAC_BITS 4
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint16_t interval_tu;       // Advertised, 1 TU is 1024 us
+    uint32_t visit;             // Visit of the last beacon
+    uint32_t last_rx_us;        // Arrival of the last beacon, receiver clock
+    uint32_t last_tbtt;         // Its TBTT, low 32 bits of the AP's TSF
+    uint32_t last_seen_ms;
+    uint32_t beacons;
+    uint32_t expected;          // Intervals spanned by the compared pairs
+    uint32_t missed;            // TBTTs in those spans without a beacon
+    uint32_t late;
+    uint32_t period;            // Average arrival interval per TBTT, 0 until the first pair
+    uint32_t jitter;            // Average deviation of the arrival interval from the schedule
+    uint32_t delay;             // Average wait after the TBTT
+    uint16_t delay_max;         // us
+} scan_bcn_t;
+
+typedef struct {
+    uint16_t count;
+    uint8_t channel;            // Channel of the last record, a change starts a new visit
+    uint32_t hop;               // Last hop count from the owner
+    uint32_t visit;
+    uint32_t evictions;
+    scan_bcn_t entries[CONFIG_SCAN_BCN_TABLE_SIZE];
+} scan_bcn_table_t;
+
+void scan_bcn_init(scan_bcn_table_t *table);
+
+// The owner's count of channel changes; a new value starts a new visit
+void scan_bcn_set_hop(scan_bcn_table_t *table, uint32_t hop);
+
+// Feed every record: beacons are timed, the others only mark channel changes
+void scan_bcn_update(scan_bcn_table_t *table, const scan_pkt_rec_t *rec, uint32_t now_ms);
+
+// Share of the expected beacons that went missing, in permille
+uint32_t scan_bcn_loss_permille(const scan_bcn_t *e);
+
+// Up to max access points, highest loss first
+void scan_bcn_report_print(const scan_bcn_table_t *table, size_t max, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <string.h>
+#include "scan_core.h"
+#include "scan_airtime.h"
+
+bool scan_capture_accept(scan_filter_t *filter, const wifi_promiscuous_pkt_t *pkt,
+                         wifi_promiscuous_pkt_type_t type) {
+    if (!pkt) return false;
+
+    // Ignore packets of types we're not interested in
+    if (filter) {
+        return scan_filter_match(filter, pkt, type);
+    }
+    return type == WIFI_PKT_MGMT || type == WIFI_PKT_DATA || type == WIFI_PKT_CTRL;
+}
+
+bool scan_capture(scan_ring_t *ring, scan_filter_t *filter, const wifi_promiscuous_pkt_t *pkt,
+                  wifi_promiscuous_pkt_type_t type) {
+    return scan_capture_accept(filter, pkt, type) && scan_capture_push(ring, pkt, type);
+}
+
+bool scan_capture_push(scan_ring_t *ring, const wifi_promiscuous_pkt_t *pkt, wifi_promiscuous_pkt_type_t type) {
+    const wifi_pkt_rx_ctrl_t *rx_ctrl = &pkt->rx_ctrl;
+
+    scan_pkt_rec_t rec = {
+        .timestamp = rx_ctrl->timestamp,
+        .sig_len = rx_ctrl->sig_len,
+        .channel = rx_ctrl->channel,
+        .rssi = rx_ctrl->rssi,
+        .rx_state = rx_ctrl->rx_state,
+        .rate = rx_ctrl->rate,
+        .mcs = rx_ctrl->mcs,
+        .noise_floor = rx_ctrl->noise_floor,
+        .phy = (uint8_t)((rx_ctrl->sig_mode & SCAN_PHY_SIG_MODE_MASK) |
+                         (rx_ctrl->cwb ? SCAN_PHY_CWB : 0) | (rx_ctrl->sgi ? SCAN_PHY_SGI : 0)),
+    };
+
+    // Management and data frames all carry addr2 after fc, duration and addr1,
+    // control frames only if long enough (RTS yes, CTS and ACK no)
+    if (rx_ctrl->sig_len >= SCAN_HDR_FC_END) {
+        rec.fc = (uint16_t)(pkt->payload[0] | pkt->payload[1] << 8);
+    }
+    if (rx_ctrl->sig_len >= SCAN_HDR_ADDR2_END) {
+        memcpy(rec.addr2, pkt->payload + SCAN_HDR_ADDR2, sizeof(rec.addr2));
+    }
+    if (type != WIFI_PKT_CTRL && rx_ctrl->sig_len >= SCAN_HDR_SEQ_END) {
+        rec.seq_ctrl = (uint16_t)(pkt->payload[SCAN_HDR_SEQ] | pkt->payload[SCAN_HDR_SEQ + 1] << 8);
+    }
+
+    // Beacons keep their timing; the offset from the TBTT needs the whole
+    // 64-bit TSF, so it is taken here rather than from the stored low half
+    if (type == WIFI_PKT_MGMT && SCAN_FC_SUBTYPE(rec.fc) == SCAN_FC_SUBTYPE_BEACON &&
+        rx_ctrl->sig_len >= SCAN_BCN_FIXED_END) {
+        const uint8_t *p = pkt->payload;
+        uint64_t tsf = 0;
+        for (int i = 7; i >= 0; i--) {
+            tsf = tsf << 8 | p[SCAN_BCN_TSF + i];
+        }
+        rec.bcn_interval = (uint16_t)(p[SCAN_BCN_INTERVAL] | p[SCAN_BCN_INTERVAL + 1] << 8);
+        if (rec.bcn_interval > 0) {
+            uint64_t delay = tsf % ((uint32_t)rec.bcn_interval * 1024);
+            rec.bcn_delay = delay > UINT16_MAX ? UINT16_MAX : (uint16_t)delay;
+            rec.bcn_tsf = (uint32_t)tsf;
+        }
+    }
+    return scan_ring_push(ring, &rec);
+}
+
+void scan_sweep_reset(scan_sweep_t *sweep) {
+    sweep->dropped = 0;
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        sweep->rssi_values[i] = SCAN_RSSI_FLOOR;
+        sweep->packet_count[i] = 0;
+        sweep->error_count[i] = 0;
+        sweep->airtime_us[i] = 0;
+        sweep->retries[i] = 0;
+        sweep->nf_min[i] = INT8_MAX;
+        sweep->nf_max[i] = INT8_MIN;
+        memset(sweep->frames[i], 0, sizeof(sweep->frames[i]));
+        memset(sweep->snr[i], 0, sizeof(sweep->snr[i]));
+        scan_hist_reset(&sweep->hist[i]);
+    }
+}
+
+void scan_sweep_ingest(scan_sweep_t *sweep, const scan_pkt_rec_t *rec) {
+    if (rec->channel < 1 || rec->channel > CONFIG_MAX_WIFI_CHANNELS) {
+        return;
+    }
+
+    int index = rec->channel - 1;
+    if (sweep->packet_count[index] == 0 || rec->rssi > sweep->rssi_values[index]) {
+        sweep->rssi_values[index] = rec->rssi;
+    }
+    sweep->packet_count[index]++;
+    sweep->airtime_us[index] += scan_airtime_us(rec);
+    scan_hist_add(&sweep->hist[index], rec->rssi);
+
+    if (rec->noise_floor < 0) {
+        int nf = rec->noise_floor;
+        int32_t *avg = &sweep->nf_avg[index];
+        int32_t sample = nf * (1 << SCAN_NF_FRAC_BITS);
+        *avg = *avg ? *avg + ((sample - *avg) >> CONFIG_SCAN_NF_EWMA_SHIFT) : sample;
+        if (nf < sweep->nf_min[index]) sweep->nf_min[index] = (int8_t)nf;
+        if (nf > sweep->nf_max[index]) sweep->nf_max[index] = (int8_t)nf;
+
+        int bin = (rec->rssi - nf) / CONFIG_SCAN_SNR_BIN_DB;
+        if (bin < 0) bin = 0;
+        if (bin >= SCAN_SNR_BINS) bin = SCAN_SNR_BINS - 1;
+        sweep->snr[index][bin]++;
+    }
+
+    // Check for actual error conditions in rx_state
+    if (rec->rx_state != 0) {  // Non-zero state indicates some kind of error
+        if ((rec->rx_state & BIT(0)) ||     // CRC error
+            (rec->rx_state & BIT(1)) ||     // PHY error
+            (rec->rx_state & BIT(7))) {     // Incomplete reception
+            sweep->error_count[index]++;
+        }
+    }
+}
+
+void scan_sweep_classify(scan_sweep_t *sweep, const scan_pkt_rec_t *rec, bool retry) {
+    if (rec->channel < 1 || rec->channel > CONFIG_MAX_WIFI_CHANNELS) {
+        return;
+    }
+
+    int index = rec->channel - 1;
+    if (retry) {
+        sweep->retries[index]++;
+    } else {
+        sweep->frames[index][scan_frame_classify(rec->fc)]++;
+    }
+}
+
+void scan_dev_reset(scan_dev_set_t *set) {
+    for (int i = 0; i < SCAN_DEV_SKETCHES; i++) {
+        scan_hll_reset(&set->sketch[i]);
+    }
+}
+
+// A corrupt frame would add a random address, a short one the zero address
+static bool has_transmitter(const scan_pkt_rec_t *rec) {
+    return rec->channel >= 1 && rec->channel <= CONFIG_MAX_WIFI_CHANNELS && rec->rx_state == 0 &&
+           !(rec->addr2[0] & 0x01) && rec->sig_len >= SCAN_HDR_ADDR2_END;
+}
+
+void scan_dev_update(scan_dev_set_t *set, const scan_pkt_rec_t *rec) {
+    if (!has_transmitter(rec)) {
+        return;
+    }
+
+    uint32_t hash = scan_hll_hash_mac(rec->addr2);
+    scan_hll_add_hash(&set->sketch[rec->channel - 1], hash);
+    if (scan_frame_classify(rec->fc) == SCAN_FRAME_PROBE_REQ) {
+        scan_hll_add_hash(&set->sketch[SCAN_DEV_PROBES], hash);
+    }
+}
+
+void scan_talkers_reset(scan_talkers_t *talkers) {
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        scan_top_reset(&talkers->frames[i]);
+        scan_top_reset(&talkers->airtime[i]);
+    }
+}
+
+void scan_talkers_update(scan_talkers_t *talkers, const scan_pkt_rec_t *rec) {
+    if (!has_transmitter(rec)) {
+        return;
+    }
+
+    int index = rec->channel - 1;
+    scan_top_add(&talkers->frames[index], rec->addr2, 1);
+    scan_top_add(&talkers->airtime[index], rec->addr2, scan_airtime_us(rec));
+}
+
+size_t scan_sweep_drain(scan_sweep_t *sweep, scan_ring_t *ring) {
+    const scan_agg_t agg = {.sweep = sweep};
+    return scan_agg_drain(&agg, ring, 0);
+}
+
+size_t scan_agg_drain(const scan_agg_t *agg, scan_ring_t *ring, uint32_t now_ms) {
+    scan_pkt_rec_t batch[32];
+    size_t total = 0;
+    size_t n;
+
+    while ((n = scan_ring_pop(ring, batch, sizeof(batch) / sizeof(batch[0]))) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            bool retry = agg->seq_cache && scan_seq_cache_check(agg->seq_cache, &batch[i]);
+            scan_sweep_ingest(agg->sweep, &batch[i]);
+            scan_sweep_classify(agg->sweep, &batch[i], retry);
+            if (agg->stations) {
+                scan_sta_update(agg->stations, &batch[i], now_ms);
+            }
+            if (agg->beacons) {
+                scan_bcn_update(agg->beacons, &batch[i], now_ms);
+            }
+            if (agg->devices) {
+                scan_dev_update(agg->devices, &batch[i]);
+            }
+            if (agg->talkers) {
+                scan_talkers_update(agg->talkers, &batch[i]);
+            }
+        }
+        total += n;
+    }
+    return total;
+}
+
+void scan_report_print_header(void) {
+    printf("# Format for each channel: RSSI(dBm)/Packets[/Errors if any], -/- if not visited\n");
+    printf("# Second row: share of the dwell the channel was busy with received frames\n");
+    printf("# Third row: noise floor running average (dBm)\n");
+    printf("Scan     ");
+    for (int channel = 1; channel <= CONFIG_MAX_WIFI_CHANNELS; channel++) {
+        printf("Ch%-4d       ", channel);
+    }
+    printf("\n");
+}
+
+void scan_report_print(const scan_sweep_t *sweep) {
+    printf("%-6lu", (unsigned long)sweep->iteration);
+    for (int channel = 1; channel <= CONFIG_MAX_WIFI_CHANNELS; channel++) {
+        int index = channel - 1;
+        int rssi = sweep->rssi_values[index];
+        int packets = sweep->packet_count[index];
+        int errors = sweep->error_count[index];
+
+        // Print RSSI and packet count, and errors only if present
+        if (sweep->dwell_ms[index] == 0) {
+            printf("%5s/%-3s    ", "-", "-");
+        } else if (errors > 0) {
+            printf("%5d/%-3d/%-3d ", packets > 0 ? rssi : SCAN_RSSI_FLOOR, packets, errors);
+        } else {
+            printf("%5d/%-3d    ", packets > 0 ? rssi : SCAN_RSSI_FLOOR, packets);
+        }
+    }
+    printf("\n");
+    scan_airtime_report_print(sweep);
+
+    printf("%-6s", "nf");
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        if (sweep->nf_avg[i] == 0) {
+            printf("%9s    ", "-");
+        } else {
+            printf("%9.1f    ", (double)sweep->nf_avg[i] / (1 << SCAN_NF_FRAC_BITS));
+        }
+    }
+    printf("\n");
+
+    if (sweep->dropped > 0) {
+        printf("# Ring overflow: %lu packets dropped\n", (unsigned long)sweep->dropped);
+    }
+}
+
+void scan_class_report_print(const scan_sweep_t *sweep) {
+    // Row labels fit the sweep table's first column
+    static const char *const labels[SCAN_FRAME_CLASSES + 1] = {
+        "beacon", "prbreq", "prbrsp", "auth", "deauth", "action", "rts",
+        "cts", "ack", "back", "data", "qos", "null", "other", "retry",
+    };
+
+    for (int cls = 0; cls <= SCAN_FRAME_CLASSES; cls++) {
+        // The last row is the retransmissions left out of the classes
+        const uint32_t *counts[CONFIG_MAX_WIFI_CHANNELS];
+        uint32_t total = 0;
+
+        for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+            counts[i] = cls < SCAN_FRAME_CLASSES ? &sweep->frames[i][cls] : &sweep->retries[i];
+            total += *counts[i];
+        }
+        if (total == 0) continue;
+
+        printf("%-6s", labels[cls]);
+        for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+            if (sweep->dwell_ms[i] == 0) {
+                printf("%9s    ", "-");
+            } else {
+                printf("%9lu    ", (unsigned long)*counts[i]);
+            }
+        }
+        printf("\n");
+    }
+}
+
+void scan_snr_report_print(const scan_sweep_t *sweep) {
+    printf("# SNR (dB): frames per bin, RSSI minus the frame's noise floor\n");
+    for (int bin = 0; bin < SCAN_SNR_BINS; bin++) {
+        uint32_t total = 0;
+        for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+            total += sweep->snr[i][bin];
+        }
+        if (total == 0) continue;
+
+        // Row labels fit the sweep table's first column
+        char label[8];
+        if (bin == 0) {
+            snprintf(label, sizeof(label), "<%d", CONFIG_SCAN_SNR_BIN_DB);
+        } else if (bin == SCAN_SNR_BINS - 1) {
+            snprintf(label, sizeof(label), "%d+", bin * CONFIG_SCAN_SNR_BIN_DB);
+        } else {
+            snprintf(label, sizeof(label), "%d-%d", bin * CONFIG_SCAN_SNR_BIN_DB, (bin + 1) * CONFIG_SCAN_SNR_BIN_DB - 1);
+        }
+
+        printf("%-6s", label);
+        for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+            if (sweep->dwell_ms[i] == 0) {
+                printf("%9s    ", "-");
+            } else {
+                printf("%9lu    ", (unsigned long)sweep->snr[i][bin]);
+            }
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+// Platform-independent packet processing core of the scanner. Everything in
+// here builds both as part of the ESP-IDF app and on a Linux host (see host/),
+// so it must not depend on FreeRTOS or any driver API.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#include "esp_wifi_types.h"
+#include "scan_ring.h"
+#include "scan_hist.h"
+#include "scan_sta.h"
+#include "scan_bcn.h"
+#include "scan_frame.h"
+#include "scan_filter.h"
+#include "scan_hll.h"
+#include "scan_top.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Configurable parameters
+#ifndef CONFIG_MAX_WIFI_CHANNELS
+#define CONFIG_MAX_WIFI_CHANNELS 13
+#endif
+
+// RSSI reported for channels on which nothing was received
+#define SCAN_RSSI_FLOOR -100
+
+// Each frame moves a channel's noise floor average by 1/2^shift of the difference
+#ifndef CONFIG_SCAN_NF_EWMA_SHIFT
+#define CONFIG_SCAN_NF_EWMA_SHIFT 4
+#endif
+
+// SNR distribution: bin i counts frames with RSSI minus noise floor in
+// [i, i + 1) x CONFIG_SCAN_SNR_BIN_DB, the first bin also everything below
+// and the last everything above
+#ifndef CONFIG_SCAN_SNR_BIN_DB
+#define CONFIG_SCAN_SNR_BIN_DB 5
+#endif
+
+#define SCAN_SNR_BINS 10
+
+// Fixed point of the noise floor average
+#define SCAN_NF_FRAC_BITS 8
+
+// Results of one sweep over all channels
+typedef struct {
+    uint32_t iteration;                             // Sweep number, starting at 1
+    uint32_t dropped;                               // Records lost to ring overflow during the sweep
+    int32_t rssi_values[CONFIG_MAX_WIFI_CHANNELS];  // Strongest RSSI seen per channel
+    int32_t packet_count[CONFIG_MAX_WIFI_CHANNELS];
+    int32_t error_count[CONFIG_MAX_WIFI_CHANNELS];
+    int32_t nf_avg[CONFIG_MAX_WIFI_CHANNELS];       // Noise floor running average, dBm << SCAN_NF_FRAC_BITS,
+                                                    // kept across sweeps, 0 until a frame reported one
+    int8_t nf_min[CONFIG_MAX_WIFI_CHANNELS];        // Noise floor range over the sweep, empty if min > max
+    int8_t nf_max[CONFIG_MAX_WIFI_CHANNELS];
+    uint32_t snr[CONFIG_MAX_WIFI_CHANNELS][SCAN_SNR_BINS];  // Frames by RSSI minus noise floor
+    uint16_t dwell_ms[CONFIG_MAX_WIFI_CHANNELS];    // Listening time per channel, 0 if skipped
+    uint32_t airtime_us[CONFIG_MAX_WIFI_CHANNELS];  // Estimated time on air of received frames
+    scan_hist_t hist[CONFIG_MAX_WIFI_CHANNELS];     // RSSI distribution per channel
+    uint32_t frames[CONFIG_MAX_WIFI_CHANNELS][SCAN_FRAME_CLASSES];  // Per class, retransmissions excluded
+    uint32_t retries[CONFIG_MAX_WIFI_CHANNELS];     // Retransmissions left out of frames
+} scan_sweep_t;
+
+// Distinct transmitters: a sketch per channel, then one of the source
+// addresses of probe requests on any channel. Phones send those from a
+// fresh random address per scan, so they are kept apart from the rest.
+#define SCAN_DEV_PROBES   CONFIG_MAX_WIFI_CHANNELS
+#define SCAN_DEV_SKETCHES (CONFIG_MAX_WIFI_CHANNELS + 1)
+
+typedef struct {
+    scan_hll_t sketch[SCAN_DEV_SKETCHES];
+} scan_dev_set_t;
+
+// Heaviest transmitters per channel by frames and by estimated airtime (us),
+// kept across sweeps, see scan_top.h
+typedef struct {
+    scan_top_t frames[CONFIG_MAX_WIFI_CHANNELS];
+    scan_top_t airtime[CONFIG_MAX_WIFI_CHANNELS];
+} scan_talkers_t;
+
+// Callback side: filter one promiscuous frame and push its record into the ring.
+// Without a filter, management, control and data frames are taken. Returns
+// false if the frame was ignored or the ring was full.
+bool scan_capture(scan_ring_t *ring, scan_filter_t *filter, const wifi_promiscuous_pkt_t *pkt,
+                  wifi_promiscuous_pkt_type_t type);
+
+// The two steps of scan_capture, for callers that also hand accepted frames elsewhere
+bool scan_capture_accept(scan_filter_t *filter, const wifi_promiscuous_pkt_t *pkt,
+                         wifi_promiscuous_pkt_type_t type);
+bool scan_capture_push(scan_ring_t *ring, const wifi_promiscuous_pkt_t *pkt, wifi_promiscuous_pkt_type_t type);
+
+// Aggregator side. Reset leaves dwell_ms alone, that belongs to whoever hops
+// channels, and nf_avg, which follows the noise floor from sweep to sweep.
+void scan_sweep_reset(scan_sweep_t *sweep);
+void scan_sweep_ingest(scan_sweep_t *sweep, const scan_pkt_rec_t *rec);
+
+// Count rec in its frame class, or as a retry if the caller found it to be a retransmission
+void scan_sweep_classify(scan_sweep_t *sweep, const scan_pkt_rec_t *rec, bool retry);
+
+void scan_dev_reset(scan_dev_set_t *set);
+
+// Add the transmitter of rec. Frames with errors, without a transmitter
+// address or with a group address there are left out.
+void scan_dev_update(scan_dev_set_t *set, const scan_pkt_rec_t *rec);
+
+void scan_talkers_reset(scan_talkers_t *talkers);
+
+// Account rec to its transmitter, on the same frames as scan_dev_update
+void scan_talkers_update(scan_talkers_t *talkers, const scan_pkt_rec_t *rec);
+
+// Drain everything currently in the ring into the sweep, returns the record count
+size_t scan_sweep_drain(scan_sweep_t *sweep, scan_ring_t *ring);
+
+// Everything the aggregator feeds from the ring. Members other than sweep may be NULL.
+typedef struct {
+    scan_sweep_t *sweep;
+    scan_sta_table_t *stations;
+    scan_seq_cache_t *seq_cache;    // Without it no frame counts as a retransmission
+    scan_bcn_table_t *beacons;
+    scan_dev_set_t *devices;
+    scan_talkers_t *talkers;
+} scan_agg_t;
+
+// Like scan_sweep_drain, for all consumers in agg. now_ms stamps table entries.
+size_t scan_agg_drain(const scan_agg_t *agg, scan_ring_t *ring, uint32_t now_ms);
+
+// Human-readable sweep table on stdout
+void scan_report_print_header(void);
+void scan_report_print(const scan_sweep_t *sweep);
+
+// Frame classes heard per channel, one row per class that occurred
+void scan_class_report_print(const scan_sweep_t *sweep);
+
+// Frames per SNR bin and channel, one row per bin that occurred
+void scan_snr_report_print(const scan_sweep_t *sweep);
+
+#ifdef __cplusplus
+}
+#endif
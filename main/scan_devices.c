@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <string.h>
+#include "scan_devices.h"
+#include "scan_telemetry.h"
+
+// Payload bytes before the sketches at most: four varints
+#define DEV_FRAME_FIXED 20
+
+void scan_dev_window_init(scan_dev_window_t *win, uint32_t length_ms, int nslots) {
+    if (nslots < 1) nslots = 1;
+    if (nslots > SCAN_DEV_WINDOW_MAX_SLOTS) nslots = SCAN_DEV_WINDOW_MAX_SLOTS;
+    memset(win, 0, SCAN_DEV_WINDOW_SIZE(nslots));
+
+    win->length_ms = length_ms;
+    win->nslots = nslots;
+    win->slot_ms = length_ms / (uint32_t)nslots;
+    if (win->slot_ms == 0) win->slot_ms = 1;
+}
+
+void scan_dev_window_add(scan_dev_window_t *win, const scan_dev_set_t *set, uint32_t now_ms) {
+    if (!win->started) {
+        win->started = true;
+        win->slot_start_ms = now_ms;
+    }
+
+    // After a long pause every slot has expired; no need to rotate one by one
+    if (now_ms - win->slot_start_ms >= win->length_ms + win->slot_ms) {
+        memset(win->slots, 0, (size_t)win->nslots * sizeof(win->slots[0]));
+        win->slot_start_ms = now_ms;
+    }
+    while (now_ms - win->slot_start_ms >= win->slot_ms) {
+        win->cur = (win->cur + 1) % win->nslots;
+        scan_dev_reset(&win->slots[win->cur]);
+        win->slot_start_ms += win->slot_ms;
+    }
+
+    for (int i = 0; i < SCAN_DEV_SKETCHES; i++) {
+        scan_hll_merge(&win->slots[win->cur].sketch[i], &set->sketch[i]);
+    }
+}
+
+void scan_dev_window_union(const scan_dev_window_t *win, scan_dev_set_t *out) {
+    *out = win->slots[0];
+    for (int s = 1; s < win->nslots; s++) {
+        for (int i = 0; i < SCAN_DEV_SKETCHES; i++) {
+            scan_hll_merge(&out->sketch[i], &win->slots[s].sketch[i]);
+        }
+    }
+}
+
+void scan_dev_count(const scan_dev_set_t *set, uint32_t length_ms, scan_dev_counts_t *out) {
+    scan_hll_t all = set->sketch[0];
+
+    out->length_ms = length_ms;
+    for (int i = 0; i < SCAN_DEV_SKETCHES; i++) {
+        out->count[i] = scan_hll_estimate(&set->sketch[i]);
+        if (i > 0 && i < SCAN_DEV_PROBES) {
+            scan_hll_merge(&all, &set->sketch[i]);
+        }
+    }
+    out->all = scan_hll_estimate(&all);
+}
+
+static void print_row(const char *name, const scan_dev_counts_t *counts, size_t n, int index) {
+    printf("%-7s", name);
+    for (size_t c = 0; c < n; c++) {
+        printf(" %8lu", (unsigned long)(index < 0 ? counts[c].all : counts[c].count[index]));
+    }
+    printf("\n");
+}
+
+void scan_dev_report_print(const scan_dev_counts_t *counts, size_t n) {
+    uint32_t err = scan_hll_error_permille();
+
+    printf("# Distinct transmitters, +-%lu.%lu %% standard error; probes counts probe request sources\n",
+           (unsigned long)(err / 10), (unsigned long)(err % 10));
+    printf("%-7s", "Ch");
+    for (size_t c = 0; c < n; c++) {
+        char title[16];
+        uint32_t len_s = counts[c].length_ms / 1000;
+        if (len_s == 0) {
+            snprintf(title, sizeof(title), "Sweep");
+        } else if (len_s % 3600 == 0) {
+            snprintf(title, sizeof(title), "%lu h", (unsigned long)(len_s / 3600));
+        } else if (len_s % 60 == 0) {
+            snprintf(title, sizeof(title), "%lu min", (unsigned long)(len_s / 60));
+        } else {
+            snprintf(title, sizeof(title), "%lu s", (unsigned long)len_s);
+        }
+        printf(" %8s", title);
+    }
+    printf("\n");
+
+    for (int channel = 1; channel <= CONFIG_MAX_WIFI_CHANNELS; channel++) {
+        char name[8];
+        snprintf(name, sizeof(name), "%d", channel);
+        print_row(name, counts, n, channel - 1);
+    }
+    print_row("all", counts, n, -1);
+    print_row("probes", counts, n, SCAN_DEV_PROBES);
+}
+
+size_t scan_dev_encode(uint8_t *buf, size_t cap, uint16_t seq, uint32_t time_ms, uint32_t iteration,
+                       uint32_t window_s, const scan_dev_set_t *set, int *next) {
+    uint8_t sketch[SCAN_HLL_MAX_ENCODED];
+    size_t room = cap > SCAN_TLM_HEADER_LEN + SCAN_TLM_CRC_LEN ? cap - SCAN_TLM_HEADER_LEN - SCAN_TLM_CRC_LEN : 0;
+    size_t used = DEV_FRAME_FIXED;
+    int first = *next;
+    int end = first;
+    uint32_t count = 0;
+
+    if (room > SCAN_TLM_MAX_PAYLOAD) room = SCAN_TLM_MAX_PAYLOAD;
+
+    // Sketches that fit, the channel byte included
+    for (; end < SCAN_DEV_SKETCHES; end++) {
+        if (scan_hll_empty(&set->sketch[end])) continue;
+        size_t n = scan_hll_encode(&set->sketch[end], sketch, sizeof(sketch));
+        if (used + 1 + n > room) break;
+        used += 1 + n;
+        count++;
+    }
+    if (count == 0 && end < SCAN_DEV_SKETCHES) return 0;
+
+    scan_tlm_writer_t w;
+    scan_tlm_begin(&w, buf, cap, SCAN_TLM_DEVICES);
+    scan_tlm_put_varint(&w, time_ms);
+    scan_tlm_put_varint(&w, iteration);
+    scan_tlm_put_varint(&w, window_s);
+    scan_tlm_put_varint(&w, count);
+    for (int i = first; i < end; i++) {
+        if (scan_hll_empty(&set->sketch[i])) continue;
+        scan_tlm_put_u8(&w, i == SCAN_DEV_PROBES ? 0 : (uint8_t)(i + 1));
+        scan_tlm_put_bytes(&w, sketch, scan_hll_encode(&set->sketch[i], sketch, sizeof(sketch)));
+    }
+    *next = end;
+    return scan_tlm_end(&w, seq);
+}
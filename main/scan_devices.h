@@ -0,0 +1,75 @@
+#pragma once
+
+// Distinct transmitters per channel over the sweep and longer windows. The
+// aggregator fills a set of HyperLogLog sketches (scan_dev_set_t, see
+// scan_core.h) during each sweep; windows keep one set per slot and answer
+// with the union of the slots still inside, which is the sketch of every
+// transmitter heard in the window. A sketch cannot forget a transmitter, so
+// unlike the RSSI windows there is no running total, and like them a window
+// covers between (slots - 1) and slots slot lengths of history.
+//
+// Sketches go out as SCAN_TLM_DEVICES frames:
+//
+//   time_ms, iteration, window_s (0 for the sweep), count,
+//   count x { channel (0 for probe request sources), sketch }
+//
+// with sketches serialized as in scan_hll.h and empty ones left out. A set
+// that does not fit in one frame is split over several with the same time
+// and iteration. Sketches of the same precision from any number of frames
+// and scanners merge into the count of their union.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "scan_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCAN_DEV_WINDOW_MAX_SLOTS 6
+
+// A window holds only the slots it was made with; allocate it with
+// SCAN_DEV_WINDOW_SIZE(nslots) bytes
+typedef struct {
+    uint32_t length_ms;
+    uint32_t slot_ms;
+    int nslots;
+    int cur;
+    bool started;
+    uint32_t slot_start_ms;
+    scan_dev_set_t slots[];
+} scan_dev_window_t;
+
+#define SCAN_DEV_WINDOW_SIZE(nslots) (offsetof(scan_dev_window_t, slots) + (size_t)(nslots) * sizeof(scan_dev_set_t))
+
+// Estimates of one set, enough to report it
+typedef struct {
+    uint32_t length_ms;                 // Window length, 0 for a sweep
+    uint32_t count[SCAN_DEV_SKETCHES];
+    uint32_t all;                       // Every channel together
+} scan_dev_counts_t;
+
+// nslots is 1~SCAN_DEV_WINDOW_MAX_SLOTS and at most what win was allocated for
+void scan_dev_window_init(scan_dev_window_t *win, uint32_t length_ms, int nslots);
+
+// Merge the set of a finished sweep that ended at now_ms
+void scan_dev_window_add(scan_dev_window_t *win, const scan_dev_set_t *set, uint32_t now_ms);
+
+// Sketches of the whole window
+void scan_dev_window_union(const scan_dev_window_t *win, scan_dev_set_t *out);
+
+void scan_dev_count(const scan_dev_set_t *set, uint32_t length_ms, scan_dev_counts_t *out);
+
+// Per-channel distinct transmitters, one column per set of counts
+void scan_dev_report_print(const scan_dev_counts_t *counts, size_t n);
+
+// SCAN_TLM_DEVICES frame with the non-empty sketches of set from index *next
+// on, as many as fit. *next moves past them; the set is complete once it
+// reaches SCAN_DEV_SKETCHES. Returns the frame length, 0 if it did not fit.
+size_t scan_dev_encode(uint8_t *buf, size_t cap, uint16_t seq, uint32_t time_ms, uint32_t iteration,
+                       uint32_t window_s, const scan_dev_set_t *set, int *next);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "scan_filter.h"
+
+// Control subtypes the radio can filter, from wrapper (7) to CF-End+ack (15)
+static const uint32_t hw_ctrl_bits[16] = {
+    [7]  = WIFI_PROMIS_CTRL_FILTER_MASK_WRAPPER,
+    [8]  = WIFI_PROMIS_CTRL_FILTER_MASK_BAR,
+    [9]  = WIFI_PROMIS_CTRL_FILTER_MASK_BA,
+    [10] = WIFI_PROMIS_CTRL_FILTER_MASK_PSPOLL,
+    [11] = WIFI_PROMIS_CTRL_FILTER_MASK_RTS,
+    [12] = WIFI_PROMIS_CTRL_FILTER_MASK_CTS,
+    [13] = WIFI_PROMIS_CTRL_FILTER_MASK_ACK,
+    [14] = WIFI_PROMIS_CTRL_FILTER_MASK_CFEND,
+    [15] = (uint32_t)WIFI_PROMIS_CTRL_FILTER_MASK_CFENDACK,
+};
+
+static const uint32_t hw_type_bits[3] = {
+    WIFI_PROMIS_FILTER_MASK_MGMT,
+    WIFI_PROMIS_FILTER_MASK_CTRL,
+    WIFI_PROMIS_FILTER_MASK_DATA,
+};
+
+void scan_filter_config_default(scan_filter_config_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->classes = SCAN_FILTER_ALL_CLASSES;
+    cfg->min_rssi = SCAN_FILTER_RSSI_OFF;
+}
+
+void scan_filter_compile(const scan_filter_config_t *cfg, scan_filter_t *out) {
+    memset(out, 0, sizeof(*out));
+
+    // Subtypes follow from the class table, frame types from the subtypes
+    for (int type = 0; type < 3; type++) {
+        for (int subtype = 0; subtype < 16; subtype++) {
+            if (cfg->classes & (1UL << scan_frame_class_table[type << 4 | subtype])) {
+                out->subtypes[type] |= (uint16_t)(1u << subtype);
+            }
+        }
+        if (out->subtypes[type]) {
+            out->hw_mask |= hw_type_bits[type];
+        }
+        if (out->subtypes[type] != 0 && out->subtypes[type] != 0xFFFF) {
+            out->checks |= SCAN_FILTER_CHECK_SUBTYPE;
+        }
+    }
+    for (int subtype = 0; subtype < 16; subtype++) {
+        if (out->subtypes[SCAN_FC_TYPE_CTRL] & (1u << subtype)) {
+            out->hw_ctrl_mask |= hw_ctrl_bits[subtype];
+        }
+    }
+
+    out->min_rssi = cfg->min_rssi;
+    if (cfg->min_rssi != SCAN_FILTER_RSSI_OFF) {
+        out->checks |= SCAN_FILTER_CHECK_RSSI;
+    }
+
+    out->nallow = cfg->nallow;
+    for (int i = 0; i < cfg->nallow; i++) {
+        out->allow[i] = scan_frame_mac_key(cfg->allow[i]);
+    }
+    if (cfg->nallow) {
+        out->checks |= SCAN_FILTER_CHECK_ALLOW;
+    }
+    out->ndeny = cfg->ndeny;
+    for (int i = 0; i < cfg->ndeny; i++) {
+        out->deny[i] = scan_frame_mac_key(cfg->deny[i]);
+    }
+    if (cfg->ndeny) {
+        out->checks |= SCAN_FILTER_CHECK_DENY;
+    }
+}
+
+bool scan_filter_parse_mac(const char *text, uint8_t mac[6]) {
+    unsigned v[6];
+    char tail;
+
+    if (sscanf(text, "%2x:%2x:%2x:%2x:%2x:%2x%c", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &tail) != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        mac[i] = (uint8_t)v[i];
+    }
+    return true;
+}
+
+bool scan_filter_parse_classes(const char *text, uint32_t *classes) {
+    uint32_t mask = 0;
+    const char *p = text;
+
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        bool found = false;
+
+        if (len == 3 && strncasecmp(p, "all", 3) == 0) {
+            mask |= SCAN_FILTER_ALL_CLASSES;
+            found = true;
+        }
+        for (int cls = 0; cls < SCAN_FRAME_CLASSES && !found; cls++) {
+            const char *name = scan_frame_class_name(cls);
+            if (strlen(name) == len && strncasecmp(p, name, len) == 0) {
+                mask |= 1UL << cls;
+                found = true;
+            }
+        }
+        if (!found) return false;
+
+        p += len;
+        if (*p == ',') p++;
+    }
+    *classes = mask;
+    return true;
+}
+
+bool scan_filter_add_mac(uint8_t list[][6], uint8_t *count, const uint8_t mac[6]) {
+    for (int i = 0; i < *count; i++) {
+        if (memcmp(list[i], mac, 6) == 0) return true;
+    }
+    if (*count >= CONFIG_SCAN_FILTER_MAX_MACS) return false;
+    memcpy(list[(*count)++], mac, 6);
+    return true;
+}
+
+const char *scan_filter_stage_name(scan_filter_stage_t stage) {
+    switch (stage) {
+    case SCAN_FILTER_STAGE_TYPE:    return "type";
+    case SCAN_FILTER_STAGE_RSSI:    return "rssi";
+    case SCAN_FILTER_STAGE_SUBTYPE: return "subtype";
+    case SCAN_FILTER_STAGE_DENY:    return "deny";
+    case SCAN_FILTER_STAGE_ALLOW:   return "allow";
+    default:                        return "unknown";
+    }
+}
+
+static void print_macs(const char *title, const uint8_t list[][6], int count) {
+    printf("%-10s", title);
+    if (count == 0) printf(" -");
+    for (int i = 0; i < count; i++) {
+        printf(" %02x:%02x:%02x:%02x:%02x:%02x",
+               list[i][0], list[i][1], list[i][2], list[i][3], list[i][4], list[i][5]);
+    }
+    printf("\n");
+}
+
+void scan_filter_report_print(const scan_filter_config_t *cfg, const scan_filter_t *f) {
+    printf("%-10s", "classes");
+    if (cfg->classes == SCAN_FILTER_ALL_CLASSES) {
+        printf(" all");
+    } else {
+        for (int cls = 0; cls < SCAN_FRAME_CLASSES; cls++) {
+            if (cfg->classes & (1UL << cls)) printf(" %s", scan_frame_class_name(cls));
+        }
+    }
+    printf("\n");
+    if (cfg->min_rssi == SCAN_FILTER_RSSI_OFF) {
+        printf("%-10s off\n", "min rssi");
+    } else {
+        printf("%-10s %d dBm\n", "min rssi", cfg->min_rssi);
+    }
+    print_macs("allow", cfg->allow, cfg->nallow);
+    print_macs("deny", cfg->deny, cfg->ndeny);
+    printf("%-10s mask 0x%08lx ctrl 0x%08lx\n", "hardware",
+           (unsigned long)f->hw_mask, (unsigned long)f->hw_ctrl_mask);
+
+    // The radio does not count what its filter drops, only the software stages are known
+    uint32_t passed = atomic_load_explicit(&f->passed, memory_order_relaxed);
+    uint32_t total = passed;
+    for (int s = 0; s < SCAN_FILTER_STAGES; s++) {
+        total += atomic_load_explicit(&f->rejected[s], memory_order_relaxed);
+    }
+    printf("# Frames reaching the callback: %lu\n", (unsigned long)total);
+    for (int s = 0; s < SCAN_FILTER_STAGES; s++) {
+        uint32_t n = atomic_load_explicit(&f->rejected[s], memory_order_relaxed);
+        printf("rejected  %-8s %10lu  %5.1f%%\n", scan_filter_stage_name(s), (unsigned long)n,
+               total ? 100.0 * n / total : 0.0);
+    }
+    printf("passed    %-8s %10lu  %5.1f%%\n", "", (unsigned long)passed, total ? 100.0 * passed / total : 0.0);
+}
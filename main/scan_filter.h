@@ -0,0 +1,138 @@
+#pragma once
+
+// Frame filter for packet RSSI mode. A configuration says which frame
+// classes, transmitters and signal levels are wanted. It is compiled into
+// two parts: the promiscuous filter masks, so the radio drops whole frame
+// types and control subtypes before the callback runs, and a compact
+// predicate that the callback applies to what still arrives. The predicate
+// only runs the checks the configuration actually uses, cheapest first, and
+// counts the frames each check rejected.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "esp_wifi_types.h"
+#include "scan_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Entries in each of the allow and deny lists
+#ifndef CONFIG_SCAN_FILTER_MAX_MACS
+#define CONFIG_SCAN_FILTER_MAX_MACS 8
+#endif
+
+// min_rssi that disables the signal check
+#define SCAN_FILTER_RSSI_OFF INT8_MIN
+
+#define SCAN_FILTER_ALL_CLASSES ((1UL << SCAN_FRAME_CLASSES) - 1)
+
+// Software stages, in the order the predicate runs them
+typedef enum {
+    SCAN_FILTER_STAGE_TYPE,     // Packet type not enabled (or not management, control or data)
+    SCAN_FILTER_STAGE_RSSI,     // Below min_rssi
+    SCAN_FILTER_STAGE_SUBTYPE,  // Frame class not enabled
+    SCAN_FILTER_STAGE_DENY,     // Transmitter on the deny list
+    SCAN_FILTER_STAGE_ALLOW,    // Transmitter missing or not on the allow list
+    SCAN_FILTER_STAGES
+} scan_filter_stage_t;
+
+// What the user asked for
+typedef struct {
+    uint32_t classes;           // Bit per scan_frame_class_t
+    int8_t min_rssi;            // dBm, SCAN_FILTER_RSSI_OFF to accept any
+    uint8_t nallow;             // With an allow list, only frames from those transmitters pass
+    uint8_t ndeny;
+    uint8_t allow[CONFIG_SCAN_FILTER_MAX_MACS][6];
+    uint8_t deny[CONFIG_SCAN_FILTER_MAX_MACS][6];
+} scan_filter_config_t;
+
+// Checks the predicate has to run
+#define SCAN_FILTER_CHECK_RSSI    0x01
+#define SCAN_FILTER_CHECK_SUBTYPE 0x02
+#define SCAN_FILTER_CHECK_DENY    0x04
+#define SCAN_FILTER_CHECK_ALLOW   0x08
+
+// Compiled filter. The callback is the only writer of the counters, which
+// restart whenever a new configuration is compiled.
+typedef struct {
+    uint8_t checks;             // SCAN_FILTER_CHECK_*
+    int8_t min_rssi;
+    uint8_t nallow;
+    uint8_t ndeny;
+    uint16_t subtypes[3];       // Accepted subtypes per management, control and data type
+    uint64_t allow[CONFIG_SCAN_FILTER_MAX_MACS];    // Packed by scan_frame_mac_key
+    uint64_t deny[CONFIG_SCAN_FILTER_MAX_MACS];
+    uint32_t hw_mask;           // For esp_wifi_set_promiscuous_filter
+    uint32_t hw_ctrl_mask;      // For esp_wifi_set_promiscuous_ctrl_filter
+    _Atomic uint32_t passed;
+    _Atomic uint32_t rejected[SCAN_FILTER_STAGES];
+} scan_filter_t;
+
+// Everything the scanner handles passes
+void scan_filter_config_default(scan_filter_config_t *cfg);
+
+void scan_filter_compile(const scan_filter_config_t *cfg, scan_filter_t *out);
+
+static inline void scan_filter_count(_Atomic uint32_t *counter) {
+    // Single writer, so a plain load/store is enough
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+static inline bool scan_filter_reject(scan_filter_t *f, scan_filter_stage_t stage) {
+    scan_filter_count(&f->rejected[stage]);
+    return false;
+}
+
+// Callback side fast path. Frames too short for a check's field fail that check.
+static inline bool scan_filter_match(scan_filter_t *f, const wifi_promiscuous_pkt_t *pkt,
+                                     wifi_promiscuous_pkt_type_t type) {
+    const unsigned sig_len = pkt->rx_ctrl.sig_len;
+
+    if ((unsigned)type > WIFI_PKT_DATA || f->subtypes[type] == 0) {
+        return scan_filter_reject(f, SCAN_FILTER_STAGE_TYPE);
+    }
+    if ((f->checks & SCAN_FILTER_CHECK_RSSI) && pkt->rx_ctrl.rssi < f->min_rssi) {
+        return scan_filter_reject(f, SCAN_FILTER_STAGE_RSSI);
+    }
+    if ((f->checks & SCAN_FILTER_CHECK_SUBTYPE) &&
+        (sig_len < 1 || !(f->subtypes[type] & (1u << (pkt->payload[0] >> 4))))) {
+        return scan_filter_reject(f, SCAN_FILTER_STAGE_SUBTYPE);
+    }
+    if (f->checks & (SCAN_FILTER_CHECK_DENY | SCAN_FILTER_CHECK_ALLOW)) {
+        uint64_t key = sig_len >= SCAN_HDR_ADDR2_END ? scan_frame_mac_key(pkt->payload + SCAN_HDR_ADDR2) : 0;
+        bool listed = false;
+
+        for (int i = 0; i < f->ndeny && key; i++) {
+            listed |= f->deny[i] == key;
+        }
+        if (listed) {
+            return scan_filter_reject(f, SCAN_FILTER_STAGE_DENY);
+        }
+        for (int i = 0; i < f->nallow && key; i++) {
+            listed |= f->allow[i] == key;
+        }
+        if ((f->checks & SCAN_FILTER_CHECK_ALLOW) && !listed) {
+            return scan_filter_reject(f, SCAN_FILTER_STAGE_ALLOW);
+        }
+    }
+    scan_filter_count(&f->passed);
+    return true;
+}
+
+// Console helpers. Classes are a comma separated list of
+// scan_frame_class_name() values, or "all".
+bool scan_filter_parse_mac(const char *text, uint8_t mac[6]);
+bool scan_filter_parse_classes(const char *text, uint32_t *classes);
+bool scan_filter_add_mac(uint8_t list[][6], uint8_t *count, const uint8_t mac[6]);
+
+// Configuration, hardware masks and per-stage counters on stdout
+void scan_filter_report_print(const scan_filter_config_t *cfg, const scan_filter_t *f);
+
+const char *scan_filter_stage_name(scan_filter_stage_t stage);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,259 @@
+#include <string.h>
+#include "scan_flog.h"
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t get_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static void encode_header(uint8_t *buf, uint32_t seq, uint32_t boot) {
+    put_le32(buf, SCAN_FLOG_MAGIC);
+    put_le32(buf + 4, seq);
+    put_le32(buf + 8, boot);
+    buf[12] = SCAN_FLOG_VERSION;
+    buf[13] = 0;
+    uint16_t crc = scan_tlm_crc16(buf, 14);
+    buf[14] = crc & 0xFF;
+    buf[15] = crc >> 8;
+}
+
+bool scan_flog_parse_header(const uint8_t *buf, scan_flog_header_t *hdr) {
+    hdr->valid = get_le32(buf) == SCAN_FLOG_MAGIC && buf[12] == SCAN_FLOG_VERSION &&
+                 get_le16(buf + 14) == scan_tlm_crc16(buf, 14);
+    hdr->seq = get_le32(buf + 4);
+    hdr->boot = get_le32(buf + 8);
+    return hdr->valid;
+}
+
+bool scan_flog_mount(scan_flog_t *log, const scan_flog_ops_t *ops, uint32_t size) {
+    bool found = false;
+    uint32_t max_seq = 0;
+    uint32_t max_boot = 0;
+
+    memset(log, 0, sizeof(*log));
+    log->ops = ops;
+    log->nsectors = size / SCAN_FLOG_SECTOR;
+    if (log->nsectors == 0) return false;
+
+    log->head = log->nsectors - 1;     // The first sector opened is then sector 0
+    for (uint32_t s = 0; s < log->nsectors; s++) {
+        uint8_t buf[SCAN_FLOG_HEADER_LEN];
+        scan_flog_header_t hdr;
+
+        if (!ops->read(s * SCAN_FLOG_SECTOR, buf, sizeof(buf), ops->ctx)) return false;
+        if (!scan_flog_parse_header(buf, &hdr)) continue;
+        if (!found || hdr.seq > max_seq) {
+            max_seq = hdr.seq;
+            log->head = s;
+        }
+        if (!found || hdr.boot > max_boot) {
+            max_boot = hdr.boot;
+        }
+        found = true;
+    }
+    log->next_seq = found ? max_seq + 1 : 0;
+    log->boot = found ? max_boot + 1 : 0;
+    return true;
+}
+
+// Write the bytes of the page buffer that are not on flash yet
+static bool write_pending(scan_flog_t *log) {
+    if (log->page_written == log->page_fill) return true;
+
+    uint32_t offset = log->head * SCAN_FLOG_SECTOR + log->page_base + log->page_written;
+    if (!log->ops->write(offset, log->page + log->page_written, log->page_fill - log->page_written, log->ops->ctx)) {
+        log->errors++;
+        log->open = false;
+        return false;
+    }
+    log->page_written = log->page_fill;
+    return true;
+}
+
+static bool put(scan_flog_t *log, const uint8_t *data, size_t len) {
+    while (len) {
+        size_t n = SCAN_FLOG_PAGE - log->page_fill;
+        if (n > len) n = len;
+
+        memcpy(log->page + log->page_fill, data, n);
+        log->page_fill += n;
+        data += n;
+        len -= n;
+        if (log->page_fill == SCAN_FLOG_PAGE) {
+            if (!write_pending(log)) return false;
+            log->page_base += SCAN_FLOG_PAGE;
+            log->page_fill = 0;
+            log->page_written = 0;
+        }
+    }
+    return true;
+}
+
+// Erase the sector after head and start it with a header. A sector that fails
+// is skipped: head still moves, so the next attempt tries the one after.
+static bool open_sector(scan_flog_t *log) {
+    uint8_t hdr[SCAN_FLOG_HEADER_LEN];
+
+    log->head = (log->head + 1) % log->nsectors;
+    log->page_base = 0;
+    log->page_fill = 0;
+    log->page_written = 0;
+    if (!log->ops->erase(log->head * SCAN_FLOG_SECTOR, SCAN_FLOG_SECTOR, log->ops->ctx)) {
+        log->errors++;
+        return false;
+    }
+    log->erases++;
+    log->open = true;
+
+    encode_header(hdr, log->next_seq++, log->boot);
+    return put(log, hdr, sizeof(hdr));
+}
+
+bool scan_flog_append(scan_flog_t *log, const uint8_t *frame, size_t len) {
+    if (log->nsectors == 0 || len > SCAN_FLOG_SECTOR - SCAN_FLOG_HEADER_LEN) return false;
+
+    if (!log->open || log->page_base + log->page_fill + len > SCAN_FLOG_SECTOR) {
+        if (log->open && !write_pending(log)) return false;
+        log->open = false;
+        if (!open_sector(log)) return false;
+    }
+    if (!put(log, frame, len)) return false;
+
+    log->frames++;
+    log->bytes += len;
+    return true;
+}
+
+bool scan_flog_flush(scan_flog_t *log) {
+    return !log->open || write_pending(log);
+}
+
+bool scan_flog_format(scan_flog_t *log) {
+    const scan_flog_ops_t *ops = log->ops;
+    uint32_t size = log->nsectors * SCAN_FLOG_SECTOR;
+
+    if (!ops->erase(0, size, ops->ctx)) {
+        log->errors++;
+        return false;
+    }
+    return scan_flog_mount(log, ops, size);
+}
+
+// Length of the valid frame at buf[off], 0 if there is none
+static size_t frame_at(const uint8_t *buf, size_t off, size_t end, bool *bad_crc) {
+    const uint8_t *p = buf + off;
+
+    *bad_crc = false;
+    if (end - off < SCAN_TLM_HEADER_LEN + SCAN_TLM_CRC_LEN || p[0] != SCAN_TLM_MAGIC0 ||
+        p[1] != SCAN_TLM_MAGIC1 || p[2] == 0 || p[2] > SCAN_TLM_VERSION) {
+        return 0;
+    }
+    size_t payload = get_le16(p + 6);
+    size_t total = SCAN_TLM_HEADER_LEN + payload + SCAN_TLM_CRC_LEN;
+    if (payload > SCAN_TLM_MAX_PAYLOAD || total > end - off) return 0;
+
+    if (get_le16(p + total - SCAN_TLM_CRC_LEN) != scan_tlm_crc16(p + 2, total - SCAN_TLM_CRC_LEN - 2)) {
+        *bad_crc = true;
+        return 0;
+    }
+    return total;
+}
+
+bool scan_flog_walk(const scan_flog_ops_t *ops, uint32_t size, uint8_t *buf, scan_flog_walk_cb_t cb, void *ctx,
+                    scan_flog_walk_stats_t *stats) {
+    uint32_t nsectors = size / SCAN_FLOG_SECTOR;
+    uint32_t start = 0;
+    uint32_t max_seq = 0;
+    bool found = false;
+
+    memset(stats, 0, sizeof(*stats));
+
+    // Sectors are written in ring order, so the oldest follows the newest.
+    // The lowest seq would not do: a sector whose erase failed keeps the seq
+    // of an old pass wherever it is.
+    for (uint32_t s = 0; s < nsectors; s++) {
+        scan_flog_header_t hdr;
+
+        if (!ops->read(s * SCAN_FLOG_SECTOR, buf, SCAN_FLOG_HEADER_LEN, ops->ctx)) return false;
+        if (scan_flog_parse_header(buf, &hdr) && (!found || hdr.seq > max_seq)) {
+            max_seq = hdr.seq;
+            start = (s + 1) % nsectors;
+            found = true;
+        }
+    }
+    if (!found) return true;
+
+    uint32_t prev_seq = 0;
+    bool have_prev = false;
+    for (uint32_t i = 0; i < nsectors; i++) {
+        uint32_t s = (start + i) % nsectors;
+        scan_flog_header_t hdr;
+
+        if (!ops->read(s * SCAN_FLOG_SECTOR, buf, SCAN_FLOG_SECTOR, ops->ctx)) return false;
+        if (!scan_flog_parse_header(buf, &hdr) || hdr.seq > max_seq || (have_prev && hdr.seq <= prev_seq)) continue;
+        prev_seq = hdr.seq;
+        have_prev = true;
+        stats->sectors++;
+
+        size_t off = SCAN_FLOG_HEADER_LEN;
+        while (off < SCAN_FLOG_SECTOR) {
+            bool bad_crc;
+            size_t len = frame_at(buf, off, SCAN_FLOG_SECTOR, &bad_crc);
+
+            if (len == 0) {
+                stats->bad += bad_crc;
+                off++;
+                continue;
+            }
+
+            scan_flog_record_t rec = {
+                .boot = hdr.boot,
+                .sector = s,
+                .raw = buf + off,
+                .len = len,
+                .frame = {
+                    .version = buf[off + 2],
+                    .type = buf[off + 3],
+                    .seq = get_le16(buf + off + 4),
+                    .len = get_le16(buf + off + 6),
+                    .payload = buf + off + SCAN_TLM_HEADER_LEN,
+                },
+            };
+            stats->frames++;
+            if (!cb(&rec, ctx)) return true;
+            off += len;
+        }
+    }
+    return true;
+}
+
+bool scan_flog_frame_time(const scan_tlm_frame_t *frame, uint32_t *time_ms) {
+    scan_tlm_reader_t r;
+
+    scan_tlm_reader_init(&r, frame->payload, frame->len);
+    switch (frame->type) {
+    case SCAN_TLM_SWEEP:
+    case SCAN_TLM_SWEEP_MORE:
+        scan_tlm_get_varint(&r);    // iteration
+        break;
+    case SCAN_TLM_APS:
+    case SCAN_TLM_STATS:
+    case SCAN_TLM_EVENTS:
+    case SCAN_TLM_DEVICES:
+        break;
+    default:
+        return false;
+    }
+    *time_ms = scan_tlm_get_varint(&r);
+    return !r.error;
+}
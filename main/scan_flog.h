@@ -0,0 +1,114 @@
+#pragma once
+
+// Circular log of telemetry frames in a raw flash partition, for units that
+// run unattended with no host attached.
+//
+// The partition is a ring of 4 KB sectors, written strictly in order, so every
+// sector is erased once per pass over the partition and wear is even. Each
+// sector starts with a header
+//
+//   magic (u32 LE) | seq (u32 LE) | boot (u32 LE) | version | reserved | crc (u16 LE)
+//
+// where seq grows by one per sector opened and boot by one per mount. The rest
+// of the sector holds complete telemetry frames (see scan_telemetry.h) back to
+// back; a frame never spans two sectors. Frames are batched in RAM and written
+// a flash page at a time, never crossing a page.
+//
+// Every mount opens a fresh sector, so a sector holds the records of one boot.
+// After a power loss the tail of the last sector may be erased or torn; readers
+// hunt for the frame magic and drop frames whose CRC does not match, so only
+// the records not yet flushed are lost.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "scan_telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCAN_FLOG_SECTOR     4096
+#define SCAN_FLOG_PAGE       256
+#define SCAN_FLOG_HEADER_LEN 16
+#define SCAN_FLOG_MAGIC      0x474F4C53u     // "SLOG"
+#define SCAN_FLOG_VERSION    1
+
+// Offsets are from the start of the partition; erases are whole sectors
+typedef struct {
+    bool (*read)(uint32_t offset, void *buf, size_t len, void *ctx);
+    bool (*write)(uint32_t offset, const void *buf, size_t len, void *ctx);
+    bool (*erase)(uint32_t offset, size_t len, void *ctx);
+    void *ctx;
+} scan_flog_ops_t;
+
+typedef struct {
+    const scan_flog_ops_t *ops;
+    uint32_t nsectors;
+    uint32_t boot;              // Of this mount
+    uint32_t next_seq;          // For the next sector opened
+    uint32_t head;              // Sector being written
+    bool open;                  // head belongs to this mount and has room left
+    uint8_t page[SCAN_FLOG_PAGE];
+    uint32_t page_base;         // Offset of page[0] in the head sector
+    uint32_t page_fill;         // Bytes of page in use
+    uint32_t page_written;      // Bytes of page already on flash
+    uint32_t frames;            // Appended since the mount
+    uint32_t bytes;
+    uint32_t erases;
+    uint32_t errors;            // Failed flash operations
+} scan_flog_t;
+
+typedef struct {
+    bool valid;
+    uint32_t seq;
+    uint32_t boot;
+} scan_flog_header_t;
+
+// Find the newest sector in a partition of size bytes. Returns false if the
+// partition holds no whole sector or a header read failed.
+bool scan_flog_mount(scan_flog_t *log, const scan_flog_ops_t *ops, uint32_t size);
+
+// Append one complete frame. Fails for frames larger than a sector's payload
+// and on flash errors, after which the log moves on to the next sector.
+bool scan_flog_append(scan_flog_t *log, const uint8_t *frame, size_t len);
+
+// Write out the part of the current page that is not on flash yet
+bool scan_flog_flush(scan_flog_t *log);
+
+// Erase every sector and mount the empty log
+bool scan_flog_format(scan_flog_t *log);
+
+bool scan_flog_parse_header(const uint8_t *buf, scan_flog_header_t *hdr);
+
+// A frame found while walking the log; raw and len cover the whole frame
+typedef struct {
+    uint32_t boot;
+    uint32_t sector;
+    const uint8_t *raw;
+    size_t len;
+    scan_tlm_frame_t frame;
+} scan_flog_record_t;
+
+// Return false to end the walk
+typedef bool (*scan_flog_walk_cb_t)(const scan_flog_record_t *rec, void *ctx);
+
+typedef struct {
+    uint32_t sectors;           // Sectors with a valid header
+    uint32_t frames;
+    uint32_t bad;               // Frames with a good header but a bad CRC
+} scan_flog_walk_stats_t;
+
+// Call cb for every frame from the oldest sector to the newest, reading one
+// sector at a time into buf (SCAN_FLOG_SECTOR bytes). Sectors the writer
+// recycles while the walk runs, and those left over from an old pass because
+// their erase failed, are skipped, as their seq is out of order.
+bool scan_flog_walk(const scan_flog_ops_t *ops, uint32_t size, uint8_t *buf, scan_flog_walk_cb_t cb, void *ctx,
+                    scan_flog_walk_stats_t *stats);
+
+// time_ms of a sweep, AP, stats, events or devices frame, false for other record types
+bool scan_flog_frame_time(const scan_tlm_frame_t *frame, uint32_t *time_ms);
+
+#ifdef __cplusplus
+}
+#endif
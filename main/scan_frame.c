@@ -0,0 +1,95 @@
+#include <string.h>
+#include "scan_frame.h"
+
+#define SEQ_MASK (CONFIG_SCAN_SEQ_CACHE_SIZE - 1)
+
+#define B  SCAN_FRAME_BEACON
+#define PQ SCAN_FRAME_PROBE_REQ
+#define PR SCAN_FRAME_PROBE_RESP
+#define AU SCAN_FRAME_AUTH
+#define DA SCAN_FRAME_DEAUTH
+#define AC SCAN_FRAME_ACTION
+#define RT SCAN_FRAME_RTS
+#define CT SCAN_FRAME_CTS
+#define AK SCAN_FRAME_ACK
+#define BA SCAN_FRAME_BLOCK_ACK
+#define D  SCAN_FRAME_DATA
+#define QD SCAN_FRAME_QOS_DATA
+#define NL SCAN_FRAME_NULL
+#define O  SCAN_FRAME_OTHER
+
+const uint8_t scan_frame_class_table[64] = {
+    // Management: assoc req/resp, reassoc req/resp, probe req/resp, timing adv, -,
+    // beacon, ATIM, disassoc, auth, deauth, action, action no ack, -
+    AU, AU, AU, AU, PQ, PR, O,  O,  B,  O,  DA, AU, DA, AC, AC, O,
+    // Control: -, -, -, -, beamforming poll, NDP announce, extension, wrapper,
+    // BAR, BA, PS-Poll, RTS, CTS, ACK, CF-End, CF-End+ack
+    O,  O,  O,  O,  O,  O,  O,  O,  BA, BA, O,  RT, CT, AK, O,  O,
+    // Data: data and CF variants, null and CF variants, QoS data and CF
+    // variants, QoS null, -, QoS CF variants without data
+    D,  D,  D,  D,  NL, NL, NL, NL, QD, QD, QD, QD, NL, O,  NL, NL,
+    // Extension
+    O,  O,  O,  O,  O,  O,  O,  O,  O,  O,  O,  O,  O,  O,  O,  O,
+};
+
+#undef B
+#undef PQ
+#undef PR
+#undef AU
+#undef DA
+#undef AC
+#undef RT
+#undef CT
+#undef AK
+#undef BA
+#undef D
+#undef QD
+#undef NL
+#undef O
+
+const char *scan_frame_class_name(scan_frame_class_t cls) {
+    static const char *const names[SCAN_FRAME_CLASSES] = {
+        [SCAN_FRAME_BEACON]     = "beacon",
+        [SCAN_FRAME_PROBE_REQ]  = "probe_req",
+        [SCAN_FRAME_PROBE_RESP] = "probe_resp",
+        [SCAN_FRAME_AUTH]       = "auth",
+        [SCAN_FRAME_DEAUTH]     = "deauth",
+        [SCAN_FRAME_ACTION]     = "action",
+        [SCAN_FRAME_RTS]        = "rts",
+        [SCAN_FRAME_CTS]        = "cts",
+        [SCAN_FRAME_ACK]        = "ack",
+        [SCAN_FRAME_BLOCK_ACK]  = "block_ack",
+        [SCAN_FRAME_DATA]       = "data",
+        [SCAN_FRAME_QOS_DATA]   = "qos_data",
+        [SCAN_FRAME_NULL]       = "null",
+        [SCAN_FRAME_OTHER]      = "other",
+    };
+    return (unsigned)cls < SCAN_FRAME_CLASSES ? names[cls] : "unknown";
+}
+
+#define SEQ_ADDR_GROUP (1ULL << 40)     // I/G bit of the first address byte
+#define SEQ_SHIFT      48
+
+void scan_seq_cache_init(scan_seq_cache_t *cache) {
+    memset(cache, 0, sizeof(*cache));
+}
+
+bool scan_seq_cache_check(scan_seq_cache_t *cache, const scan_pkt_rec_t *rec) {
+    int type = SCAN_FC_TYPE(rec->fc);
+
+    // Only management and data frames carry a sequence number
+    if ((type != SCAN_FC_TYPE_MGMT && type != SCAN_FC_TYPE_DATA) || rec->sig_len < SCAN_HDR_SEQ_END) {
+        return false;
+    }
+    uint64_t key = scan_frame_mac_key(rec->addr2);
+    // Group or missing transmitter address
+    if (key == 0 || (key & SEQ_ADDR_GROUP)) return false;
+
+    // Same Fibonacci hash as the station table, on fewer bits
+    uint64_t *slot = &cache->slots[((key * 0x9E3779B97F4A7C15ULL) >> 40) & SEQ_MASK];
+    uint64_t entry = key | (uint64_t)rec->seq_ctrl << SEQ_SHIFT;
+    bool retry = (rec->fc & SCAN_FC_RETRY) && *slot == entry;
+
+    *slot = entry;
+    return retry;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+// 802.11 frame classification from the frame control field, and suppression
+// of retransmitted frames. The class of a frame is one table lookup on its
+// type and subtype; retransmissions are recognised by the retry bit together
+// with a repeated sequence number from the same transmitter.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "scan_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Transmitters remembered for retransmission checks, must be a power of two
+#ifndef CONFIG_SCAN_SEQ_CACHE_SIZE
+#define CONFIG_SCAN_SEQ_CACHE_SIZE 64
+#endif
+
+_Static_assert((CONFIG_SCAN_SEQ_CACHE_SIZE & (CONFIG_SCAN_SEQ_CACHE_SIZE - 1)) == 0,
+               "CONFIG_SCAN_SEQ_CACHE_SIZE must be a power of two");
+
+// Offsets in the 802.11 MAC header
+#define SCAN_HDR_FC_END    2
+#define SCAN_HDR_ADDR2     10
+#define SCAN_HDR_ADDR2_END 16
+#define SCAN_HDR_SEQ       22
+#define SCAN_HDR_SEQ_END   24
+
+// Fixed fields at the start of a beacon body
+#define SCAN_BCN_TSF        24
+#define SCAN_BCN_INTERVAL   32
+#define SCAN_BCN_FIXED_END  34
+
+// Frame control bits, fc as stored in scan_pkt_rec_t
+#define SCAN_FC_TYPE(fc)    (((fc) >> 2) & 0x3)
+#define SCAN_FC_SUBTYPE(fc) (((fc) >> 4) & 0xF)
+#define SCAN_FC_RETRY       0x0800
+
+#define SCAN_FC_TYPE_MGMT   0
+#define SCAN_FC_TYPE_CTRL   1
+#define SCAN_FC_TYPE_DATA   2
+
+#define SCAN_FC_SUBTYPE_BEACON 8
+
+typedef enum {
+    SCAN_FRAME_BEACON,
+    SCAN_FRAME_PROBE_REQ,
+    SCAN_FRAME_PROBE_RESP,
+    SCAN_FRAME_AUTH,        // Authentication, (re)association request and response
+    SCAN_FRAME_DEAUTH,      // Deauthentication and disassociation
+    SCAN_FRAME_ACTION,
+    SCAN_FRAME_RTS,
+    SCAN_FRAME_CTS,
+    SCAN_FRAME_ACK,
+    SCAN_FRAME_BLOCK_ACK,   // Block ack and block ack request
+    SCAN_FRAME_DATA,
+    SCAN_FRAME_QOS_DATA,
+    SCAN_FRAME_NULL,        // Null and QoS null, power save signalling
+    SCAN_FRAME_OTHER,
+    SCAN_FRAME_CLASSES
+} scan_frame_class_t;
+
+// Indexed by type << 4 | subtype
+extern const uint8_t scan_frame_class_table[64];
+
+static inline scan_frame_class_t scan_frame_classify(uint16_t fc) {
+    return (scan_frame_class_t)scan_frame_class_table[SCAN_FC_TYPE(fc) << 4 | SCAN_FC_SUBTYPE(fc)];
+}
+
+const char *scan_frame_class_name(scan_frame_class_t cls);
+
+// 48-bit address as an integer, first byte most significant
+static inline uint64_t scan_frame_mac_key(const uint8_t mac[6]) {
+    uint64_t key = 0;
+    for (int i = 0; i < 6; i++) {
+        key = key << 8 | mac[i];
+    }
+    return key;
+}
+
+// Last sequence control seen per transmitter, direct mapped on addr2. A
+// collision replaces the older transmitter, which at worst lets one
+// retransmission through. Each slot packs the address into the low 48 bits
+// and the sequence control into the top 16, so a lookup is one compare.
+typedef struct {
+    uint64_t slots[CONFIG_SCAN_SEQ_CACHE_SIZE];
+} scan_seq_cache_t;
+
+void scan_seq_cache_init(scan_seq_cache_t *cache);
+
+// True if rec is a retransmission of the last frame from its transmitter.
+// Records the frame's sequence number either way.
+bool scan_seq_cache_check(scan_seq_cache_t *cache, const scan_pkt_rec_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
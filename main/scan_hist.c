@@ -0,0 +1,55 @@
+#include <string.h>
+#include "scan_hist.h"
+
+void scan_hist_reset(scan_hist_t *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+void scan_hist_merge(scan_hist_t *dst, const scan_hist_t *src) {
+    if (src->count == 0) return;
+
+    for (int i = 0; i < SCAN_HIST_BINS; i++) {
+        dst->bins[i] += src->bins[i];
+    }
+    if (dst->count == 0 || src->min < dst->min) dst->min = src->min;
+    if (dst->count == 0 || src->max > dst->max) dst->max = src->max;
+    dst->count += src->count;
+}
+
+void scan_hist_subtract(scan_hist_t *dst, const scan_hist_t *src) {
+    for (int i = 0; i < SCAN_HIST_BINS; i++) {
+        dst->bins[i] -= src->bins[i];
+    }
+    dst->count -= src->count;
+}
+
+int scan_hist_percentile(const scan_hist_t *h, unsigned pct) {
+    if (h->count == 0) return 0;
+
+    uint32_t rank = (uint32_t)(((uint64_t)h->count * pct + 99) / 100);
+    if (rank == 0) rank = 1;
+
+    uint32_t seen = 0;
+    int bin = SCAN_HIST_BINS - 1;
+    for (int i = 0; i < SCAN_HIST_BINS; i++) {
+        seen += h->bins[i];
+        if (seen >= rank) {
+            bin = i;
+            break;
+        }
+    }
+
+    int value = CONFIG_SCAN_HIST_MIN_DBM + bin * CONFIG_SCAN_HIST_BIN_DB;
+    if (value < h->min) value = h->min;
+    if (value > h->max) value = h->max;
+    return value;
+}
+
+void scan_hist_summarize(const scan_hist_t *h, scan_hist_summary_t *out) {
+    out->count = h->count;
+    out->min = h->min;
+    out->max = h->max;
+    out->p10 = (int8_t)scan_hist_percentile(h, 10);
+    out->p50 = (int8_t)scan_hist_percentile(h, 50);
+    out->p90 = (int8_t)scan_hist_percentile(h, 90);
+}
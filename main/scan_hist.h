@@ -0,0 +1,76 @@
+#pragma once
+
+// Fixed-bin RSSI histogram. Adding a sample is one increment and two compares,
+// so it is cheap enough for the aggregation path and never allocates.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Binned range; samples outside it land in the end bins, min and max stay exact
+#ifndef CONFIG_SCAN_HIST_MIN_DBM
+#define CONFIG_SCAN_HIST_MIN_DBM -100
+#endif
+
+#ifndef CONFIG_SCAN_HIST_MAX_DBM
+#define CONFIG_SCAN_HIST_MAX_DBM -20
+#endif
+
+#ifndef CONFIG_SCAN_HIST_BIN_DB
+#define CONFIG_SCAN_HIST_BIN_DB 2
+#endif
+
+#define SCAN_HIST_BINS ((CONFIG_SCAN_HIST_MAX_DBM - CONFIG_SCAN_HIST_MIN_DBM) / CONFIG_SCAN_HIST_BIN_DB + 1)
+
+typedef struct {
+    uint32_t count;
+    int8_t min;
+    int8_t max;
+    uint32_t bins[SCAN_HIST_BINS];
+} scan_hist_t;
+
+// Percentiles read back from a histogram, in dBm. Only valid if count > 0.
+typedef struct {
+    uint32_t count;
+    int8_t min;
+    int8_t p10;
+    int8_t p50;
+    int8_t p90;
+    int8_t max;
+} scan_hist_summary_t;
+
+void scan_hist_reset(scan_hist_t *h);
+
+static inline void scan_hist_add(scan_hist_t *h, int rssi) {
+    int bin = (rssi - CONFIG_SCAN_HIST_MIN_DBM) / CONFIG_SCAN_HIST_BIN_DB;
+    if (bin < 0) bin = 0;
+    if (bin >= SCAN_HIST_BINS) bin = SCAN_HIST_BINS - 1;
+
+    h->bins[bin]++;
+    if (h->count == 0 || rssi < h->min) h->min = (int8_t)rssi;
+    if (h->count == 0 || rssi > h->max) h->max = (int8_t)rssi;
+    h->count++;
+}
+
+// dst += src
+void scan_hist_merge(scan_hist_t *dst, const scan_hist_t *src);
+
+// dst -= src for bins and count. src must have been merged into dst before;
+// min and max cannot be recovered this way and are left for the caller to fix.
+void scan_hist_subtract(scan_hist_t *dst, const scan_hist_t *src);
+
+// Nearest-rank percentile, reported as the lower edge of its bin clamped to [min, max]
+int scan_hist_percentile(const scan_hist_t *h, unsigned pct);
+
+void scan_hist_summarize(const scan_hist_t *h, scan_hist_summary_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,172 @@
+#include <string.h>
+#include <math.h>
+#include "scan_hll.h"
+
+#define HLL_DENSE 0x80
+#define HLL_RANK_BITS 5
+
+void scan_hll_reset(scan_hll_t *h) {
+    memset(h->reg, 0, sizeof(h->reg));
+}
+
+// splitmix64 finalizer over the address, high half kept
+uint32_t scan_hll_hash_mac(const uint8_t mac[6]) {
+    uint64_t x = (uint64_t)mac[0] << 40 | (uint64_t)mac[1] << 32 | (uint64_t)mac[2] << 24 |
+                 (uint64_t)mac[3] << 16 | (uint64_t)mac[4] << 8 | mac[5];
+
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (uint32_t)(x >> 32);
+}
+
+void scan_hll_merge(scan_hll_t *dst, const scan_hll_t *src) {
+    for (uint32_t i = 0; i < SCAN_HLL_REGS; i++) {
+        if (src->reg[i] > dst->reg[i]) {
+            dst->reg[i] = src->reg[i];
+        }
+    }
+}
+
+bool scan_hll_empty(const scan_hll_t *h) {
+    for (uint32_t i = 0; i < SCAN_HLL_REGS; i++) {
+        if (h->reg[i]) return false;
+    }
+    return true;
+}
+
+uint32_t scan_hll_estimate(const scan_hll_t *h) {
+    const float m = (float)SCAN_HLL_REGS;
+    float sum = 0.0f;
+    uint32_t zeros = 0;
+
+    for (uint32_t i = 0; i < SCAN_HLL_REGS; i++) {
+        sum += ldexpf(1.0f, -h->reg[i]);
+        zeros += h->reg[i] == 0;
+    }
+
+    float alpha = SCAN_HLL_REGS == 16 ? 0.673f : SCAN_HLL_REGS == 32 ? 0.697f : SCAN_HLL_REGS == 64 ? 0.709f
+                                                 : 0.7213f / (1.0f + 1.079f / m);
+    float e = alpha * m * m / sum;
+    if (e <= 2.5f * m && zeros > 0) {
+        e = m * logf(m / (float)zeros);
+    }
+    return (uint32_t)lroundf(e);
+}
+
+uint32_t scan_hll_error_permille(void) {
+    return (uint32_t)lroundf(1040.0f / sqrtf((float)SCAN_HLL_REGS));
+}
+
+static size_t varint_len(uint32_t v) {
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static size_t put_varint(uint8_t *p, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static size_t get_varint(const uint8_t *p, const uint8_t *end, uint32_t *v) {
+    uint32_t x = 0;
+    for (size_t n = 0; n < 5 && p + n < end; n++) {
+        x |= (uint32_t)(p[n] & 0x7f) << (7 * n);
+        if (!(p[n] & 0x80)) {
+            *v = x;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+size_t scan_hll_encode(const scan_hll_t *h, uint8_t *buf, size_t cap) {
+    const size_t dense_len = SCAN_HLL_MAX_ENCODED;
+    size_t sparse_len = 0;
+    uint32_t nonzero = 0;
+    uint32_t prev = 0;
+
+    for (uint32_t i = 0; i < SCAN_HLL_REGS; i++) {
+        if (!h->reg[i]) continue;
+        sparse_len += varint_len((i - prev) << HLL_RANK_BITS | h->reg[i]);
+        prev = i;
+        nonzero++;
+    }
+    sparse_len += 1 + varint_len(nonzero);
+
+    if (sparse_len < dense_len) {
+        if (cap < sparse_len) return 0;
+        size_t n = 0;
+        buf[n++] = CONFIG_SCAN_HLL_PRECISION;
+        n += put_varint(buf + n, nonzero);
+        prev = 0;
+        for (uint32_t i = 0; i < SCAN_HLL_REGS; i++) {
+            if (!h->reg[i]) continue;
+            n += put_varint(buf + n, (i - prev) << HLL_RANK_BITS | h->reg[i]);
+            prev = i;
+        }
+        return n;
+    }
+
+    if (cap < dense_len) return 0;
+    memset(buf, 0, dense_len);
+    buf[0] = CONFIG_SCAN_HLL_PRECISION | HLL_DENSE;
+    for (uint32_t i = 0; i < SCAN_HLL_REGS; i++) {
+        uint32_t bit = i * HLL_RANK_BITS;
+        uint32_t v = (uint32_t)h->reg[i] << (bit % 8);
+        buf[1 + bit / 8] |= (uint8_t)v;
+        if (v >> 8) {
+            buf[2 + bit / 8] |= (uint8_t)(v >> 8);
+        }
+    }
+    return dense_len;
+}
+
+size_t scan_hll_decode(scan_hll_t *h, const uint8_t *buf, size_t len) {
+    const uint8_t *end = buf + len;
+
+    if (len < 1 || (buf[0] & ~HLL_DENSE) != CONFIG_SCAN_HLL_PRECISION) return 0;
+    scan_hll_reset(h);
+
+    if (buf[0] & HLL_DENSE) {
+        if (len < SCAN_HLL_MAX_ENCODED) return 0;
+        for (uint32_t i = 0; i < SCAN_HLL_REGS; i++) {
+            uint32_t bit = i * HLL_RANK_BITS;
+            uint32_t v = buf[1 + bit / 8];
+            if (bit % 8 > 8 - HLL_RANK_BITS) {
+                v |= (uint32_t)buf[2 + bit / 8] << 8;
+            }
+            h->reg[i] = (uint8_t)((v >> (bit % 8)) & ((1u << HLL_RANK_BITS) - 1));
+        }
+        return SCAN_HLL_MAX_ENCODED;
+    }
+
+    const uint8_t *p = buf + 1;
+    uint32_t nonzero;
+    size_t n = get_varint(p, end, &nonzero);
+    if (n == 0 || nonzero > SCAN_HLL_REGS) return 0;
+    p += n;
+
+    uint32_t index = 0;
+    for (uint32_t k = 0; k < nonzero; k++) {
+        uint32_t v;
+        n = get_varint(p, end, &v);
+        if (n == 0) return 0;
+        p += n;
+        index += v >> HLL_RANK_BITS;
+        if (index >= SCAN_HLL_REGS) return 0;
+        h->reg[index] = (uint8_t)(v & ((1u << HLL_RANK_BITS) - 1));
+    }
+    return (size_t)(p - buf);
+}
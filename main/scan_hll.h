@@ -0,0 +1,87 @@
+#pragma once
+
+// HyperLogLog sketch for counting distinct transmitters. A 48-bit address is
+// hashed to 32 bits; the top CONFIG_SCAN_HLL_PRECISION bits pick a register
+// and the register keeps the longest run of leading zeros (plus one) seen in
+// the remaining bits. Memory is one byte per register whatever the count,
+// the standard error is 1.04 / sqrt(registers), and two sketches of the same
+// precision merge into the sketch of the union by taking the larger register.
+//
+// Serialized form, self-delimiting:
+//
+//   precision | 0x80 if dense,
+//   sparse: n, n x varint(index delta << 5 | register), non-zero registers
+//           in index order, the first delta from index 0
+//   dense:  every register in 5 bits, packed from the least significant bit
+//
+// The encoder picks whichever is shorter, so a sketch of a quiet channel
+// costs a few bytes and a full one 5/8 of a byte per register.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Registers are 2^CONFIG_SCAN_HLL_PRECISION, 4~16. At 8 the standard error is 6.5%.
+#ifndef CONFIG_SCAN_HLL_PRECISION
+#define CONFIG_SCAN_HLL_PRECISION 8
+#endif
+
+_Static_assert(CONFIG_SCAN_HLL_PRECISION >= 4 && CONFIG_SCAN_HLL_PRECISION <= 16,
+               "CONFIG_SCAN_HLL_PRECISION must be 4~16");
+
+#define SCAN_HLL_REGS (1u << CONFIG_SCAN_HLL_PRECISION)
+
+// Serialized size at most, dense plus the header byte
+#define SCAN_HLL_MAX_ENCODED (1 + (SCAN_HLL_REGS * 5 + 7) / 8)
+
+typedef struct {
+    uint8_t reg[SCAN_HLL_REGS];
+} scan_hll_t;
+
+void scan_hll_reset(scan_hll_t *h);
+
+uint32_t scan_hll_hash_mac(const uint8_t mac[6]);
+
+static inline void scan_hll_add_hash(scan_hll_t *h, uint32_t hash) {
+    uint32_t index = hash >> (32 - CONFIG_SCAN_HLL_PRECISION);
+    uint32_t rest = hash << CONFIG_SCAN_HLL_PRECISION;
+    uint8_t rank = rest ? (uint8_t)(__builtin_clz(rest) + 1) : (uint8_t)(32 - CONFIG_SCAN_HLL_PRECISION + 1);
+
+    if (rank > h->reg[index]) {
+        h->reg[index] = rank;
+    }
+}
+
+static inline void scan_hll_add_mac(scan_hll_t *h, const uint8_t mac[6]) {
+    scan_hll_add_hash(h, scan_hll_hash_mac(mac));
+}
+
+// dst becomes the sketch of the union
+void scan_hll_merge(scan_hll_t *dst, const scan_hll_t *src);
+
+bool scan_hll_empty(const scan_hll_t *h);
+
+// Distinct values added, with linear counting while many registers are empty
+uint32_t scan_hll_estimate(const scan_hll_t *h);
+
+// Standard error of an estimate, permille
+uint32_t scan_hll_error_permille(void);
+
+// Returns the bytes written, 0 if cap is too small
+size_t scan_hll_encode(const scan_hll_t *h, uint8_t *buf, size_t cap);
+
+// Returns the bytes consumed, 0 if the input is malformed, truncated or of
+// another precision
+size_t scan_hll_decode(scan_hll_t *h, const uint8_t *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,80 @@
+#include <string.h>
+#include "scan_out.h"
+
+enum {
+    SLOT_FREE,
+    SLOT_FILLING,   // Producer's
+    SLOT_READY,     // Published, waiting for the writer
+    SLOT_WRITING,   // Writer's
+};
+
+static bool claim(scan_out_t *o, int slot, uint8_t from, uint8_t to) {
+    return atomic_compare_exchange_strong_explicit(&o->state[slot], &from, to, memory_order_acq_rel,
+                                                   memory_order_relaxed);
+}
+
+void scan_out_init(scan_out_t *o) {
+    memset(o, 0, sizeof(*o));
+    for (int i = 0; i < 2; i++) {
+        atomic_init(&o->state[i], SLOT_FREE);
+    }
+    o->filling = -1;
+}
+
+scan_out_sweep_t *scan_out_begin(scan_out_t *o) {
+    // At most one slot is ready and the writer holds at most one. A claim
+    // only fails if the writer took the ready slot in between, and it had
+    // released its previous one before that, so the second pass succeeds.
+    while (1) {
+        for (int i = 0; i < 2; i++) {
+            if (claim(o, i, SLOT_READY, SLOT_FILLING)) {
+                o->carry |= o->slots[i].flags & SCAN_OUT_STICKY;
+                o->coalesced++;
+                o->filling = i;
+                return &o->slots[i];
+            }
+        }
+        for (int i = 0; i < 2; i++) {
+            if (claim(o, i, SLOT_FREE, SLOT_FILLING)) {
+                o->filling = i;
+                return &o->slots[i];
+            }
+        }
+    }
+}
+
+void scan_out_publish(scan_out_t *o, scan_out_sweep_t *slot) {
+    slot->flags |= o->carry;
+    o->carry = 0;
+    o->published++;
+    atomic_store_explicit(&o->state[o->filling], SLOT_READY, memory_order_release);
+    o->filling = -1;
+}
+
+bool scan_out_discard(scan_out_t *o) {
+    for (int i = 0; i < 2; i++) {
+        if (claim(o, i, SLOT_READY, SLOT_FILLING)) {
+            o->carry |= o->slots[i].flags & SCAN_OUT_STICKY;
+            o->coalesced++;
+            atomic_store_explicit(&o->state[i], SLOT_FREE, memory_order_release);
+            return true;
+        }
+    }
+    return false;
+}
+
+const scan_out_sweep_t *scan_out_take(scan_out_t *o) {
+    for (int i = 0; i < 2; i++) {
+        if (claim(o, i, SLOT_READY, SLOT_WRITING)) {
+            return &o->slots[i];
+        }
+    }
+    return NULL;
+}
+
+void scan_out_release(scan_out_t *o, const scan_out_sweep_t *slot) {
+    int i = slot == &o->slots[0] ? 0 : 1;
+
+    atomic_fetch_add_explicit(&o->written, 1, memory_order_relaxed);
+    atomic_store_explicit(&o->state[i], SLOT_FREE, memory_order_release);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+// Double-buffered sweep output. The scan loop publishes each finished sweep
+// into a slot together with what should be done with it, and a writer task
+// prints or encodes it while the next sweep is already being captured.
+//
+// There is one producer and one consumer and two slots. The writer holds at
+// most one slot while it writes; the producer fills the other. Publishing
+// never waits: if the writer has not started on the previous sweep yet, the
+// new one replaces it and the replacement is counted as coalesced. The
+// newest sweep therefore always gets out, and a slow console costs whole
+// sweeps rather than listening time.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "scan_core.h"
+#include "scan_window.h"
+#include "scan_anom.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Long-window distributions a slot has room for
+#define SCAN_OUT_WINDOWS 2
+
+// What the writer does with a sweep
+#define SCAN_OUT_BINARY    (1u << 0)  // Telemetry frame to the console
+#define SCAN_OUT_LOG       (1u << 1)  // Telemetry frame to the flash log
+#define SCAN_OUT_TEXT      (1u << 2)  // Sweep table
+#define SCAN_OUT_HEADER    (1u << 3)  // Table header first
+#define SCAN_OUT_CLASSES   (1u << 4)  // Frame class table under the sweep table
+#define SCAN_OUT_DIST      (1u << 5)  // RSSI distribution table under the sweep table
+#define SCAN_OUT_EVENTS    (1u << 6)  // Anomaly events to the console, a heartbeat if there are none
+#define SCAN_OUT_EVENT_LOG (1u << 7)  // Anomaly events to the flash log
+#define SCAN_OUT_QUIET     (1u << 8)  // Nothing but the events to the console
+
+// Passed on to the next published sweep when one is replaced or discarded,
+// so a coalesced sweep does not take its log entry or the table header with it
+#define SCAN_OUT_STICKY (SCAN_OUT_LOG | SCAN_OUT_HEADER)
+
+typedef struct {
+    uint32_t flags;
+    uint32_t time_ms;       // When the sweep ended
+    scan_sweep_t sweep;
+    scan_dev_set_t devices;     // Distinct transmitter sketches of the sweep
+    size_t nwindows;
+    scan_window_snap_t windows[SCAN_OUT_WINDOWS];
+    size_t nevents;
+    uint32_t events_dropped;    // Events that did not fit
+    scan_anom_event_t events[SCAN_ANOM_MAX_EVENTS];
+} scan_out_sweep_t;
+
+typedef struct {
+    scan_out_sweep_t slots[2];
+    _Atomic uint8_t state[2];
+    int filling;                // Producer only: slot between begin and publish
+    uint32_t carry;             // Producer only: sticky flags of replaced or discarded sweeps
+    uint32_t published;         // Producer only
+    uint32_t coalesced;         // Producer only: sweeps replaced before the writer took them
+    _Atomic uint32_t written;   // Sweeps the writer has finished
+} scan_out_t;
+
+void scan_out_init(scan_out_t *o);
+
+// Producer: slot to fill with the next sweep. Never blocks. If it replaces a
+// sweep the writer has not taken, the contents are stale and must all be set.
+scan_out_sweep_t *scan_out_begin(scan_out_t *o);
+
+// Producer: hand the slot from scan_out_begin to the writer
+void scan_out_publish(scan_out_t *o, scan_out_sweep_t *slot);
+
+// Producer: drop a sweep the writer has not taken, counted as coalesced.
+// Returns true if there was one.
+bool scan_out_discard(scan_out_t *o);
+
+// Consumer: the pending sweep, or NULL. The slot stays the writer's until released.
+const scan_out_sweep_t *scan_out_take(scan_out_t *o);
+
+void scan_out_release(scan_out_t *o, const scan_out_sweep_t *slot);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,221 @@
+#include <string.h>
+#include "scan_pcap.h"
+#include "scan_airtime.h"
+
+// Radiotap presence bits and field values used below
+#define RT_FLAGS    BIT(1)
+#define RT_RATE     BIT(2)
+#define RT_CHANNEL  BIT(3)
+#define RT_SIGNAL   BIT(5)
+#define RT_NOISE    BIT(6)
+#define RT_MCS      BIT(19)
+
+#define RT_FLAG_FCS     0x10
+#define RT_FLAG_BADFCS  0x40
+
+#define RT_CHAN_CCK     0x0020
+#define RT_CHAN_OFDM    0x0040
+#define RT_CHAN_2GHZ    0x0080
+
+#define RT_MCS_KNOWN_BW   0x01
+#define RT_MCS_KNOWN_MCS  0x02
+#define RT_MCS_KNOWN_GI   0x04
+#define RT_MCS_BW_40      0x01
+#define RT_MCS_SGI        0x04
+
+#define ENTRY_ALIGN 4
+
+static uint32_t entry_size(uint32_t caplen) {
+    return (sizeof(scan_pcap_entry_t) + caplen + ENTRY_ALIGN - 1) & ~(uint32_t)(ENTRY_ALIGN - 1);
+}
+
+bool scan_pcap_init(scan_pcap_ring_t *ring, uint8_t *buf, uint32_t size, uint16_t snaplen) {
+    if (size < 4096 || (size & (size - 1)) != 0) return false;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->buf = buf;
+    ring->size = size;
+    scan_pcap_set_snaplen(ring, snaplen);
+    return true;
+}
+
+void scan_pcap_set_snaplen(scan_pcap_ring_t *ring, uint16_t snaplen) {
+    if (snaplen > SCAN_PCAP_MAX_SNAPLEN) snaplen = SCAN_PCAP_MAX_SNAPLEN;
+    atomic_store_explicit(&ring->snaplen, snaplen, memory_order_relaxed);
+}
+
+void scan_pcap_restart(scan_pcap_ring_t *ring, uint16_t snaplen) {
+    atomic_store_explicit(&ring->captured, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->dropped, 0, memory_order_relaxed);
+    scan_pcap_set_snaplen(ring, snaplen);
+}
+
+static void count(_Atomic uint32_t *counter) {
+    // Only the producer writes the counters, so a plain load/store is enough
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+bool scan_pcap_capture(scan_pcap_ring_t *ring, const wifi_promiscuous_pkt_t *pkt, size_t len) {
+    const wifi_pkt_rx_ctrl_t *rx_ctrl = &pkt->rx_ctrl;
+    uint32_t caplen = atomic_load_explicit(&ring->snaplen, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (caplen > len) caplen = (uint32_t)len;
+    if (caplen > rx_ctrl->sig_len) caplen = rx_ctrl->sig_len;
+
+    // An entry never wraps; the rest of the buffer is filled and the entry
+    // goes to the start, which then has to be free as well
+    uint32_t need = entry_size(caplen);
+    uint32_t offset = head & (ring->size - 1);
+    uint32_t skip = ring->size - offset < need ? ring->size - offset : 0;
+
+    if (head + skip + need - tail > ring->size) {
+        count(&ring->dropped);
+        return false;
+    }
+    if (skip) {
+        // The consumer skips gaps too short for an entry header by their size
+        if (skip >= sizeof(scan_pcap_entry_t)) {
+            const uint16_t wrap = SCAN_PCAP_WRAP;
+            memcpy(ring->buf + offset, &wrap, sizeof(wrap));
+        }
+        offset = 0;
+    }
+
+    scan_pcap_entry_t entry = {
+        .caplen = (uint16_t)caplen,
+        .orig_len = rx_ctrl->sig_len,
+        .timestamp = rx_ctrl->timestamp,
+        .channel = rx_ctrl->channel,
+        .rssi = rx_ctrl->rssi,
+        .noise = rx_ctrl->noise_floor,
+        .rate = rx_ctrl->rate,
+        .mcs = rx_ctrl->mcs,
+        .phy = (uint8_t)((rx_ctrl->sig_mode & SCAN_PHY_SIG_MODE_MASK) |
+                         (rx_ctrl->cwb ? SCAN_PHY_CWB : 0) | (rx_ctrl->sgi ? SCAN_PHY_SGI : 0)),
+        .rx_state = rx_ctrl->rx_state,
+    };
+    memcpy(ring->buf + offset, &entry, sizeof(entry));
+    memcpy(ring->buf + offset + sizeof(entry), pkt->payload, caplen);
+
+    atomic_store_explicit(&ring->head, head + skip + need, memory_order_release);
+    count(&ring->captured);
+    return true;
+}
+
+// Driver rate code to radiotap rate in 500 kbps units
+static uint8_t esp_to_rate(uint8_t rate) {
+    static const uint8_t rates[16] = {
+        [0x0] = 2, [0x1] = 4, [0x2] = 11, [0x3] = 22,
+        [0x8] = 96, [0x9] = 48, [0xA] = 24, [0xB] = 12,
+        [0xC] = 108, [0xD] = 72, [0xE] = 36, [0xF] = 18,
+    };
+    return rates[rate & 0x0F];
+}
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+// Legacy frames get the rate field, HT frames the MCS field. Returns the length.
+static size_t build_radiotap(uint8_t *rt, const scan_pcap_entry_t *e) {
+    bool ht = (e->phy & SCAN_PHY_SIG_MODE_MASK) != 0;
+    bool cck = !ht && e->rate <= 0x03;
+    uint16_t freq = e->channel == 14 ? 2484 : (uint16_t)(2407 + 5 * e->channel);
+    uint32_t present = RT_FLAGS | RT_CHANNEL | RT_SIGNAL | RT_NOISE | (ht ? RT_MCS : RT_RATE);
+    size_t len;
+
+    rt[0] = 0;      // Version
+    rt[1] = 0;
+    put_le32(rt + 4, present);
+    rt[8] = RT_FLAG_FCS | (e->rx_state ? RT_FLAG_BADFCS : 0);
+    rt[9] = ht ? 0 : esp_to_rate(e->rate);      // Padding before the channel field for HT
+    put_le16(rt + 10, freq);
+    put_le16(rt + 12, RT_CHAN_2GHZ | (cck ? RT_CHAN_CCK : RT_CHAN_OFDM));
+    rt[14] = (uint8_t)e->rssi;
+    rt[15] = (uint8_t)e->noise;
+    len = 16;
+    if (ht) {
+        rt[16] = RT_MCS_KNOWN_BW | RT_MCS_KNOWN_MCS | RT_MCS_KNOWN_GI;
+        rt[17] = ((e->phy & SCAN_PHY_CWB) ? RT_MCS_BW_40 : 0) | ((e->phy & SCAN_PHY_SGI) ? RT_MCS_SGI : 0);
+        rt[18] = e->mcs;
+        len = 19;
+    }
+    put_le16(rt + 2, (uint16_t)len);
+    return len;
+}
+
+size_t scan_pcap_encode(scan_pcap_ring_t *ring, uint8_t *buf, size_t cap, uint16_t seq) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    scan_tlm_writer_t w;
+    size_t records = 0;
+
+    if (tail == head) return 0;
+
+    scan_tlm_begin(&w, buf, cap < SCAN_TLM_MAX_FRAME ? cap : SCAN_TLM_MAX_FRAME, SCAN_TLM_PCAP);
+    scan_tlm_put_varint(&w, atomic_load_explicit(&ring->dropped, memory_order_relaxed));
+
+    while (tail != head) {
+        uint32_t offset = tail & (ring->size - 1);
+        scan_pcap_entry_t e;
+
+        if (ring->size - offset < sizeof(e)) {
+            tail += ring->size - offset;
+            continue;
+        }
+        memcpy(&e, ring->buf + offset, sizeof(e));
+        if (e.caplen == SCAN_PCAP_WRAP) {
+            tail += ring->size - offset;
+            continue;
+        }
+
+        uint8_t rt[SCAN_PCAP_RADIOTAP_MAX];
+        size_t rt_len = build_radiotap(rt, &e);
+        size_t rec_len = SCAN_PCAP_RECORD_HEADER_LEN + rt_len + e.caplen;
+        if (w.len + rec_len + SCAN_TLM_CRC_LEN > w.cap) break;
+
+        if (!ring->have_time) {
+            ring->time_us = e.timestamp;
+            ring->have_time = true;
+        } else {
+            ring->time_us += (uint32_t)(e.timestamp - ring->last_ts);
+        }
+        ring->last_ts = e.timestamp;
+
+        uint8_t hdr[SCAN_PCAP_RECORD_HEADER_LEN];
+        put_le32(hdr, (uint32_t)(ring->time_us / 1000000));
+        put_le32(hdr + 4, (uint32_t)(ring->time_us % 1000000));
+        put_le32(hdr + 8, (uint32_t)(rt_len + e.caplen));
+        put_le32(hdr + 12, (uint32_t)(rt_len + e.orig_len));
+        scan_tlm_put_bytes(&w, hdr, sizeof(hdr));
+        scan_tlm_put_bytes(&w, rt, rt_len);
+        scan_tlm_put_bytes(&w, ring->buf + offset + sizeof(e), e.caplen);
+
+        tail += entry_size(e.caplen);
+        records++;
+    }
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+    // The ring may have held only the wrap filler
+    return records ? scan_tlm_end(&w, seq) : 0;
+}
+
+void scan_pcap_file_header(uint8_t buf[SCAN_PCAP_FILE_HEADER_LEN], uint32_t snaplen) {
+    put_le32(buf, SCAN_PCAP_MAGIC_US);
+    put_le16(buf + 4, 2);       // Version 2.4
+    put_le16(buf + 6, 4);
+    put_le32(buf + 8, 0);       // Time zone offset
+    put_le32(buf + 12, 0);      // Timestamp accuracy
+    put_le32(buf + 16, snaplen);
+    put_le32(buf + 20, SCAN_PCAP_LINKTYPE_RADIOTAP);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+// Raw frame capture for export as pcap.
+//
+// The promiscuous callback copies each frame, cut to the snap length, with the
+// radio metadata it arrived with into a byte ring. Entries are variable sized,
+// so this is not scan_ring.h, but it follows the same rules: one producer (the
+// Wi-Fi task), one consumer (the capture writer), no locks, and a full ring
+// drops the frame and counts it.
+//
+// The consumer packs entries into SCAN_TLM_PCAP telemetry frames whose payload
+// is
+//
+//   dropped (varint, total since the capture started), pcap records until the end
+//
+// Each record is a classic pcap record header (ts_sec, ts_usec, incl_len,
+// orig_len, all u32 LE) followed by a radiotap header and the frame, so a
+// receiver only has to write a pcap file header with linktype 127 and append
+// the records as they come. Timestamps are device uptime. Radiotap carries
+// flags (FCS included), channel, antenna signal and noise in dBm, and the
+// legacy rate or the HT MCS.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "esp_wifi_types.h"
+#include "scan_telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCAN_PCAP_MAGIC_US           0xa1b2c3d4u
+#define SCAN_PCAP_LINKTYPE_RADIOTAP  127
+#define SCAN_PCAP_FILE_HEADER_LEN    24
+#define SCAN_PCAP_RECORD_HEADER_LEN  16
+#define SCAN_PCAP_RADIOTAP_MAX       20
+
+// Longest frame prefix a record can hold: one record must fit in a telemetry
+// payload next to the drop counter
+#define SCAN_PCAP_MAX_SNAPLEN \
+    (SCAN_TLM_MAX_PAYLOAD - 5 - SCAN_PCAP_RECORD_HEADER_LEN - SCAN_PCAP_RADIOTAP_MAX)
+
+// Ring entry header, the captured bytes follow it. Entries start on 4 byte boundaries.
+typedef struct {
+    uint16_t caplen;        // Bytes stored, SCAN_PCAP_WRAP for the filler at the end of the buffer
+    uint16_t orig_len;      // rx_ctrl.sig_len, includes the FCS
+    uint32_t timestamp;     // rx_ctrl.timestamp, microseconds
+    uint8_t channel;
+    int8_t rssi;
+    int8_t noise;
+    uint8_t rate;           // rx_ctrl.rate for legacy frames
+    uint8_t mcs;
+    uint8_t phy;            // sig_mode, 40 MHz and short GI, see scan_airtime.h
+    uint8_t rx_state;
+    uint8_t reserved;
+} scan_pcap_entry_t;
+
+#define SCAN_PCAP_WRAP 0xFFFF
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;              // Power of two
+    _Atomic uint32_t head;      // Byte position of the next entry, owned by the producer
+    _Atomic uint32_t tail;      // Byte position of the oldest entry, owned by the consumer
+    _Atomic uint32_t captured;  // Frames stored, written by the producer only
+    _Atomic uint32_t dropped;   // Frames lost to a full ring, written by the producer only
+    _Atomic uint16_t snaplen;
+
+    // Consumer side: 64 bit time built from the wrapping 32 bit timestamps
+    bool have_time;
+    uint32_t last_ts;
+    uint64_t time_us;
+} scan_pcap_ring_t;
+
+// buf holds size bytes, size must be a power of two of at least 4 KB
+bool scan_pcap_init(scan_pcap_ring_t *ring, uint8_t *buf, uint32_t size, uint16_t snaplen);
+
+// Clamped to SCAN_PCAP_MAX_SNAPLEN. Takes effect for the next frame captured.
+void scan_pcap_set_snaplen(scan_pcap_ring_t *ring, uint16_t snaplen);
+
+// Zero the frame counters and set the snap length for a new capture. Only
+// while the producer is stopped; entries still queued are kept.
+void scan_pcap_restart(scan_pcap_ring_t *ring, uint16_t snaplen);
+
+// Producer side. len is the number of payload bytes present in pkt, which is
+// rx_ctrl.sig_len for frames from the driver. Never blocks.
+bool scan_pcap_capture(scan_pcap_ring_t *ring, const wifi_promiscuous_pkt_t *pkt, size_t len);
+
+// Consumer side. Packs as many entries as fit into one SCAN_TLM_PCAP frame and
+// returns its length, 0 if the ring is empty. cap must be SCAN_TLM_MAX_FRAME or more.
+size_t scan_pcap_encode(scan_pcap_ring_t *ring, uint8_t *buf, size_t cap, uint16_t seq);
+
+// Bytes in use, for status output
+static inline uint32_t scan_pcap_fill(const scan_pcap_ring_t *ring) {
+    return atomic_load_explicit(&ring->head, memory_order_relaxed) -
+           atomic_load_explicit(&ring->tail, memory_order_relaxed);
+}
+
+// pcap file header for the records in SCAN_TLM_PCAP frames
+void scan_pcap_file_header(uint8_t buf[SCAN_PCAP_FILE_HEADER_LEN], uint32_t snaplen);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include "scan_per.h"
+
+#define PER_MAX_CHANNEL 14
+
+static const char *const rate_names[SCAN_PER_RATE_CODES] = {
+    [0x00] = "1M",   [0x01] = "2M",   [0x02] = "5.5M", [0x03] = "11M",
+    [0x08] = "48M",  [0x09] = "24M",  [0x0A] = "12M",  [0x0B] = "6M",
+    [0x0C] = "54M",  [0x0D] = "36M",  [0x0E] = "18M",  [0x0F] = "9M",
+    [0x10] = "MCS0", [0x11] = "MCS1", [0x12] = "MCS2", [0x13] = "MCS3",
+    [0x14] = "MCS4", [0x15] = "MCS5", [0x16] = "MCS6", [0x17] = "MCS7",
+};
+
+// Two-sided normal quantiles for the supported confidence levels
+static const struct {
+    int confidence;
+    float z;
+} z_table[] = {
+    {80, 1.2816f}, {90, 1.6449f}, {95, 1.9600f}, {98, 2.3263f}, {99, 2.5758f},
+};
+
+bool scan_per_target_init(scan_per_target_t *target, int confidence, float precision, uint32_t min_packets) {
+    if (precision <= 0.0f || precision >= 50.0f) return false;
+
+    for (size_t i = 0; i < sizeof(z_table) / sizeof(z_table[0]); i++) {
+        if (z_table[i].confidence == confidence) {
+            target->z = z_table[i].z;
+            target->half_width = precision / 100.0f;
+            target->min_packets = min_packets;
+            return true;
+        }
+    }
+    return false;
+}
+
+void scan_per_add(scan_per_point_t *pt, uint32_t desired, uint32_t correct, int32_t rssi, uint32_t elapsed_ms) {
+    if (correct > desired) correct = desired;
+
+    pt->desired += desired;
+    pt->correct += correct;
+    pt->rssi_sum += (int64_t)rssi * correct;
+    pt->elapsed_ms += elapsed_ms;
+}
+
+float scan_per_value(const scan_per_point_t *pt) {
+    if (pt->desired == 0) return -1.0f;
+    return (float)(pt->desired - pt->correct) / (float)pt->desired;
+}
+
+float scan_per_half_width(const scan_per_point_t *pt, float z) {
+    if (pt->desired == 0) return 1.0f;
+
+    // Unlike the normal approximation the Wilson interval stays honest at a PER of 0 or 1
+    float n = (float)pt->desired;
+    float p = scan_per_value(pt);
+    float z2 = z * z;
+    return z * sqrtf(p * (1.0f - p) / n + z2 / (4.0f * n * n)) / (1.0f + z2 / n);
+}
+
+bool scan_per_converged(const scan_per_point_t *pt, const scan_per_target_t *target) {
+    return pt->desired >= target->min_packets && scan_per_half_width(pt, target->z) <= target->half_width;
+}
+
+float scan_per_rssi(const scan_per_point_t *pt) {
+    return pt->correct ? (float)pt->rssi_sum / (float)pt->correct / 10.0f : 0.0f;
+}
+
+const char *scan_per_rate_name(uint8_t rate) {
+    return rate < SCAN_PER_RATE_CODES ? rate_names[rate] : NULL;
+}
+
+// Split a comma separated list, calling parse on every item. Duplicates are an error.
+static bool parse_list(const char *text, uint8_t *out, int *count, int max, bool (*parse)(const char *, size_t, uint8_t *)) {
+    const char *p = text;
+    int n = 0;
+
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        uint8_t v;
+
+        if (len == 0 || !parse(p, len, &v) || n == max) return false;
+        for (int i = 0; i < n; i++) {
+            if (out[i] == v) return false;
+        }
+        out[n++] = v;
+
+        p += len;
+        if (*p == ',') p++;
+    }
+    *count = n;
+    return n > 0;
+}
+
+static bool parse_number(const char *text, size_t len, long *value) {
+    char buf[8];
+    char *end;
+
+    if (len >= sizeof(buf)) return false;
+    memcpy(buf, text, len);
+    buf[len] = '\0';
+    *value = strtol(buf, &end, 0);
+    return end != buf && *end == '\0';
+}
+
+static bool parse_channel(const char *text, size_t len, uint8_t *channel) {
+    long ch;
+
+    if (!parse_number(text, len, &ch) || ch < 1 || ch > PER_MAX_CHANNEL) return false;
+    *channel = (uint8_t)ch;
+    return true;
+}
+
+static bool parse_rate(const char *text, size_t len, uint8_t *rate) {
+    long code;
+
+    for (int r = 0; r < SCAN_PER_RATE_CODES; r++) {
+        if (rate_names[r] && strlen(rate_names[r]) == len && strncasecmp(text, rate_names[r], len) == 0) {
+            *rate = (uint8_t)r;
+            return true;
+        }
+    }
+    if (!parse_number(text, len, &code) || code < 0 || code >= SCAN_PER_RATE_CODES || !rate_names[code]) {
+        return false;
+    }
+    *rate = (uint8_t)code;
+    return true;
+}
+
+bool scan_per_parse_channels(const char *text, scan_per_sweep_t *sweep) {
+    if (strcasecmp(text, "all") == 0) {
+        sweep->nchan = CONFIG_SCAN_PER_MAX_CHANNELS < 13 ? CONFIG_SCAN_PER_MAX_CHANNELS : 13;
+        for (int i = 0; i < sweep->nchan; i++) {
+            sweep->channels[i] = (uint8_t)(i + 1);
+        }
+        return true;
+    }
+    return parse_list(text, sweep->channels, &sweep->nchan, CONFIG_SCAN_PER_MAX_CHANNELS, parse_channel);
+}
+
+bool scan_per_parse_rates(const char *text, scan_per_sweep_t *sweep) {
+    if (strcasecmp(text, "all") == 0) {
+        sweep->nrate = 0;
+        for (int r = 0; r < SCAN_PER_RATE_CODES && sweep->nrate < CONFIG_SCAN_PER_MAX_RATES; r++) {
+            if (rate_names[r]) sweep->rates[sweep->nrate++] = (uint8_t)r;
+        }
+        return true;
+    }
+    return parse_list(text, sweep->rates, &sweep->nrate, CONFIG_SCAN_PER_MAX_RATES, parse_rate);
+}
+
+void scan_per_matrix_print(const scan_per_sweep_t *sweep) {
+    uint32_t total_ms = 0;
+    int done = 0;
+
+    printf("# RX PER %% / RSSI dBm, * dwell ran out before the PER converged\n");
+    printf("Ch ");
+    for (int r = 0; r < sweep->nrate; r++) {
+        printf(" %12s", rate_names[sweep->rates[r]]);
+    }
+    printf("\n");
+
+    for (int c = 0; c < sweep->nchan; c++) {
+        printf("%-3d", sweep->channels[c]);
+        for (int r = 0; r < sweep->nrate; r++) {
+            const scan_per_point_t *pt = &sweep->points[c][r];
+            total_ms += pt->elapsed_ms;
+            done += pt->done;
+            if (pt->desired == 0) {
+                printf(" %12s", pt->elapsed_ms ? "-*" : "-");
+            } else if (pt->correct == 0) {
+                printf(" %5.1f/%-5s%c", 100.0f * scan_per_value(pt), "-", pt->done ? ' ' : '*');
+            } else {
+                printf(" %5.1f/%-5.1f%c", 100.0f * scan_per_value(pt), scan_per_rssi(pt), pt->done ? ' ' : '*');
+            }
+        }
+        printf("\n");
+    }
+    printf("# %d points, %d converged, %.1f s listening\n", sweep->nchan * sweep->nrate, done, total_ms / 1000.0);
+}
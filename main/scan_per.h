@@ -0,0 +1,80 @@
+#pragma once
+
+// Packet error rate estimation for RX sensitivity sweeps. Every test point,
+// one channel at one rate, adds up the PHY's desired and correct counters
+// over a series of short RX runs. A point is finished once the Wilson score
+// interval around its PER is narrow enough at the requested confidence, so
+// clean and hopeless points stop early and only marginal ones use the full
+// dwell.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_SCAN_PER_MAX_CHANNELS
+#define CONFIG_SCAN_PER_MAX_CHANNELS 14
+#endif
+
+#ifndef CONFIG_SCAN_PER_MAX_RATES
+#define CONFIG_SCAN_PER_MAX_RATES 20
+#endif
+
+// Rate codes as in esp_phy_wifi_rate_t: 11b, 11g and HT20 MCS0~7
+#define SCAN_PER_RATE_CODES 0x18
+
+typedef struct {
+    float z;                    // Normal quantile of the confidence level
+    float half_width;           // Largest acceptable interval half width, PER as a fraction
+    uint32_t min_packets;       // Never decide on fewer desired packets
+} scan_per_target_t;
+
+typedef struct {
+    uint32_t desired;
+    uint32_t correct;
+    int64_t rssi_sum;           // phy_rx_rssi weighted by correct packets
+    uint32_t elapsed_ms;        // Listening time spent on the point
+    bool done;                  // Converged before the dwell ran out
+} scan_per_point_t;
+
+typedef struct {
+    int nchan;
+    int nrate;
+    uint8_t channels[CONFIG_SCAN_PER_MAX_CHANNELS];
+    uint8_t rates[CONFIG_SCAN_PER_MAX_RATES];
+    scan_per_point_t points[CONFIG_SCAN_PER_MAX_CHANNELS][CONFIG_SCAN_PER_MAX_RATES];
+} scan_per_sweep_t;
+
+// Confidence in percent, one of 80, 90, 95, 98 or 99; precision in percent PER
+bool scan_per_target_init(scan_per_target_t *target, int confidence, float precision, uint32_t min_packets);
+
+// Add the counters of one RX run. rssi is the run's average in the PHY's 0.1 dB steps.
+void scan_per_add(scan_per_point_t *pt, uint32_t desired, uint32_t correct, int32_t rssi, uint32_t elapsed_ms);
+
+// PER as a fraction, negative if nothing was received
+float scan_per_value(const scan_per_point_t *pt);
+
+// Half width of the Wilson score interval, 1 with no packets
+float scan_per_half_width(const scan_per_point_t *pt, float z);
+
+bool scan_per_converged(const scan_per_point_t *pt, const scan_per_target_t *target);
+
+// Average RSSI of correctly received packets in dBm
+float scan_per_rssi(const scan_per_point_t *pt);
+
+// Console helpers. Channels are a comma separated list of 1~14, rates a list
+// of codes or names such as 1M, 54M or MCS7; both accept "all".
+bool scan_per_parse_channels(const char *text, scan_per_sweep_t *sweep);
+bool scan_per_parse_rates(const char *text, scan_per_sweep_t *sweep);
+
+// NULL for codes that are not a rate
+const char *scan_per_rate_name(uint8_t rate);
+
+// PER and RSSI per channel and rate on stdout
+void scan_per_matrix_print(const scan_per_sweep_t *sweep);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <string.h>
+#include "scan_prof.h"
+
+static const char *const probe_names[SCAN_PROF_PROBES] = {
+    [SCAN_PROF_CALLBACK] = "callback",
+    [SCAN_PROF_DRAIN] = "drain",
+    [SCAN_PROF_REPORT] = "report",
+};
+
+void scan_prof_init(scan_prof_t *p, uint32_t cycles_per_us) {
+    memset(p, 0, sizeof(*p));
+    p->cycles_per_us = cycles_per_us ? cycles_per_us : 1;
+}
+
+const char *scan_prof_probe_name(scan_prof_probe_t probe) {
+    return probe < SCAN_PROF_PROBES ? probe_names[probe] : "?";
+}
+
+void scan_prof_snapshot(const scan_prof_t *p, scan_prof_probe_t probe, scan_prof_snap_t *out) {
+    const scan_prof_hist_t *h = &p->hist[probe];
+
+    // Count first: a sample landing meanwhile shows in the bins but not the
+    // count, which keeps percentile ranks inside the bins
+    out->count = atomic_load_explicit(&h->count, memory_order_relaxed);
+    out->busy_us = atomic_load_explicit(&h->busy_us, memory_order_relaxed);
+    out->max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    for (int i = 0; i < SCAN_PROF_BINS; i++) {
+        out->bins[i] = atomic_load_explicit(&h->bins[i], memory_order_relaxed);
+    }
+}
+
+void scan_prof_diff(const scan_prof_snap_t *now, const scan_prof_snap_t *before, scan_prof_snap_t *out) {
+    out->count = now->count - before->count;
+    out->busy_us = now->busy_us - before->busy_us;
+    out->max = now->max;
+    for (int i = 0; i < SCAN_PROF_BINS; i++) {
+        out->bins[i] = now->bins[i] - before->bins[i];
+    }
+}
+
+uint32_t scan_prof_percentile(const scan_prof_snap_t *s, unsigned pct) {
+    if (s->count == 0) return 0;
+
+    uint32_t rank = (uint32_t)(((uint64_t)s->count * pct + 99) / 100);
+    uint32_t seen = 0;
+    if (rank == 0) rank = 1;
+    for (int i = 0; i < SCAN_PROF_BINS; i++) {
+        seen += s->bins[i];
+        if (seen >= rank) {
+            // The top bin is open ended, and no edge is above the largest sample
+            uint32_t edge = i == 0 ? 0 : i == SCAN_PROF_BINS - 1 ? UINT32_MAX : (1u << i) - 1;
+            return edge < s->max ? edge : s->max;
+        }
+    }
+    return s->max;
+}
+
+static double to_us(uint32_t cycles, uint32_t cycles_per_us) {
+    return (double)cycles / cycles_per_us;
+}
+
+void scan_prof_report_print(const scan_prof_snap_t *delta, uint32_t cycles_per_us, uint32_t interval_ms, bool hist) {
+    printf("# Hot path over the last %.1f s, times in us (p50 and p99 are bin upper edges)\n", interval_ms / 1000.0);
+    printf("Probe      Count       Rate(/s)   Busy(%%)  p50      p99      Max\n");
+
+    for (int probe = 0; probe < SCAN_PROF_PROBES; probe++) {
+        const scan_prof_snap_t *s = &delta[probe];
+        double rate = interval_ms ? s->count * 1000.0 / interval_ms : 0.0;
+        double busy = interval_ms ? s->busy_us / (interval_ms * 10.0) : 0.0;
+
+        printf("%-10s %-11lu %-10.1f %-8.2f %-8.2f %-8.2f %.2f\n", scan_prof_probe_name(probe),
+               (unsigned long)s->count, rate, busy, to_us(scan_prof_percentile(s, 50), cycles_per_us),
+               to_us(scan_prof_percentile(s, 99), cycles_per_us), to_us(s->max, cycles_per_us));
+        if (!hist) continue;
+
+        for (int i = 0; i < SCAN_PROF_BINS; i++) {
+            if (s->bins[i] == 0) continue;
+            uint32_t upper = i == 0 ? 1 : 1u << i;
+            printf("  < %-10.2f %lu\n", to_us(upper, cycles_per_us), (unsigned long)s->bins[i]);
+        }
+    }
+}
+
+void scan_prof_task_report_print(const scan_prof_task_t *tasks, size_t count) {
+    printf("Task             Core  Prio  CPU(%%)  StackFree\n");
+    for (size_t i = 0; i < count; i++) {
+        const scan_prof_task_t *t = &tasks[i];
+        char core[5] = "-";     // Up to "-128"
+
+        if (t->core >= 0) {
+            snprintf(core, sizeof(core), "%d", t->core);
+        }
+        printf("%-16s %-5s %-5u %-7.1f %lu\n", t->name, core, t->prio, t->cpu_permille / 10.0,
+               (unsigned long)t->stack_free);
+    }
+}
+
+size_t scan_prof_encode(uint8_t *buf, size_t cap, uint16_t seq, uint32_t time_ms, uint32_t interval_ms,
+                        uint32_t cycles_per_us, const scan_prof_snap_t *delta,
+                        const scan_prof_counters_t *counters, const scan_prof_task_t *tasks, size_t ntasks) {
+    scan_tlm_writer_t w;
+
+    scan_tlm_begin(&w, buf, cap, SCAN_TLM_STATS);
+    scan_tlm_put_varint(&w, time_ms);
+    scan_tlm_put_varint(&w, interval_ms);
+    scan_tlm_put_varint(&w, cycles_per_us);
+
+    for (int probe = 0; probe < SCAN_PROF_PROBES; probe++) {
+        const scan_prof_snap_t *s = &delta[probe];
+        int nbins = SCAN_PROF_BINS;
+        while (nbins > 0 && s->bins[nbins - 1] == 0) nbins--;
+
+        scan_tlm_section_begin(&w, SCAN_PROF_SEC_PROBE);
+        scan_tlm_put_varint(&w, (uint32_t)probe);
+        scan_tlm_put_varint(&w, s->count);
+        scan_tlm_put_varint(&w, s->busy_us);
+        scan_tlm_put_varint(&w, s->max);
+        scan_tlm_put_varint(&w, (uint32_t)nbins);
+        for (int i = 0; i < nbins; i++) {
+            scan_tlm_put_varint(&w, s->bins[i]);
+        }
+        scan_tlm_section_end(&w);
+    }
+
+    if (counters) {
+        scan_tlm_section_begin(&w, SCAN_PROF_SEC_COUNTERS);
+        scan_tlm_put_varint(&w, counters->ring_dropped);
+        scan_tlm_put_varint(&w, counters->pcap_dropped);
+        scan_tlm_put_varint(&w, counters->heap_min_free);
+        scan_tlm_section_end(&w);
+    }
+
+    for (size_t i = 0; i < ntasks; i++) {
+        const scan_prof_task_t *t = &tasks[i];
+        size_t name_len = strnlen(t->name, sizeof(t->name));
+
+        scan_tlm_section_begin(&w, SCAN_PROF_SEC_TASK);
+        scan_tlm_put_u8(&w, (uint8_t)name_len);
+        scan_tlm_put_bytes(&w, t->name, name_len);
+        scan_tlm_put_svarint(&w, t->core);
+        scan_tlm_put_varint(&w, t->prio);
+        scan_tlm_put_varint(&w, t->cpu_permille);
+        scan_tlm_put_varint(&w, t->stack_free);
+        scan_tlm_section_end(&w);
+    }
+
+    return scan_tlm_end(&w, seq);
+}
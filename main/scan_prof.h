@@ -0,0 +1,160 @@
+#pragma once
+
+// Hot-path instrumentation. A probe times one code path with the CPU cycle
+// counter and keeps a log2 histogram of the results: recording is a clz, a
+// few relaxed atomic adds and one division, so it stays on in normal builds.
+// Build with CONFIG_SCAN_PROF 0 to compile the probes out entirely.
+//
+// Each probe has a single writer; readers take snapshots at any time and
+// work with the difference between two of them. The cycle counter is per
+// core, so a probe must only time code that cannot migrate mid-measurement,
+// which holds for the scanner's tasks as they are all pinned.
+//
+// Stats telemetry frames (SCAN_TLM_STATS) carry a snapshot difference:
+//
+//   time_ms, interval_ms, cycles_per_us, sections { tag, len (u16 LE), bytes[len] }
+//
+//   SCAN_PROF_SEC_PROBE    probe, count, busy_us, max cycles since boot,
+//                          nbins, nbins x count. One section per probe.
+//   SCAN_PROF_SEC_COUNTERS ring_dropped, pcap_dropped, heap_min_free
+//   SCAN_PROF_SEC_TASK     name_len, name, core (signed, -1 for either),
+//                          prio, cpu_permille, stack_free. One per task.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#include "esp_cpu.h"
+#else
+#include <time.h>
+#endif
+
+#include "scan_telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_SCAN_PROF
+#define CONFIG_SCAN_PROF 1
+#endif
+
+// Bin 0 holds zero-length samples, bin i > 0 those of [2^(i-1), 2^i) cycles
+#define SCAN_PROF_BINS 32
+
+typedef enum {
+    SCAN_PROF_CALLBACK,     // Promiscuous callback, one sample per frame
+    SCAN_PROF_DRAIN,        // Aggregator pass over the ring
+    SCAN_PROF_REPORT,       // Printing or encoding one sweep
+    SCAN_PROF_PROBES,
+} scan_prof_probe_t;
+
+typedef enum {
+    SCAN_PROF_SEC_PROBE = 1,
+    SCAN_PROF_SEC_COUNTERS = 2,
+    SCAN_PROF_SEC_TASK = 3,
+} scan_prof_section_t;
+
+typedef struct {
+    _Atomic uint32_t count;
+    _Atomic uint32_t busy_us;       // Wraps after 71 minutes, readers take differences
+    _Atomic uint32_t max;           // Cycles, since boot
+    uint32_t frac;                  // Writer only: cycles not yet counted in busy_us
+    _Atomic uint32_t bins[SCAN_PROF_BINS];
+} scan_prof_hist_t;
+
+typedef struct {
+    uint32_t cycles_per_us;
+    scan_prof_hist_t hist[SCAN_PROF_PROBES];
+} scan_prof_t;
+
+// Plain copy of a histogram, or the difference of two copies
+typedef struct {
+    uint32_t count;
+    uint32_t busy_us;
+    uint32_t max;
+    uint32_t bins[SCAN_PROF_BINS];
+} scan_prof_snap_t;
+
+// Loss and memory counters that go with the probes
+typedef struct {
+    uint32_t ring_dropped;          // Records lost to a full scan ring, since boot
+    uint32_t pcap_dropped;          // Frames lost by the capture ring, this capture
+    uint32_t heap_min_free;         // Lowest free internal RAM, where the driver's RX buffers come from
+} scan_prof_counters_t;
+
+typedef struct {
+    char name[16];
+    int8_t core;                    // -1 if not pinned
+    uint8_t prio;
+    uint16_t cpu_permille;          // Share of all cores over the interval
+    uint32_t stack_free;            // Bytes of stack never used
+} scan_prof_task_t;
+
+#ifdef ESP_PLATFORM
+static inline uint32_t scan_prof_cycles(void) {
+    return (uint32_t)esp_cpu_get_cycle_count();
+}
+#else
+// Nanoseconds stand in for cycles on the host, with cycles_per_us 1000
+static inline uint32_t scan_prof_cycles(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+#endif
+
+void scan_prof_init(scan_prof_t *p, uint32_t cycles_per_us);
+
+static inline void scan_prof_add(scan_prof_t *p, scan_prof_probe_t probe, uint32_t cycles) {
+    scan_prof_hist_t *h = &p->hist[probe];
+    int bin = cycles ? 32 - __builtin_clz(cycles) : 0;
+    if (bin >= SCAN_PROF_BINS) bin = SCAN_PROF_BINS - 1;
+
+    uint32_t frac = h->frac + cycles;
+    atomic_fetch_add_explicit(&h->busy_us, frac / p->cycles_per_us, memory_order_relaxed);
+    h->frac = frac % p->cycles_per_us;
+    if (cycles > atomic_load_explicit(&h->max, memory_order_relaxed)) {
+        atomic_store_explicit(&h->max, cycles, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&h->bins[bin], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+}
+
+#if CONFIG_SCAN_PROF
+#define SCAN_PROF_START(t)            uint32_t t = scan_prof_cycles()
+#define SCAN_PROF_STOP(p, probe, t)   scan_prof_add((p), (probe), scan_prof_cycles() - (t))
+#else
+#define SCAN_PROF_START(t)
+#define SCAN_PROF_STOP(p, probe, t)
+#endif
+
+const char *scan_prof_probe_name(scan_prof_probe_t probe);
+
+void scan_prof_snapshot(const scan_prof_t *p, scan_prof_probe_t probe, scan_prof_snap_t *out);
+
+// out = now - before; max is taken from now
+void scan_prof_diff(const scan_prof_snap_t *now, const scan_prof_snap_t *before, scan_prof_snap_t *out);
+
+// Nearest-rank percentile in cycles, reported as the upper edge of its bin
+// capped at max
+uint32_t scan_prof_percentile(const scan_prof_snap_t *s, unsigned pct);
+
+// Table of the probes over an interval: rate, busy share, p50, p99 and max.
+// With hist, each probe's non-empty bins follow its row.
+void scan_prof_report_print(const scan_prof_snap_t *delta, uint32_t cycles_per_us, uint32_t interval_ms, bool hist);
+
+void scan_prof_task_report_print(const scan_prof_task_t *tasks, size_t count);
+
+// Complete SCAN_TLM_STATS frame, 0 if it did not fit. delta holds
+// SCAN_PROF_PROBES entries; counters and tasks may be NULL.
+size_t scan_prof_encode(uint8_t *buf, size_t cap, uint16_t seq, uint32_t time_ms, uint32_t interval_ms,
+                        uint32_t cycles_per_us, const scan_prof_snap_t *delta,
+                        const scan_prof_counters_t *counters, const scan_prof_task_t *tasks, size_t ntasks);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,22 @@
+#include "scan_ring.h"
+
+void scan_ring_init(scan_ring_t *ring) {
+    atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->dropped, 0, memory_order_relaxed);
+}
+
+size_t scan_ring_pop(scan_ring_t *ring, scan_pkt_rec_t *out, size_t max) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t avail = head - tail;
+    size_t n = avail < max ? avail : max;
+
+    for (size_t i = 0; i < n; i++) {
+        out[i] = ring->slots[(tail + i) & (CONFIG_SCAN_RING_SIZE - 1)];
+    }
+
+    // Release the slots only after they have been copied out
+    atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+    return n;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of records the ring can hold, must be a power of two
+#ifndef CONFIG_SCAN_RING_SIZE
+#define CONFIG_SCAN_RING_SIZE 1024
+#endif
+
+_Static_assert((CONFIG_SCAN_RING_SIZE & (CONFIG_SCAN_RING_SIZE - 1)) == 0,
+               "CONFIG_SCAN_RING_SIZE must be a power of two");
+
+// Compact per-frame record handed from the promiscuous callback to the aggregator
+typedef struct {
+    uint32_t timestamp;   // rx_ctrl.timestamp, microseconds
+    uint16_t sig_len;     // Frame length including FCS
+    uint8_t channel;
+    int8_t rssi;
+    uint8_t rx_state;
+    uint8_t rate;
+    uint16_t fc;          // 802.11 frame control, little endian as on air
+    uint8_t addr2[6];     // Transmitter address, zero if the frame is too short
+    uint8_t mcs;          // HT MCS index, valid if phy says HT
+    uint8_t phy;          // sig_mode, 40 MHz and short GI, see scan_airtime.h
+    uint16_t seq_ctrl;    // Sequence control of management and data frames
+    int8_t noise_floor;   // dBm, 0 if the driver did not report one
+    uint16_t bcn_interval; // Beacon interval in TU, 0 if not a beacon
+    uint16_t bcn_delay;   // Beacon TSF modulo the interval, microseconds, capped at UINT16_MAX
+    uint32_t bcn_tsf;     // Low 32 bits of the beacon TSF, microseconds
+} scan_pkt_rec_t;
+
+// Single-producer/single-consumer ring. The Wi-Fi task is the only producer,
+// the aggregator task the only consumer, so head and tail each have exactly
+// one writer and no lock is needed.
+typedef struct {
+    _Atomic uint32_t head;      // Next slot to write, owned by the producer
+    _Atomic uint32_t tail;      // Next slot to read, owned by the consumer
+    _Atomic uint32_t dropped;   // Records rejected because the ring was full
+    scan_pkt_rec_t slots[CONFIG_SCAN_RING_SIZE];
+} scan_ring_t;
+
+void scan_ring_init(scan_ring_t *ring);
+
+// Producer side. Never blocks; a full ring counts the record as dropped.
+static inline bool scan_ring_push(scan_ring_t *ring, const scan_pkt_rec_t *rec) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail >= CONFIG_SCAN_RING_SIZE) {
+        // Only the producer writes this counter, so a plain load/store is enough
+        uint32_t dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+        atomic_store_explicit(&ring->dropped, dropped + 1, memory_order_relaxed);
+        return false;
+    }
+
+    ring->slots[head & (CONFIG_SCAN_RING_SIZE - 1)] = *rec;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+// Consumer side. Copies up to max records into out and returns how many were copied.
+size_t scan_ring_pop(scan_ring_t *ring, scan_pkt_rec_t *out, size_t max);
+
+// Total number of records dropped since init
+static inline uint32_t scan_ring_dropped(const scan_ring_t *ring) {
+    return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
+
+#ifdef __cplusplus
+}
+#endif
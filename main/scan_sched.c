@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "scan_sched.h"
+
+// Weight of the newest sweep in the activity model
+#define SCHED_EWMA_ALPHA 0.3f
+
+// Floor on a channel's weight so that a quiet channel still gets explored
+#define SCHED_MIN_WEIGHT 1.0f
+
+void scan_sched_config_default(scan_sched_config_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->policy = SCAN_SCHED_PROPORTIONAL;
+    cfg->budget_ms = CONFIG_SCAN_SWEEP_BUDGET_MS;
+    cfg->min_dwell_ms = CONFIG_SCAN_MIN_DWELL_MS;
+    cfg->max_revisit_ms = CONFIG_SCAN_MAX_REVISIT_MS;
+
+    // The non-overlapping 2.4 GHz channels are the usual priority list
+    static const uint8_t common[] = {1, 6, 11};
+    for (size_t i = 0; i < sizeof(common); i++) {
+        if (common[i] <= CONFIG_MAX_WIFI_CHANNELS) {
+            cfg->priority[cfg->priority_count++] = common[i];
+        }
+    }
+}
+
+void scan_sched_init(scan_sched_t *sched, const scan_sched_config_t *cfg) {
+    memset(sched, 0, sizeof(*sched));
+    sched->cfg = *cfg;
+}
+
+void scan_sched_set_config(scan_sched_t *sched, const scan_sched_config_t *cfg) {
+    sched->cfg = *cfg;
+}
+
+const char *scan_sched_policy_name(scan_sched_policy_t policy) {
+    switch (policy) {
+    case SCAN_SCHED_FIXED:        return "fixed";
+    case SCAN_SCHED_PROPORTIONAL: return "proportional";
+    case SCAN_SCHED_PRIORITY:     return "priority";
+    default:                      return "unknown";
+    }
+}
+
+// A channel is due when skipping it now could push its next visit, at the end
+// of the following sweep at the latest, past the revisit guarantee
+static bool channel_due(const scan_sched_t *sched, int index, uint32_t now_ms) {
+    if (!sched->visited[index] || !sched->sampled[index]) {
+        return true;
+    }
+    uint32_t since = now_ms - sched->last_visit_ms[index];
+    return since + 2 * sched->cfg.budget_ms >= sched->cfg.max_revisit_ms;
+}
+
+// Busy channels and channels whose rate swings a lot both need more samples
+static float channel_weight(const scan_sched_t *sched, int index) {
+    float w = sched->rate_mean[index] + sqrtf(sched->rate_var[index]);
+    return w < SCHED_MIN_WEIGHT ? SCHED_MIN_WEIGHT : w;
+}
+
+static void plan_fixed(const scan_sched_t *sched, uint32_t *dwell) {
+    uint32_t share = sched->cfg.budget_ms / CONFIG_MAX_WIFI_CHANNELS;
+    if (share < sched->cfg.min_dwell_ms) {
+        share = sched->cfg.min_dwell_ms;
+    }
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        dwell[i] = share;
+    }
+}
+
+// Split budget over the channels in pool by weight. Pool members whose share
+// falls below the minimum dwell are dropped, or pinned to it if they are due,
+// and the rest is recomputed until the split is stable.
+static void plan_weighted(const scan_sched_t *sched, uint32_t now_ms, bool *pool, uint32_t budget, uint32_t *dwell) {
+    const uint32_t min_dwell = sched->cfg.min_dwell_ms;
+    bool changed = true;
+
+    while (changed) {
+        float total = 0.0f;
+        changed = false;
+
+        for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+            if (pool[i]) total += channel_weight(sched, i);
+        }
+        if (total <= 0.0f) return;
+
+        for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+            if (!pool[i]) continue;
+
+            uint32_t share = (uint32_t)((float)budget * channel_weight(sched, i) / total);
+            if (share >= min_dwell) {
+                dwell[i] = share;
+                continue;
+            }
+
+            pool[i] = false;
+            changed = true;
+            if (channel_due(sched, i, now_ms)) {
+                dwell[i] = min_dwell;
+                budget = budget > min_dwell ? budget - min_dwell : 0;
+            } else {
+                dwell[i] = 0;
+            }
+        }
+    }
+}
+
+static void plan_priority(const scan_sched_t *sched, uint32_t now_ms, uint32_t *dwell) {
+    const scan_sched_config_t *cfg = &sched->cfg;
+    bool listed[CONFIG_MAX_WIFI_CHANNELS] = {false};
+    int nlisted = 0;
+    uint32_t budget = cfg->budget_ms;
+
+    for (int i = 0; i < cfg->priority_count; i++) {
+        int ch = cfg->priority[i];
+        if (ch >= 1 && ch <= CONFIG_MAX_WIFI_CHANNELS && !listed[ch - 1]) {
+            listed[ch - 1] = true;
+            nlisted++;
+        }
+    }
+    if (nlisted == 0) {
+        plan_fixed(sched, dwell);
+        return;
+    }
+
+    // Unlisted channels only get the minimum dwell, and only when due
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        if (!listed[i] && channel_due(sched, i, now_ms)) {
+            dwell[i] = cfg->min_dwell_ms;
+            budget = budget > cfg->min_dwell_ms ? budget - cfg->min_dwell_ms : 0;
+        }
+    }
+
+    uint32_t share = budget / (uint32_t)nlisted;
+    if (share < cfg->min_dwell_ms) {
+        share = cfg->min_dwell_ms;
+    }
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        if (listed[i]) dwell[i] = share;
+    }
+}
+
+void scan_sched_plan(const scan_sched_t *sched, uint32_t now_ms, scan_sched_plan_t *plan) {
+    uint32_t dwell[CONFIG_MAX_WIFI_CHANNELS] = {0};
+
+    switch (sched->cfg.policy) {
+    case SCAN_SCHED_PROPORTIONAL: {
+        bool pool[CONFIG_MAX_WIFI_CHANNELS];
+        for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+            pool[i] = true;
+        }
+        plan_weighted(sched, now_ms, pool, sched->cfg.budget_ms, dwell);
+        break;
+    }
+    case SCAN_SCHED_PRIORITY:
+        plan_priority(sched, now_ms, dwell);
+        break;
+    case SCAN_SCHED_FIXED:
+    default:
+        plan_fixed(sched, dwell);
+        break;
+    }
+
+    // Walk channels in ascending order, like the fixed hop always did
+    plan->count = 0;
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        if (dwell[i] == 0) continue;
+        plan->slots[plan->count].channel = (uint8_t)(i + 1);
+        plan->slots[plan->count].dwell_ms = (uint16_t)(dwell[i] > UINT16_MAX ? UINT16_MAX : dwell[i]);
+        plan->count++;
+    }
+}
+
+void scan_sched_visit(scan_sched_t *sched, uint8_t channel, uint32_t now_ms, uint32_t dwell_ms) {
+    if (channel < 1 || channel > CONFIG_MAX_WIFI_CHANNELS) return;
+
+    int i = channel - 1;
+    if (sched->visited[i]) {
+        uint32_t interval = now_ms - sched->last_visit_ms[i];
+        sched->revisit_total_ms[i] += interval;
+        if (interval > sched->revisit_max_ms[i]) {
+            sched->revisit_max_ms[i] = interval;
+        }
+    }
+    sched->visited[i] = true;
+    sched->last_visit_ms[i] = now_ms;
+    sched->hops[i]++;
+    sched->dwell_total_ms[i] += dwell_ms;
+}
+
+void scan_sched_update(scan_sched_t *sched, const scan_sweep_t *sweep) {
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        if (sweep->dwell_ms[i] == 0) continue;
+
+        float rate = (float)sweep->packet_count[i] * 1000.0f / (float)sweep->dwell_ms[i];
+        if (!sched->sampled[i]) {
+            sched->rate_mean[i] = rate;
+            sched->rate_var[i] = 0.0f;
+            sched->sampled[i] = true;
+            continue;
+        }
+
+        float diff = rate - sched->rate_mean[i];
+        sched->rate_mean[i] += SCHED_EWMA_ALPHA * diff;
+        sched->rate_var[i] = (1.0f - SCHED_EWMA_ALPHA) * (sched->rate_var[i] + SCHED_EWMA_ALPHA * diff * diff);
+    }
+}
+
+void scan_sched_apply_dwell(const scan_sched_plan_t *plan, scan_sweep_t *sweep) {
+    memset(sweep->dwell_ms, 0, sizeof(sweep->dwell_ms));
+    for (int i = 0; i < plan->count; i++) {
+        sweep->dwell_ms[plan->slots[i].channel - 1] += plan->slots[i].dwell_ms;
+    }
+}
+
+void scan_sched_report_print(const scan_sched_t *sched) {
+    const scan_sched_config_t *cfg = &sched->cfg;
+
+    printf("# Channel schedule: policy %s, budget %lu ms, min dwell %lu ms, max revisit %lu ms\n",
+           scan_sched_policy_name(cfg->policy), (unsigned long)cfg->budget_ms,
+           (unsigned long)cfg->min_dwell_ms, (unsigned long)cfg->max_revisit_ms);
+    printf("Ch   Hops     Dwell(ms)  AvgDwell  Revisit(ms)  MaxRevisit  Rate(pkt/s)\n");
+
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        uint32_t hops = sched->hops[i];
+        unsigned long avg_dwell = hops ? (unsigned long)(sched->dwell_total_ms[i] / hops) : 0;
+        unsigned long revisit = hops > 1 ? (unsigned long)(sched->revisit_total_ms[i] / (hops - 1)) : 0;
+
+        printf("%-4d %-8lu %-10llu %-9lu %-12lu %-11lu %.1f\n", i + 1, (unsigned long)hops,
+               (unsigned long long)sched->dwell_total_ms[i], avg_dwell, revisit,
+               (unsigned long)sched->revisit_max_ms[i], sched->rate_mean[i]);
+    }
+}
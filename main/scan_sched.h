@@ -0,0 +1,95 @@
+#pragma once
+
+// Channel dwell scheduler. Each sweep gets a fixed listening budget which a
+// policy divides between channels based on what was heard on them before.
+// Channels may be left out of a sweep, but never for longer than the revisit
+// guarantee allows.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "scan_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_SCAN_SWEEP_BUDGET_MS
+#define CONFIG_SCAN_SWEEP_BUDGET_MS (CONFIG_MAX_WIFI_CHANNELS * 150)
+#endif
+
+#ifndef CONFIG_SCAN_MIN_DWELL_MS
+#define CONFIG_SCAN_MIN_DWELL_MS 30
+#endif
+
+#ifndef CONFIG_SCAN_MAX_REVISIT_MS
+#define CONFIG_SCAN_MAX_REVISIT_MS 10000
+#endif
+
+typedef enum {
+    SCAN_SCHED_FIXED,           // Equal dwell on every channel, the classic 150 ms hop
+    SCAN_SCHED_PROPORTIONAL,    // Dwell follows packet rate and its variability
+    SCAN_SCHED_PRIORITY,        // Listed channels share the budget, others only when due
+} scan_sched_policy_t;
+
+typedef struct {
+    scan_sched_policy_t policy;
+    uint32_t budget_ms;         // Listening time per sweep
+    uint32_t min_dwell_ms;      // Shortest useful visit
+    uint32_t max_revisit_ms;    // Longest time any channel may go unvisited
+    uint8_t priority[CONFIG_MAX_WIFI_CHANNELS];  // Channels for SCAN_SCHED_PRIORITY
+    int priority_count;
+} scan_sched_config_t;
+
+typedef struct {
+    uint8_t channel;
+    uint16_t dwell_ms;
+} scan_sched_slot_t;
+
+typedef struct {
+    int count;
+    scan_sched_slot_t slots[CONFIG_MAX_WIFI_CHANNELS];
+} scan_sched_plan_t;
+
+typedef struct {
+    scan_sched_config_t cfg;
+
+    // Activity model per channel, packets per second while listening
+    float rate_mean[CONFIG_MAX_WIFI_CHANNELS];
+    float rate_var[CONFIG_MAX_WIFI_CHANNELS];
+    bool sampled[CONFIG_MAX_WIFI_CHANNELS];
+
+    // Hop bookkeeping for the report
+    bool visited[CONFIG_MAX_WIFI_CHANNELS];
+    uint32_t last_visit_ms[CONFIG_MAX_WIFI_CHANNELS];
+    uint32_t hops[CONFIG_MAX_WIFI_CHANNELS];
+    uint64_t dwell_total_ms[CONFIG_MAX_WIFI_CHANNELS];
+    uint64_t revisit_total_ms[CONFIG_MAX_WIFI_CHANNELS];
+    uint32_t revisit_max_ms[CONFIG_MAX_WIFI_CHANNELS];
+} scan_sched_t;
+
+void scan_sched_config_default(scan_sched_config_t *cfg);
+
+// Install a configuration; the activity model and hop statistics are kept
+void scan_sched_init(scan_sched_t *sched, const scan_sched_config_t *cfg);
+void scan_sched_set_config(scan_sched_t *sched, const scan_sched_config_t *cfg);
+
+// Build the plan for the next sweep starting at now_ms
+void scan_sched_plan(const scan_sched_t *sched, uint32_t now_ms, scan_sched_plan_t *plan);
+
+// Record that a slot of the plan started at now_ms
+void scan_sched_visit(scan_sched_t *sched, uint8_t channel, uint32_t now_ms, uint32_t dwell_ms);
+
+// Feed the sweep's results back into the activity model
+void scan_sched_update(scan_sched_t *sched, const scan_sweep_t *sweep);
+
+// Copy the plan's dwell times into the sweep so reports can tell skipped channels apart
+void scan_sched_apply_dwell(const scan_sched_plan_t *plan, scan_sweep_t *sweep);
+
+// Hop count, dwell time and effective revisit interval per channel
+void scan_sched_report_print(const scan_sched_t *sched);
+
+const char *scan_sched_policy_name(scan_sched_policy_t policy);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "scan_script.h"
+
+typedef struct {
+    const char *name;
+    int64_t value;
+} script_var_t;
+
+static bool is_ident(char c, bool first) {
+    return isalpha((unsigned char)c) || c == '_' || (!first && isdigit((unsigned char)c));
+}
+
+// Length of the identifier at p, 0 if there is none
+static size_t ident_len(const char *p) {
+    size_t n = 0;
+    while (is_ident(p[n], n == 0)) n++;
+    return n;
+}
+
+static const char *skip_space(const char *p) {
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+}
+
+static bool parse_int(const char **p, int32_t *value) {
+    char *end;
+    const char *s = skip_space(*p);
+    long v = strtol(s, &end, 0);
+
+    if (end == s || (*end != '\0' && *end != ' ' && *end != '\t')) return false;
+    *value = (int32_t)v;
+    *p = end;
+    return true;
+}
+
+static bool at_end(const char *p) {
+    return *skip_space(p) == '\0';
+}
+
+static bool keyword(const char *s, const char *kw) {
+    size_t n = strlen(kw);
+    return strncmp(s, kw, n) == 0 && (s[n] == '\0' || s[n] == ' ' || s[n] == '\t');
+}
+
+// Every $name in s must be the variable of an enclosing loop
+static bool check_vars(const scan_script_t *script, const char *s, const int *stack, int depth) {
+    for (const char *p = strchr(s, '$'); p; p = strchr(p + 1, '$')) {
+        size_t n = ident_len(p + 1);
+        bool found = false;
+
+        for (int i = 0; i < depth && !found; i++) {
+            const char *var = script->steps[stack[i]].var;
+            found = strlen(var) == n && strncmp(var, p + 1, n) == 0;
+        }
+        if (!found) return false;
+    }
+    return true;
+}
+
+#define FAIL(...) do { snprintf(err, errlen, __VA_ARGS__); return false; } while (0)
+
+bool scan_script_compile(scan_script_t *script, const char *src, char *err, size_t errlen) {
+    int stack[CONFIG_SCAN_SCRIPT_MAX_DEPTH];
+    int depth = 0;
+
+    memset(script, 0, sizeof(*script));
+    for (const char *p = src; *p; ) {
+        size_t len = strcspn(p, ";\n");
+        const char *stmt = p;
+
+        p += len;
+        if (*p) p++;
+        while (len && isspace((unsigned char)*stmt)) {
+            stmt++;
+            len--;
+        }
+        while (len && isspace((unsigned char)stmt[len - 1])) len--;
+        if (len == 0 || *stmt == '#') continue;
+
+        int n = script->nsteps;
+        if (n == CONFIG_SCAN_SCRIPT_MAX_STEPS) FAIL("More than %d statements", CONFIG_SCAN_SCRIPT_MAX_STEPS);
+        if (len >= SCAN_SCRIPT_MAX_LINE) FAIL("Statement %d is too long", n + 1);
+        if (script->len + len + 1 > sizeof(script->text)) FAIL("Script is longer than %d bytes", CONFIG_SCAN_SCRIPT_MAX_LEN);
+
+        scan_script_step_t *step = &script->steps[n];
+        char *s = &script->text[script->len];
+        memcpy(s, stmt, len);
+        s[len] = '\0';
+        step->text = (uint16_t)script->len;
+        script->len += len + 1;
+
+        if (keyword(s, "wait")) {
+            const char *q = s + 4;
+            step->op = SCAN_SCRIPT_WAIT;
+            if (!parse_int(&q, &step->from) || step->from < 0 || !at_end(q)) {
+                FAIL("Statement %d: wait <ms>", n + 1);
+            }
+        } else if (keyword(s, "for")) {
+            const char *q = skip_space(s + 3);
+            size_t vlen = ident_len(q);
+            step->op = SCAN_SCRIPT_FOR;
+            if (vlen == 0 || vlen > SCAN_SCRIPT_MAX_VAR) FAIL("Statement %d: for <var> <from> <to> [step]", n + 1);
+            memcpy(step->var, q, vlen);
+            q += vlen;
+            if (!parse_int(&q, &step->from) || !parse_int(&q, &step->to)) {
+                FAIL("Statement %d: for <var> <from> <to> [step]", n + 1);
+            }
+            step->step = step->from <= step->to ? 1 : -1;
+            if (!at_end(q) && (!parse_int(&q, &step->step) || step->step == 0 || !at_end(q))) {
+                FAIL("Statement %d: step must be a non-zero number", n + 1);
+            }
+            if (depth == CONFIG_SCAN_SCRIPT_MAX_DEPTH) FAIL("Statement %d: loops nested deeper than %d", n + 1,
+                                                          CONFIG_SCAN_SCRIPT_MAX_DEPTH);
+            stack[depth++] = n;
+        } else if (keyword(s, "end")) {
+            step->op = SCAN_SCRIPT_END;
+            if (!at_end(s + 3)) FAIL("Statement %d: end takes no arguments", n + 1);
+            if (depth == 0) FAIL("Statement %d: end without for", n + 1);
+            step->jump = (uint16_t)stack[--depth];
+            script->steps[step->jump].jump = (uint16_t)n;
+        } else if (keyword(s, "capture")) {
+            step->op = SCAN_SCRIPT_CAPTURE;
+            if (strlen(skip_space(s + 7)) >= sizeof(((scan_script_capture_t *)0)->label)) {
+                FAIL("Statement %d: capture label is too long", n + 1);
+            }
+        } else {
+            step->op = SCAN_SCRIPT_CMD;
+        }
+        if (!check_vars(script, s, stack, depth)) FAIL("Statement %d: unknown $variable", n + 1);
+
+        script->nsteps++;
+    }
+    if (depth) FAIL("for without end");
+    return true;
+}
+
+#undef FAIL
+
+const char *scan_script_statement(const scan_script_t *script, int n) {
+    return n >= 0 && n < script->nsteps ? &script->text[script->steps[n].text] : NULL;
+}
+
+// Copy s to out with $var replaced by the innermost loop value of that name
+static void expand(const char *s, char *out, size_t cap, const script_var_t *vars, int nvars) {
+    size_t len = 0;
+
+    while (*s && len + 1 < cap) {
+        size_t n = *s == '$' ? ident_len(s + 1) : 0;
+        int i = nvars - 1;
+
+        while (n && i >= 0 && (strlen(vars[i].name) != n || strncmp(vars[i].name, s + 1, n) != 0)) i--;
+        if (n && i >= 0) {
+            int w = snprintf(out + len, cap - len, "%lld", (long long)vars[i].value);
+            len += w > 0 ? (size_t)w : 0;
+            if (len >= cap) len = cap - 1;
+            s += n + 1;
+        } else {
+            out[len++] = *s++;
+        }
+    }
+    out[len] = '\0';
+}
+
+static bool in_range(const scan_script_step_t *loop, int64_t v) {
+    return loop->step > 0 ? v <= loop->to : v >= loop->to;
+}
+
+void scan_script_run(const scan_script_t *script, const scan_script_ops_t *ops, void *ctx,
+                     scan_script_report_t *report) {
+    script_var_t vars[CONFIG_SCAN_SCRIPT_MAX_DEPTH];
+    int nvars = 0;
+    char line[SCAN_SCRIPT_MAX_LINE + 64];     // Room for expanded values
+    const uint32_t start = ops->now_ms(ctx);
+    uint32_t deadline = 0;                      // Script clock after the last wait
+
+    memset(report, 0, sizeof(*report));
+    report->error_step = -1;
+
+    for (int pc = 0; pc < script->nsteps; ) {
+        const scan_script_step_t *step = &script->steps[pc];
+        const char *s = &script->text[step->text];
+
+        switch (step->op) {
+        case SCAN_SCRIPT_FOR:
+            vars[nvars] = (script_var_t){.name = step->var, .value = step->from};
+            if (in_range(step, step->from)) {
+                nvars++;
+                pc++;
+            } else {
+                pc = step->jump + 1;
+            }
+            continue;
+        case SCAN_SCRIPT_END: {
+            const scan_script_step_t *loop = &script->steps[step->jump];
+            script_var_t *var = &vars[nvars - 1];
+            var->value += loop->step;
+            if (in_range(loop, var->value)) {
+                pc = step->jump + 1;
+            } else {
+                nvars--;
+                pc++;
+            }
+            continue;
+        }
+        case SCAN_SCRIPT_WAIT: {
+            uint32_t now = ops->now_ms(ctx) - start;
+            deadline += (uint32_t)step->from;
+            if ((int32_t)(deadline - now) > 0) {
+                ops->sleep_until(start + deadline, ctx);
+            } else if (now - deadline > report->late_ms) {
+                report->late_ms = now - deadline;
+            }
+            break;
+        }
+        case SCAN_SCRIPT_CAPTURE:
+            if (report->ncaptures < CONFIG_SCAN_SCRIPT_MAX_CAPTURES) {
+                scan_script_capture_t *cap = &report->captures[report->ncaptures++];
+                expand(skip_space(s + 7), cap->label, sizeof(cap->label), vars, nvars);
+                cap->t_ms = ops->now_ms(ctx) - start;
+                ops->capture(cap, ctx);
+            }
+            break;
+        case SCAN_SCRIPT_CMD: {
+            expand(s, line, sizeof(line), vars, nvars);
+            int status = ops->exec(line, ctx);
+            report->commands++;
+            if (status != 0) {
+                if (report->errors++ == 0) {
+                    report->error_step = pc;
+                    report->error_status = status;
+                    size_t n = strlen(line) < sizeof(report->error_line) ? strlen(line) : sizeof(report->error_line) - 1;
+                    memcpy(report->error_line, line, n);
+                    report->error_line[n] = '\0';
+                }
+            }
+            break;
+        }
+        }
+        pc++;
+    }
+    report->elapsed_ms = ops->now_ms(ctx) - start;
+}
+
+void scan_script_report_print(const scan_script_report_t *report) {
+    printf("# Script: %lu commands, %lu failed, %.2f s, worst wait overrun %lu ms\n",
+           (unsigned long)report->commands, (unsigned long)report->errors, report->elapsed_ms / 1000.0,
+           (unsigned long)report->late_ms);
+    if (report->error_step >= 0) {
+        printf("# First failure at statement %d, status %d: %s\n", report->error_step + 1, report->error_status,
+               report->error_line);
+    }
+    if (report->ncaptures == 0) return;
+
+    printf("%-16s %8s %8s %8s %6s %7s\n", "capture", "t_ms", "desired", "correct", "PER%", "RSSI");
+    for (int i = 0; i < report->ncaptures; i++) {
+        const scan_script_capture_t *cap = &report->captures[i];
+        printf("%-16s %8lu %8lu %8lu", cap->label, (unsigned long)cap->t_ms, (unsigned long)cap->desired,
+               (unsigned long)cap->correct);
+        if (cap->desired) {
+            printf(" %6.2f %7.1f\n", 100.0 * (cap->desired - cap->correct) / cap->desired, cap->rssi / 10.0);
+        } else {
+            printf(" %6s %7s\n", "-", "-");
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+// Command scripts for cert test sequences. A script is a list of statements
+// separated by newlines or ';':
+//
+//   <console command>           run through the caller's exec hook, $var expanded
+//   wait <ms>                   advance the script clock
+//   for <var> <from> <to> [step]
+//   end                         close the innermost for, bounds are inclusive
+//   capture [label]             record the PHY RX counters under label
+//   # ...                       comment
+//
+// Waits are measured on the script's own timeline, not from the end of the
+// previous command: "wait 1000" starts the next statement 1000 ms after the
+// previous wait ended, however long the commands in between took. A command
+// that overruns the timeline shows up as lateness in the report.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_SCAN_SCRIPT_MAX_LEN
+#define CONFIG_SCAN_SCRIPT_MAX_LEN 2048
+#endif
+
+#ifndef CONFIG_SCAN_SCRIPT_MAX_STEPS
+#define CONFIG_SCAN_SCRIPT_MAX_STEPS 128
+#endif
+
+#ifndef CONFIG_SCAN_SCRIPT_MAX_DEPTH
+#define CONFIG_SCAN_SCRIPT_MAX_DEPTH 4
+#endif
+
+#ifndef CONFIG_SCAN_SCRIPT_MAX_CAPTURES
+#define CONFIG_SCAN_SCRIPT_MAX_CAPTURES 64
+#endif
+
+#define SCAN_SCRIPT_MAX_LINE 256
+#define SCAN_SCRIPT_MAX_VAR  8
+
+typedef enum {
+    SCAN_SCRIPT_CMD,
+    SCAN_SCRIPT_WAIT,
+    SCAN_SCRIPT_FOR,
+    SCAN_SCRIPT_END,
+    SCAN_SCRIPT_CAPTURE,
+} scan_script_op_t;
+
+typedef struct {
+    uint8_t op;                 // scan_script_op_t
+    uint16_t text;              // Offset of the statement in text
+    uint16_t jump;              // for: its end, end: its for
+    int32_t from;               // for: first value, wait: milliseconds
+    int32_t to;
+    int32_t step;
+    char var[SCAN_SCRIPT_MAX_VAR + 1];
+} scan_script_step_t;
+
+typedef struct {
+    char text[CONFIG_SCAN_SCRIPT_MAX_LEN];  // Statements, each NUL terminated
+    size_t len;
+    int nsteps;
+    scan_script_step_t steps[CONFIG_SCAN_SCRIPT_MAX_STEPS];
+} scan_script_t;
+
+typedef struct {
+    char label[16];
+    uint32_t t_ms;              // On the script clock
+    uint32_t desired;
+    uint32_t correct;
+    int32_t rssi;               // PHY units of 0.1 dB
+} scan_script_capture_t;
+
+typedef struct {
+    uint32_t commands;
+    uint32_t errors;
+    uint32_t elapsed_ms;
+    uint32_t late_ms;           // Worst overrun of a wait deadline
+    int error_step;             // First failing statement, -1 if none
+    int error_status;
+    char error_line[64];
+    int ncaptures;
+    scan_script_capture_t captures[CONFIG_SCAN_SCRIPT_MAX_CAPTURES];
+} scan_script_report_t;
+
+// What a script runs on
+typedef struct {
+    int (*exec)(const char *line, void *ctx);       // Returns the command status, 0 for success
+    uint32_t (*now_ms)(void *ctx);
+    void (*sleep_until)(uint32_t ms, void *ctx);    // In the clock of now_ms
+    void (*capture)(scan_script_capture_t *cap, void *ctx); // Fill in the counters
+} scan_script_ops_t;
+
+// Returns false with a message in err if src is not a valid script
+bool scan_script_compile(scan_script_t *script, const char *src, char *err, size_t errlen);
+
+void scan_script_run(const scan_script_t *script, const scan_script_ops_t *ops, void *ctx,
+                     scan_script_report_t *report);
+
+// Statement n as compiled, for listings
+const char *scan_script_statement(const scan_script_t *script, int n);
+
+// Summary and capture table on stdout
+void scan_script_report_print(const scan_script_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
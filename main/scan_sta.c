@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <string.h>
+#include "scan_sta.h"
+
+#define STA_MASK (CONFIG_SCAN_STA_TABLE_SIZE - 1)
+
+// Weight of a new frame in the RSSI average is 1/2^STA_EWMA_SHIFT
+#define STA_EWMA_SHIFT 3
+
+// Fibonacci hashing of the 48-bit address; randomised and vendor-sequential
+// MACs both spread well over the table
+static uint32_t sta_hash(const uint8_t mac[6]) {
+    uint64_t key = 0;
+    for (int i = 0; i < 6; i++) {
+        key = key << 8 | mac[i];
+    }
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 40) & STA_MASK;
+}
+
+void scan_sta_init(scan_sta_table_t *table) {
+    memset(table, 0, sizeof(*table));
+    table->lru_head = SCAN_STA_NONE;
+    table->lru_tail = SCAN_STA_NONE;
+}
+
+static void lru_unlink(scan_sta_table_t *table, uint16_t i) {
+    scan_sta_t *e = &table->slots[i];
+
+    if (e->lru_prev != SCAN_STA_NONE) {
+        table->slots[e->lru_prev].lru_next = e->lru_next;
+    } else {
+        table->lru_head = e->lru_next;
+    }
+    if (e->lru_next != SCAN_STA_NONE) {
+        table->slots[e->lru_next].lru_prev = e->lru_prev;
+    } else {
+        table->lru_tail = e->lru_prev;
+    }
+}
+
+static void lru_push_front(scan_sta_table_t *table, uint16_t i) {
+    scan_sta_t *e = &table->slots[i];
+
+    e->lru_prev = SCAN_STA_NONE;
+    e->lru_next = table->lru_head;
+    if (table->lru_head != SCAN_STA_NONE) {
+        table->slots[table->lru_head].lru_prev = i;
+    } else {
+        table->lru_tail = i;
+    }
+    table->lru_head = i;
+}
+
+// Entry moved from slot from to slot to by deletion; repoint its LRU neighbours
+static void lru_relocate(scan_sta_table_t *table, uint16_t from, uint16_t to) {
+    scan_sta_t *e = &table->slots[to];
+
+    *e = table->slots[from];
+    if (e->lru_prev != SCAN_STA_NONE) {
+        table->slots[e->lru_prev].lru_next = to;
+    } else {
+        table->lru_head = to;
+    }
+    if (e->lru_next != SCAN_STA_NONE) {
+        table->slots[e->lru_next].lru_prev = to;
+    } else {
+        table->lru_tail = to;
+    }
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones
+static void sta_delete(scan_sta_table_t *table, uint16_t i) {
+    lru_unlink(table, i);
+    table->slots[i].used = false;
+    table->count--;
+
+    uint16_t j = i;
+    while (1) {
+        j = (j + 1) & STA_MASK;
+        if (!table->slots[j].used) break;
+
+        // Leave the entry where it is if its home slot lies in (i, j]
+        uint32_t home = sta_hash(table->slots[j].mac);
+        bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (stays) continue;
+
+        lru_relocate(table, j, i);
+        table->slots[j].used = false;
+        i = j;
+    }
+}
+
+scan_sta_t *scan_sta_find(scan_sta_table_t *table, const uint8_t mac[6]) {
+    uint32_t i = sta_hash(mac);
+
+    while (table->slots[i].used) {
+        if (memcmp(table->slots[i].mac, mac, 6) == 0) {
+            return &table->slots[i];
+        }
+        i = (i + 1) & STA_MASK;
+    }
+    return NULL;
+}
+
+scan_sta_t *scan_sta_update(scan_sta_table_t *table, const scan_pkt_rec_t *rec, uint32_t now_ms) {
+    static const uint8_t zero[6];
+    const uint8_t *mac = rec->addr2;
+
+    // A transmitter address is never group addressed
+    if ((mac[0] & 0x01) || memcmp(mac, zero, sizeof(zero)) == 0) {
+        return NULL;
+    }
+
+    uint32_t i = sta_hash(mac);
+    while (table->slots[i].used) {
+        scan_sta_t *e = &table->slots[i];
+        if (memcmp(e->mac, mac, 6) == 0) {
+            e->frames++;
+            e->channel = rec->channel;
+            e->last_seen_ms = now_ms;
+            e->rssi_ewma += (int16_t)((rec->rssi * 16 - e->rssi_ewma) / (1 << STA_EWMA_SHIFT));
+            if (table->lru_head != i) {
+                lru_unlink(table, (uint16_t)i);
+                lru_push_front(table, (uint16_t)i);
+            }
+            return e;
+        }
+        i = (i + 1) & STA_MASK;
+    }
+
+    // New station. Eviction may shift entries, so probe again afterwards.
+    if (table->count >= SCAN_STA_MAX_ENTRIES) {
+        sta_delete(table, table->lru_tail);
+        table->evictions++;
+        i = sta_hash(mac);
+        while (table->slots[i].used) {
+            i = (i + 1) & STA_MASK;
+        }
+    }
+
+    scan_sta_t *e = &table->slots[i];
+    memcpy(e->mac, mac, 6);
+    e->used = true;
+    e->channel = rec->channel;
+    e->rssi_ewma = (int16_t)(rec->rssi * 16);
+    e->frames = 1;
+    e->first_seen_ms = now_ms;
+    e->last_seen_ms = now_ms;
+    lru_push_front(table, (uint16_t)i);
+    table->count++;
+    return e;
+}
+
+static bool sta_better(const scan_sta_t *a, const scan_sta_t *b, scan_sta_order_t order) {
+    switch (order) {
+    case SCAN_STA_BY_RSSI: return a->rssi_ewma > b->rssi_ewma;
+    case SCAN_STA_BY_FRAMES:
+    default:               return a->frames > b->frames;
+    }
+}
+
+size_t scan_sta_top(const scan_sta_table_t *table, scan_sta_order_t order, scan_sta_t *out, size_t max) {
+    size_t n = 0;
+
+    if (order == SCAN_STA_BY_RECENT) {
+        for (uint16_t i = table->lru_head; i != SCAN_STA_NONE && n < max; i = table->slots[i].lru_next) {
+            out[n++] = table->slots[i];
+        }
+        return n;
+    }
+
+    // Insertion into a short sorted list; max is small compared to the table
+    for (int i = 0; i < CONFIG_SCAN_STA_TABLE_SIZE; i++) {
+        const scan_sta_t *e = &table->slots[i];
+        if (!e->used) continue;
+        if (n == max && !sta_better(e, &out[n - 1], order)) continue;
+
+        size_t pos = n < max ? n++ : n - 1;
+        while (pos > 0 && sta_better(e, &out[pos - 1], order)) {
+            out[pos] = out[pos - 1];
+            pos--;
+        }
+        out[pos] = *e;
+    }
+    return n;
+}
+
+void scan_sta_report_print(const scan_sta_table_t *table, const scan_sta_t *top, size_t count, uint32_t now_ms) {
+    printf("# Stations: %u tracked, %lu evicted, capacity %d\n", table->count,
+           (unsigned long)table->evictions, SCAN_STA_MAX_ENTRIES);
+    printf("MAC                Ch  RSSI  Frames     First(s)  Idle(s)\n");
+
+    for (size_t i = 0; i < count; i++) {
+        const scan_sta_t *e = &top[i];
+        printf("%02x:%02x:%02x:%02x:%02x:%02x  %-3u %-5d %-10lu %-9lu %lu\n",
+               e->mac[0], e->mac[1], e->mac[2], e->mac[3], e->mac[4], e->mac[5],
+               e->channel, scan_sta_rssi(e), (unsigned long)e->frames,
+               (unsigned long)(e->first_seen_ms / 1000), (unsigned long)((now_ms - e->last_seen_ms) / 1000));
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Table of transmitters seen on the air, keyed by MAC address (addr2, so
+// access points show up under their BSSID). Open addressing with linear
+// probing in a fixed, statically sized array; entries are also kept on an
+// LRU list so that a full table evicts the station heard from least recently.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "scan_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hash slots, must be a power of two. At most 3/4 of them are used.
+#ifndef CONFIG_SCAN_STA_TABLE_SIZE
+#define CONFIG_SCAN_STA_TABLE_SIZE 256
+#endif
+
+_Static_assert((CONFIG_SCAN_STA_TABLE_SIZE & (CONFIG_SCAN_STA_TABLE_SIZE - 1)) == 0,
+               "CONFIG_SCAN_STA_TABLE_SIZE must be a power of two");
+_Static_assert(CONFIG_SCAN_STA_TABLE_SIZE <= 32768, "LRU links are 16 bit");
+
+#define SCAN_STA_MAX_ENTRIES (CONFIG_SCAN_STA_TABLE_SIZE / 4 * 3)
+#define SCAN_STA_NONE        0xFFFF
+
+typedef struct {
+    uint8_t mac[6];
+    uint8_t channel;            // Channel of the most recent frame
+    bool used;
+    int16_t rssi_ewma;          // dBm in 1/16 units
+    uint16_t lru_prev;          // Towards more recently seen
+    uint16_t lru_next;          // Towards less recently seen
+    uint32_t frames;
+    uint32_t first_seen_ms;
+    uint32_t last_seen_ms;
+} scan_sta_t;
+
+typedef struct {
+    uint16_t count;
+    uint16_t lru_head;          // Most recently seen
+    uint16_t lru_tail;          // Least recently seen, evicted first
+    uint32_t evictions;
+    scan_sta_t slots[CONFIG_SCAN_STA_TABLE_SIZE];
+} scan_sta_table_t;
+
+void scan_sta_init(scan_sta_table_t *table);
+
+// Account one frame to its transmitter, inserting it if new. Frames without a
+// usable transmitter address are ignored. Returns the entry or NULL.
+scan_sta_t *scan_sta_update(scan_sta_table_t *table, const scan_pkt_rec_t *rec, uint32_t now_ms);
+
+scan_sta_t *scan_sta_find(scan_sta_table_t *table, const uint8_t mac[6]);
+
+typedef enum {
+    SCAN_STA_BY_FRAMES,
+    SCAN_STA_BY_RSSI,
+    SCAN_STA_BY_RECENT,
+} scan_sta_order_t;
+
+// Copy up to max entries into out, best first. Returns the number copied.
+size_t scan_sta_top(const scan_sta_table_t *table, scan_sta_order_t order, scan_sta_t *out, size_t max);
+
+static inline int scan_sta_rssi(const scan_sta_t *sta) {
+    return (sta->rssi_ewma >= 0 ? sta->rssi_ewma + 8 : sta->rssi_ewma - 8) / 16;
+}
+
+// Table of the top entries as returned by scan_sta_top
+void scan_sta_report_print(const scan_sta_table_t *table, const scan_sta_t *top, size_t count, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <string.h>
+#include "scan_survey.h"
+
+void scan_survey_init(scan_survey_t *s, uint32_t period_ms) {
+    memset(s, 0, sizeof(*s));
+    s->period_ms = period_ms;
+}
+
+uint32_t scan_survey_sweep_done(scan_survey_t *s, uint32_t awake_ms) {
+    s->sweeps++;
+    s->last_awake_ms = awake_ms;
+    s->awake_total_ms += awake_ms;
+    if (awake_ms >= s->period_ms) {
+        s->overruns++;
+        return 0;
+    }
+    return s->period_ms - awake_ms;
+}
+
+void scan_survey_slept(scan_survey_t *s, uint32_t sleep_ms) {
+    s->last_sleep_ms = sleep_ms;
+    s->sleep_total_ms += sleep_ms;
+}
+
+uint32_t scan_survey_duty_permille(const scan_survey_t *s) {
+    uint64_t total = s->awake_total_ms + s->sleep_total_ms;
+    return total ? (uint32_t)(s->awake_total_ms * 1000 / total) : 1000;
+}
+
+uint32_t scan_survey_avg_current_ua(const scan_survey_t *s, uint32_t active_ua, uint32_t sleep_ua) {
+    uint32_t duty = scan_survey_duty_permille(s);
+    return (uint32_t)(((uint64_t)active_ua * duty + (uint64_t)sleep_ua * (1000 - duty)) / 1000);
+}
+
+void scan_survey_report_print(const scan_survey_t *s, const scan_survey_config_t *cfg) {
+    printf("# Survey mode %s, one sweep every %lu ms\n", cfg->enabled ? "on" : "off",
+           (unsigned long)cfg->period_ms);
+    if (!cfg->enabled || s->sweeps == 0) return;
+
+    uint32_t duty = scan_survey_duty_permille(s);
+    uint32_t avg_ua = scan_survey_avg_current_ua(s, CONFIG_SCAN_SURVEY_ACTIVE_UA, CONFIG_SCAN_SURVEY_SLEEP_UA);
+
+    printf("%-10s %lu, %lu overran the period\n", "sweeps", (unsigned long)s->sweeps, (unsigned long)s->overruns);
+    printf("%-10s %lu ms last, %llu ms average per sweep\n", "awake", (unsigned long)s->last_awake_ms,
+           (unsigned long long)(s->awake_total_ms / s->sweeps));
+    printf("%-10s %lu ms last, %llu ms total\n", "sleep", (unsigned long)s->last_sleep_ms,
+           (unsigned long long)s->sleep_total_ms);
+    printf("%-10s %lu.%lu %%\n", "duty", (unsigned long)(duty / 10), (unsigned long)(duty % 10));
+    printf("%-10s %lu.%02lu mA at %lu mA awake and %lu uA asleep\n", "current", (unsigned long)(avg_ua / 1000),
+           (unsigned long)(avg_ua % 1000 / 10), (unsigned long)(CONFIG_SCAN_SURVEY_ACTIVE_UA / 1000),
+           (unsigned long)CONFIG_SCAN_SURVEY_SLEEP_UA);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// Duty-cycle bookkeeping for the low-power survey mode. One sweep starts
+// every period; the time left after it is spent with the radio off and the
+// chip free to enter light sleep. Awake time runs from wake-up until the
+// sweep is handed to the output writer, so it includes bringing the radio
+// back; the writer keeps the chip awake by itself until the sweep is out.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_SCAN_SURVEY_PERIOD_MS
+#define CONFIG_SCAN_SURVEY_PERIOD_MS 60000
+#endif
+
+// Current draw used for the battery estimate: listening with the CPU at full
+// clock, and light sleep
+#ifndef CONFIG_SCAN_SURVEY_ACTIVE_UA
+#define CONFIG_SCAN_SURVEY_ACTIVE_UA 88000
+#endif
+
+#ifndef CONFIG_SCAN_SURVEY_SLEEP_UA
+#define CONFIG_SCAN_SURVEY_SLEEP_UA 240
+#endif
+
+typedef struct {
+    bool enabled;
+    uint32_t period_ms;     // From one sweep start to the next
+} scan_survey_config_t;
+
+typedef struct {
+    uint32_t period_ms;
+    uint32_t sweeps;
+    uint32_t overruns;          // Sweeps that took the whole period or longer
+    uint32_t last_awake_ms;
+    uint32_t last_sleep_ms;
+    uint64_t awake_total_ms;
+    uint64_t sleep_total_ms;    // Time the chip was allowed to sleep
+} scan_survey_t;
+
+void scan_survey_init(scan_survey_t *s, uint32_t period_ms);
+
+// A sweep kept the chip awake for awake_ms; returns how long to sleep before
+// the next one, 0 if the sweep overran the period
+uint32_t scan_survey_sweep_done(scan_survey_t *s, uint32_t awake_ms);
+
+// Time actually spent asleep, shorter than asked if a console command woke the loop
+void scan_survey_slept(scan_survey_t *s, uint32_t sleep_ms);
+
+// Awake share of the time so far, in permille
+uint32_t scan_survey_duty_permille(const scan_survey_t *s);
+
+// Average current over the time so far with the given active and sleep draw
+uint32_t scan_survey_avg_current_ua(const scan_survey_t *s, uint32_t active_ua, uint32_t sleep_ua);
+
+void scan_survey_report_print(const scan_survey_t *s, const scan_survey_config_t *cfg);
+
+#ifdef __cplusplus
+}
+#endif
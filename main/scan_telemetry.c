@@ -0,0 +1,399 @@
+#include <string.h>
+#include "scan_telemetry.h"
+
+uint16_t scan_tlm_crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static uint16_t get_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+void scan_tlm_begin(scan_tlm_writer_t *w, uint8_t *buf, size_t cap, scan_tlm_type_t type) {
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->section = 0;
+    w->overflow = cap < SCAN_TLM_HEADER_LEN + SCAN_TLM_CRC_LEN;
+    if (w->overflow) return;
+
+    buf[0] = SCAN_TLM_MAGIC0;
+    buf[1] = SCAN_TLM_MAGIC1;
+    buf[2] = SCAN_TLM_VERSION;
+    buf[3] = (uint8_t)type;
+    w->len = SCAN_TLM_HEADER_LEN;  // seq and len are filled in by scan_tlm_end
+}
+
+void scan_tlm_put_bytes(scan_tlm_writer_t *w, const void *data, size_t len) {
+    // Keep room for the CRC, and never grow the payload past the format limit
+    if (w->overflow || w->len + len + SCAN_TLM_CRC_LEN > w->cap ||
+        w->len + len - SCAN_TLM_HEADER_LEN > SCAN_TLM_MAX_PAYLOAD) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+void scan_tlm_put_u8(scan_tlm_writer_t *w, uint8_t v) {
+    scan_tlm_put_bytes(w, &v, 1);
+}
+
+void scan_tlm_put_varint(scan_tlm_writer_t *w, uint32_t v) {
+    uint8_t tmp[5];
+    size_t n = 0;
+
+    do {
+        uint8_t b = v & 0x7F;
+        v >>= 7;
+        tmp[n++] = v ? (b | 0x80) : b;
+    } while (v);
+    scan_tlm_put_bytes(w, tmp, n);
+}
+
+void scan_tlm_put_svarint(scan_tlm_writer_t *w, int32_t v) {
+    scan_tlm_put_varint(w, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+void scan_tlm_section_begin(scan_tlm_writer_t *w, uint32_t tag) {
+    uint8_t len[2] = {0, 0};
+
+    scan_tlm_put_varint(w, tag);
+    w->section = w->len;
+    scan_tlm_put_bytes(w, len, sizeof(len));
+}
+
+void scan_tlm_section_end(scan_tlm_writer_t *w) {
+    if (!w->overflow && w->section) {
+        put_le16(w->buf + w->section, (uint16_t)(w->len - w->section - 2));
+    }
+    w->section = 0;
+}
+
+size_t scan_tlm_end(scan_tlm_writer_t *w, uint16_t seq) {
+    if (w->overflow) return 0;
+
+    put_le16(w->buf + 4, seq);
+    put_le16(w->buf + 6, (uint16_t)(w->len - SCAN_TLM_HEADER_LEN));
+    put_le16(w->buf + w->len, scan_tlm_crc16(w->buf + 2, w->len - 2));
+    w->len += SCAN_TLM_CRC_LEN;
+    return w->len;
+}
+
+static void put_dist(scan_tlm_writer_t *w, uint32_t window_s, const scan_hist_summary_t *summaries) {
+    scan_tlm_section_begin(w, SCAN_TLM_SEC_DIST);
+    scan_tlm_put_varint(w, window_s);
+    for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+        const scan_hist_summary_t *s = &summaries[i];
+
+        scan_tlm_put_varint(w, s->count);
+        if (s->count == 0) continue;
+        scan_tlm_put_svarint(w, s->min);
+        scan_tlm_put_varint(w, (uint32_t)(s->p10 - s->min));
+        scan_tlm_put_varint(w, (uint32_t)(s->p50 - s->p10));
+        scan_tlm_put_varint(w, (uint32_t)(s->p90 - s->p50));
+        scan_tlm_put_varint(w, (uint32_t)(s->max - s->p90));
+    }
+    scan_tlm_section_end(w);
+}
+
+// Sections in the order they go out; the window distributions follow the fixed ones
+#define SWEEP_SECTIONS 6
+
+// Empty section closing a frame that continues in SCAN_TLM_SWEEP_MORE
+#define CONTINUED_LEN  3
+
+static void put_sweep_section(scan_tlm_writer_t *w, int index, const scan_sweep_t *sweep,
+                              const scan_window_snap_t *windows) {
+    switch (index) {
+    case 0:
+        scan_tlm_section_begin(w, SCAN_TLM_SEC_DWELL);
+        for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+            scan_tlm_put_varint(w, sweep->dwell_ms[i]);
+        }
+        scan_tlm_section_end(w);
+        break;
+    case 1:
+        scan_tlm_section_begin(w, SCAN_TLM_SEC_AIRTIME);
+        for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+            scan_tlm_put_varint(w, sweep->airtime_us[i]);
+        }
+        scan_tlm_section_end(w);
+        break;
+    case 2:
+        scan_tlm_section_begin(w, SCAN_TLM_SEC_FRAMES);
+        scan_tlm_put_varint(w, SCAN_FRAME_CLASSES);
+        for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+            scan_tlm_put_varint(w, sweep->retries[i]);
+            for (int cls = 0; cls < SCAN_FRAME_CLASSES; cls++) {
+                scan_tlm_put_varint(w, sweep->frames[i][cls]);
+            }
+        }
+        scan_tlm_section_end(w);
+        break;
+    case 3:
+        scan_tlm_section_begin(w, SCAN_TLM_SEC_NOISE);
+        for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+            bool seen = sweep->nf_min[i] <= sweep->nf_max[i];
+            scan_tlm_put_svarint(w, sweep->nf_avg[i] / (1 << (SCAN_NF_FRAC_BITS - 4)));
+            scan_tlm_put_varint(w, seen ? (uint32_t)(sweep->nf_max[i] - sweep->nf_min[i] + 1) : 0);
+            if (seen) {
+                scan_tlm_put_svarint(w, sweep->nf_min[i]);
+            }
+        }
+        scan_tlm_section_end(w);
+        break;
+    case 4:
+        scan_tlm_section_begin(w, SCAN_TLM_SEC_SNR);
+        scan_tlm_put_varint(w, CONFIG_SCAN_SNR_BIN_DB);
+        for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+            int nbins = SCAN_SNR_BINS;
+            while (nbins > 0 && sweep->snr[i][nbins - 1] == 0) nbins--;
+            scan_tlm_put_varint(w, (uint32_t)nbins);
+            for (int bin = 0; bin < nbins; bin++) {
+                scan_tlm_put_varint(w, sweep->snr[i][bin]);
+            }
+        }
+        scan_tlm_section_end(w);
+        break;
+    case 5: {
+        scan_hist_summary_t sweep_dist[CONFIG_MAX_WIFI_CHANNELS];
+        for (int i = 0; i < CONFIG_MAX_WIFI_CHANNELS; i++) {
+            scan_hist_summarize(&sweep->hist[i], &sweep_dist[i]);
+        }
+        put_dist(w, 0, sweep_dist);
+        break;
+    }
+    default:
+        put_dist(w, windows[index - SWEEP_SECTIONS].length_ms / 1000, windows[index - SWEEP_SECTIONS].ch);
+        break;
+    }
+}
+
+size_t scan_tlm_encode_sweep(uint8_t *buf, size_t cap, uint16_t seq, uint32_t time_ms, const scan_sweep_t *sweep,
+                             const scan_window_snap_t *windows, size_t nwindows, int *next) {
+    scan_tlm_writer_t w;
+    int first = *next;
+    int end = SWEEP_SECTIONS + (int)nwindows;
+    int i;
+
+    scan_tlm_begin(&w, buf, cap, first == 0 ? SCAN_TLM_SWEEP : SCAN_TLM_SWEEP_MORE);
+    scan_tlm_put_varint(&w, sweep->iteration);
+    scan_tlm_put_varint(&w, time_ms);
+    if (first == 0) {
+        int32_t prev_rssi = SCAN_RSSI_FLOOR;
+
+        scan_tlm_put_varint(&w, sweep->dropped);
+        scan_tlm_put_varint(&w, CONFIG_MAX_WIFI_CHANNELS);
+        for (int ch = 0; ch < CONFIG_MAX_WIFI_CHANNELS; ch++) {
+            int32_t rssi = sweep->packet_count[ch] > 0 ? sweep->rssi_values[ch] : SCAN_RSSI_FLOOR;
+            scan_tlm_put_svarint(&w, rssi - prev_rssi);
+            scan_tlm_put_varint(&w, (uint32_t)sweep->packet_count[ch]);
+            scan_tlm_put_varint(&w, (uint32_t)sweep->error_count[ch]);
+            prev_rssi = rssi;
+        }
+    } else {
+        scan_tlm_put_varint(&w, CONFIG_MAX_WIFI_CHANNELS);
+    }
+    if (w.overflow) return 0;
+
+    // Whole sections while they fit, leaving room to mark the frame as continued
+    for (i = first; i < end; i++) {
+        size_t mark = w.len;
+        size_t keep = i + 1 < end ? CONTINUED_LEN : 0;
+
+        put_sweep_section(&w, i, sweep, windows);
+        if (!w.overflow && w.len + keep + SCAN_TLM_CRC_LEN <= w.cap &&
+            w.len + keep - SCAN_TLM_HEADER_LEN <= SCAN_TLM_MAX_PAYLOAD) {
+            continue;
+        }
+        w.len = mark;
+        w.section = 0;
+        w.overflow = false;
+        break;
+    }
+    // A frame with no room for a single section would never finish the sweep
+    if (i == first && i < end) return 0;
+
+    if (i < end) {
+        scan_tlm_section_begin(&w, SCAN_TLM_SEC_CONTINUED);
+        scan_tlm_section_end(&w);
+    }
+    size_t len = scan_tlm_end(&w, seq);
+    if (len > 0) {
+        *next = i < end ? i : 0;
+    }
+    return len;
+}
+
+size_t scan_tlm_encode_aps(uint8_t *buf, size_t cap, uint16_t seq, uint32_t time_ms,
+                           const scan_tlm_ap_t *aps, size_t count) {
+    scan_tlm_writer_t w;
+
+    scan_tlm_begin(&w, buf, cap, SCAN_TLM_APS);
+    scan_tlm_put_varint(&w, time_ms);
+    scan_tlm_put_varint(&w, (uint32_t)count);
+
+    for (size_t i = 0; i < count; i++) {
+        const scan_tlm_ap_t *ap = &aps[i];
+        size_t ssid_len = strnlen(ap->ssid, sizeof(ap->ssid) - 1);
+
+        scan_tlm_put_bytes(&w, ap->bssid, sizeof(ap->bssid));
+        scan_tlm_put_u8(&w, ap->channel);
+        scan_tlm_put_svarint(&w, ap->rssi);
+        scan_tlm_put_u8(&w, ap->authmode);
+        scan_tlm_put_u8(&w, ap->status);
+        scan_tlm_put_u8(&w, (uint8_t)ssid_len);
+        scan_tlm_put_bytes(&w, ap->ssid, ssid_len);
+    }
+    return scan_tlm_end(&w, seq);
+}
+
+void scan_tlm_reader_init(scan_tlm_reader_t *r, const uint8_t *payload, size_t len) {
+    r->p = payload;
+    r->end = payload + len;
+    r->error = false;
+}
+
+bool scan_tlm_get_bytes(scan_tlm_reader_t *r, void *out, size_t len) {
+    if (r->error || (size_t)(r->end - r->p) < len) {
+        r->error = true;
+        memset(out, 0, len);
+        return false;
+    }
+    memcpy(out, r->p, len);
+    r->p += len;
+    return true;
+}
+
+uint8_t scan_tlm_get_u8(scan_tlm_reader_t *r) {
+    uint8_t v;
+    scan_tlm_get_bytes(r, &v, 1);
+    return v;
+}
+
+uint16_t scan_tlm_get_u16(scan_tlm_reader_t *r) {
+    uint8_t v[2];
+    scan_tlm_get_bytes(r, v, 2);
+    return get_le16(v);
+}
+
+uint32_t scan_tlm_get_varint(scan_tlm_reader_t *r) {
+    uint32_t v = 0;
+
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (r->error || r->p >= r->end) {
+            r->error = true;
+            return 0;
+        }
+        uint8_t b = *r->p++;
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return v;
+        }
+    }
+    r->error = true;
+    return 0;
+}
+
+int32_t scan_tlm_get_svarint(scan_tlm_reader_t *r) {
+    uint32_t v = scan_tlm_get_varint(r);
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+void scan_tlm_parser_init(scan_tlm_parser_t *p) {
+    p->len = 0;
+    p->frame_len = 0;
+    p->crc_errors = 0;
+    p->skipped = 0;
+}
+
+// Drop the first buffered byte and move to the next possible frame start
+static void parser_resync(scan_tlm_parser_t *p) {
+    size_t i = 1;
+
+    while (i < p->len && p->buf[i] != SCAN_TLM_MAGIC0) {
+        i++;
+    }
+    p->skipped += i;
+    memmove(p->buf, p->buf + i, p->len - i);
+    p->len -= i;
+}
+
+typedef enum {
+    PARSE_NEED_MORE,
+    PARSE_BAD,
+    PARSE_COMPLETE,
+} parse_state_t;
+
+static parse_state_t parser_check(scan_tlm_parser_t *p) {
+    if (p->len >= 1 && p->buf[0] != SCAN_TLM_MAGIC0) return PARSE_BAD;
+    if (p->len >= 2 && p->buf[1] != SCAN_TLM_MAGIC1) return PARSE_BAD;
+    if (p->len < SCAN_TLM_HEADER_LEN) return PARSE_NEED_MORE;
+
+    uint16_t payload_len = get_le16(p->buf + 6);
+    if (p->buf[2] == 0 || p->buf[2] > SCAN_TLM_VERSION || payload_len > SCAN_TLM_MAX_PAYLOAD) {
+        return PARSE_BAD;
+    }
+
+    size_t total = SCAN_TLM_HEADER_LEN + payload_len + SCAN_TLM_CRC_LEN;
+    if (p->len < total) return PARSE_NEED_MORE;
+
+    uint16_t crc = get_le16(p->buf + total - SCAN_TLM_CRC_LEN);
+    if (crc != scan_tlm_crc16(p->buf + 2, total - SCAN_TLM_CRC_LEN - 2)) {
+        p->crc_errors++;
+        return PARSE_BAD;
+    }
+    return PARSE_COMPLETE;
+}
+
+size_t scan_tlm_parser_feed(scan_tlm_parser_t *p, const uint8_t *data, size_t len,
+                            scan_tlm_frame_t *frame, bool *have_frame) {
+    size_t used = 0;
+
+    *have_frame = false;
+
+    // A frame returned by the previous call is still at the front of the buffer
+    if (p->frame_len) {
+        memmove(p->buf, p->buf + p->frame_len, p->len - p->frame_len);
+        p->len -= p->frame_len;
+        p->frame_len = 0;
+    }
+
+    for (;;) {
+        parse_state_t state = parser_check(p);
+        while (state == PARSE_BAD) {
+            parser_resync(p);
+            state = parser_check(p);
+        }
+
+        if (state == PARSE_COMPLETE) {
+            frame->version = p->buf[2];
+            frame->type = p->buf[3];
+            frame->seq = get_le16(p->buf + 4);
+            frame->len = get_le16(p->buf + 6);
+            frame->payload = p->buf + SCAN_TLM_HEADER_LEN;
+            p->frame_len = SCAN_TLM_HEADER_LEN + frame->len + SCAN_TLM_CRC_LEN;
+            *have_frame = true;
+            return used;
+        }
+
+        if (used == len) {
+            return used;
+        }
+        p->buf[p->len++] = data[used++];
+    }
+}
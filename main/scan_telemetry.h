@@ -0,0 +1,178 @@
+#pragma once
+
+// Framed binary telemetry. Every frame is
+//
+//   magic[2] = A5 5C | version | type | seq (u16 LE) | len (u16 LE) | payload[len] | crc (u16 LE)
+//
+// The CRC is CRC-16/CCITT-FALSE over version..payload, so a reader can hunt
+// for the magic in a byte stream shared with log output and resynchronise on
+// the next valid frame. Sequence numbers let the reader count lost frames;
+// SCAN_TLM_PCAP frames come from their own writer and have a sequence of their own.
+//
+// Payload integers are LEB128 varints, signed values are zigzag encoded.
+// A sweep payload is
+//
+//   iteration, time_ms, dropped, nchan,
+//   nchan x { rssi delta to previous channel (signed), packets, errors },
+//   optional sections { tag, len (u16 LE), bytes[len] } until the end
+//
+// Readers must skip sections whose tag they do not know, which is how new
+// per-sweep data is added without bumping the version. A sweep that does not
+// fit one frame ends with an empty SCAN_TLM_SEC_CONTINUED section and goes on
+// in SCAN_TLM_SWEEP_MORE frames of
+//
+//   iteration, time_ms, nchan, sections as above
+//
+// each carrying whole sections, the last one without the marker. Known sections:
+//
+//   SCAN_TLM_SEC_DWELL   nchan x dwell_ms, 0 for channels skipped by the scheduler
+//   SCAN_TLM_SEC_DIST    window_s (0 for the sweep itself), nchan x { count,
+//                        and if count > 0: min (signed), p10 - min, p50 - p10,
+//                        p90 - p50, max - p90 }. One section per window.
+//   SCAN_TLM_SEC_AIRTIME nchan x estimated busy airtime in microseconds
+//   SCAN_TLM_SEC_FRAMES  nclass, nchan x { retries, nclass x frames }, classes
+//                        in scan_frame_class_t order
+//   SCAN_TLM_SEC_NOISE   nchan x { running average in 1/16 dBm (signed, 0 if
+//                        no frame has reported one yet), range, which is 0 if
+//                        no frame this sweep did and max - min + 1 otherwise,
+//                        and if range > 0: min (signed) }
+//   SCAN_TLM_SEC_SNR     bin_db, nchan x { nbins, nbins x frames }: frames by
+//                        RSSI minus noise floor, bin i from i x bin_db, the
+//                        first bin also below and the last also above. Empty
+//                        bins at the top are left out.
+//   SCAN_TLM_SEC_CONTINUED empty, the sweep goes on in the next frame
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "scan_core.h"
+#include "scan_window.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCAN_TLM_MAGIC0        0xA5
+#define SCAN_TLM_MAGIC1        0x5C
+#define SCAN_TLM_VERSION       1
+#define SCAN_TLM_HEADER_LEN    8
+#define SCAN_TLM_CRC_LEN       2
+#define SCAN_TLM_MAX_PAYLOAD   1024
+#define SCAN_TLM_MAX_FRAME     (SCAN_TLM_HEADER_LEN + SCAN_TLM_MAX_PAYLOAD + SCAN_TLM_CRC_LEN)
+
+typedef enum {
+    SCAN_TLM_SWEEP = 1,      // One packet-RSSI sweep
+    SCAN_TLM_APS   = 2,      // Access point scan results
+    SCAN_TLM_PCAP  = 3,      // Captured frames as pcap records, see scan_pcap.h
+    SCAN_TLM_STATS = 4,      // Hot-path timing, drops and task load, see scan_prof.h
+    SCAN_TLM_EVENTS = 5,     // Anomaly events and heartbeats, see scan_anom.h
+    SCAN_TLM_DEVICES = 6,    // Distinct transmitter sketches, see scan_devices.h
+    SCAN_TLM_SWEEP_MORE = 7, // Sections of a sweep that did not fit its frame
+} scan_tlm_type_t;
+
+typedef enum {
+    SCAN_TLM_SEC_DWELL = 1,
+    SCAN_TLM_SEC_DIST = 2,
+    SCAN_TLM_SEC_AIRTIME = 3,
+    SCAN_TLM_SEC_FRAMES = 4,
+    SCAN_TLM_SEC_NOISE = 5,
+    SCAN_TLM_SEC_SNR = 6,
+    SCAN_TLM_SEC_CONTINUED = 7,
+} scan_tlm_section_t;
+
+// Access point entry in an SCAN_TLM_APS payload:
+//   time_ms, count, count x { bssid[6], channel, rssi (signed), authmode, status, ssid_len, ssid }
+// The scanner sends only changes to its AP table; a frame with count 0 marks
+// a scan that changed nothing.
+typedef enum {
+    SCAN_TLM_AP_SEEN = 0,       // Plain scan result
+    SCAN_TLM_AP_NEW = 1,
+    SCAN_TLM_AP_CHANGED = 2,    // Channel, SSID, auth mode or smoothed RSSI moved
+    SCAN_TLM_AP_EXPIRED = 3,    // Not seen for a while, dropped from the table
+} scan_tlm_ap_status_t;
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;
+    uint8_t authmode;
+    uint8_t status;         // scan_tlm_ap_status_t
+    char ssid[33];
+} scan_tlm_ap_t;
+
+// Frame builder
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;             // Bytes written including the header
+    size_t section;         // Offset of the open section's length field, 0 if none
+    bool overflow;
+} scan_tlm_writer_t;
+
+void scan_tlm_begin(scan_tlm_writer_t *w, uint8_t *buf, size_t cap, scan_tlm_type_t type);
+void scan_tlm_put_u8(scan_tlm_writer_t *w, uint8_t v);
+void scan_tlm_put_varint(scan_tlm_writer_t *w, uint32_t v);
+void scan_tlm_put_svarint(scan_tlm_writer_t *w, int32_t v);
+void scan_tlm_put_bytes(scan_tlm_writer_t *w, const void *data, size_t len);
+void scan_tlm_section_begin(scan_tlm_writer_t *w, uint32_t tag);
+void scan_tlm_section_end(scan_tlm_writer_t *w);
+
+// Seal the frame, returns its total length or 0 if it did not fit
+size_t scan_tlm_end(scan_tlm_writer_t *w, uint16_t seq);
+
+// Complete frames for the record types above, return 0 if buf is too small.
+// Each window adds an RSSI distribution section after the sweep's own one.
+// A sweep goes out in as many frames as it needs: start with *next at 0 and
+// call again with the following sequence number until *next is back to 0.
+size_t scan_tlm_encode_sweep(uint8_t *buf, size_t cap, uint16_t seq, uint32_t time_ms, const scan_sweep_t *sweep,
+                             const scan_window_snap_t *windows, size_t nwindows, int *next);
+size_t scan_tlm_encode_aps(uint8_t *buf, size_t cap, uint16_t seq, uint32_t time_ms,
+                           const scan_tlm_ap_t *aps, size_t count);
+
+// Payload reader
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool error;             // Set on truncated or malformed input, reads then return 0
+} scan_tlm_reader_t;
+
+void scan_tlm_reader_init(scan_tlm_reader_t *r, const uint8_t *payload, size_t len);
+uint8_t scan_tlm_get_u8(scan_tlm_reader_t *r);
+uint16_t scan_tlm_get_u16(scan_tlm_reader_t *r);
+uint32_t scan_tlm_get_varint(scan_tlm_reader_t *r);
+int32_t scan_tlm_get_svarint(scan_tlm_reader_t *r);
+bool scan_tlm_get_bytes(scan_tlm_reader_t *r, void *out, size_t len);
+
+static inline bool scan_tlm_reader_done(const scan_tlm_reader_t *r) {
+    return r->error || r->p >= r->end;
+}
+
+// Incremental stream parser. Bytes that are not part of a valid frame are skipped.
+typedef struct {
+    uint8_t buf[SCAN_TLM_MAX_FRAME];
+    size_t len;
+    size_t frame_len;       // Frame handed out by the last feed, dropped on the next one
+    uint32_t crc_errors;    // Frames with a valid header but a bad CRC
+    uint32_t skipped;       // Bytes discarded while hunting for a frame
+} scan_tlm_parser_t;
+
+typedef struct {
+    uint8_t version;
+    uint8_t type;
+    uint16_t seq;
+    uint16_t len;
+    const uint8_t *payload; // Valid until the next call into the parser
+} scan_tlm_frame_t;
+
+void scan_tlm_parser_init(scan_tlm_parser_t *p);
+
+// Consumes bytes from data until a frame is complete. Returns the number of
+// bytes consumed; *frame is filled and *have_frame set when one was found.
+size_t scan_tlm_parser_feed(scan_tlm_parser_t *p, const uint8_t *data, size_t len,
+                            scan_tlm_frame_t *frame, bool *have_frame);
+
+uint16_t scan_tlm_crc16(const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <string.h>
+#include "scan_top.h"
+
+#define INDEX_MASK (SCAN_TOP_INDEX - 1)
+
+static uint64_t mac_key(const uint8_t mac[6]) {
+    uint64_t key = 0;
+    for (int i = 0; i < 6; i++) {
+        key = key << 8 | mac[i];
+    }
+    return key;
+}
+
+static uint32_t key_hash(uint64_t key) {
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & INDEX_MASK;
+}
+
+void scan_top_reset(scan_top_t *s) {
+    memset(s, 0, sizeof(*s));
+    memset(s->index, SCAN_TOP_NONE, sizeof(s->index));
+}
+
+static size_t find(const scan_top_t *s, uint64_t key) {
+    for (uint32_t i = key_hash(key); s->index[i] != SCAN_TOP_NONE; i = (i + 1) & INDEX_MASK) {
+        if (s->heap[s->index[i]].key == key) {
+            return s->index[i];
+        }
+    }
+    return SCAN_TOP_NONE;
+}
+
+static void index_insert(scan_top_t *s, size_t pos) {
+    uint32_t i = key_hash(s->heap[pos].key);
+    while (s->index[i] != SCAN_TOP_NONE) {
+        i = (i + 1) & INDEX_MASK;
+    }
+    s->index[i] = (uint8_t)pos;
+    s->slot[pos] = (uint16_t)i;
+}
+
+// Backward-shift deletion, as in the station table
+static void index_delete(scan_top_t *s, uint32_t i) {
+    s->index[i] = SCAN_TOP_NONE;
+
+    uint32_t j = i;
+    while (1) {
+        j = (j + 1) & INDEX_MASK;
+        if (s->index[j] == SCAN_TOP_NONE) break;
+
+        uint32_t home = key_hash(s->heap[s->index[j]].key);
+        bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (stays) continue;
+
+        s->index[i] = s->index[j];
+        s->slot[s->index[i]] = (uint16_t)i;
+        s->index[j] = SCAN_TOP_NONE;
+        i = j;
+    }
+}
+
+static void swap(scan_top_t *s, size_t a, size_t b) {
+    scan_top_counter_t t = s->heap[a];
+    s->heap[a] = s->heap[b];
+    s->heap[b] = t;
+
+    uint16_t slot = s->slot[a];
+    s->slot[a] = s->slot[b];
+    s->slot[b] = slot;
+    s->index[s->slot[a]] = (uint8_t)a;
+    s->index[s->slot[b]] = (uint8_t)b;
+}
+
+static void sift_up(scan_top_t *s, size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (s->heap[parent].count <= s->heap[i].count) break;
+        swap(s, parent, i);
+        i = parent;
+    }
+}
+
+static void sift_down(scan_top_t *s, size_t i) {
+    while (1) {
+        size_t least = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < s->used && s->heap[left].count < s->heap[least].count) least = left;
+        if (right < s->used && s->heap[right].count < s->heap[least].count) least = right;
+        if (least == i) break;
+        swap(s, least, i);
+        i = least;
+    }
+}
+
+// Halving is monotonic, so the heap stays a heap. Errors round up so that
+// count minus error stays a lower bound.
+static void halve(scan_top_t *s) {
+    for (size_t i = 0; i < s->used; i++) {
+        s->heap[i].count /= 2;
+        s->heap[i].error = (s->heap[i].error + 1) / 2;
+        if (s->heap[i].error > s->heap[i].count) s->heap[i].error = s->heap[i].count;
+    }
+    s->total /= 2;
+}
+
+void scan_top_add(scan_top_t *s, const uint8_t mac[6], uint32_t weight) {
+    uint64_t key = mac_key(mac);
+
+    if (weight == 0) return;
+    while (s->total > UINT32_MAX - weight) {
+        halve(s);
+    }
+    s->total += weight;
+
+    size_t pos = find(s, key);
+    if (pos != SCAN_TOP_NONE) {
+        s->heap[pos].count += weight;
+        sift_down(s, pos);
+        return;
+    }
+
+    if (s->used < CONFIG_SCAN_TOP_COUNTERS) {
+        pos = s->used++;
+        s->heap[pos] = (scan_top_counter_t){.key = key, .count = weight};
+        index_insert(s, pos);
+        sift_up(s, pos);
+        return;
+    }
+
+    // The smallest counter changes hands; its count is all the newcomer may have had before
+    scan_top_counter_t *min = &s->heap[0];
+    index_delete(s, s->slot[0]);
+    min->key = key;
+    min->error = min->count;
+    min->count += weight;
+    index_insert(s, 0);
+    sift_down(s, 0);
+}
+
+size_t scan_top_list(const scan_top_t *s, scan_top_entry_t *out, size_t max) {
+    size_t n = 0;
+
+    // A transmitter without a counter weighs at most the smallest count
+    uint32_t left_out = s->used == CONFIG_SCAN_TOP_COUNTERS ? s->heap[0].count : 0;
+
+    if (max == 0) return 0;
+    for (size_t i = 0; i < s->used; i++) {
+        const scan_top_counter_t *c = &s->heap[i];
+        if (n == max && c->count <= out[n - 1].count) {
+            if (c->count > left_out) left_out = c->count;
+            continue;
+        }
+        if (n == max && out[n - 1].count > left_out) {
+            left_out = out[n - 1].count;
+        }
+
+        size_t pos = n < max ? n++ : n - 1;
+        while (pos > 0 && c->count > out[pos - 1].count) {
+            out[pos] = out[pos - 1];
+            pos--;
+        }
+        for (int b = 0; b < 6; b++) {
+            out[pos].mac[b] = (uint8_t)(c->key >> (8 * (5 - b)));
+        }
+        out[pos].count = c->count;
+        out[pos].error = c->error;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        out[i].guaranteed = out[i].count - out[i].error >= left_out;
+    }
+    return n;
+}
+
+void scan_top_report_print(const char *title, const scan_top_t *s, const scan_top_entry_t *top, size_t count,
+                           const char *unit) {
+    printf("# %s: %lu %s in total, anyone above %lu %s is listed; * certainly in this top %zu\n", title,
+           (unsigned long)s->total, unit, (unsigned long)scan_top_bound(s), unit, count);
+    printf("MAC                  %-10s Error      Share\n", unit);
+
+    for (size_t i = 0; i < count; i++) {
+        const scan_top_entry_t *e = &top[i];
+        printf("%02x:%02x:%02x:%02x:%02x:%02x %c  %-10lu %-10lu %5.1f%%\n",
+               e->mac[0], e->mac[1], e->mac[2], e->mac[3], e->mac[4], e->mac[5], e->guaranteed ? '*' : ' ',
+               (unsigned long)e->count, (unsigned long)e->error,
+               s->total ? 100.0 * e->count / s->total : 0.0);
+    }
+}
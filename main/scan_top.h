@@ -0,0 +1,86 @@
+#pragma once
+
+// Heaviest transmitters of a stream in bounded memory (Space-Saving). A
+// summary keeps CONFIG_SCAN_TOP_COUNTERS counters of address and weight. A
+// known address adds its weight to its counter; a new one takes over the
+// smallest counter and starts from its count plus the weight, remembering
+// the count it started from as its error. Every count is then at most its
+// error above the true weight, and any transmitter with more than
+// total / counters of the weight has a counter. The counters form a min-heap
+// on count, so the smallest is at the root, and a hash index maps addresses
+// to heap positions, so an update costs a probe or two and a sift of at
+// most log2(counters) steps.
+//
+// Reading the top is sorting the counters, nothing more. When the total
+// would no longer fit in 32 bits every count, error and the total are
+// halved, which keeps the order and the bounds and lets old traffic fade.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Counters per summary, the error bound is total / counters
+#ifndef CONFIG_SCAN_TOP_COUNTERS
+#define CONFIG_SCAN_TOP_COUNTERS 32
+#endif
+
+_Static_assert(CONFIG_SCAN_TOP_COUNTERS >= 2 && CONFIG_SCAN_TOP_COUNTERS <= 255,
+               "CONFIG_SCAN_TOP_COUNTERS must be 2~255");
+
+typedef struct {
+    uint64_t key;       // Address as a 48-bit number, first octet most significant
+    uint32_t count;     // Weight, at most error above the true weight
+    uint32_t error;
+} scan_top_counter_t;
+
+// Index slots, a power of two at least twice the counters
+#define SCAN_TOP_INDEX (CONFIG_SCAN_TOP_COUNTERS <= 8 ? 16 : CONFIG_SCAN_TOP_COUNTERS <= 16 ? 32 :  \
+                        CONFIG_SCAN_TOP_COUNTERS <= 32 ? 64 : CONFIG_SCAN_TOP_COUNTERS <= 64 ? 128 : \
+                        CONFIG_SCAN_TOP_COUNTERS <= 128 ? 256 : 512)
+#define SCAN_TOP_NONE  0xFF
+
+typedef struct {
+    uint32_t total;     // Weight added, halved together with the counts
+    uint8_t used;
+    scan_top_counter_t heap[CONFIG_SCAN_TOP_COUNTERS];
+    uint16_t slot[CONFIG_SCAN_TOP_COUNTERS];    // Index slot of each heap entry
+    uint8_t index[SCAN_TOP_INDEX];              // Heap position per slot, open addressing
+} scan_top_t;
+
+// One entry of a report, best first
+typedef struct {
+    uint8_t mac[6];
+    bool guaranteed;    // Certainly among the top entries returned
+    uint32_t count;
+    uint32_t error;
+} scan_top_entry_t;
+
+void scan_top_reset(scan_top_t *s);
+
+void scan_top_add(scan_top_t *s, const uint8_t mac[6], uint32_t weight);
+
+// Weight above which a transmitter certainly has a counter
+static inline uint32_t scan_top_bound(const scan_top_t *s) {
+    return s->total / CONFIG_SCAN_TOP_COUNTERS;
+}
+
+// Up to max heaviest entries, best first. An entry is guaranteed when its
+// count minus its error is at least the count of every entry left out, so
+// no transmitter outside the list can be heavier.
+size_t scan_top_list(const scan_top_t *s, scan_top_entry_t *out, size_t max);
+
+// Table of a list from scan_top_list; unit names the weight
+void scan_top_report_print(const char *title, const scan_top_t *s, const scan_top_entry_t *top, size_t count,
+                           const char *unit);
+
+#ifdef __cplusplus
+}
+#endif
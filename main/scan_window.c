@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <string.h>
+#include "scan_window.h"
+
+void scan_window_init(scan_window_t *win, uint32_t length_ms, int nslots) {
+    memset(win, 0, sizeof(*win));
+    if (nslots < 1) nslots = 1;
+    if (nslots > SCAN_WINDOW_MAX_SLOTS) nslots = SCAN_WINDOW_MAX_SLOTS;
+
+    win->length_ms = length_ms;
+    win->nslots = nslots;
+    win->slot_ms = length_ms / (uint32_t)nslots;
+    if (win->slot_ms == 0) win->slot_ms = 1;
+}
+
+// Drop the oldest slot from the total and reuse it as the current one
+static void window_rotate(scan_window_t *win) {
+    win->cur = (win->cur + 1) % win->nslots;
+    for (int ch = 0; ch < CONFIG_MAX_WIFI_CHANNELS; ch++) {
+        scan_hist_t *old = &win->slots[win->cur][ch];
+        if (old->count == 0) continue;
+        scan_hist_subtract(&win->total[ch], old);
+        scan_hist_reset(old);
+    }
+    win->slot_start_ms += win->slot_ms;
+}
+
+void scan_window_add(scan_window_t *win, const scan_sweep_t *sweep, uint32_t now_ms) {
+    if (!win->started) {
+        win->started = true;
+        win->slot_start_ms = now_ms;
+    }
+
+    // After a long pause every slot has expired; no need to rotate one by one
+    if (now_ms - win->slot_start_ms >= win->length_ms + win->slot_ms) {
+        memset(win->total, 0, sizeof(win->total));
+        memset(win->slots, 0, sizeof(win->slots));
+        win->slot_start_ms = now_ms;
+    }
+    while (now_ms - win->slot_start_ms >= win->slot_ms) {
+        window_rotate(win);
+    }
+
+    for (int ch = 0; ch < CONFIG_MAX_WIFI_CHANNELS; ch++) {
+        scan_hist_merge(&win->slots[win->cur][ch], &sweep->hist[ch]);
+        scan_hist_merge(&win->total[ch], &sweep->hist[ch]);
+    }
+}
+
+static int8_t clamp_rssi(int8_t v, int8_t lo, int8_t hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+void scan_window_summarize(const scan_window_t *win, int channel, scan_hist_summary_t *out) {
+    const int ch = channel - 1;
+
+    scan_hist_summarize(&win->total[ch], out);
+
+    // Subtraction cannot undo min and max, the live slots still know them
+    bool first = true;
+    for (int s = 0; s < win->nslots; s++) {
+        const scan_hist_t *h = &win->slots[s][ch];
+        if (h->count == 0) continue;
+        if (first || h->min < out->min) out->min = h->min;
+        if (first || h->max > out->max) out->max = h->max;
+        first = false;
+    }
+    out->p10 = clamp_rssi(out->p10, out->min, out->max);
+    out->p50 = clamp_rssi(out->p50, out->min, out->max);
+    out->p90 = clamp_rssi(out->p90, out->min, out->max);
+}
+
+void scan_window_snapshot(const scan_window_t *win, scan_window_snap_t *out) {
+    out->length_ms = win->length_ms;
+    for (int channel = 1; channel <= CONFIG_MAX_WIFI_CHANNELS; channel++) {
+        scan_window_summarize(win, channel, &out->ch[channel - 1]);
+    }
+}
+
+static void print_summary(const scan_hist_summary_t *s) {
+    if (s->count == 0) {
+        printf(" %7s %19s", "0", "-");
+        return;
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%d/%d/%d/%d/%d", s->min, s->p10, s->p50, s->p90, s->max);
+    printf(" %7lu %19s", (unsigned long)s->count, buf);
+}
+
+void scan_dist_report_print(const scan_sweep_t *sweep, const scan_window_snap_t *windows, size_t nwindows) {
+    printf("# RSSI distribution: count and min/p10/p50/p90/max (dBm)\n");
+    printf("Ch  %27s", "Sweep");
+    for (size_t w = 0; w < nwindows; w++) {
+        char title[16];
+        uint32_t len_s = windows[w].length_ms / 1000;
+        if (len_s % 60 == 0) {
+            snprintf(title, sizeof(title), "%lu min", (unsigned long)(len_s / 60));
+        } else {
+            snprintf(title, sizeof(title), "%lu s", (unsigned long)len_s);
+        }
+        printf(" %27s", title);
+    }
+    printf("\n");
+
+    for (int channel = 1; channel <= CONFIG_MAX_WIFI_CHANNELS; channel++) {
+        scan_hist_summary_t s;
+
+        printf("%-3d", channel);
+        scan_hist_summarize(&sweep->hist[channel - 1], &s);
+        print_summary(&s);
+        for (size_t w = 0; w < nwindows; w++) {
+            print_summary(&windows[w].ch[channel - 1]);
+        }
+        printf("\n");
+    }
+}
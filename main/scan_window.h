@@ -0,0 +1,53 @@
+#pragma once
+
+// RSSI distributions over longer windows than one sweep, built from sweep
+// histograms. A window is split into slots; finished sweeps are merged into
+// the current slot and into a running total, and when a slot expires its
+// histogram is subtracted from the total again. The window therefore covers
+// between (slots - 1) and slots slot lengths of history, with memory fixed at
+// slots + 1 histograms per channel.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "scan_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCAN_WINDOW_MAX_SLOTS 6
+
+typedef struct {
+    uint32_t length_ms;
+    uint32_t slot_ms;
+    int nslots;
+    int cur;
+    bool started;
+    uint32_t slot_start_ms;
+    scan_hist_t total[CONFIG_MAX_WIFI_CHANNELS];
+    scan_hist_t slots[SCAN_WINDOW_MAX_SLOTS][CONFIG_MAX_WIFI_CHANNELS];
+} scan_window_t;
+
+// Per-channel summaries of a window at one moment, enough to report it
+// after the window itself has moved on
+typedef struct {
+    uint32_t length_ms;
+    scan_hist_summary_t ch[CONFIG_MAX_WIFI_CHANNELS];
+} scan_window_snap_t;
+
+void scan_window_init(scan_window_t *win, uint32_t length_ms, int nslots);
+
+// Merge a finished sweep that ended at now_ms
+void scan_window_add(scan_window_t *win, const scan_sweep_t *sweep, uint32_t now_ms);
+
+void scan_window_summarize(const scan_window_t *win, int channel, scan_hist_summary_t *out);
+
+void scan_window_snapshot(const scan_window_t *win, scan_window_snap_t *out);
+
+// Per-channel count and min/p10/p50/p90/max for the sweep and each window
+void scan_dist_report_print(const scan_sweep_t *sweep, const scan_window_snap_t *windows, size_t nwindows);
+
+#ifdef __cplusplus
+}
+#endif